@@ -2,6 +2,8 @@
 #define NDCRASHDEMO_NDCRASH_H
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
 
 /**
  * Enum representing supported unwinders for stack unwinding.
@@ -11,7 +13,10 @@ enum ndcrash_unwinder {                      // Supported modes
     ndcrash_unwinder_libunwind,              // Both
     ndcrash_unwinder_libunwindstack,         // Both
     ndcrash_unwinder_cxxabi,                 // In-process only
-    ndcrash_unwinder_stackscan,              // In-process only
+    ndcrash_unwinder_stackscan,              // Both
+    ndcrash_unwinder_framepointer,           // Both, arm64 and x86 only
+    ndcrash_unwinder_cfi,                    // In-process only, arm64 and x86 only
+    ndcrash_unwinder_ehabi,                  // Both, 32-bit arm only
 };
 
 /**
@@ -45,8 +50,96 @@ enum ndcrash_error {
 
     /// A background out-of-process service has failed to start.
     ndcrash_error_service_start_failed,
+
+    /// Error during memory allocation for internal data structures.
+    ndcrash_error_memory,
 };
 
+/**
+ * Destinations where crash report lines are written. Values are bit flags that may be combined.
+ */
+enum ndcrash_output {
+
+    /// Android log (logcat), standard error stream on other platforms. Library diagnostic
+    /// messages are also written here.
+    ndcrash_output_log = 1,
+
+    /// Crash report file passed on initialization.
+    ndcrash_output_file = 2,
+
+    /// File descriptor set by ndcrash_set_output_fd.
+    ndcrash_output_fd = 4,
+
+    /// In-memory ring buffer set by ndcrash_set_output_ring.
+    ndcrash_output_ring = 8,
+
+    /// Callback set by ndcrash_set_output_callback.
+    ndcrash_output_callback = 16,
+};
+
+/**
+ * Type for output callback.
+ *
+ * @param line Crash report line including a new line character, not null-terminated.
+ * @param length Line length in bytes.
+ * @param arg Argument value that was previously passed to ndcrash_set_output_callback function.
+ */
+typedef void (*ndcrash_output_callback_func)(const char *line, size_t length, void *arg);
+
+/**
+ * Sets destinations where crash report lines are written. By default log and file outputs are
+ * enabled. Should be called before initialization, outputs are used from a signal handler in
+ * in-process mode.
+ * @param outputs Bit mask of ndcrash_output values.
+ */
+void ndcrash_set_outputs(unsigned outputs);
+
+/**
+ * Sets a file descriptor for ndcrash_output_fd output. Writes are buffered, a buffer is written
+ * when a report is finished.
+ * @param fd File descriptor, negative value to unset.
+ */
+void ndcrash_set_output_fd(int fd);
+
+/**
+ * Sets a callback for ndcrash_output_callback output. Called for every line, in in-process mode
+ * it's called from a signal handler so it should be signal safe.
+ * @param callback Callback function, NULL to unset.
+ * @param arg Argument for a callback.
+ */
+void ndcrash_set_output_callback(ndcrash_output_callback_func callback, void *arg);
+
+/**
+ * Allocates an in-memory ring buffer for ndcrash_output_ring output. When it's full the oldest
+ * data is overwritten. A previous buffer is freed.
+ * @param size Size of a buffer in bytes, 0 to free a buffer.
+ * @return Flag whether allocation is successful.
+ */
+bool ndcrash_set_output_ring(size_t size);
+
+/**
+ * Copies the most recent data of ndcrash_output_ring output in order of writing.
+ * @param buffer Buffer where to copy.
+ * @param size Size of buffer in bytes.
+ * @return Count of copied bytes.
+ */
+size_t ndcrash_get_output_ring(char *buffer, size_t size);
+
+/**
+ * Sets fallback unwinders. An unwinder passed on initialization is tried first, if its backtrace
+ * is poor fallback unwinders are tried in order until a backtrace is good enough. A backtrace is
+ * good enough if it has at least min_frames frames or reaches a thread start function. When no
+ * backtrace is good enough the deepest one is written. Unwinders that have been tried and their
+ * timings are written to a report after a backtrace. Unwinders not supported in a working mode
+ * are skipped. Should be called before ndcrash_in_init or ndcrash_out_start_daemon.
+ * @param unwinders Fallback unwinders in order of trying, NULL to disable fallback. The first
+ * NDCRASH_MAX_UNWINDERS - 1 elements are used.
+ * @param count Count of elements in unwinders array.
+ * @param min_frames Minimum count of frames of a good backtrace, 0 for a default value configured
+ * by NDCRASH_UNWIND_MIN_FRAMES macro.
+ */
+void ndcrash_set_fallback_unwinders(const enum ndcrash_unwinder *unwinders, size_t count, size_t min_frames);
+
 /**
  * Initializes crash reporting library in in-process mode.
  *
@@ -63,6 +156,49 @@ enum ndcrash_error ndcrash_in_init(const enum ndcrash_unwinder unwinder, const c
  */
 bool ndcrash_in_deinit();
 
+/**
+ * Refreshes a list of loaded modules that is used by in-process mode for stack unwinding. In-process
+ * mode doesn't parse a memory map in a signal handler, it uses a list collected in advance instead.
+ * This function should be called after a library is loaded or unloaded by a method other than
+ * ndcrash_in_dlopen and ndcrash_in_dlclose, for example, by System.loadLibrary Java method.
+ * Thread safe, does nothing if in-process mode isn't initialized. If a crash report is being
+ * created by another thread, waits until it's done before freeing a previous list.
+ */
+void ndcrash_in_refresh_modules();
+
+/**
+ * Wrapper around dlopen function that refreshes a list of loaded modules for in-process mode.
+ * Arguments and return value are the same as for dlopen.
+ */
+void *ndcrash_in_dlopen(const char *filename, int flags);
+
+/**
+ * Wrapper around dlclose function that refreshes a list of loaded modules for in-process mode.
+ * Arguments and return value are the same as for dlclose.
+ */
+int ndcrash_in_dlclose(void *handle);
+
+/**
+ * Installs a large alternate signal stack for a current thread in in-process mode. Its size is
+ * configured by NDCRASH_IN_ALTSTACK_SIZE macro. Default alternate stack set by bionic is too small
+ * for unwinding, this function should be called once from every thread that isn't created by
+ * ndcrash_in_pthread_create. A thread calling ndcrash_in_init gets a stack automatically.
+ * @return Flag whether a current thread has an alternate stack of sufficient size. False if
+ * in-process mode isn't initialized.
+ */
+bool ndcrash_in_install_altstack();
+
+/**
+ * Wrapper around pthread_create function that installs a large alternate signal stack for a new
+ * thread in in-process mode, see ndcrash_in_install_altstack. Arguments and return value are the
+ * same as for pthread_create.
+ */
+int ndcrash_in_pthread_create(
+        pthread_t *thread,
+        const pthread_attr_t *attr,
+        void *(*start_routine)(void *),
+        void *arg);
+
 /**
  * Initializes crash reporting library in out-of-process mode. This method should be called from
  * the main process of an application.
@@ -89,11 +225,47 @@ typedef void (*ndcrash_daemon_start_stop_callback)(void *arg);
 /**
  * Type for a crash callback.
  *
- * @param report_file Path to a crash report file that has just been generated.
+ * @param report_file Path to a crash report file that has just been generated. By default it's
+ * a report file passed to ndcrash_out_start_daemon. If an executor thread is enabled by
+ * ndcrash_out_set_crash_callback_policy it's a unique file "<report_file>.<pid>.<number>" that isn't
+ * overwritten by next crashes, a callback owns it and should delete it after processing. A path
+ * is valid only during a callback call.
  * @param arg Argument value that was previously passed to ndcrash_out_start_daemon function.
  */
 typedef void (*ndcrash_daemon_crash_callback)(const char *report_file, void *arg);
 
+/**
+ * Policy of crash callback execution in out-of-process mode.
+ */
+enum ndcrash_crash_callback_policy {
+
+    /// A call is queued to an executor thread. If a queue is full a call is dropped.
+    ndcrash_crash_callback_drop,
+
+    /// A call is queued to an executor thread. If a queue is full a daemon thread waits until
+    /// a running callback returns.
+    ndcrash_crash_callback_wait,
+
+    /// A callback is run synchronously on a daemon thread, no executor thread is created. Next
+    /// crashing processes aren't served until a callback returns. Default.
+    ndcrash_crash_callback_inline,
+};
+
+/**
+ * Sets a policy of crash callback execution. Should be called before ndcrash_out_start_daemon.
+ * By default a crash callback is run synchronously on a daemon thread with report_file path.
+ * ndcrash_crash_callback_drop and ndcrash_crash_callback_wait enable a separate executor thread,
+ * so a daemon is ready to serve the next crashing process while a callback performs a long
+ * operation. Calls are queued, a queue size is configured by NDCRASH_OUT_CALLBACK_QUEUE_SIZE macro.
+ * With an executor thread:
+ * - A report is renamed to a unique file "<report_file>.<pid>.<number>" before a call is queued.
+ *   A callback receives this path and owns a file: it should delete it when it's processed. If a
+ *   call is dropped a report is left in report_file.
+ * - Start and stop callbacks are run on an executor thread instead of a daemon thread.
+ * @param policy Policy value.
+ */
+void ndcrash_out_set_crash_callback_policy(enum ndcrash_crash_callback_policy policy);
+
 /**
  * Start an unwinding daemon for out-of-process crash reporting. In out-of-process architecture
  * a daemon performs stack crash report creation, does stack unwinding using ptrace mechanism and
@@ -107,6 +279,7 @@ typedef void (*ndcrash_daemon_crash_callback)(const char *report_file, void *arg
  * @param log_file Path to crash report file where to write it.
  * @param start_callback Callback executed on successful daemon start from its background thread. NULL if not needed.
  * @param crash_callback Callback executed on successful crash report creation. NULL if not needed.
+ * Executed on a thread that depends on a policy, see ndcrash_out_set_crash_callback_policy.
  * @param stop_callback Callback executed on successful daemon stop from its background thread.  NULL if not needed.
  * @param callback_arg Argument for callbacks. NULL if not needed.
  * @return Initialization result.
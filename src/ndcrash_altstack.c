@@ -0,0 +1,196 @@
+#include "ndcrash_altstack.h"
+#include "ndcrash_log.h"
+#include "ndcrash_private.h"
+#include "ndcrash_memory_map.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef ENABLE_INPROCESS
+
+/**
+ * Describes an alternate signal stack installed for a thread.
+ */
+struct ndcrash_altstack {
+
+    /// Memory mapping of a stack including a guard page. NULL if an existing alternate stack of
+    /// a thread is kept.
+    void *memory;
+
+    /// Size of memory mapping in bytes.
+    size_t memory_size;
+
+    /// Alternate stack that was set for a thread before installation. Restored on uninstallation.
+    stack_t old_stack;
+
+    /// Index of a thread stack record in ndcrash_altstack_thread_stacks, -1 if it's not recorded.
+    int thread_stack;
+};
+
+/**
+ * Bounds of a regular stack of a thread that has installed an alternate stack.
+ */
+struct ndcrash_altstack_thread_stack {
+
+    /// Lowest address of a stack, inclusive.
+    uintptr_t start;
+
+    /// End of a stack, exclusive. 0 for a free record, 1 for a record being filled.
+    uintptr_t end;
+};
+
+/// Stack bounds of threads, records are claimed and released atomically by end field.
+static struct ndcrash_altstack_thread_stack ndcrash_altstack_thread_stacks[NDCRASH_IN_MAX_THREAD_STACKS];
+
+/**
+ * Records bounds of a regular stack of a current thread. Not signal safe.
+ * @return Index of a record or -1 on failure.
+ */
+static int ndcrash_altstack_record_thread_stack() {
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr)) return -1;
+    void *stack_address = NULL;
+    size_t stack_size = 0;
+    const int result = pthread_attr_getstack(&attr, &stack_address, &stack_size);
+    pthread_attr_destroy(&attr);
+    if (result || !stack_size) return -1;
+
+    for (int i = 0; i < NDCRASH_IN_MAX_THREAD_STACKS; ++i) {
+        struct ndcrash_altstack_thread_stack * const record = &ndcrash_altstack_thread_stacks[i];
+        uintptr_t expected = 0;
+        if (!__atomic_compare_exchange_n(&record->end, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        __atomic_store_n(&record->start, (uintptr_t) stack_address, __ATOMIC_RELAXED);
+        __atomic_store_n(&record->end, (uintptr_t) stack_address + stack_size, __ATOMIC_RELEASE);
+        return i;
+    }
+    NDCRASHLOG(WARN, "Thread stacks count exceeds limit %d, a stack isn't recorded.", NDCRASH_IN_MAX_THREAD_STACKS);
+    return -1;
+}
+
+/// Thread-specific data key, a value is a pointer to ndcrash_altstack struct of a thread.
+static pthread_key_t ndcrash_altstack_key;
+
+/// Flag whether thread-specific data key has been successfully created.
+static bool ndcrash_altstack_key_created = false;
+
+/// Used to create thread-specific data key only once.
+static pthread_once_t ndcrash_altstack_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Restores a previous alternate stack if a stack described by data argument (ndcrash_altstack
+ * struct) is still set for a current thread and frees its memory. Used as a key destructor.
+ */
+static void ndcrash_altstack_free(void *data) {
+    struct ndcrash_altstack * const altstack = (struct ndcrash_altstack *) data;
+    if (altstack->thread_stack >= 0) {
+        // A stack is freed after a thread exits, its record shouldn't be found anymore.
+        __atomic_store_n(&ndcrash_altstack_thread_stacks[altstack->thread_stack].end, 0, __ATOMIC_RELEASE);
+    }
+    if (altstack->memory) {
+        const size_t page_size = (size_t) getpagesize();
+        stack_t current;
+        if (!sigaltstack(NULL, &current) && current.ss_sp == (uint8_t *) altstack->memory + page_size) {
+            sigaltstack(&altstack->old_stack, NULL);
+        }
+        munmap(altstack->memory, altstack->memory_size);
+    }
+    free(altstack);
+}
+
+static void ndcrash_altstack_create_key() {
+    ndcrash_altstack_key_created = !pthread_key_create(&ndcrash_altstack_key, &ndcrash_altstack_free);
+}
+
+bool ndcrash_altstack_install(size_t size) {
+    pthread_once(&ndcrash_altstack_key_once, &ndcrash_altstack_create_key);
+    if (!ndcrash_altstack_key_created) return false;
+    if (pthread_getspecific(ndcrash_altstack_key)) return true;
+
+    struct ndcrash_altstack * const altstack = (struct ndcrash_altstack *) calloc(1, sizeof(struct ndcrash_altstack));
+    if (!altstack) return false;
+    altstack->thread_stack = -1;
+
+    // Keeping an existing stack if it's large enough, for example, set by an application. Stack
+    // bounds are recorded anyway, a record is released by a key destructor on thread exit.
+    if (sigaltstack(NULL, &altstack->old_stack)) {
+        free(altstack);
+        return false;
+    }
+    if (!(altstack->old_stack.ss_flags & SS_DISABLE) && altstack->old_stack.ss_size >= size) {
+        if (pthread_setspecific(ndcrash_altstack_key, altstack)) {
+            free(altstack);
+            return true;
+        }
+        altstack->thread_stack = ndcrash_altstack_record_thread_stack();
+        return true;
+    }
+
+    // Allocating a stack with a guard page at the lowest address: a stack grows down, an overflow
+    // leads to a crash instead of a memory corruption.
+    const size_t page_size = (size_t) getpagesize();
+    size = (size + page_size - 1) & ~(page_size - 1);
+    const size_t memory_size = size + page_size;
+    uint8_t * const memory = (uint8_t *) mmap(
+            NULL,
+            memory_size,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0);
+    if (memory == MAP_FAILED) {
+        NDCRASHLOG(ERROR, "Couldn't allocate alternate stack: %s (%d)", strerror(errno), errno);
+        free(altstack);
+        return false;
+    }
+    mprotect(memory, page_size, PROT_NONE);
+
+    // Touching every page in order to avoid page faults in a signal handler.
+    for (size_t offset = page_size; offset < memory_size; offset += page_size) {
+        ((volatile uint8_t *) memory)[offset] = 0;
+    }
+
+    altstack->memory = memory;
+    altstack->memory_size = memory_size;
+
+    stack_t stack;
+    memset(&stack, 0, sizeof(stack));
+    stack.ss_sp = memory + page_size;
+    stack.ss_size = size;
+    if (sigaltstack(&stack, NULL) || pthread_setspecific(ndcrash_altstack_key, altstack)) {
+        NDCRASHLOG(ERROR, "Couldn't set alternate stack: %s (%d)", strerror(errno), errno);
+        ndcrash_altstack_free(altstack);
+        return false;
+    }
+    altstack->thread_stack = ndcrash_altstack_record_thread_stack();
+    return true;
+}
+
+void ndcrash_altstack_uninstall() {
+    if (!ndcrash_altstack_key_created) return;
+    struct ndcrash_altstack * const altstack =
+            (struct ndcrash_altstack *) pthread_getspecific(ndcrash_altstack_key);
+    if (!altstack) return;
+    pthread_setspecific(ndcrash_altstack_key, NULL);
+    ndcrash_altstack_free(altstack);
+}
+
+uintptr_t ndcrash_altstack_find_stack_end(uintptr_t sp) {
+    for (size_t i = 0; i < NDCRASH_IN_MAX_THREAD_STACKS; ++i) {
+        const struct ndcrash_altstack_thread_stack * const record = &ndcrash_altstack_thread_stacks[i];
+        const uintptr_t end = __atomic_load_n(&record->end, __ATOMIC_ACQUIRE);
+        if (end > 1 && sp >= __atomic_load_n(&record->start, __ATOMIC_RELAXED) && sp < end) return end;
+    }
+
+    // A thread hasn't installed an alternate stack by ndcrash, for example, it's created by
+    // a framework or a stack is a signal stack itself.
+    return ndcrash_memory_map_find_end(getpid(), sp);
+}
+
+#endif //ENABLE_INPROCESS
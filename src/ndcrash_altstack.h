@@ -0,0 +1,40 @@
+#ifndef NDCRASH_ALTSTACK_H
+#define NDCRASH_ALTSTACK_H
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Installs an alternate signal stack of a specified size for a current thread. A stack is allocated
+ * by mmap, it has a guard page below it and all its pages are pre-faulted. Does nothing if a current
+ * thread already has an alternate stack of sufficient size. A stack is freed automatically when
+ * a thread exits. Not signal safe.
+ * @param size Size of a stack in bytes, excluding a guard page.
+ * @return Flag whether a current thread has an alternate stack of sufficient size.
+ */
+bool ndcrash_altstack_install(size_t size);
+
+/**
+ * Restores a previous alternate signal stack for a current thread and frees a stack previously
+ * installed by ndcrash_altstack_install. Does nothing if it wasn't installed. Not signal safe.
+ */
+void ndcrash_altstack_uninstall();
+
+/**
+ * Finds an end of a thread stack containing an address. Bounds of stacks of threads that have
+ * called ndcrash_altstack_install are recorded on installation and are found without system calls.
+ * For other threads a memory map is parsed. Signal safe.
+ * @param sp Stack pointer value of a thread.
+ * @return End of a stack, exclusive. Equal to sp if sp isn't within a stack or mapped memory.
+ */
+uintptr_t ndcrash_altstack_find_stack_end(uintptr_t sp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_ALTSTACK_H
@@ -0,0 +1,83 @@
+#include "ndcrash_arena.h"
+#include "ndcrash_log.h"
+#include <sys/mman.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef ENABLE_INPROCESS
+
+/// Alignment of all blocks returned by arena, enough for any fundamental type and SIMD registers.
+#define NDCRASH_ARENA_ALIGNMENT 16
+
+/// Reserved memory region. NULL if arena isn't initialized.
+static uint8_t *ndcrash_arena_memory = NULL;
+
+/// Size of reserved memory region in bytes.
+static size_t ndcrash_arena_size = 0;
+
+/// Offset of the first free byte within a region. Incremented atomically on allocation.
+static size_t ndcrash_arena_offset = 0;
+
+bool ndcrash_arena_init(size_t size) {
+    if (ndcrash_arena_memory) return true;
+    const size_t page_size = (size_t) getpagesize();
+    size = (size + page_size - 1) & ~(page_size - 1);
+    void * const memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        NDCRASHLOG(ERROR, "Couldn't allocate arena: %s (%d)", strerror(errno), errno);
+        return false;
+    }
+
+    // Touching every page in order to avoid page faults in a signal handler: a crash may happen
+    // when a system is out of memory.
+    for (size_t offset = 0; offset < size; offset += page_size) {
+        ((volatile uint8_t *) memory)[offset] = 0;
+    }
+
+    ndcrash_arena_size = size;
+    __atomic_store_n(&ndcrash_arena_offset, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ndcrash_arena_memory, (uint8_t *) memory, __ATOMIC_RELEASE);
+    return true;
+}
+
+void ndcrash_arena_deinit() {
+    uint8_t * const memory = __atomic_exchange_n(&ndcrash_arena_memory, NULL, __ATOMIC_ACQ_REL);
+    if (memory) {
+        munmap(memory, ndcrash_arena_size);
+    }
+    ndcrash_arena_size = 0;
+}
+
+void *ndcrash_arena_alloc(size_t size) {
+    uint8_t * const memory = __atomic_load_n(&ndcrash_arena_memory, __ATOMIC_ACQUIRE);
+    if (!memory || !size) return NULL;
+    size = (size + NDCRASH_ARENA_ALIGNMENT - 1) & ~(size_t) (NDCRASH_ARENA_ALIGNMENT - 1);
+
+    // Compare-and-swap loop instead of fetch-add: an offset must never exceed arena size, otherwise
+    // allocations that fit after a failed big allocation would be impossible.
+    size_t offset = __atomic_load_n(&ndcrash_arena_offset, __ATOMIC_RELAXED);
+    do {
+        if (size > ndcrash_arena_size - offset) {
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(
+            &ndcrash_arena_offset,
+            &offset,
+            offset + size,
+            true,
+            __ATOMIC_RELAXED,
+            __ATOMIC_RELAXED));
+    return memory + offset;
+}
+
+size_t ndcrash_arena_mark() {
+    return __atomic_load_n(&ndcrash_arena_offset, __ATOMIC_RELAXED);
+}
+
+void ndcrash_arena_rewind(size_t mark) {
+    __atomic_store_n(&ndcrash_arena_offset, mark, __ATOMIC_RELAXED);
+}
+
+#endif //ENABLE_INPROCESS
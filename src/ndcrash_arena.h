@@ -0,0 +1,52 @@
+#ifndef NDCRASH_ARENA_H
+#define NDCRASH_ARENA_H
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reserves a memory region for allocations in a signal handler and pre-faults it, so a crash
+ * report may be created without heap usage and page faults. Not signal safe, should be called on
+ * in-process mode initialization.
+ * @param size Size of a region in bytes.
+ * @return Flag whether initialization is successful.
+ */
+bool ndcrash_arena_init(size_t size);
+
+/**
+ * Frees a memory region reserved by ndcrash_arena_init. All pointers returned by
+ * ndcrash_arena_alloc become invalid.
+ */
+void ndcrash_arena_deinit();
+
+/**
+ * Allocates a memory block from a reserved region. Signal safe and lock free, may be called from
+ * several crashing threads simultaneously: every call gets its own block. Memory is returned back
+ * to arena only by ndcrash_arena_rewind. A block isn't zeroed, it may contain data of blocks freed
+ * by rewinding.
+ * @param size Size of a block in bytes.
+ * @return Pointer to a block aligned by 16 bytes or NULL if arena isn't initialized or exhausted.
+ */
+void *ndcrash_arena_alloc(size_t size);
+
+/**
+ * Retrieves a current arena position. Signal safe.
+ * @return Position value that may be passed to ndcrash_arena_rewind.
+ */
+size_t ndcrash_arena_mark();
+
+/**
+ * Frees all blocks allocated after a specified position was retrieved. Signal safe, but should be
+ * used only when other threads don't allocate from arena, otherwise their blocks are freed too.
+ * @param mark Value previously returned by ndcrash_arena_mark.
+ */
+void ndcrash_arena_rewind(size_t mark);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_ARENA_H
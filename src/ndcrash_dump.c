@@ -1,14 +1,18 @@
 #include "ndcrash_dump.h"
 #include "ndcrash_log.h"
 #include "ndcrash_signal_utils.h"
+#include "ndcrash_output.h"
+#include "ndcrash_private.h"
+#include "ndcrash_format.h"
+#include "ndcrash_elf.h"
 #include "sizeofa.h"
 #include <ucontext.h>
 #include <unistd.h>
-#include <stdio.h>
 #include <fcntl.h>
-#include <android/log.h>
 #include <inttypes.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <sys/system_properties.h>
 #include <sys/ptrace.h>
@@ -59,44 +63,36 @@ int ndcrash_dump_create_file(const char *path) {
     return result;
 }
 
-#ifndef NDCRASH_LOG_BUFFER_SIZE
-#define NDCRASH_LOG_BUFFER_SIZE 256
-#endif
+/// Memory buffer where a report is written if set. See ndcrash_dump_set_buffer.
+static struct ndcrash_dump_buffer *ndcrash_dump_buffer_instance = NULL;
+
+void ndcrash_dump_set_buffer(struct ndcrash_dump_buffer *buffer) {
+    ndcrash_dump_buffer_instance = buffer;
+}
 
 void ndcrash_dump_write_line(int fd, const char *format, ...) {
     char buffer[NDCRASH_LOG_BUFFER_SIZE];
 
-    // First writing to a log as is.
-    {
-        va_list args;
-        va_start(args, format);
-        __android_log_vprint(ANDROID_LOG_ERROR, NDCRASH_LOG_TAG, format, args);
-        va_end(args);
-    }
-
-    // Writing file to log may be disabled.
-    if (fd <= 0) return;
+    // A line is formatted once and then passed to all enabled outputs. If a memory buffer for
+    // a report is set a line is formatted directly to it, lines that don't fit are discarded.
+    struct ndcrash_dump_buffer * const dump_buffer =
+            ndcrash_output_is_enabled(ndcrash_output_file) ? ndcrash_dump_buffer_instance : NULL;
+    const bool in_dump_buffer = dump_buffer && dump_buffer->size - dump_buffer->length >= NDCRASH_LOG_BUFFER_SIZE;
+    char * const line = in_dump_buffer ? dump_buffer->data + dump_buffer->length : buffer;
 
-    // Writing to a buffer.
-    int printed;
+    // Exceeding characters are discarded, printed is never greater than NDCRASH_LOG_BUFFER_SIZE - 1.
+    size_t printed;
     {
         va_list args;
         va_start(args, format);
-        printed = vsnprintf(buffer, NDCRASH_LOG_BUFFER_SIZE, format, args);
+        printed = ndcrash_vformat(line, NDCRASH_LOG_BUFFER_SIZE, format, args);
         va_end(args);
     }
 
-    // printed contains the number of characters that would have been written if n had been sufficiently
-    // large, not counting the terminating null character.
-    if (printed > 0) {
-        if (printed >= NDCRASH_LOG_BUFFER_SIZE) {
-            printed = NDCRASH_LOG_BUFFER_SIZE - 1;
-        }
-        // Replacing last buffer character with new line.
-        buffer[printed] = '\n';
-
-        // Writing to a file including \n character.
-        write(fd, buffer, (size_t) printed + 1);
+    // File output isn't used if a memory buffer is set. A new line character is added to a line.
+    ndcrash_output_write_line(dump_buffer ? 0 : fd, line, printed);
+    if (in_dump_buffer) {
+        dump_buffer->length += printed + 1;
     }
 }
 
@@ -138,12 +134,13 @@ static void ndcrash_write_process_and_thread_info(
     process_name_buffer[0] = proc_file_path[0] = '\0';
 
     // Reading a process name.
-    if (snprintf(proc_file_path, sizeofa(proc_file_path), "/proc/%d/cmdline", pid) >= 0) {
-        ndcrash_read_file(proc_file_path, process_name_buffer, process_name_buffer_size);
-    }
+    ndcrash_format(proc_file_path, sizeofa(proc_file_path), "/proc/%d/cmdline", pid);
+    ndcrash_read_file(proc_file_path, process_name_buffer, process_name_buffer_size);
 
     // Reading a thread name.
-    if (snprintf(proc_file_path, sizeofa(proc_file_path), "/proc/%d/comm", tid) >= 0) {
+    proc_comm_content[0] = '\0';
+    ndcrash_format(proc_file_path, sizeofa(proc_file_path), "/proc/%d/comm", tid);
+    {
         const ssize_t bytes_read = ndcrash_read_file(proc_file_path, proc_comm_content,
                                                      sizeofa(proc_comm_content));
         // comm usually contains newline character on the end. We don't need it.
@@ -179,9 +176,9 @@ static inline void ndcrash_dump_signal_info(
         char *str_buffer,
         size_t str_buffer_size) {
     if (ndcrash_signal_has_si_addr(signo, si_code)) {
-        snprintf(str_buffer, str_buffer_size, "%p", faultaddr);
+        ndcrash_format(str_buffer, str_buffer_size, "%p", faultaddr);
     } else {
-        snprintf(str_buffer, str_buffer_size, "--------");
+        ndcrash_format(str_buffer, str_buffer_size, "--------");
     }
     ndcrash_dump_write_line(
             outfile,
@@ -193,6 +190,149 @@ static inline void ndcrash_dump_signal_info(
             str_buffer);
 }
 
+#if defined(__arm__)
+/// Count of dumped registers.
+#define NDCRASH_DUMP_REGISTERS_COUNT 17
+#elif defined(__aarch64__)
+#define NDCRASH_DUMP_REGISTERS_COUNT 34
+#elif defined(__i386__)
+#define NDCRASH_DUMP_REGISTERS_COUNT 15
+#elif defined(__x86_64__)
+#define NDCRASH_DUMP_REGISTERS_COUNT 20
+#endif
+
+/**
+ * Names of dumped registers including alignment spaces, in order of values passed to
+ * ndcrash_dump_register_rows. NULL is the end of a row.
+ */
+static const char * const ndcrash_dump_register_names[] = {
+#if defined(__arm__)
+        "r0", "r1", "r2", "r3", NULL,
+        "r4", "r5", "r6", "r7", NULL,
+        "r8", "r9", "sl", "fp", NULL,
+        "ip", "sp", "lr", "pc", "cpsr", NULL,
+#elif defined(__aarch64__)
+        "x0  ", "x1  ", "x2  ", "x3  ", NULL,
+        "x4  ", "x5  ", "x6  ", "x7  ", NULL,
+        "x8  ", "x9  ", "x10 ", "x11 ", NULL,
+        "x12 ", "x13 ", "x14 ", "x15 ", NULL,
+        "x16 ", "x17 ", "x18 ", "x19 ", NULL,
+        "x20 ", "x21 ", "x22 ", "x23 ", NULL,
+        "x24 ", "x25 ", "x26 ", "x27 ", NULL,
+        "x28 ", "x29 ", "x30 ", NULL,
+        "sp  ", "pc  ", "pstate", NULL,
+#elif defined(__i386__)
+        "eax", "ebx", "ecx", "edx", NULL,
+        "esi", "edi", NULL,
+        "xcs", "xds", "xes", "xfs", "xss", NULL,
+        "eip", "ebp", "esp", "flags", NULL,
+#elif defined(__x86_64__)
+        "rax", "rbx", "rcx", "rdx", NULL,
+        "rsi", "rdi", NULL,
+        "r8 ", "r9 ", "r10", "r11", NULL,
+        "r12", "r13", "r14", "r15", NULL,
+        "cs ", "ss ", NULL,
+        "rip", "rbp", "rsp", "eflags", NULL,
+#endif
+};
+
+#if defined(__x86_64__)
+/**
+ * Names of registers dumped from a processor context. Differs from ndcrash_dump_register_names
+ * only by "cs" row: ucontext has a single CSGSFS value that is dumped as is.
+ */
+static const char * const ndcrash_dump_context_register_names[] = {
+        "rax", "rbx", "rcx", "rdx", NULL,
+        "rsi", "rdi", NULL,
+        "r8 ", "r9 ", "r10", "r11", NULL,
+        "r12", "r13", "r14", "r15", NULL,
+        "cs ", NULL,
+        "rip", "rbp", "rsp", "eflags", NULL,
+};
+#else
+#define ndcrash_dump_context_register_names ndcrash_dump_register_names
+#endif
+
+/**
+ * Writes registers values to a crash report, rows are built by a table of register names.
+ * Values are written as hexadecimal numbers of pointer size without calling a formatter.
+ * @param outfile Output file descriptor for a crash report.
+ * @param names Names of registers, see ndcrash_dump_register_names.
+ * @param names_count Count of elements in names table.
+ * @param values Register values, one per non-NULL element of names table.
+ */
+static void ndcrash_dump_register_rows(
+        int outfile,
+        const char * const *names,
+        size_t names_count,
+        const uintptr_t *values) {
+    char row[NDCRASH_LOG_BUFFER_SIZE];
+    char *it = row;
+    for (size_t i = 0; i < names_count; ++i) {
+        const char * const name = names[i];
+        if (!name) {
+            *it = '\0';
+            ndcrash_dump_write_line(outfile, "%s", row);
+            it = row;
+            continue;
+        }
+        // Indentation before the first register, separator before others.
+        memcpy(it, it == row ? "    " : "  ", it == row ? 4 : 2);
+        it += it == row ? 4 : 2;
+        const size_t name_length = strlen(name);
+        memcpy(it, name, name_length);
+        it += name_length;
+        *it++ = ' ';
+        it = ndcrash_format_hex(it, *values++, sizeof(uintptr_t) * 2);
+    }
+}
+
+/**
+ * Writes registers values from a processor context to a crash report.
+ * @param outfile Output file descriptor for a crash report.
+ * @param context Processor context which registers to dump.
+ */
+static void ndcrash_dump_registers(int outfile, const struct ucontext *context) {
+    const mcontext_t *const ctx = &context->uc_mcontext;
+#if defined(__arm__)
+    const uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT] = {
+            ctx->arm_r0, ctx->arm_r1, ctx->arm_r2, ctx->arm_r3,
+            ctx->arm_r4, ctx->arm_r5, ctx->arm_r6, ctx->arm_r7,
+            ctx->arm_r8, ctx->arm_r9, ctx->arm_r10, ctx->arm_fp,
+            ctx->arm_ip, ctx->arm_sp, ctx->arm_lr, ctx->arm_pc, ctx->arm_cpsr,
+    };
+#elif defined(__aarch64__)
+    uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT];
+    for (int i = 0; i < 31; ++i) {
+        values[i] = ctx->regs[i];
+    }
+    values[31] = ctx->sp;
+    values[32] = ctx->pc;
+    values[33] = ctx->pstate;
+#elif defined(__i386__)
+    const uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT] = {
+            ctx->gregs[REG_EAX], ctx->gregs[REG_EBX], ctx->gregs[REG_ECX], ctx->gregs[REG_EDX],
+            ctx->gregs[REG_ESI], ctx->gregs[REG_EDI],
+            ctx->gregs[REG_CS], ctx->gregs[REG_DS], ctx->gregs[REG_ES], ctx->gregs[REG_FS], ctx->gregs[REG_SS],
+            ctx->gregs[REG_EIP], ctx->gregs[REG_EBP], ctx->gregs[REG_ESP], ctx->gregs[REG_EFL],
+    };
+#elif defined(__x86_64__)
+    const uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT] = {
+            ctx->gregs[REG_RAX], ctx->gregs[REG_RBX], ctx->gregs[REG_RCX], ctx->gregs[REG_RDX],
+            ctx->gregs[REG_RSI], ctx->gregs[REG_RDI],
+            ctx->gregs[REG_R8], ctx->gregs[REG_R9], ctx->gregs[REG_R10], ctx->gregs[REG_R11],
+            ctx->gregs[REG_R12], ctx->gregs[REG_R13], ctx->gregs[REG_R14], ctx->gregs[REG_R15],
+            ctx->gregs[REG_CSGSFS],
+            ctx->gregs[REG_RIP], ctx->gregs[REG_RBP], ctx->gregs[REG_RSP], ctx->gregs[REG_EFL],
+    };
+#endif
+    ndcrash_dump_register_rows(
+            outfile,
+            ndcrash_dump_context_register_names,
+            sizeofa(ndcrash_dump_context_register_names),
+            values);
+}
+
 void ndcrash_dump_header(int outfile, pid_t pid, pid_t tid, int signo, int si_code, void *faultaddr,
                          struct ucontext *context) {
     // A special marker of crash report beginning.
@@ -227,67 +367,7 @@ void ndcrash_dump_header(int outfile, pid_t pid, pid_t tid, int signo, int si_co
     ndcrash_dump_signal_info(outfile, signo, si_code, faultaddr, str_buffer, sizeofa(str_buffer));
 
     // Writing registers to a report.
-    const mcontext_t *const ctx = &context->uc_mcontext;
-#if defined(__arm__)
-    ndcrash_dump_write_line(outfile, "    r0 %08x  r1 %08x  r2 %08x  r3 %08x",
-                            ctx->arm_r0, ctx->arm_r1, ctx->arm_r2, ctx->arm_r3);
-    ndcrash_dump_write_line(outfile, "    r4 %08x  r5 %08x  r6 %08x  r7 %08x",
-                            ctx->arm_r4, ctx->arm_r5, ctx->arm_r6, ctx->arm_r7);
-    ndcrash_dump_write_line(outfile, "    r8 %08x  r9 %08x  sl %08x  fp %08x",
-                            ctx->arm_r8, ctx->arm_r9, ctx->arm_r10, ctx->arm_fp);
-    ndcrash_dump_write_line(outfile, "    ip %08x  sp %08x  lr %08x  pc %08x  cpsr %08x",
-                            ctx->arm_ip, ctx->arm_sp, ctx->arm_lr, ctx->arm_pc, ctx->arm_cpsr);
-#elif defined(__aarch64__)
-    for (int i = 0; i < 28; i += 4) {
-        ndcrash_dump_write_line(
-                outfile,
-                "    x%-2d  %016llx  x%-2d  %016llx  x%-2d  %016llx  x%-2d  %016llx",
-                i, ctx->regs[i],
-                i+1, ctx->regs[i+1],
-                i+2, ctx->regs[i+2],
-                i+3, ctx->regs[i+3]);
-    }
-    ndcrash_dump_write_line(
-            outfile,
-            "    x28  %016llx  x29  %016llx  x30  %016llx",
-            ctx->regs[28],
-            ctx->regs[29],
-            ctx->regs[30]);
-    ndcrash_dump_write_line(
-            outfile,
-            "    sp   %016llx  pc   %016llx  pstate %016llx",
-            ctx->sp,
-            ctx->pc,
-            ctx->pstate);
-#elif defined(__i386__)
-    ndcrash_dump_write_line(outfile, "    eax %08lx  ebx %08lx  ecx %08lx  edx %08lx",
-            ctx->gregs[REG_EAX], ctx->gregs[REG_EBX], ctx->gregs[REG_ECX], ctx->gregs[REG_EDX]);
-    ndcrash_dump_write_line(outfile, "    esi %08lx  edi %08lx",
-            ctx->gregs[REG_ESI], ctx->gregs[REG_EDI]);
-    ndcrash_dump_write_line(outfile, "    xcs %08x  xds %08x  xes %08x  xfs %08x  xss %08x",
-            ctx->gregs[REG_CS], ctx->gregs[REG_DS], ctx->gregs[REG_ES], ctx->gregs[REG_FS], ctx->gregs[REG_SS]);
-    ndcrash_dump_write_line(outfile, "    eip %08lx  ebp %08lx  esp %08lx  flags %08lx",
-            ctx->gregs[REG_EIP], ctx->gregs[REG_EBP], ctx->gregs[REG_ESP], ctx->gregs[REG_EFL]);
-#elif defined(__x86_64__)
-    ndcrash_dump_write_line(
-            outfile, "    rax %016lx  rbx %016lx  rcx %016lx  rdx %016lx",
-            ctx->gregs[REG_RAX], ctx->gregs[REG_RBX], ctx->gregs[REG_RCX], ctx->gregs[REG_RDX]);
-    ndcrash_dump_write_line(
-            outfile, "    rsi %016lx  rdi %016lx",
-            ctx->gregs[REG_RSI], ctx->gregs[REG_RDI]);
-    ndcrash_dump_write_line(
-            outfile, "    r8  %016lx  r9  %016lx  r10 %016lx  r11 %016lx",
-            ctx->gregs[REG_R8], ctx->gregs[REG_R9], ctx->gregs[REG_R10], ctx->gregs[REG_R11]);
-    ndcrash_dump_write_line(
-            outfile, "    r12 %016lx  r13 %016lx  r14 %016lx  r15 %016lx",
-            ctx->gregs[REG_R12], ctx->gregs[REG_R13], ctx->gregs[REG_R14], ctx->gregs[REG_R15]);
-    ndcrash_dump_write_line(
-            outfile, "    cs  %016lx"/*  ss  %016lx"*/,
-            ctx->gregs[REG_CSGSFS]/*, ctx->gregs[REG_SS]*/);
-    ndcrash_dump_write_line(
-            outfile, "    rip %016lx  rbp %016lx  rsp %016lx  eflags %016lx",
-            ctx->gregs[REG_RIP], ctx->gregs[REG_RBP], ctx->gregs[REG_RSP], ctx->gregs[REG_EFL]);
-#endif
+    ndcrash_dump_registers(outfile, context);
 
     // Writing "backtrace:"
     ndcrash_write_backtrace_title(outfile);
@@ -321,65 +401,38 @@ static inline void dump_other_thread_registers_by_ptrace(int outfile, pid_t tid)
 #endif
 
 #if defined(__arm__)
-    ndcrash_dump_write_line(outfile, "    r0 %08x  r1 %08x  r2 %08x  r3 %08x",
-            (uint32_t)r.ARM_r0, (uint32_t)r.ARM_r1, (uint32_t)r.ARM_r2, (uint32_t)r.ARM_r3);
-    ndcrash_dump_write_line(outfile, "    r4 %08x  r5 %08x  r6 %08x  r7 %08x",
-            (uint32_t)r.ARM_r4, (uint32_t)r.ARM_r5, (uint32_t)r.ARM_r6, (uint32_t)r.ARM_r7);
-    ndcrash_dump_write_line(outfile, "    r8 %08x  r9 %08x  sl %08x  fp %08x",
-            (uint32_t)r.ARM_r8, (uint32_t)r.ARM_r9, (uint32_t)r.ARM_r10, (uint32_t)r.ARM_fp);
-    ndcrash_dump_write_line(outfile, "    ip %08x  sp %08x  lr %08x  pc %08x  cpsr %08x",
-            (uint32_t)r.ARM_ip, (uint32_t)r.ARM_sp, (uint32_t)r.ARM_lr, (uint32_t)r.ARM_pc, (uint32_t)r.ARM_cpsr);
+    const uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT] = {
+            r.ARM_r0, r.ARM_r1, r.ARM_r2, r.ARM_r3,
+            r.ARM_r4, r.ARM_r5, r.ARM_r6, r.ARM_r7,
+            r.ARM_r8, r.ARM_r9, r.ARM_r10, r.ARM_fp,
+            r.ARM_ip, r.ARM_sp, r.ARM_lr, r.ARM_pc, r.ARM_cpsr,
+    };
 #elif defined(__aarch64__)
-    for (int i = 0; i < 28; i += 4) {
-        ndcrash_dump_write_line(
-                outfile,
-                "    x%-2d  %016llx  x%-2d  %016llx  x%-2d  %016llx  x%-2d  %016llx",
-                i, r.regs[i],
-                i+1, r.regs[i+1],
-                i+2, r.regs[i+2],
-                i+3, r.regs[i+3]);
+    uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT];
+    for (int i = 0; i < 31; ++i) {
+        values[i] = r.regs[i];
     }
-    ndcrash_dump_write_line(
-            outfile,
-            "    x28  %016llx  x29  %016llx  x30  %016llx",
-            r.regs[28],
-            r.regs[29],
-            r.regs[30]);
-    ndcrash_dump_write_line(
-            outfile,
-            "    sp   %016llx  pc   %016llx  pstate %016llx",
-            r.sp,
-            r.pc,
-            r.pstate);
+    values[31] = r.sp;
+    values[32] = r.pc;
+    values[33] = r.pstate;
 #elif defined(__i386__)
-    ndcrash_dump_write_line(outfile, "    eax %08lx  ebx %08lx  ecx %08lx  edx %08lx",
-            r.eax, r.ebx, r.ecx, r.edx);
-    ndcrash_dump_write_line(outfile, "    esi %08lx  edi %08lx",
-            r.esi, r.edi);
-    ndcrash_dump_write_line(outfile, "    xcs %08x  xds %08x  xes %08x  xfs %08x  xss %08x",
-            r.xcs, r.xds, r.xes, r.xfs, r.xss);
-    ndcrash_dump_write_line(outfile, "    eip %08lx  ebp %08lx  esp %08lx  flags %08lx",
-            r.eip, r.ebp, r.esp, r.eflags);
+    const uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT] = {
+            r.eax, r.ebx, r.ecx, r.edx,
+            r.esi, r.edi,
+            r.xcs, r.xds, r.xes, r.xfs, r.xss,
+            r.eip, r.ebp, r.esp, r.eflags,
+    };
 #elif defined(__x86_64__)
-    ndcrash_dump_write_line(
-            outfile, "    rax %016lx  rbx %016lx  rcx %016lx  rdx %016lx",
-            r.rax, r.rbx, r.rcx, r.rdx);
-    ndcrash_dump_write_line(
-            outfile, "    rsi %016lx  rdi %016lx",
-            r.rsi, r.rdi);
-    ndcrash_dump_write_line(
-            outfile, "    r8  %016lx  r9  %016lx  r10 %016lx  r11 %016lx",
-            r.r8, r.r9, r.r10, r.r11);
-    ndcrash_dump_write_line(
-            outfile, "    r12 %016lx  r13 %016lx  r14 %016lx  r15 %016lx",
-            r.r12, r.r13, r.r14, r.r15);
-    ndcrash_dump_write_line(
-            outfile, "    cs  %016lx  ss  %016lx",
-            r.cs, r.ss);
-    ndcrash_dump_write_line(
-            outfile, "    rip %016lx  rbp %016lx  rsp %016lx  eflags %016lx",
-            r.rip, r.rbp, r.rsp, r.eflags);
+    const uintptr_t values[NDCRASH_DUMP_REGISTERS_COUNT] = {
+            r.rax, r.rbx, r.rcx, r.rdx,
+            r.rsi, r.rdi,
+            r.r8, r.r9, r.r10, r.r11,
+            r.r12, r.r13, r.r14, r.r15,
+            r.cs, r.ss,
+            r.rip, r.rbp, r.rsp, r.eflags,
+    };
 #endif
+    ndcrash_dump_register_rows(outfile, ndcrash_dump_register_names, sizeofa(ndcrash_dump_register_names), values);
     return;
     // C-style error processing.
 error:
@@ -412,6 +465,30 @@ void ndcrash_dump_other_thread_header(int outfile, pid_t pid, pid_t tid) {
     ndcrash_write_backtrace_title(outfile);
 }
 
+void ndcrash_dump_other_thread_context_header(int outfile, pid_t pid, pid_t tid, int signo, int si_code,
+                                              void *faultaddr, struct ucontext *context) {
+    // The same marker as for out-of-process mode.
+    ndcrash_dump_write_line(outfile, "--- --- --- --- --- --- --- --- --- --- --- --- --- --- --- ---");
+
+    // Assuming 64 bytes is sufficient for a process name.
+    char process_name_buffer[64];
+
+    // Writing a line about process and thread.
+    ndcrash_write_process_and_thread_info(outfile, pid, tid, process_name_buffer, sizeofa(process_name_buffer));
+
+    // Writing an information about signal if a thread has crashed. Otherwise a thread has received
+    // a service signal, there is nothing to write.
+    if (signo) {
+        ndcrash_dump_signal_info(outfile, signo, si_code, faultaddr, process_name_buffer, sizeofa(process_name_buffer));
+    }
+
+    // Dumping registers information from a context.
+    ndcrash_dump_registers(outfile, context);
+
+    // Writing "backtrace:"
+    ndcrash_write_backtrace_title(outfile);
+}
+
 void ndcrash_dump_backtrace_line(
         int outfile,
         int counter,
@@ -444,3 +521,31 @@ void ndcrash_dump_backtrace_line(
 
     }
 }
+
+void ndcrash_dump_modules_title(int outfile) {
+    ndcrash_dump_write_line(outfile, " ");
+    ndcrash_dump_write_line(outfile, "modules:");
+}
+
+void ndcrash_dump_module_line(
+        int outfile,
+        uintptr_t start,
+        uintptr_t offset,
+        const char *name,
+        const uint8_t *build_id,
+        size_t build_id_size) {
+    if (!*name) {
+        name = "<unknown>";
+    }
+    if (!build_id_size) {
+        ndcrash_dump_write_line(outfile, "    %"PRIPTR" %"PRIPTR"  %s", start, offset, name);
+        return;
+    }
+    char build_id_str[NDCRASH_ELF_BUILD_ID_MAX_SIZE * 2 + 1];
+    char *it = build_id_str;
+    for (size_t i = 0; i < build_id_size && i < NDCRASH_ELF_BUILD_ID_MAX_SIZE; ++i) {
+        it = ndcrash_format_hex(it, build_id[i], 2);
+    }
+    *it = '\0';
+    ndcrash_dump_write_line(outfile, "    %"PRIPTR" %"PRIPTR"  %s (BuildId: %s)", start, offset, name, build_id_str);
+}
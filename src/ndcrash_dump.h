@@ -10,6 +10,29 @@ extern "C" {
 struct siginfo;
 struct ucontext;
 
+/**
+ * Memory buffer where a crash report is written instead of a file.
+ */
+struct ndcrash_dump_buffer {
+
+    /// Buffer memory.
+    char *data;
+
+    /// Size of buffer memory in bytes.
+    size_t size;
+
+    /// Count of bytes written to a buffer. Lines that don't fit are discarded.
+    size_t length;
+};
+
+/**
+ * Sets a memory buffer where all following lines are written instead of a file passed to dump
+ * functions. Lines are still written to a log. Not thread safe, should be called by a thread
+ * that creates a report.
+ * @param buffer Buffer to write to or NULL to write to a file again.
+ */
+void ndcrash_dump_set_buffer(struct ndcrash_dump_buffer *buffer);
+
 /**
  * Creates an output file for a crash report. Wrapper around open() system call.
  * @param path Path to an output file.
@@ -46,6 +69,20 @@ void ndcrash_dump_header(int outfile, pid_t pid, pid_t tid, int signo, int si_co
  */
 void ndcrash_dump_other_thread_header(int outfile, pid_t pid, pid_t tid);
 
+/**
+ * Write an other thread info to a file and to a log. Registers are taken from a passed processor
+ * context instead of ptrace, used by in-process mode.
+ * @param outfile Output file descriptor for a crash report.
+ * @param pid Process identifier.
+ * @param tid Thread identifier.
+ * @param signo Number of signal that was caught if a thread has crashed too, otherwise 0.
+ * @param si_code Code of signal that was caught on crash. Ignored if signo is 0.
+ * @param faultaddr Optional fault address. Ignored if signo is 0.
+ * @param context Processor context of a thread.
+ */
+void ndcrash_dump_other_thread_context_header(int outfile, pid_t pid, pid_t tid, int signo, int si_code,
+                                              void *faultaddr, struct ucontext *context);
+
 /**
  * Write a full line of backtrace to a crash report. Full means that we have all data including
  * function name and instruction offset within a function.
@@ -64,6 +101,31 @@ void ndcrash_dump_backtrace_line(
         const char *func_name,
         intptr_t func_offset);
 
+/**
+ * Writes "modules:" line and a new line before it. Starts a list of modules referenced by
+ * backtraces which is written at the end of a report.
+ * @param outfile Output file descriptor for a crash report.
+ */
+void ndcrash_dump_modules_title(int outfile);
+
+/**
+ * Write a line of modules list to a crash report. Example:
+ * "    0000007f8c1a2000 0000000000000000  /system/lib64/libc.so (BuildId: 3ac3b9e0...)"
+ * @param outfile Output file descriptor for a crash report.
+ * @param start Load base of a module, absolute address of its first mapping.
+ * @param offset Offset of a module first mapping within a file.
+ * @param name Module file path. Empty string if unknown.
+ * @param build_id GNU build-id of a module.
+ * @param build_id_size Size of build-id in bytes. If 0 build-id isn't printed.
+ */
+void ndcrash_dump_module_line(
+        int outfile,
+        uintptr_t start,
+        uintptr_t offset,
+        const char *name,
+        const uint8_t *build_id,
+        size_t build_id_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,270 @@
+#include "ndcrash_elf.h"
+#include "ndcrash_log.h"
+#include <link.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if __LP64__
+#define NDCRASH_ELF_CLASS ELFCLASS64
+#define NDCRASH_ELF_ST_TYPE ELF64_ST_TYPE
+#else
+#define NDCRASH_ELF_CLASS ELFCLASS32
+#define NDCRASH_ELF_ST_TYPE ELF32_ST_TYPE
+#endif
+
+/**
+ * Retrieves a section header by index with bounds checking.
+ * @return Pointer to section header or NULL if it's out of file.
+ */
+static const ElfW(Shdr) *ndcrash_elf_section(const uint8_t *file, size_t file_size, size_t index) {
+    const ElfW(Ehdr) * const ehdr = (const ElfW(Ehdr) *) file;
+    if (index >= ehdr->e_shnum) return NULL;
+    const size_t offset = ehdr->e_shoff + index * sizeof(ElfW(Shdr));
+    if (offset + sizeof(ElfW(Shdr)) > file_size) return NULL;
+    return (const ElfW(Shdr) *) (file + offset);
+}
+
+/**
+ * Checks whether a symbol should be added to a table: only defined functions are used.
+ */
+static inline bool ndcrash_elf_symbol_is_function(const ElfW(Sym) *sym) {
+    const int type = NDCRASH_ELF_ST_TYPE(sym->st_info);
+    return (type == STT_FUNC || type == STT_GNU_IFUNC) && sym->st_shndx != SHN_UNDEF && sym->st_value;
+}
+
+/**
+ * Comparison function for qsort, orders symbols by address. Symbols with the same address are
+ * ordered by size descending in order to keep the most informative one first.
+ */
+static int ndcrash_elf_symbol_compare(const void *a, const void *b) {
+    const struct ndcrash_elf_symbol * const sa = (const struct ndcrash_elf_symbol *) a;
+    const struct ndcrash_elf_symbol * const sb = (const struct ndcrash_elf_symbol *) b;
+    if (sa->address != sb->address) return sa->address < sb->address ? -1 : 1;
+    return sa->size > sb->size ? -1 : sa->size < sb->size;
+}
+
+bool ndcrash_elf_load_symbols(
+        const char *path,
+        uintptr_t offset,
+        bool use_symtab,
+        struct ndcrash_elf_symbols *symbols) {
+    memset(symbols, 0, sizeof(struct ndcrash_elf_symbols));
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) || (size_t) st.st_size < offset + sizeof(ElfW(Ehdr))) {
+        close(fd);
+        return false;
+    }
+    // Mapping from a page boundary, an ELF image embedded into APK is page-aligned anyway.
+    const size_t map_offset = offset & ~((uintptr_t) getpagesize() - 1);
+    const size_t map_size = (size_t) st.st_size - map_offset;
+    uint8_t * const map = (uint8_t *) mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, (off_t) map_offset);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+    const uint8_t * const file = map + (offset - map_offset);
+    const size_t file_size = map_size - (offset - map_offset);
+
+    bool result = false;
+    const ElfW(Ehdr) * const ehdr = (const ElfW(Ehdr) *) file;
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) || ehdr->e_ident[EI_CLASS] != NDCRASH_ELF_CLASS) {
+        goto func_end;
+    }
+
+    // Looking for a symbol table section: .symtab is preferred because it contains all functions.
+    const ElfW(Shdr) *symtab = NULL;
+    for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+        const ElfW(Shdr) * const shdr = ndcrash_elf_section(file, file_size, i);
+        if (!shdr) break;
+        if ((shdr->sh_type == SHT_SYMTAB && use_symtab) || (shdr->sh_type == SHT_DYNSYM && !symtab)) {
+            symtab = shdr;
+        }
+    }
+    if (!symtab || symtab->sh_entsize != sizeof(ElfW(Sym)) ||
+        symtab->sh_offset + symtab->sh_size > file_size) {
+        goto func_end;
+    }
+    const ElfW(Shdr) * const strtab = ndcrash_elf_section(file, file_size, symtab->sh_link);
+    if (!strtab || strtab->sh_offset + strtab->sh_size > file_size) {
+        goto func_end;
+    }
+    const ElfW(Sym) * const syms = (const ElfW(Sym) *) (file + symtab->sh_offset);
+    const size_t syms_count = symtab->sh_size / sizeof(ElfW(Sym));
+    const char * const strings = (const char *) (file + strtab->sh_offset);
+
+    // Calculating a required memory size.
+    size_t count = 0, names_size = 0;
+    for (size_t i = 0; i < syms_count; ++i) {
+        if (!ndcrash_elf_symbol_is_function(&syms[i]) || syms[i].st_name >= strtab->sh_size) continue;
+        ++count;
+        names_size += strnlen(strings + syms[i].st_name, strtab->sh_size - syms[i].st_name) + 1;
+    }
+    if (!count) goto func_end;
+
+    // Allocating a single memory block for symbols and names.
+    const size_t memory_size = count * sizeof(struct ndcrash_elf_symbol) + names_size;
+    void * const memory = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        NDCRASHLOG(ERROR, "Couldn't allocate symbols table for %s: %s (%d)", path, strerror(errno), errno);
+        goto func_end;
+    }
+    struct ndcrash_elf_symbol * const table = (struct ndcrash_elf_symbol *) memory;
+    char * const names = (char *) (table + count);
+
+    // Copying symbols.
+    size_t names_offset = 0;
+    struct ndcrash_elf_symbol *it = table;
+    for (size_t i = 0; i < syms_count; ++i) {
+        const ElfW(Sym) * const sym = &syms[i];
+        if (!ndcrash_elf_symbol_is_function(sym) || sym->st_name >= strtab->sh_size) continue;
+        it->address = (uintptr_t) sym->st_value;
+#ifdef __arm__
+        // The lowest bit is set for Thumb functions.
+        it->address &= ~(uintptr_t) 1;
+#endif
+        it->size = (uint32_t) sym->st_size;
+        it->name = (uint32_t) names_offset;
+        const size_t length = strnlen(strings + sym->st_name, strtab->sh_size - sym->st_name);
+        memcpy(names + names_offset, strings + sym->st_name, length);
+        names[names_offset + length] = '\0';
+        names_offset += length + 1;
+        ++it;
+    }
+
+    // Sorting and removing duplicates (aliases of the same function).
+    qsort(table, count, sizeof(struct ndcrash_elf_symbol), &ndcrash_elf_symbol_compare);
+    size_t unique = 1;
+    for (size_t i = 1; i < count; ++i) {
+        if (table[i].address != table[unique - 1].address) {
+            table[unique++] = table[i];
+        }
+    }
+
+    symbols->symbols = table;
+    symbols->count = unique;
+    symbols->names = names;
+    symbols->memory = memory;
+    symbols->memory_size = memory_size;
+    result = true;
+
+func_end:
+    munmap(map, map_size);
+    return result;
+}
+
+void ndcrash_elf_free_symbols(struct ndcrash_elf_symbols *symbols) {
+    if (symbols->memory) {
+        munmap(symbols->memory, symbols->memory_size);
+    }
+    memset(symbols, 0, sizeof(struct ndcrash_elf_symbols));
+}
+
+/**
+ * Checks whether an address is within a function of a symbol which is the last one not greater
+ * than an address.
+ * @return Function name or NULL if an address is out of function.
+ */
+static inline const char *ndcrash_elf_symbol_match(
+        const struct ndcrash_elf_symbols *symbols,
+        const struct ndcrash_elf_symbol *symbol,
+        uintptr_t address,
+        uintptr_t *offset) {
+    // Symbols without size are accepted only on exact match.
+    if (address - symbol->address >= symbol->size && address != symbol->address) return NULL;
+    if (offset) {
+        *offset = address - symbol->address;
+    }
+    return symbols->names + symbol->name;
+}
+
+const char *ndcrash_elf_find_symbol(
+        const struct ndcrash_elf_symbols *symbols,
+        uintptr_t address,
+        uintptr_t *offset) {
+    // Binary search for the first symbol with address greater than searched address.
+    size_t low = 0, high = symbols->count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (address < symbols->symbols[middle].address) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    if (!low) return NULL;
+    return ndcrash_elf_symbol_match(symbols, &symbols->symbols[low - 1], address, offset);
+}
+
+const char *ndcrash_elf_find_symbol_sequential(
+        const struct ndcrash_elf_symbols *symbols,
+        uintptr_t address,
+        size_t *index,
+        uintptr_t *offset) {
+    // Moving to the last symbol with address not greater than searched address.
+    size_t i = *index;
+    while (i + 1 < symbols->count && symbols->symbols[i + 1].address <= address) {
+        ++i;
+    }
+    *index = i;
+    if (i >= symbols->count || symbols->symbols[i].address > address) return NULL;
+    return ndcrash_elf_symbol_match(symbols, &symbols->symbols[i], address, offset);
+}
+
+size_t ndcrash_elf_parse_build_id(const void *notes, size_t size, uint8_t *build_id) {
+    // Each note is a header, a name and a descriptor. Name and descriptor are aligned by 4 bytes.
+    const uint8_t *it = (const uint8_t *) notes;
+    const uint8_t * const end = it + size;
+    while ((size_t) (end - it) >= sizeof(ElfW(Nhdr))) {
+        const ElfW(Nhdr) * const nhdr = (const ElfW(Nhdr) *) it;
+        const size_t name_size = (nhdr->n_namesz + 3) & ~(size_t) 3;
+        const size_t desc_size = (nhdr->n_descsz + 3) & ~(size_t) 3;
+        it += sizeof(ElfW(Nhdr));
+        if (name_size > (size_t) (end - it) || desc_size > (size_t) (end - it) - name_size) break;
+        if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 && !memcmp(it, "GNU", 4)) {
+            const size_t result = nhdr->n_descsz < NDCRASH_ELF_BUILD_ID_MAX_SIZE ?
+                    nhdr->n_descsz : NDCRASH_ELF_BUILD_ID_MAX_SIZE;
+            memcpy(build_id, it + name_size, result);
+            return result;
+        }
+        it += name_size + desc_size;
+    }
+    return 0;
+}
+
+size_t ndcrash_elf_read_build_id(const char *path, uintptr_t offset, uint8_t *build_id) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    size_t result = 0;
+    ElfW(Ehdr) ehdr;
+    if (pread(fd, &ehdr, sizeof(ehdr), (off_t) offset) != sizeof(ehdr) ||
+        memcmp(ehdr.e_ident, ELFMAG, SELFMAG) ||
+        ehdr.e_ident[EI_CLASS] != NDCRASH_ELF_CLASS ||
+        ehdr.e_phentsize != sizeof(ElfW(Phdr))) {
+        goto func_end;
+    }
+
+    // Notes segments are small, a build-id note is usually in the first one.
+    for (size_t i = 0; i < ehdr.e_phnum && !result; ++i) {
+        ElfW(Phdr) phdr;
+        const off_t phdr_offset = (off_t) (offset + ehdr.e_phoff + i * sizeof(ElfW(Phdr)));
+        if (pread(fd, &phdr, sizeof(phdr), phdr_offset) != sizeof(phdr)) break;
+        if (phdr.p_type != PT_NOTE) continue;
+        uint8_t notes[1024];
+        const size_t notes_size = phdr.p_filesz < sizeof(notes) ? phdr.p_filesz : sizeof(notes);
+        const ssize_t bytes_read = pread(fd, notes, notes_size, (off_t) (offset + phdr.p_offset));
+        if (bytes_read > 0) {
+            result = ndcrash_elf_parse_build_id(notes, (size_t) bytes_read, build_id);
+        }
+    }
+
+func_end:
+    close(fd);
+    return result;
+}
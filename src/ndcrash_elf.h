@@ -0,0 +1,123 @@
+#ifndef NDCRASH_ELF_H
+#define NDCRASH_ELF_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Maximum size of GNU build-id in bytes. Usually it's 20 bytes (SHA-1) or 16 bytes (MD5).
+#define NDCRASH_ELF_BUILD_ID_MAX_SIZE 32
+
+/**
+ * Function symbol of ELF file.
+ */
+struct ndcrash_elf_symbol {
+
+    /// Address of a function, ELF virtual address (not including a load bias).
+    uintptr_t address;
+
+    /// Size of a function in bytes. May be 0 for some symbols defined in assembler.
+    uint32_t size;
+
+    /// Offset of a null-terminated function name within names buffer.
+    uint32_t name;
+};
+
+/**
+ * Table of ELF function symbols sorted by address. Stored in a memory allocated by mmap, lookup in
+ * this table is signal safe.
+ */
+struct ndcrash_elf_symbols {
+
+    /// Symbols array sorted by address.
+    const struct ndcrash_elf_symbol *symbols;
+
+    /// Count of elements in symbols array.
+    size_t count;
+
+    /// Buffer containing all symbol names.
+    const char *names;
+
+    /// Memory block containing symbols and names. NULL if a table isn't loaded.
+    void *memory;
+
+    /// Size of memory block in bytes.
+    size_t memory_size;
+};
+
+/**
+ * Loads function symbols from ELF file to a sorted table. Not signal safe.
+ * @param path Path to ELF file.
+ * @param offset Offset of ELF image within a file. Non-zero for libraries loaded directly from APK.
+ * @param use_symtab Flag whether to use .symtab section if it's present. Otherwise only .dynsym
+ * section is used, it contains only exported symbols but requires less memory.
+ * @param symbols Pointer to a table to fill. Zeroed on failure.
+ * @return Flag whether loading is successful.
+ */
+bool ndcrash_elf_load_symbols(
+        const char *path,
+        uintptr_t offset,
+        bool use_symtab,
+        struct ndcrash_elf_symbols *symbols);
+
+/**
+ * Frees a memory used by symbols table.
+ * @param symbols Pointer to a table previously filled by ndcrash_elf_load_symbols.
+ */
+void ndcrash_elf_free_symbols(struct ndcrash_elf_symbols *symbols);
+
+/**
+ * Looks for a function containing a specified address by binary search. Signal safe.
+ * @param symbols Symbols table.
+ * @param address ELF virtual address to look for (a load bias should be subtracted).
+ * @param offset Pointer where to write an offset of address from function start. May be NULL.
+ * @return Function name or NULL if not found.
+ */
+const char *ndcrash_elf_find_symbol(
+        const struct ndcrash_elf_symbols *symbols,
+        uintptr_t address,
+        uintptr_t *offset);
+
+/**
+ * Looks for a function containing a specified address by linear search from a specified symbol.
+ * Used for a series of ascending addresses: a table is walked only once. Signal safe.
+ * @param symbols Symbols table.
+ * @param address ELF virtual address to look for (a load bias should be subtracted).
+ * @param index Pointer to index of a symbol where to start searching, should be 0 for the first
+ * address of a series. Updated for the next call.
+ * @param offset Pointer where to write an offset of address from function start. May be NULL.
+ * @return Function name or NULL if not found.
+ */
+const char *ndcrash_elf_find_symbol_sequential(
+        const struct ndcrash_elf_symbols *symbols,
+        uintptr_t address,
+        size_t *index,
+        uintptr_t *offset);
+
+/**
+ * Looks for GNU build-id note (NT_GNU_BUILD_ID) in a block of ELF notes. Signal safe.
+ * @param notes Content of PT_NOTE segment.
+ * @param size Size of notes block in bytes.
+ * @param build_id Buffer of NDCRASH_ELF_BUILD_ID_MAX_SIZE bytes where to write build-id. Longer
+ * identifiers are truncated.
+ * @return Size of build-id in bytes, 0 if not found.
+ */
+size_t ndcrash_elf_parse_build_id(const void *notes, size_t size, uint8_t *build_id);
+
+/**
+ * Reads GNU build-id from PT_NOTE segments of ELF file. Not signal safe.
+ * @param path Path to a file containing ELF image.
+ * @param offset Offset of ELF image within a file, non-zero for libraries loaded from APK directly.
+ * @param build_id Buffer of NDCRASH_ELF_BUILD_ID_MAX_SIZE bytes where to write build-id.
+ * @return Size of build-id in bytes, 0 if not found or a file couldn't be read.
+ */
+size_t ndcrash_elf_read_build_id(const char *path, uintptr_t offset, uint8_t *build_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_ELF_H
@@ -0,0 +1,323 @@
+#include "ndcrash_format.h"
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+
+/// Digits for hexadecimal conversion.
+static const char ndcrash_format_digits_lower[] = "0123456789abcdef";
+static const char ndcrash_format_digits_upper[] = "0123456789ABCDEF";
+
+/**
+ * Output state of a formatter. The last buffer byte is reserved for terminating '\0'.
+ */
+struct ndcrash_format_output {
+
+    /// Current writing position.
+    char *position;
+
+    /// Position of reserved '\0' byte, nothing is written at or after it.
+    char *end;
+};
+
+/**
+ * Appends a character block to an output. Exceeding characters are discarded.
+ */
+static inline void ndcrash_format_put(struct ndcrash_format_output *out, const char *data, size_t length) {
+    const size_t available = (size_t) (out->end - out->position);
+    if (length > available) {
+        length = available;
+    }
+    memcpy(out->position, data, length);
+    out->position += length;
+}
+
+/**
+ * Appends a character repeated several times to an output.
+ */
+static inline void ndcrash_format_fill(struct ndcrash_format_output *out, char c, int count) {
+    for (; count > 0 && out->position < out->end; --count) {
+        *out->position++ = c;
+    }
+}
+
+/**
+ * Converts an unsigned value to digits. Digits are written to the end of passed buffer.
+ * @return Pointer to the first digit.
+ */
+static inline char *ndcrash_format_digits(char *buffer_end, uintmax_t value, unsigned base, const char *digits) {
+    char *it = buffer_end;
+    do {
+        *--it = digits[value % base];
+        value /= base;
+    } while (value);
+    return it;
+}
+
+/**
+ * Writes a field with padding according to width and '-' flag.
+ * @param leading_zeroes Count of zeroes between prefix and data required by precision of an integer.
+ */
+static void ndcrash_format_field(
+        struct ndcrash_format_output *out,
+        const char *prefix,
+        size_t prefix_length,
+        int leading_zeroes,
+        const char *data,
+        size_t length,
+        int width,
+        bool left,
+        bool zero) {
+    const int padding = width - (int) (prefix_length + length) - leading_zeroes;
+    if (!left && !zero) ndcrash_format_fill(out, ' ', padding);
+    ndcrash_format_put(out, prefix, prefix_length);
+    if (!left && zero) ndcrash_format_fill(out, '0', padding);
+    ndcrash_format_fill(out, '0', leading_zeroes);
+    ndcrash_format_put(out, data, length);
+    if (left) ndcrash_format_fill(out, ' ', padding);
+}
+
+/**
+ * Writes an integer field: digits are at [start, end). Precision is a minimum count of digits, zero
+ * value with zero precision produces no digits. '0' flag is ignored if precision is specified.
+ */
+static void ndcrash_format_integer(
+        struct ndcrash_format_output *out,
+        const char *prefix,
+        size_t prefix_length,
+        const char *start,
+        const char *end,
+        int precision,
+        int width,
+        bool left,
+        bool zero) {
+    size_t length = (size_t) (end - start);
+    if (precision < 0) {
+        ndcrash_format_field(out, prefix, prefix_length, 0, start, length, width, left, zero);
+        return;
+    }
+    if (!precision && length == 1 && *start == '0') {
+        length = 0;
+    }
+    const int leading_zeroes = precision > (int) length ? precision - (int) length : 0;
+    ndcrash_format_field(out, prefix, prefix_length, leading_zeroes, start, length, width, left, false);
+}
+
+size_t ndcrash_format(char *buffer, size_t size, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    const size_t result = ndcrash_vformat(buffer, size, format, args);
+    va_end(args);
+    return result;
+}
+
+size_t ndcrash_vformat(char *buffer, size_t size, const char *format, va_list args) {
+    if (!size) return 0;
+    struct ndcrash_format_output out = { buffer, buffer + size - 1 };
+
+    // Enough for 64-bit value in octal plus sign.
+    char digits[24];
+    char * const digits_end = digits + sizeof(digits);
+
+    const char *it = format;
+    while (*it && out.position < out.end) {
+        // Copying plain characters up to the next conversion at once.
+        if (*it != '%') {
+            const char *plain_end = it + 1;
+            while (*plain_end && *plain_end != '%') ++plain_end;
+            ndcrash_format_put(&out, it, (size_t) (plain_end - it));
+            it = plain_end;
+            continue;
+        }
+        ++it;
+
+        // Flags.
+        bool left = false, zero = false;
+        for (;; ++it) {
+            if (*it == '-') {
+                left = true;
+            } else if (*it == '0') {
+                zero = true;
+            } else {
+                break;
+            }
+        }
+
+        // Width.
+        int width = 0;
+        if (*it == '*') {
+            width = va_arg(args, int);
+            if (width < 0) {
+                left = true;
+                width = -width;
+            }
+            ++it;
+        } else {
+            for (; *it >= '0' && *it <= '9'; ++it) {
+                width = width * 10 + (*it - '0');
+            }
+        }
+
+        // Precision: maximum length for strings, minimum count of digits for integers. Negative value
+        // passed as '*' argument is treated as if precision is omitted.
+        int precision = -1;
+        if (*it == '.') {
+            ++it;
+            if (*it == '*') {
+                precision = va_arg(args, int);
+                if (precision < 0) {
+                    precision = -1;
+                }
+                ++it;
+            } else {
+                precision = 0;
+                for (; *it >= '0' && *it <= '9'; ++it) {
+                    precision = precision * 10 + (*it - '0');
+                }
+            }
+        }
+
+        // Length modifier, converted to size of an argument: 0 is int, otherwise bytes count.
+        size_t length = 0;
+        switch (*it) {
+            case 'h':
+                ++it;
+                length = sizeof(short);
+                if (*it == 'h') {
+                    ++it;
+                    length = sizeof(char);
+                }
+                break;
+            case 'l':
+                ++it;
+                length = sizeof(long);
+                if (*it == 'l') {
+                    ++it;
+                    length = sizeof(long long);
+                }
+                break;
+            case 'z':
+                ++it;
+                length = sizeof(size_t);
+                break;
+            case 'j':
+                ++it;
+                length = sizeof(intmax_t);
+                break;
+            case 't':
+                ++it;
+                length = sizeof(ptrdiff_t);
+                break;
+        }
+
+        const char conversion = *it;
+        if (!conversion) break;
+        ++it;
+        switch (conversion) {
+            case 'd':
+            case 'i': {
+                intmax_t value;
+                if (length == sizeof(long long)) {
+                    value = va_arg(args, long long);
+                } else if (length == sizeof(long)) {
+                    value = va_arg(args, long);
+                } else {
+                    value = va_arg(args, int);
+                    // Arguments of hh and h are promoted to int, converting back as printf does.
+                    if (length == sizeof(char)) {
+                        value = (signed char) value;
+                    } else if (length == sizeof(short)) {
+                        value = (short) value;
+                    }
+                }
+                const uintmax_t magnitude = value < 0 ? -(uintmax_t) value : (uintmax_t) value;
+                const char * const start = ndcrash_format_digits(digits_end, magnitude, 10, ndcrash_format_digits_lower);
+                ndcrash_format_integer(&out, "-", value < 0, start, digits_end, precision, width, left, zero);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X': {
+                uintmax_t value;
+                if (length == sizeof(long long)) {
+                    value = va_arg(args, unsigned long long);
+                } else if (length == sizeof(long)) {
+                    value = va_arg(args, unsigned long);
+                } else {
+                    value = va_arg(args, unsigned int);
+                    if (length == sizeof(char)) {
+                        value = (unsigned char) value;
+                    } else if (length == sizeof(short)) {
+                        value = (unsigned short) value;
+                    }
+                }
+                const char * const start = conversion == 'u' ?
+                        ndcrash_format_digits(digits_end, value, 10, ndcrash_format_digits_lower) :
+                        ndcrash_format_digits(digits_end, value, 16, conversion == 'x' ?
+                                ndcrash_format_digits_lower : ndcrash_format_digits_upper);
+                ndcrash_format_integer(&out, NULL, 0, start, digits_end, precision, width, left, zero);
+                break;
+            }
+            case 'p': {
+                const uintptr_t value = (uintptr_t) va_arg(args, void *);
+                const char * const start = ndcrash_format_digits(digits_end, value, 16, ndcrash_format_digits_lower);
+                ndcrash_format_integer(&out, "0x", 2, start, digits_end, precision, width, left, zero);
+                break;
+            }
+            case 's': {
+                const char *value = va_arg(args, const char *);
+                if (!value) {
+                    value = "(null)";
+                }
+                const size_t value_length = precision >= 0 ? strnlen(value, (size_t) precision) : strlen(value);
+                ndcrash_format_field(&out, NULL, 0, 0, value, value_length, width, left, false);
+                break;
+            }
+            case 'c': {
+                const char value = (char) va_arg(args, int);
+                ndcrash_format_field(&out, NULL, 0, 0, &value, 1, width, left, false);
+                break;
+            }
+            case '%':
+                ndcrash_format_put(&out, "%", 1);
+                break;
+            default:
+                // Unsupported conversion is written as is, an argument isn't consumed.
+                ndcrash_format_put(&out, it - 2, 2);
+                break;
+        }
+    }
+    *out.position = '\0';
+    return (size_t) (out.position - buffer);
+}
+
+char *ndcrash_format_hex(char *out, uintmax_t value, int width) {
+    char digits[16];
+    char * const digits_end = digits + sizeof(digits);
+    const char * const start = ndcrash_format_digits(digits_end, value, 16, ndcrash_format_digits_lower);
+    for (int padding = width - (int) (digits_end - start); padding > 0; --padding) {
+        *out++ = '0';
+    }
+    const size_t length = (size_t) (digits_end - start);
+    memcpy(out, start, length);
+    return out + length;
+}
+
+uintptr_t ndcrash_parse_hex(const char *str, const char **end) {
+    uintptr_t result = 0;
+    for (;; ++str) {
+        const char c = *str;
+        if (c >= '0' && c <= '9') {
+            result = (result << 4) | (uintptr_t) (c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            result = (result << 4) | (uintptr_t) (c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            result = (result << 4) | (uintptr_t) (c - 'A' + 10);
+        } else {
+            break;
+        }
+    }
+    if (end) {
+        *end = str;
+    }
+    return result;
+}
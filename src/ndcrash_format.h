@@ -0,0 +1,53 @@
+#ifndef NDCRASH_FORMAT_H
+#define NDCRASH_FORMAT_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Formats a string to a buffer. A replacement of snprintf that is signal safe: doesn't allocate
+ * memory, doesn't use locale and locks. Supports only a subset of printf format that is used in
+ * crash reports: conversions d, i, u, x, X, p, s, c and %, flags '-' and '0', width and precision
+ * (including '*'), length modifiers hh, h, l, ll, z, j and t. Precision is a maximum length for s
+ * and a minimum count of digits for integer conversions, as in printf. Unlike printf, p conversion
+ * of a null pointer is written as 0x0.
+ * @param buffer Buffer where to write a string. Always null-terminated if size isn't 0.
+ * @param size Size of buffer in bytes.
+ * @param format Format string.
+ * @param ... Format arguments.
+ * @return Count of written characters not including terminating '\0'. Unlike snprintf it's never
+ * greater than size - 1, exceeding characters are discarded.
+ */
+size_t ndcrash_format(char *buffer, size_t size, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * The same as ndcrash_format but with va_list argument.
+ */
+size_t ndcrash_vformat(char *buffer, size_t size, const char *format, va_list args);
+
+/**
+ * Writes a hexadecimal value padded by zeroes, lower case digits. Signal safe.
+ * @param out Where to write. Should have space for at least max(width, 16) characters.
+ * @param value Value to write.
+ * @param width Minimum count of digits.
+ * @return Pointer to a character after the last written one. Terminating '\0' isn't written.
+ */
+char *ndcrash_format_hex(char *out, uintmax_t value, int width);
+
+/**
+ * Parses a hexadecimal value without prefix. A replacement of strtoul(str, end, 16). Signal safe.
+ * @param str String to parse.
+ * @param end Optional pointer where to write a pointer to the first character that isn't a digit.
+ * @return Parsed value, 0 if there are no digits.
+ */
+uintptr_t ndcrash_parse_hex(const char *str, const char **end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_FORMAT_H
@@ -0,0 +1,125 @@
+#include "ndcrash_frames.h"
+#include "ndcrash_dump.h"
+#include <string.h>
+
+/**
+ * Copies a string to a strings storage of frames buffer.
+ * @return Pointer to a copy or NULL if there is no space.
+ */
+static const char *ndcrash_frames_copy_string(struct ndcrash_frames *frames, const char *str) {
+    const size_t length = strlen(str);
+    if (length >= frames->strings_size - frames->strings_length) return NULL;
+    char * const result = frames->strings + frames->strings_length;
+    memcpy(result, str, length + 1);
+    frames->strings_length += length + 1;
+    return result;
+}
+
+/**
+ * Looks for a module name in modules array of frames buffer and appends it if not found.
+ * @return Index of a module or -1 if there is no space.
+ */
+static int ndcrash_frames_find_module(struct ndcrash_frames *frames, const char *module_name) {
+    // Searching from the end, neighbour frames usually belong to the same module.
+    for (size_t i = frames->modules_count; i > 0; --i) {
+        if (!strcmp(frames->modules[i - 1], module_name)) return (int) (i - 1);
+    }
+    if (frames->modules_count >= frames->capacity) return -1;
+    const char * const copy = ndcrash_frames_copy_string(frames, module_name);
+    if (!copy) return -1;
+    frames->modules[frames->modules_count] = copy;
+    return (int) frames->modules_count++;
+}
+
+size_t ndcrash_frames_memory_size(size_t capacity, size_t strings_size) {
+    return capacity * (sizeof(struct ndcrash_frame) + sizeof(const char *)) + strings_size;
+}
+
+void ndcrash_frames_init(struct ndcrash_frames *frames, void *memory, size_t capacity, size_t strings_size) {
+    // Layout of memory block: frames, module names pointers, strings.
+    frames->capacity = capacity;
+    frames->frames = (struct ndcrash_frame *) memory;
+    frames->modules = (const char **) (frames->frames + capacity);
+    frames->strings = (char *) (frames->modules + capacity);
+    frames->strings_size = strings_size;
+    frames->defer_symbols = false;
+    ndcrash_frames_reset(frames);
+}
+
+void ndcrash_frames_reset(struct ndcrash_frames *frames) {
+    frames->count = 0;
+    frames->modules_count = 0;
+    frames->strings_length = 0;
+}
+
+size_t ndcrash_frames_copy_size(const struct ndcrash_frames *frames) {
+    return frames->count * sizeof(struct ndcrash_frame) +
+           frames->modules_count * sizeof(const char *) +
+           frames->strings_length;
+}
+
+void ndcrash_frames_copy(struct ndcrash_frames *copy, void *memory, const struct ndcrash_frames *frames) {
+    copy->count = copy->capacity = frames->count;
+    copy->frames = (struct ndcrash_frame *) memory;
+    copy->modules_count = frames->modules_count;
+    copy->modules = (const char **) (copy->frames + frames->count);
+    copy->strings_length = copy->strings_size = frames->strings_length;
+    copy->strings = (char *) (copy->modules + frames->modules_count);
+    copy->defer_symbols = frames->defer_symbols;
+    memcpy(copy->frames, frames->frames, frames->count * sizeof(struct ndcrash_frame));
+    memcpy(copy->strings, frames->strings, frames->strings_length);
+
+    // Pointers to strings are moved to a new storage. Symbols outside of strings aren't changed.
+    const char * const strings_end = frames->strings + frames->strings_length;
+    for (size_t i = 0; i < frames->modules_count; ++i) {
+        copy->modules[i] = copy->strings + (frames->modules[i] - frames->strings);
+    }
+    for (size_t i = 0; i < copy->count; ++i) {
+        const char * const symbol = copy->frames[i].symbol;
+        if (symbol >= frames->strings && symbol < strings_end) {
+            copy->frames[i].symbol = copy->strings + (symbol - frames->strings);
+        }
+    }
+}
+
+bool ndcrash_frames_add(
+        struct ndcrash_frames *frames,
+        uintptr_t pc,
+        uintptr_t rel_pc,
+        const char *module_name,
+        const char *symbol,
+        uintptr_t offset,
+        unsigned flags) {
+    if (ndcrash_frames_full(frames)) return false;
+    struct ndcrash_frame * const frame = &frames->frames[frames->count++];
+    frame->pc = pc;
+    frame->rel_pc = rel_pc;
+    frame->module = module_name ? ndcrash_frames_find_module(frames, module_name) : -1;
+    frame->symbol = NULL;
+    frame->offset = 0;
+    frame->flags = flags;
+    if (!symbol && frames->defer_symbols) {
+        frame->flags |= ndcrash_frame_symbol_deferred;
+    } else if (symbol) {
+        frame->symbol = ndcrash_frames_copy_string(frames, symbol);
+        if (frame->symbol) {
+            frame->offset = offset;
+        } else {
+            frame->flags |= ndcrash_frame_symbol_truncated;
+        }
+    }
+    return !ndcrash_frames_full(frames);
+}
+
+void ndcrash_frames_emit(int outfile, const struct ndcrash_frames *frames) {
+    for (size_t i = 0; i < frames->count; ++i) {
+        const struct ndcrash_frame * const frame = &frames->frames[i];
+        ndcrash_dump_backtrace_line(
+                outfile,
+                (int) i,
+                (intptr_t) frame->rel_pc,
+                ndcrash_frames_module_name(frames, frame),
+                frame->symbol,
+                (intptr_t) frame->offset);
+    }
+}
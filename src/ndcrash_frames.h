@@ -0,0 +1,185 @@
+#ifndef NDCRASH_FRAMES_H
+#define NDCRASH_FRAMES_H
+#include "ndcrash_private.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Flags of a backtrace frame.
+ */
+enum ndcrash_frame_flags {
+
+    /// Frame is found by stack scanning instead of unwinding, it may be a false positive.
+    ndcrash_frame_scanned = 1,
+
+    /// Function name didn't fit to a strings buffer and was discarded.
+    ndcrash_frame_symbol_truncated = 2,
+
+    /// Function name hasn't been looked up by an unwinder, it should be resolved by a batch
+    /// symbolizer. See defer_symbols field of ndcrash_frames.
+    ndcrash_frame_symbol_deferred = 4,
+
+    /// pc is a return address, a deferred function name is looked up for a previous instruction
+    /// because a call may be the last instruction of a function. An offset is still pc offset.
+    ndcrash_frame_return_address = 8,
+};
+
+/**
+ * A single frame of a backtrace filled by an unwinder.
+ */
+struct ndcrash_frame {
+
+    /// Absolute program counter value, 0 if unknown.
+    uintptr_t pc;
+
+    /// Program counter value relative to a module start. Equal to pc if a module is unknown.
+    uintptr_t rel_pc;
+
+    /// Index of a module name in modules array of ndcrash_frames, -1 if a module is unknown.
+    int module;
+
+    /// Function name, points to strings of ndcrash_frames or to a symbols table of a loaded module
+    /// if it's resolved by a batch symbolizer. NULL if unknown.
+    const char *symbol;
+
+    /// Offset of an instruction from function start in bytes. Ignored if symbol is NULL.
+    uintptr_t offset;
+
+    /// Bit mask of ndcrash_frame_flags values.
+    unsigned flags;
+};
+
+/**
+ * Fixed-capacity backtrace of a single thread. Unwinders fill it, then it's written to a report
+ * by ndcrash_frames_emit. Names are copied, so an unwinder may release its data right after
+ * adding a frame. Uses a memory block passed on initialization, signal safe.
+ */
+struct ndcrash_frames {
+
+    /// Count of filled frames.
+    size_t count;
+
+    /// Maximum count of frames, also maximum count of modules.
+    size_t capacity;
+
+    /// Backtrace frames, the first one is a frame where a thread has stopped.
+    struct ndcrash_frame *frames;
+
+    /// Count of filled elements in modules array.
+    size_t modules_count;
+
+    /// Unique module names of frames, point to strings. Empty string for anonymous memory.
+    const char **modules;
+
+    /// Count of used bytes of strings.
+    size_t strings_length;
+
+    /// Size of strings storage in bytes.
+    size_t strings_size;
+
+    /// Storage for module and function names.
+    char *strings;
+
+    /// Flag whether unwinders should skip function names lookup. Frames are marked by
+    /// ndcrash_frame_symbol_deferred flag and names are resolved later for all threads at once.
+    bool defer_symbols;
+};
+
+/**
+ * Calculates a size of memory block for a frames buffer.
+ * @param capacity Maximum count of frames.
+ * @param strings_size Size of storage for names in bytes.
+ * @return Size in bytes.
+ */
+size_t ndcrash_frames_memory_size(size_t capacity, size_t strings_size);
+
+/**
+ * Initializes an empty frames buffer.
+ * @param frames Frames buffer to initialize.
+ * @param memory Memory block of ndcrash_frames_memory_size bytes, should be aligned by pointer size.
+ * @param capacity Maximum count of frames.
+ * @param strings_size Size of storage for names in bytes.
+ */
+void ndcrash_frames_init(struct ndcrash_frames *frames, void *memory, size_t capacity, size_t strings_size);
+
+/**
+ * Makes a frames buffer empty.
+ * @param frames Frames buffer.
+ */
+void ndcrash_frames_reset(struct ndcrash_frames *frames);
+
+/**
+ * Calculates a size of memory block for a compact copy of a frames buffer: only used frames and
+ * strings are copied.
+ * @param frames Frames buffer to copy.
+ * @return Size in bytes.
+ */
+size_t ndcrash_frames_copy_size(const struct ndcrash_frames *frames);
+
+/**
+ * Makes a compact copy of a frames buffer. A copy is full, no frames may be added to it.
+ * @param copy Frames buffer to initialize.
+ * @param memory Memory block of ndcrash_frames_copy_size bytes, should be aligned by pointer size.
+ * @param frames Frames buffer to copy.
+ */
+void ndcrash_frames_copy(struct ndcrash_frames *copy, void *memory, const struct ndcrash_frames *frames);
+
+/**
+ * Appends a frame to a backtrace. Names are copied to a frames buffer. If symbols are deferred and
+ * a function name isn't passed a frame is marked by ndcrash_frame_symbol_deferred flag.
+ * @param frames Frames buffer.
+ * @param pc Absolute program counter value, 0 if unknown.
+ * @param rel_pc Program counter value relative to a module start.
+ * @param module_name Path of a module containing pc. NULL if unknown, empty string for anonymous memory.
+ * @param symbol Function name, NULL if unknown.
+ * @param offset Offset of an instruction from function start in bytes. Ignored if symbol is NULL.
+ * @param flags Bit mask of ndcrash_frame_flags values.
+ * @return Flag whether more frames may be added after this one. False if a buffer is full.
+ */
+bool ndcrash_frames_add(
+        struct ndcrash_frames *frames,
+        uintptr_t pc,
+        uintptr_t rel_pc,
+        const char *module_name,
+        const char *symbol,
+        uintptr_t offset,
+        unsigned flags);
+
+/**
+ * Checks whether a frames buffer has no space for more frames.
+ * @param frames Frames buffer.
+ * @return Flag value.
+ */
+static inline bool ndcrash_frames_full(const struct ndcrash_frames *frames) {
+    return frames->count >= frames->capacity;
+}
+
+/**
+ * Retrieves a module name of a frame.
+ * @param frames Frames buffer containing a frame.
+ * @param frame Frame.
+ * @return Module name, NULL if a module is unknown.
+ */
+static inline const char *ndcrash_frames_module_name(
+        const struct ndcrash_frames *frames,
+        const struct ndcrash_frame *frame) {
+    return frame->module >= 0 ? frames->modules[frame->module] : NULL;
+}
+
+/**
+ * Writes backtrace lines of all frames to a crash report.
+ * @param outfile Output file descriptor for a crash report.
+ * @param frames Frames buffer.
+ */
+void ndcrash_frames_emit(int outfile, const struct ndcrash_frames *frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_FRAMES_H
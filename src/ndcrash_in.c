@@ -4,57 +4,548 @@
 #include "ndcrash_private.h"
 #include "ndcrash_log.h"
 #include "ndcrash_signal_utils.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_arena.h"
+#include "ndcrash_altstack.h"
+#include "ndcrash_in_threads.h"
+#include "ndcrash_utils.h"
+#include "ndcrash_in_report.h"
+#include "ndcrash_output.h"
+#include "ndcrash_frames.h"
+#include "ndcrash_symbolizer.h"
+#include "ndcrash_unwind_chain.h"
 #include <malloc.h>
+#include <dlfcn.h>
+#include <pthread.h>
 #include <signal.h>
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <asm/unistd.h>
 
 #ifdef ENABLE_INPROCESS
 
+/**
+ * Data of a thread that has crashed while another thread was creating a crash report.
+ */
+struct ndcrash_in_crashed_thread {
+
+    /// Thread identifier.
+    pid_t tid;
+
+    /// Slot state, a value of ndcrash_in_thread_state.
+    int state;
+
+    /// Number of signal that was caught on crash.
+    int signo;
+
+    /// Code of signal that was caught on crash.
+    int si_code;
+
+    /// Fault address from siginfo structure.
+    void *faultaddr;
+
+    /// Processor context in a moment of crash.
+    struct ucontext context;
+};
+
 struct ndcrash_in_context {
 
     /// Old handlers of signals that we restore on de-initialization. Keep values for all possible
     /// signals, for unused signals NULL value is stored.
     struct sigaction old_handlers[NSIG];
 
-    /// Pointer to unwinding function.
-    ndcrash_in_unwind_func_ptr unwind_function;
+    /// Unwinders in order of trying: an unwinder passed on initialization, then fallback ones.
+    const struct ndcrash_in_unwinder_info *unwinders[NDCRASH_MAX_UNWINDERS];
+
+    /// Count of filled elements in unwinders array.
+    size_t unwinders_count;
+
+    /// Flag whether any unwinder is able to unwind a thread other than a current one by its
+    /// context. Used for all threads unwinding.
+    bool unwind_other_threads;
 
     /// Path to a log file. Null if not set.
     char *log_file;
+
+    /// Identifier of a thread that creates a crash report, 0 if there is no crash yet. Only the
+    /// first crashed thread creates a report.
+    pid_t report_tid;
+
+    /// Flag whether a report has been written. Used as a futex by other crashed threads.
+    int report_done;
+
+    /// Threads that have crashed while a report was being created. Appended to a report.
+    struct ndcrash_in_crashed_thread crashed_threads[NDCRASH_IN_MAX_CRASHED_THREADS];
+
+    /// Modules referenced by frames of a report that is being created, listed at the end of it.
+    const struct ndcrash_module *report_modules[NDCRASH_MAX_MODULES];
+
+    /// Count of filled elements in report_modules array.
+    size_t report_modules_count;
 };
 
 /// Global instance of in-process context.
 struct ndcrash_in_context *ndcrash_in_context_instance = NULL;
 
+/// Mutex that serializes refreshing of loaded modules list.
+static pthread_mutex_t ndcrash_in_refresh_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Saves a crash information of a current thread to a free slot in order to append it to a report
+ * that is being created by another thread. Waits until a report is written, waiting is limited by
+ * NDCRASH_IN_CRASH_WAIT_MS.
+ */
+static void ndcrash_in_add_crashed_thread(int signo, struct siginfo *siginfo, struct ucontext *context) {
+    for (size_t i = 0; i < NDCRASH_IN_MAX_CRASHED_THREADS; ++i) {
+        struct ndcrash_in_crashed_thread * const thread = &ndcrash_in_context_instance->crashed_threads[i];
+        int state = ndcrash_in_thread_free;
+        if (!__atomic_compare_exchange_n(&thread->state, &state, ndcrash_in_thread_writing, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        thread->tid = gettid();
+        thread->signo = signo;
+        thread->si_code = siginfo->si_code;
+        thread->faultaddr = siginfo->si_addr;
+        memcpy(&thread->context, context, sizeof(struct ucontext));
+        __atomic_store_n(&thread->state, ndcrash_in_thread_ready, __ATOMIC_RELEASE);
+        break;
+    }
+
+    // Context is used by a reporting thread for unwinding, a current thread stack shouldn't change.
+    const int64_t deadline = ndcrash_time_ms() + NDCRASH_IN_CRASH_WAIT_MS;
+    while (!__atomic_load_n(&ndcrash_in_context_instance->report_done, __ATOMIC_ACQUIRE)) {
+        const int64_t remaining = deadline - ndcrash_time_ms();
+        if (remaining <= 0) break;
+        ndcrash_futex_wait(&ndcrash_in_context_instance->report_done, 0, (int) remaining);
+    }
+}
+
+/**
+ * Checks whether a thread has crashed while a report was being created.
+ * @return Flag value.
+ */
+static bool ndcrash_in_is_crashed_thread(pid_t tid) {
+    for (size_t i = 0; i < NDCRASH_IN_MAX_CRASHED_THREADS; ++i) {
+        const struct ndcrash_in_crashed_thread * const thread = &ndcrash_in_context_instance->crashed_threads[i];
+        if (__atomic_load_n(&thread->state, __ATOMIC_ACQUIRE) == ndcrash_in_thread_ready && thread->tid == tid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Remembers modules referenced by frames of a backtrace in order to list them in a report.
+ * @param frames Backtrace.
+ */
+static void ndcrash_in_add_report_modules(const struct ndcrash_frames *frames) {
+    for (size_t i = 0; i < frames->count; ++i) {
+        const uintptr_t pc = frames->frames[i].pc;
+        const struct ndcrash_module * const module = pc ? ndcrash_modules_find(pc) : NULL;
+        if (!module) continue;
+        size_t j = ndcrash_in_context_instance->report_modules_count;
+        for (; j > 0; --j) {
+            if (ndcrash_in_context_instance->report_modules[j - 1] == module) break;
+        }
+        if (!j && ndcrash_in_context_instance->report_modules_count < NDCRASH_MAX_MODULES) {
+            ndcrash_in_context_instance->report_modules[ndcrash_in_context_instance->report_modules_count++] = module;
+        }
+    }
+}
+
+/**
+ * Writes a list of modules referenced by backtraces, ordered by load address.
+ * @param outfile Output file descriptor for a crash report.
+ */
+static void ndcrash_in_dump_report_modules(int outfile) {
+    const struct ndcrash_module ** const modules = ndcrash_in_context_instance->report_modules;
+    const size_t count = ndcrash_in_context_instance->report_modules_count;
+    if (!count) return;
+
+    // Insertion sort, a list is short.
+    for (size_t i = 1; i < count; ++i) {
+        const struct ndcrash_module * const module = modules[i];
+        size_t j = i;
+        for (; j > 0 && modules[j - 1]->start > module->start; --j) {
+            modules[j] = modules[j - 1];
+        }
+        modules[j] = module;
+    }
+    ndcrash_dump_modules_title(outfile);
+    for (size_t i = 0; i < count; ++i) {
+        ndcrash_dump_module_line(
+                outfile,
+                modules[i]->start,
+                modules[i]->offset,
+                modules[i]->name,
+                modules[i]->build_id,
+                modules[i]->build_id_size);
+    }
+}
+
+/**
+ * A thread being unwound by a chain of unwinders.
+ */
+struct ndcrash_in_unwind_thread {
+
+    /// Processor context of a thread.
+    struct ucontext *context;
+
+    /// Flag whether it's a thread other than a current one.
+    bool other_thread;
+};
+
+/**
+ * Runs an unwinder of a chain. Unwinder data is allocated from arena and freed after unwinding.
+ * For arguments description see ndcrash_unwind_tier_func_ptr typedef.
+ */
+static const char *ndcrash_in_unwind_tier(struct ndcrash_frames *frames, size_t index, void *arg) {
+    const struct ndcrash_in_unwind_thread * const thread = (const struct ndcrash_in_unwind_thread *) arg;
+    const struct ndcrash_in_unwinder_info * const unwinder = ndcrash_in_context_instance->unwinders[index];
+    if (thread->other_thread && !unwinder->unwind_other_threads) return NULL;
+    const size_t arena_mark = ndcrash_arena_mark();
+    unwinder->unwind(frames, thread->context);
+    ndcrash_arena_rewind(arena_mark);
+    return unwinder->name;
+}
+
+/**
+ * Allocates a frames buffer from arena.
+ * @param defer_symbols Value of defer_symbols field of a buffer.
+ * @return Frames buffer or NULL if arena is exhausted.
+ */
+static struct ndcrash_frames *ndcrash_in_alloc_frames(bool defer_symbols) {
+    struct ndcrash_frames * const frames =
+            (struct ndcrash_frames *) ndcrash_arena_alloc(sizeof(struct ndcrash_frames));
+    void * const memory = frames ?
+            ndcrash_arena_alloc(ndcrash_frames_memory_size(NDCRASH_MAX_FRAMES, NDCRASH_FRAMES_STRINGS_SIZE)) : NULL;
+    if (!memory) return NULL;
+    ndcrash_frames_init(frames, memory, NDCRASH_MAX_FRAMES, NDCRASH_FRAMES_STRINGS_SIZE);
+    frames->defer_symbols = defer_symbols;
+    return frames;
+}
+
+#ifndef ENABLE_INPROCESS_DEFERRED_SYMBOLIZATION
+
+/**
+ * Unwinds a thread stack by its context and writes a backtrace to a report. Frames buffers and
+ * unwinder data are allocated from arena and freed after writing.
+ * @param outfile Output file descriptor for a crash report.
+ * @param context Processor context of a thread.
+ * @param other_thread Flag whether it's a thread other than a current one.
+ */
+static void ndcrash_in_unwind_and_dump(int outfile, struct ucontext *context, bool other_thread) {
+    const size_t arena_mark = ndcrash_arena_mark();
+    struct ndcrash_frames * const frames = ndcrash_in_alloc_frames(false);
+
+    // A spare buffer keeps a previous backtrace while fallback unwinders are tried.
+    struct ndcrash_frames * const spare = frames && ndcrash_in_context_instance->unwinders_count > 1 ?
+            ndcrash_in_alloc_frames(false) : NULL;
+    if (frames) {
+        struct ndcrash_in_unwind_thread thread = { context, other_thread };
+        struct ndcrash_unwind_stats stats;
+        const struct ndcrash_frames * const result = ndcrash_unwind_chain(
+                frames,
+                spare,
+                ndcrash_in_context_instance->unwinders_count,
+                &ndcrash_in_unwind_tier,
+                &thread,
+                &stats);
+        ndcrash_frames_emit(outfile, result);
+        if (ndcrash_in_context_instance->unwinders_count > 1) {
+            ndcrash_unwind_stats_dump(outfile, &stats);
+        }
+        ndcrash_in_add_report_modules(result);
+    } else {
+        NDCRASHLOG(ERROR, "Arena is exhausted, couldn't allocate frames buffer.");
+    }
+    ndcrash_arena_rewind(arena_mark);
+}
+
+#else
+
+/**
+ * A thread that is written to a report in deferred symbolization mode.
+ */
+struct ndcrash_in_report_thread {
+
+    /// Thread identifier.
+    pid_t tid;
+
+    /// Number of signal that was caught on crash, 0 if a thread hasn't crashed.
+    int signo;
+
+    /// Code of signal that was caught on crash.
+    int si_code;
+
+    /// Fault address from siginfo structure.
+    void *faultaddr;
+
+    /// Processor context of a thread.
+    struct ucontext *context;
+
+    /// Flag whether a thread should be unwound.
+    bool unwind;
+
+    /// Compact copy of a thread backtrace, NULL if a thread isn't unwound.
+    struct ndcrash_frames *frames;
+
+    /// Results of tried unwinders.
+    struct ndcrash_unwind_stats stats;
+};
+
+/// Initializer of empty unwinders results for ndcrash_in_report_thread compound literals.
+#define NDCRASH_IN_EMPTY_STATS { { { NULL, 0, 0, false } }, 0, 0 }
+
+/**
+ * Unwinds a thread stack to scratch frames buffers and makes a compact copy of a result in arena.
+ * Unwinder data is freed, a copy is kept until a report is written.
+ * @param scratch Frames buffer for unwinding, should have symbols deferring enabled.
+ * @param spare The same buffer for fallback unwinders, NULL if there are none.
+ * @param thread Thread to unwind, results of unwinders are written to its stats.
+ * @param other_thread Flag whether it's a thread other than a current one.
+ */
+static void ndcrash_in_unwind_deferred(
+        struct ndcrash_frames *scratch,
+        struct ndcrash_frames *spare,
+        struct ndcrash_in_report_thread *thread,
+        bool other_thread) {
+    struct ndcrash_in_unwind_thread unwind_thread = { thread->context, other_thread };
+    const struct ndcrash_frames * const result = ndcrash_unwind_chain(
+            scratch,
+            spare,
+            ndcrash_in_context_instance->unwinders_count,
+            &ndcrash_in_unwind_tier,
+            &unwind_thread,
+            &thread->stats);
+    struct ndcrash_frames * const copy =
+            (struct ndcrash_frames *) ndcrash_arena_alloc(sizeof(struct ndcrash_frames));
+    void * const memory = copy ? ndcrash_arena_alloc(ndcrash_frames_copy_size(result)) : NULL;
+    if (!memory) {
+        NDCRASHLOG(ERROR, "Arena is exhausted, couldn't allocate backtrace copy.");
+        return;
+    }
+    ndcrash_frames_copy(copy, memory, result);
+    thread->frames = copy;
+}
+
+/**
+ * Writes backtraces of all threads to a report in deferred symbolization mode. All threads are
+ * unwound first without function names lookup, then names are resolved at once and everything is
+ * written in the same order as in immediate mode. A header of a current thread should be already
+ * written.
+ * @param outfile Output file descriptor for a crash report.
+ * @param context Processor context of a current thread.
+ * @param threads_count Count of suspended threads slots.
+ */
+static void ndcrash_in_dump_deferred(int outfile, struct ucontext *context, size_t threads_count) {
+    const size_t arena_mark = ndcrash_arena_mark();
+    const size_t threads_capacity = 1 + threads_count + NDCRASH_IN_MAX_CRASHED_THREADS;
+    struct ndcrash_in_report_thread * const threads = (struct ndcrash_in_report_thread *)
+            ndcrash_arena_alloc(threads_capacity * sizeof(struct ndcrash_in_report_thread));
+    struct ndcrash_frames ** const backtraces = (struct ndcrash_frames **)
+            ndcrash_arena_alloc(threads_capacity * sizeof(struct ndcrash_frames *));
+    struct ndcrash_frames * const scratch = ndcrash_in_alloc_frames(true);
+    struct ndcrash_frames * const spare = scratch && ndcrash_in_context_instance->unwinders_count > 1 ?
+            ndcrash_in_alloc_frames(true) : NULL;
+    if (!threads || !backtraces || !scratch) {
+        NDCRASHLOG(ERROR, "Arena is exhausted, couldn't allocate threads list.");
+        ndcrash_arena_rewind(arena_mark);
+        return;
+    }
+
+    // Collecting threads in order of writing: a current thread, suspended threads, other crashed threads.
+    size_t count = 0;
+    threads[count++] = (struct ndcrash_in_report_thread) { gettid(), 0, 0, NULL, context, true, NULL, NDCRASH_IN_EMPTY_STATS };
+#ifdef ENABLE_INPROCESS_ALL_THREADS
+    for (size_t i = 0; i < threads_count; ++i) {
+        struct ndcrash_in_thread_slot * const slot = ndcrash_in_threads_slot(i);
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != ndcrash_in_thread_ready) continue;
+        if (ndcrash_in_is_crashed_thread(slot->tid)) continue;
+        threads[count++] = (struct ndcrash_in_report_thread) { slot->tid, 0, 0, NULL, &slot->context, true, NULL, NDCRASH_IN_EMPTY_STATS };
+    }
+#endif
+    for (size_t i = 0; i < NDCRASH_IN_MAX_CRASHED_THREADS; ++i) {
+        struct ndcrash_in_crashed_thread * const thread = &ndcrash_in_context_instance->crashed_threads[i];
+        if (__atomic_load_n(&thread->state, __ATOMIC_ACQUIRE) != ndcrash_in_thread_ready) continue;
+        threads[count++] = (struct ndcrash_in_report_thread) {
+                thread->tid,
+                thread->signo,
+                thread->si_code,
+                thread->faultaddr,
+                &thread->context,
+                ndcrash_in_context_instance->unwind_other_threads,
+                NULL,
+                NDCRASH_IN_EMPTY_STATS
+        };
+    }
+
+    // Unwinding without function names lookup, then resolving names of all backtraces at once.
+    size_t backtraces_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!threads[i].unwind) continue;
+        ndcrash_in_unwind_deferred(scratch, spare, &threads[i], i > 0);
+        if (threads[i].frames) {
+            backtraces[backtraces_count++] = threads[i].frames;
+        }
+    }
+    ndcrash_symbolize_frames(backtraces, backtraces_count);
+
+    // Writing. A header of a current thread is already written.
+    for (size_t i = 0; i < count; ++i) {
+        const struct ndcrash_in_report_thread * const thread = &threads[i];
+        if (i) {
+            ndcrash_dump_other_thread_context_header(
+                    outfile,
+                    getpid(),
+                    thread->tid,
+                    thread->signo,
+                    thread->si_code,
+                    thread->faultaddr,
+                    thread->context);
+        }
+        if (thread->frames) {
+            ndcrash_frames_emit(outfile, thread->frames);
+            if (ndcrash_in_context_instance->unwinders_count > 1) {
+                ndcrash_unwind_stats_dump(outfile, &thread->stats);
+            }
+            ndcrash_in_add_report_modules(thread->frames);
+        }
+    }
+    ndcrash_arena_rewind(arena_mark);
+}
+
+#endif //ENABLE_INPROCESS_DEFERRED_SYMBOLIZATION
+
+/**
+ * Calls initialization functions of all unwinders of a chain.
+ */
+static void ndcrash_in_init_unwinders() {
+    for (size_t i = 0; i < ndcrash_in_context_instance->unwinders_count; ++i) {
+        if (ndcrash_in_context_instance->unwinders[i]->init) {
+            ndcrash_in_context_instance->unwinders[i]->init();
+        }
+    }
+}
+
 /// Main signal handling function.
 void ndcrash_in_signal_handler(int signo, struct siginfo *siginfo, void *ctxvoid) {
-    // Restoring an old handler to make built-in Android crash mechanism work.
-    sigaction(signo, &ndcrash_in_context_instance->old_handlers[signo], NULL);
-
     struct ucontext *context = (struct ucontext *)ctxvoid;
+
+    // Only the first crashed thread creates a report. Unwinders and an output file can't be used
+    // concurrently.
+    pid_t report_tid = 0;
+    if (!__atomic_compare_exchange_n(&ndcrash_in_context_instance->report_tid, &report_tid, gettid(),
+                                     false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        if (report_tid == gettid()) {
+            // Crash within a signal handler itself. Restoring all old handlers, a crash will be
+            // processed by them.
+            ndcrash_unregister_signal_handler(ndcrash_in_context_instance->old_handlers);
+            return;
+        }
+        ndcrash_in_add_crashed_thread(signo, siginfo, context);
+        goto resend;
+    }
+
+    // Modules registry and unwinders data aren't freed or reused by a refresh until a report is done.
+    ndcrash_modules_acquire();
+
+    // Writing a report to a memory-mapped staging file if it has been prepared on initialization.
+    // Otherwise creating a report file.
     int outfile = 0;
-    if (ndcrash_in_context_instance->log_file) {
+    struct ndcrash_dump_buffer * const report_buffer = ndcrash_in_report_begin();
+    if (report_buffer) {
+        ndcrash_dump_set_buffer(report_buffer);
+    } else if (ndcrash_in_context_instance->log_file) {
         outfile = ndcrash_dump_create_file(ndcrash_in_context_instance->log_file);
     }
 
     // Dumping header of a crash dump.
     ndcrash_dump_header(outfile, getpid(), gettid(), signo, siginfo->si_code, siginfo->si_addr, context);
 
-    // Calling unwinding function.
-    if (ndcrash_in_context_instance->unwind_function) {
-        ndcrash_in_context_instance->unwind_function(outfile, context);
+#ifdef ENABLE_INPROCESS_ALL_THREADS
+    // Stopping other threads before unwinding in order to get their contexts as close as possible
+    // to a moment of crash.
+    const size_t threads_count =
+            ndcrash_in_context_instance->unwind_other_threads ? ndcrash_in_threads_suspend() : 0;
+#endif
+
+#ifdef ENABLE_INPROCESS_DEFERRED_SYMBOLIZATION
+    // Unwinding all threads before function names lookup, names are resolved in a batch.
+#ifdef ENABLE_INPROCESS_ALL_THREADS
+    ndcrash_in_dump_deferred(outfile, context, threads_count);
+#else
+    ndcrash_in_dump_deferred(outfile, context, 0);
+#endif
+#else
+    // Calling unwinding functions.
+    ndcrash_in_unwind_and_dump(outfile, context, false);
+
+#ifdef ENABLE_INPROCESS_ALL_THREADS
+    // Processing other threads: printing a header and stack trace. Arena memory is re-used for
+    // every thread.
+    for (size_t i = 0; i < threads_count; ++i) {
+        struct ndcrash_in_thread_slot * const slot = ndcrash_in_threads_slot(i);
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != ndcrash_in_thread_ready) continue;
+
+        // Crashed threads are written below with their crash context.
+        if (ndcrash_in_is_crashed_thread(slot->tid)) continue;
+        ndcrash_dump_other_thread_context_header(outfile, getpid(), slot->tid, 0, 0, NULL, &slot->context);
+        ndcrash_in_unwind_and_dump(outfile, &slot->context, true);
+    }
+#endif
+
+    // Appending threads that have crashed while this report was being created.
+    for (size_t i = 0; i < NDCRASH_IN_MAX_CRASHED_THREADS; ++i) {
+        struct ndcrash_in_crashed_thread * const thread = &ndcrash_in_context_instance->crashed_threads[i];
+        if (__atomic_load_n(&thread->state, __ATOMIC_ACQUIRE) != ndcrash_in_thread_ready) continue;
+        ndcrash_dump_other_thread_context_header(
+                outfile,
+                getpid(),
+                thread->tid,
+                thread->signo,
+                thread->si_code,
+                thread->faultaddr,
+                &thread->context);
+        if (ndcrash_in_context_instance->unwind_other_threads) {
+            ndcrash_in_unwind_and_dump(outfile, &thread->context, true);
+        }
     }
+#endif //ENABLE_INPROCESS_DEFERRED_SYMBOLIZATION
+
+    // Appending a list of modules referenced by backtraces.
+    ndcrash_in_dump_report_modules(outfile);
+
+#ifdef ENABLE_INPROCESS_ALL_THREADS
+    ndcrash_in_threads_resume();
+#endif
 
     // Final new line of crash dump.
     ndcrash_dump_write_line(outfile, " ");
 
-    // Closing an output file.
+    // Closing an output file or committing a report in a staging file and copying it to a report file.
+    ndcrash_output_flush();
     if (outfile) {
         close(outfile);
     }
+    if (report_buffer) {
+        ndcrash_dump_set_buffer(NULL);
+        ndcrash_in_report_commit(ndcrash_in_context_instance->log_file);
+    }
+
+    // Releasing other crashed threads.
+    __atomic_store_n(&ndcrash_in_context_instance->report_done, 1, __ATOMIC_RELEASE);
+    ndcrash_futex_wake(&ndcrash_in_context_instance->report_done);
+    ndcrash_modules_release();
+
+resend:
+    // Restoring an old handler to make built-in Android crash mechanism work. Not doing it earlier
+    // because a crash of another thread would be processed by an old handler and would terminate
+    // a process before a report is written.
+    sigaction(signo, &ndcrash_in_context_instance->old_handlers[signo], NULL);
 
     // In some cases we need to re-send a signal to run standard bionic handler.
     if (siginfo->si_code <= 0 || signo == SIGABRT) {
@@ -71,41 +562,65 @@ enum ndcrash_error ndcrash_in_init(const enum ndcrash_unwinder unwinder, const c
     ndcrash_in_context_instance = (struct ndcrash_in_context *) malloc(sizeof(struct ndcrash_in_context));
     memset(ndcrash_in_context_instance, 0, sizeof(struct ndcrash_in_context));
 
-    // Checking if unwinder is supported. Setting unwind function.
-    switch (unwinder) {
-#ifdef ENABLE_LIBCORKSCREW
-        case ndcrash_unwinder_libcorkscrew:
-            ndcrash_in_context_instance->unwind_function = &ndcrash_in_unwind_libcorkscrew;
-            break;
-#endif
-#ifdef ENABLE_LIBUNWIND
-        case ndcrash_unwinder_libunwind:
-            ndcrash_in_context_instance->unwind_function = &ndcrash_in_unwind_libunwind;
-            break;
-#endif
-#ifdef ENABLE_LIBUNWINDSTACK
-        case ndcrash_unwinder_libunwindstack:
-            ndcrash_in_context_instance->unwind_function = &ndcrash_in_unwind_libunwindstack;
-            break;
-#endif
-#ifdef ENABLE_CXXABI
-        case ndcrash_unwinder_cxxabi:
-            ndcrash_in_context_instance->unwind_function = &ndcrash_in_unwind_cxxabi;
-            break;
-#endif
-#ifdef ENABLE_STACKSCAN
-        case ndcrash_unwinder_stackscan:
-            ndcrash_in_context_instance->unwind_function = &ndcrash_in_unwind_stackscan;
-            break;
-#endif
-        default: // To suppress a warning.
-            break;
-    }
-    if (!ndcrash_in_context_instance->unwind_function) {
+    // Checking if unwinder is supported. Fallback unwinders that aren't supported are skipped.
+    const struct ndcrash_in_unwinder_info * const primary = ndcrash_in_find_unwinder(unwinder);
+    if (!primary) {
         ndcrash_in_deinit();
         return ndcrash_error_not_supported;
     }
-    
+    ndcrash_in_context_instance->unwinders[ndcrash_in_context_instance->unwinders_count++] = primary;
+    size_t fallbacks_count = 0;
+    const enum ndcrash_unwinder * const fallbacks = ndcrash_get_fallback_unwinders(&fallbacks_count);
+    for (size_t i = 0; i < fallbacks_count; ++i) {
+        const struct ndcrash_in_unwinder_info * const fallback = ndcrash_in_find_unwinder(fallbacks[i]);
+        if (!fallback) {
+            NDCRASHLOG(WARN, "Fallback unwinder %d isn't supported, skipping.", (int) fallbacks[i]);
+            continue;
+        }
+        size_t j = 0;
+        for (; j < ndcrash_in_context_instance->unwinders_count; ++j) {
+            if (ndcrash_in_context_instance->unwinders[j] == fallback) break;
+        }
+        if (j == ndcrash_in_context_instance->unwinders_count) {
+            ndcrash_in_context_instance->unwinders[ndcrash_in_context_instance->unwinders_count++] = fallback;
+        }
+    }
+    for (size_t i = 0; i < ndcrash_in_context_instance->unwinders_count; ++i) {
+        if (ndcrash_in_context_instance->unwinders[i]->unwind_other_threads) {
+            ndcrash_in_context_instance->unwind_other_threads = true;
+        }
+    }
+
+    // Reserving a memory for unwinders. A signal handler uses it instead of heap.
+    if (!ndcrash_arena_init(NDCRASH_IN_ARENA_SIZE)) {
+        ndcrash_in_deinit();
+        return ndcrash_error_memory;
+    }
+
+    // Installing a large alternate stack for a current thread, other threads should use
+    // ndcrash_in_pthread_create or ndcrash_in_install_altstack.
+    if (!ndcrash_altstack_install(NDCRASH_IN_ALTSTACK_SIZE)) {
+        NDCRASHLOG(WARN, "Couldn't install alternate stack for a current thread.");
+    }
+
+    // Collecting a list of loaded modules. A signal handler uses it instead of memory map parsing.
+    if (!ndcrash_modules_init()) {
+        ndcrash_in_deinit();
+        return ndcrash_error_memory;
+    }
+
+#ifdef ENABLE_INPROCESS_ALL_THREADS
+    // Registering a handler for a signal that is sent to other threads on crash. cxxabi unwinder
+    // can unwind only a current thread, skipping it.
+    if (ndcrash_in_context_instance->unwind_other_threads && !ndcrash_in_threads_init()) {
+        ndcrash_in_deinit();
+        return ndcrash_error_signal;
+    }
+#endif
+
+    // Unwinders initialization, should be done before a signal handler is registered.
+    ndcrash_in_init_unwinders();
+
     // Trying to register signal handler.
     if (!ndcrash_register_signal_handler(&ndcrash_in_signal_handler, ndcrash_in_context_instance->old_handlers)) {
         ndcrash_in_deinit();
@@ -118,6 +633,12 @@ enum ndcrash_error ndcrash_in_init(const enum ndcrash_unwinder unwinder, const c
         if (log_file_size) {
             ndcrash_in_context_instance->log_file = malloc(++log_file_size);
             memcpy(ndcrash_in_context_instance->log_file, log_file, log_file_size);
+
+            // Preparing a memory-mapped buffer for a report. A report of previous crash that
+            // wasn't written to log_file at crash time is recovered here if it exists.
+            if (!ndcrash_in_report_init(log_file)) {
+                NDCRASHLOG(WARN, "Couldn't prepare report buffer, a report file will be created on crash.");
+            }
         }
     }
 
@@ -127,6 +648,18 @@ enum ndcrash_error ndcrash_in_init(const enum ndcrash_unwinder unwinder, const c
 bool ndcrash_in_deinit() {
     if (!ndcrash_in_context_instance) return false;
     ndcrash_unregister_signal_handler(ndcrash_in_context_instance->old_handlers);
+    for (size_t i = 0; i < ndcrash_in_context_instance->unwinders_count; ++i) {
+        if (ndcrash_in_context_instance->unwinders[i]->deinit) {
+            ndcrash_in_context_instance->unwinders[i]->deinit();
+        }
+    }
+#ifdef ENABLE_INPROCESS_ALL_THREADS
+    ndcrash_in_threads_deinit();
+#endif
+    ndcrash_modules_deinit();
+    ndcrash_in_report_deinit();
+    ndcrash_arena_deinit();
+    ndcrash_altstack_uninstall();
     if (ndcrash_in_context_instance->log_file) {
         free(ndcrash_in_context_instance->log_file);
     }
@@ -135,4 +668,69 @@ bool ndcrash_in_deinit() {
     return true;
 }
 
+void ndcrash_in_refresh_modules() {
+    pthread_mutex_lock(&ndcrash_in_refresh_mutex);
+    if (ndcrash_in_context_instance) {
+        ndcrash_modules_refresh();
+        ndcrash_in_init_unwinders();
+    }
+    pthread_mutex_unlock(&ndcrash_in_refresh_mutex);
+}
+
+void *ndcrash_in_dlopen(const char *filename, int flags) {
+    void * const result = dlopen(filename, flags);
+    if (result) {
+        ndcrash_in_refresh_modules();
+    }
+    return result;
+}
+
+int ndcrash_in_dlclose(void *handle) {
+    const int result = dlclose(handle);
+    ndcrash_in_refresh_modules();
+    return result;
+}
+
+/**
+ * Arguments for a thread started by ndcrash_in_pthread_create.
+ */
+struct ndcrash_in_thread_start {
+
+    /// Original thread function.
+    void *(*start_routine)(void *);
+
+    /// Original thread function argument.
+    void *arg;
+};
+
+/// Thread function used by ndcrash_in_pthread_create. Installs an alternate stack and runs an original function.
+static void *ndcrash_in_thread_routine(void *data) {
+    const struct ndcrash_in_thread_start start = *(struct ndcrash_in_thread_start *) data;
+    free(data);
+    ndcrash_in_install_altstack();
+    return start.start_routine(start.arg);
+}
+
+bool ndcrash_in_install_altstack() {
+    if (!ndcrash_in_context_instance) return false;
+    return ndcrash_altstack_install(NDCRASH_IN_ALTSTACK_SIZE);
+}
+
+int ndcrash_in_pthread_create(
+        pthread_t *thread,
+        const pthread_attr_t *attr,
+        void *(*start_routine)(void *),
+        void *arg) {
+    struct ndcrash_in_thread_start * const start =
+            (struct ndcrash_in_thread_start *) malloc(sizeof(struct ndcrash_in_thread_start));
+    if (!start) return EAGAIN;
+    start->start_routine = start_routine;
+    start->arg = arg;
+    const int result = pthread_create(thread, attr, &ndcrash_in_thread_routine, start);
+    if (result) {
+        free(start);
+    }
+    return result;
+}
+
 #endif //ENABLE_INPROCESS
@@ -0,0 +1,155 @@
+#include "ndcrash_in_report.h"
+#include "ndcrash_private.h"
+#include "ndcrash_log.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef ENABLE_INPROCESS
+
+/// Magic value of a staging file header, "NDCR".
+#define NDCRASH_IN_REPORT_MAGIC 0x5243444e
+
+/// Suffix of a staging file name.
+#define NDCRASH_IN_REPORT_SUFFIX ".mmap"
+
+/**
+ * Header located at the beginning of a staging file. Followed by report data.
+ */
+struct ndcrash_in_report_header {
+
+    /// Always NDCRASH_IN_REPORT_MAGIC.
+    uint32_t magic;
+
+    /// Non-zero if a report is completely written. Set last when a report is finished.
+    uint32_t committed;
+
+    /// Length of report data in bytes.
+    uint64_t length;
+};
+
+/// Mapped memory of a staging file. NULL if not initialized.
+static struct ndcrash_in_report_header *ndcrash_in_report_mapping = NULL;
+
+/// Buffer descriptor passed to dump functions, points to data after a header.
+static struct ndcrash_dump_buffer ndcrash_in_report_buffer;
+
+/**
+ * Writes a report data to a report file replacing its contents. Signal safe.
+ * @return Flag whether all data has been written.
+ */
+static bool ndcrash_in_report_write(const char *report_file, const char *data, size_t length) {
+    const int outfile = ndcrash_dump_create_file(report_file);
+    if (outfile < 0) return false;
+    while (length) {
+        const ssize_t written = write(outfile, data, length);
+        if (written <= 0) break;
+        data += written;
+        length -= (size_t) written;
+    }
+    close(outfile);
+    return !length;
+}
+
+/**
+ * Writes a committed report from a staging file to a report file. Used when a report wasn't
+ * written to a report file at crash time.
+ */
+static void ndcrash_in_report_recover(int staging_fd, const char *report_file) {
+    struct stat st;
+    struct ndcrash_in_report_header header;
+    if (fstat(staging_fd, &st) || (size_t) st.st_size < sizeof(header)) return;
+    if (pread(staging_fd, &header, sizeof(header), 0) != sizeof(header)) return;
+    if (header.magic != NDCRASH_IN_REPORT_MAGIC || !header.committed ||
+        header.length > (uint64_t) st.st_size - sizeof(header)) {
+        return;
+    }
+    const size_t length = (size_t) header.length;
+    void * const data = mmap(NULL, length + sizeof(header), PROT_READ, MAP_SHARED, staging_fd, 0);
+    if (data == MAP_FAILED) return;
+    ndcrash_in_report_write(report_file, (const char *) data + sizeof(header), length);
+    munmap(data, length + sizeof(header));
+}
+
+bool ndcrash_in_report_init(const char *report_file) {
+    if (ndcrash_in_report_mapping) return true;
+    const size_t report_file_length = strlen(report_file);
+    char * const staging_file = (char *) malloc(report_file_length + sizeof(NDCRASH_IN_REPORT_SUFFIX));
+    if (!staging_file) return false;
+    memcpy(staging_file, report_file, report_file_length);
+    memcpy(staging_file + report_file_length, NDCRASH_IN_REPORT_SUFFIX, sizeof(NDCRASH_IN_REPORT_SUFFIX));
+    const int fd = open(staging_file, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        NDCRASHLOG(ERROR, "Couldn't open report staging file %s: %s (%d)", staging_file, strerror(errno), errno);
+        free(staging_file);
+        return false;
+    }
+    free(staging_file);
+
+    // A report of previous crash is written to a report file.
+    ndcrash_in_report_recover(fd, report_file);
+
+    // Allocating disk space in advance, otherwise writing to a mapped memory may cause SIGBUS when
+    // a disk is full. ftruncate is used if a file system doesn't support fallocate.
+    const size_t size = sizeof(struct ndcrash_in_report_header) + NDCRASH_IN_REPORT_BUFFER_SIZE;
+    if (fallocate(fd, 0, 0, (off_t) size) && ftruncate(fd, (off_t) size)) {
+        NDCRASHLOG(ERROR, "Couldn't allocate report staging file: %s (%d)", strerror(errno), errno);
+        close(fd);
+        return false;
+    }
+    void * const mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        NDCRASHLOG(ERROR, "Couldn't map report staging file: %s (%d)", strerror(errno), errno);
+        return false;
+    }
+
+    struct ndcrash_in_report_header * const header = (struct ndcrash_in_report_header *) mapping;
+    header->magic = NDCRASH_IN_REPORT_MAGIC;
+    header->committed = 0;
+    header->length = 0;
+    ndcrash_in_report_buffer.data = (char *) (header + 1);
+    ndcrash_in_report_buffer.size = NDCRASH_IN_REPORT_BUFFER_SIZE;
+    ndcrash_in_report_buffer.length = 0;
+    __atomic_store_n(&ndcrash_in_report_mapping, header, __ATOMIC_RELEASE);
+    return true;
+}
+
+void ndcrash_in_report_deinit() {
+    struct ndcrash_in_report_header * const header =
+            __atomic_exchange_n(&ndcrash_in_report_mapping, NULL, __ATOMIC_ACQ_REL);
+    if (header) {
+        munmap(header, sizeof(struct ndcrash_in_report_header) + NDCRASH_IN_REPORT_BUFFER_SIZE);
+    }
+}
+
+struct ndcrash_dump_buffer *ndcrash_in_report_begin() {
+    struct ndcrash_in_report_header * const header =
+            __atomic_load_n(&ndcrash_in_report_mapping, __ATOMIC_ACQUIRE);
+    if (!header) return NULL;
+    header->committed = 0;
+    ndcrash_in_report_buffer.length = 0;
+    return &ndcrash_in_report_buffer;
+}
+
+void ndcrash_in_report_commit(const char *report_file) {
+    struct ndcrash_in_report_header * const header =
+            __atomic_load_n(&ndcrash_in_report_mapping, __ATOMIC_ACQUIRE);
+    if (!header) return;
+    header->length = ndcrash_in_report_buffer.length;
+    // A marker is set last: a report is valid only if all data and length are written.
+    __atomic_store_n(&header->committed, 1, __ATOMIC_RELEASE);
+
+    // Delivering a report to a report file with a single write. A marker is cleared on success,
+    // otherwise a report is recovered on next initialization.
+    if (ndcrash_in_report_write(report_file, ndcrash_in_report_buffer.data, ndcrash_in_report_buffer.length)) {
+        __atomic_store_n(&header->committed, 0, __ATOMIC_RELEASE);
+    }
+}
+
+#endif //ENABLE_INPROCESS
@@ -0,0 +1,44 @@
+#ifndef NDCRASH_IN_REPORT_H
+#define NDCRASH_IN_REPORT_H
+#include "ndcrash_dump.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Prepares a memory-mapped buffer for a crash report in in-process mode. A staging file
+ * "<report_file>.mmap" is created and pre-allocated, a signal handler writes a report to its mapped
+ * memory without system calls and then copies it to report_file at once. If a staging file contains
+ * a committed report that wasn't copied (for example, a process has been killed while copying) it's
+ * written to report_file first. Not signal safe.
+ * @param report_file Path to a crash report file.
+ * @return Flag whether a buffer is ready to use.
+ */
+bool ndcrash_in_report_init(const char *report_file);
+
+/**
+ * Unmaps and closes a staging file. A committed report that wasn't written to a report file stays
+ * in it and is recovered on next initialization.
+ */
+void ndcrash_in_report_deinit();
+
+/**
+ * Starts writing a report to a memory-mapped buffer. Signal safe.
+ * @return Buffer to pass to ndcrash_dump_set_buffer or NULL if a buffer isn't initialized.
+ */
+struct ndcrash_dump_buffer *ndcrash_in_report_begin();
+
+/**
+ * Finishes writing a report: records its length, sets a committed marker and writes a report to
+ * a report file. A marker is cleared when a report file is written successfully. Signal safe.
+ * @param report_file Path to a crash report file.
+ */
+void ndcrash_in_report_commit(const char *report_file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_IN_REPORT_H
@@ -0,0 +1,183 @@
+#include "ndcrash_in_threads.h"
+#include "ndcrash_log.h"
+#include "ndcrash_utils.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if defined(ENABLE_INPROCESS) && defined(ENABLE_INPROCESS_ALL_THREADS)
+
+/// Slots allocated by mmap on initialization. NULL if not initialized.
+static struct ndcrash_in_thread_slot *ndcrash_in_threads_slots = NULL;
+
+/// Count of slots used on last suspend.
+static size_t ndcrash_in_threads_count = 0;
+
+/// Old handler of thread signal, restored on de-initialization.
+static struct sigaction ndcrash_in_threads_old_handler;
+
+/**
+ * Directory entry returned by getdents64 system call.
+ */
+struct ndcrash_linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * Signal handler executed by other threads. Copies a context to a slot and parks until a slot is
+ * released by a crashing thread.
+ */
+static void ndcrash_in_threads_signal_handler(int signo, struct siginfo *siginfo, void *ctxvoid) {
+    struct ndcrash_in_thread_slot * const slots = __atomic_load_n(&ndcrash_in_threads_slots, __ATOMIC_ACQUIRE);
+    if (!slots) return;
+    const pid_t tid = gettid();
+    for (size_t i = 0; i < NDCRASH_IN_MAX_THREADS; ++i) {
+        struct ndcrash_in_thread_slot * const slot = &slots[i];
+        if (slot->tid != tid) continue;
+
+        // State transitions are done by compare-and-swap: a slot may be released by a crashing
+        // thread at any moment if a timeout has expired.
+        int state = ndcrash_in_thread_requested;
+        if (!__atomic_compare_exchange_n(&slot->state, &state, ndcrash_in_thread_writing, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        memcpy(&slot->context, ctxvoid, sizeof(struct ucontext));
+        state = ndcrash_in_thread_writing;
+        if (!__atomic_compare_exchange_n(&slot->state, &state, ndcrash_in_thread_ready, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        ndcrash_futex_wake(&slot->state);
+        while (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == ndcrash_in_thread_ready) {
+            ndcrash_futex_wait(&slot->state, ndcrash_in_thread_ready, -1);
+        }
+        break;
+    }
+}
+
+bool ndcrash_in_threads_init() {
+    if (ndcrash_in_threads_slots) return true;
+    void * const slots = mmap(
+            NULL,
+            sizeof(struct ndcrash_in_thread_slot) * NDCRASH_IN_MAX_THREADS,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0);
+    if (slots == MAP_FAILED) {
+        NDCRASHLOG(ERROR, "Couldn't allocate thread slots: %s (%d)", strerror(errno), errno);
+        return false;
+    }
+
+    struct sigaction sigactionstruct;
+    memset(&sigactionstruct, 0, sizeof(sigactionstruct));
+    sigactionstruct.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+    sigactionstruct.sa_sigaction = &ndcrash_in_threads_signal_handler;
+    if (sigaction(NDCRASH_IN_THREADS_SIGNAL, &sigactionstruct, &ndcrash_in_threads_old_handler)) {
+        NDCRASHLOG(ERROR, "Couldn't register thread signal handler: %s (%d)", strerror(errno), errno);
+        munmap(slots, sizeof(struct ndcrash_in_thread_slot) * NDCRASH_IN_MAX_THREADS);
+        return false;
+    }
+    __atomic_store_n(&ndcrash_in_threads_slots, (struct ndcrash_in_thread_slot *) slots, __ATOMIC_RELEASE);
+    return true;
+}
+
+void ndcrash_in_threads_deinit() {
+    struct ndcrash_in_thread_slot * const slots =
+            __atomic_exchange_n(&ndcrash_in_threads_slots, NULL, __ATOMIC_ACQ_REL);
+    if (!slots) return;
+    sigaction(NDCRASH_IN_THREADS_SIGNAL, &ndcrash_in_threads_old_handler, NULL);
+    munmap(slots, sizeof(struct ndcrash_in_thread_slot) * NDCRASH_IN_MAX_THREADS);
+}
+
+/**
+ * Parses a thread identifier from a directory entry name of /proc/self/task.
+ * @return Thread identifier or 0 if a name isn't a number.
+ */
+static inline pid_t ndcrash_in_threads_parse_tid(const char *name) {
+    pid_t result = 0;
+    for (; *name; ++name) {
+        if (*name < '0' || *name > '9') return 0;
+        result = result * 10 + (*name - '0');
+    }
+    return result;
+}
+
+size_t ndcrash_in_threads_suspend() {
+    struct ndcrash_in_thread_slot * const slots = __atomic_load_n(&ndcrash_in_threads_slots, __ATOMIC_ACQUIRE);
+    if (!slots) return 0;
+
+    // Reading a list of threads by getdents64 system call: opendir allocates a memory.
+    const int fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    const pid_t pid = getpid(), tid = gettid();
+    size_t count = 0;
+    char buffer[512] __attribute__((aligned(8)));
+    long bytes_read;
+    while (count < NDCRASH_IN_MAX_THREADS &&
+           (bytes_read = syscall(__NR_getdents64, fd, buffer, sizeof(buffer))) > 0) {
+        for (long offset = 0; offset < bytes_read && count < NDCRASH_IN_MAX_THREADS; ) {
+            const struct ndcrash_linux_dirent64 * const entry =
+                    (const struct ndcrash_linux_dirent64 *) (buffer + offset);
+            offset += entry->d_reclen;
+            const pid_t other_tid = ndcrash_in_threads_parse_tid(entry->d_name);
+            if (!other_tid || other_tid == tid) continue;
+
+            // Sending a signal, a slot is used only if it has been sent successfully.
+            struct ndcrash_in_thread_slot * const slot = &slots[count];
+            slot->tid = other_tid;
+            __atomic_store_n(&slot->state, ndcrash_in_thread_requested, __ATOMIC_RELEASE);
+            if (syscall(__NR_tgkill, pid, other_tid, NDCRASH_IN_THREADS_SIGNAL)) {
+                __atomic_store_n(&slot->state, ndcrash_in_thread_free, __ATOMIC_RELEASE);
+                slot->tid = 0;
+                continue;
+            }
+            ++count;
+        }
+    }
+    close(fd);
+    ndcrash_in_threads_count = count;
+
+    // Waiting for all threads with a common deadline.
+    const int64_t deadline = ndcrash_time_ms() + NDCRASH_IN_THREADS_TIMEOUT_MS;
+    for (size_t i = 0; i < count; ++i) {
+        struct ndcrash_in_thread_slot * const slot = &slots[i];
+        int state;
+        while ((state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE)) == ndcrash_in_thread_requested ||
+               state == ndcrash_in_thread_writing) {
+            const int64_t remaining = deadline - ndcrash_time_ms();
+            if (remaining <= 0) break;
+            ndcrash_futex_wait(&slot->state, state, (int) remaining);
+        }
+    }
+    return count;
+}
+
+struct ndcrash_in_thread_slot *ndcrash_in_threads_slot(size_t index) {
+    return &ndcrash_in_threads_slots[index];
+}
+
+void ndcrash_in_threads_resume() {
+    struct ndcrash_in_thread_slot * const slots = __atomic_load_n(&ndcrash_in_threads_slots, __ATOMIC_ACQUIRE);
+    if (!slots) return;
+    for (size_t i = 0; i < ndcrash_in_threads_count; ++i) {
+        struct ndcrash_in_thread_slot * const slot = &slots[i];
+        // A thread that hasn't responded in time finds its slot free and doesn't park.
+        __atomic_store_n(&slot->state, ndcrash_in_thread_free, __ATOMIC_RELEASE);
+        ndcrash_futex_wake(&slot->state);
+        slot->tid = 0;
+    }
+    ndcrash_in_threads_count = 0;
+}
+
+#endif //defined(ENABLE_INPROCESS) && defined(ENABLE_INPROCESS_ALL_THREADS)
@@ -0,0 +1,83 @@
+#ifndef NDCRASH_IN_THREADS_H
+#define NDCRASH_IN_THREADS_H
+#include "ndcrash_private.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * State of a thread slot.
+ */
+enum ndcrash_in_thread_state {
+
+    /// Slot isn't used.
+    ndcrash_in_thread_free,
+
+    /// A signal has been sent to a thread, waiting for its context.
+    ndcrash_in_thread_requested,
+
+    /// A thread is writing its context to a slot.
+    ndcrash_in_thread_writing,
+
+    /// A thread has copied its context to a slot and is parked until a slot is released.
+    ndcrash_in_thread_ready,
+};
+
+/**
+ * Slot for other (not crashed) thread data. Slots are allocated on initialization, a thread
+ * writes its context to a slot from a signal handler.
+ */
+struct ndcrash_in_thread_slot {
+
+    /// Thread identifier.
+    pid_t tid;
+
+    /// Slot state, a value of ndcrash_in_thread_state. Used as a futex.
+    int state;
+
+    /// Processor context of a thread in a moment when a signal was received.
+    struct ucontext context;
+};
+
+/**
+ * Allocates slots for threads and registers a handler for a signal that is sent to other threads
+ * on crash. Not signal safe, should be called on in-process mode initialization.
+ * @return Flag whether initialization is successful.
+ */
+bool ndcrash_in_threads_init();
+
+/**
+ * Restores an old handler for a thread signal and frees slots.
+ */
+void ndcrash_in_threads_deinit();
+
+/**
+ * Sends a signal to all threads of a current process except a current one and waits until they
+ * write their contexts to slots. Waiting is limited by NDCRASH_IN_THREADS_TIMEOUT_MS, threads that
+ * haven't responded are skipped. Threads stay parked until ndcrash_in_threads_resume is called.
+ * Signal safe, should be called from a crash signal handler.
+ * @return Count of used slots, some of them may not be in ready state.
+ */
+size_t ndcrash_in_threads_suspend();
+
+/**
+ * Retrieves a slot by index.
+ * @param index Slot index, should be less than a value returned by ndcrash_in_threads_suspend.
+ * @return Pointer to a slot. A context is valid only if a slot is in ready state.
+ */
+struct ndcrash_in_thread_slot *ndcrash_in_threads_slot(size_t index);
+
+/**
+ * Releases all slots and resumes parked threads. Signal safe.
+ */
+void ndcrash_in_threads_resume();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_IN_THREADS_H
@@ -1,15 +1,21 @@
 #ifndef NDCRASHDEMO_NDCRASH_LOG_H
 #define NDCRASHDEMO_NDCRASH_LOG_H
-#include <android/log.h>
+#include "ndcrash_output.h"
 
 #ifndef NDCRASH_LOG_TAG
 #define NDCRASH_LOG_TAG "NDCRASH"
 #endif
 
+// Message levels, values are the same as Android log priorities.
+#define NDCRASH_LOG_LEVEL_DEBUG 3
+#define NDCRASH_LOG_LEVEL_INFO 4
+#define NDCRASH_LOG_LEVEL_WARN 5
+#define NDCRASH_LOG_LEVEL_ERROR 6
+
 #ifdef NDCRASH_NO_LOG
 #define NDCRASHLOG(level, ...)
 #else
-#define NDCRASHLOG(level, ...) __android_log_print(ANDROID_LOG_##level, NDCRASH_LOG_TAG, __VA_ARGS__)
+#define NDCRASHLOG(level, ...) ndcrash_output_print(NDCRASH_LOG_LEVEL_##level, __VA_ARGS__)
 #endif
 
 #endif //NDCRASHDEMO_NDCRASH_LOG_H
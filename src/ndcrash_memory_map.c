@@ -1,63 +1,140 @@
 #include "ndcrash_memory_map.h"
-#include <stdio.h>
+#include "ndcrash_format.h"
+#include "ndcrash_private.h"
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
+
+/// Size of reading buffer: a path of maximum length and other fields of a line.
+#define NDCRASH_MEMORY_MAP_BUFFER_SIZE (NDCRASH_MAX_MODULE_NAME_LENGTH + 128)
+
+/**
+ * Parses a single null-terminated line of memory map and passes it to a callback.
+ * @return Flag whether parsing should be continued. False on format error or if a callback has
+ * stopped parsing.
+ */
+static bool ndcrash_parse_memory_map_line(const char *line, ndcrash_memory_map_entry_callback callback, void *data) {
+    struct ndcrash_memory_map_entry entry;
+
+    // Start and end addresses.
+    const char *it = line;
+    entry.start = ndcrash_parse_hex(it, &it);
+    if (it == line || *it != '-') return false;
+    const char * const end_str = ++it;
+    entry.end = ndcrash_parse_hex(it, &it);
+    if (it == end_str || *it != ' ') return false;
+    ++it;
+
+    // Permissions, 4 characters like "r-xp".
+    entry.prot = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        if (!it[i]) return false;
+    }
+    if (it[0] == 'r') entry.prot |= PROT_READ;
+    if (it[1] == 'w') entry.prot |= PROT_WRITE;
+    if (it[2] == 'x') entry.prot |= PROT_EXEC;
+    it += 4;
+    if (*it != ' ') return false;
+
+    // File offset.
+    const char * const offset_str = ++it;
+    entry.offset = ndcrash_parse_hex(it, &it);
+    if (it == offset_str || *it != ' ') return false;
+
+    // Device is skipped, then decimal inode.
+    for (++it; *it && *it != ' '; ++it);
+    for (; *it == ' '; ++it);
+    entry.inode = 0;
+    for (; *it >= '0' && *it <= '9'; ++it) {
+        entry.inode = entry.inode * 10 + (unsigned long) (*it - '0');
+    }
+
+    // Path is the rest of a line after padding.
+    for (; *it == ' '; ++it);
+    entry.path = it;
+
+    bool stop = false;
+    callback(&entry, data, &stop);
+    return !stop;
+}
 
 void ndcrash_parse_memory_map(pid_t pid, ndcrash_memory_map_entry_callback callback, void *data) {
 
-    // Reading buffer. Should have enough space for 2 pointers, '-' separator and terminating '\0'.
-    char buffer[34];
+    // Reading buffer. The last character is reserved for terminating '\0'.
+    char buffer[NDCRASH_MEMORY_MAP_BUFFER_SIZE];
 
     // Opening input file.
-    snprintf(buffer, sizeof(buffer), "/proc/%d/maps", (int) pid);
+    ndcrash_format(buffer, sizeof(buffer), "/proc/%d/maps", (int) pid);
     const int fd = open(buffer, O_RDONLY);
     if (fd < 0) return;
 
-    // How many bytes are read on each cycle iteration.
-    ssize_t bytes_read;
+    // Count of bytes in buffer that don't form a complete line yet.
+    size_t length = 0;
 
-    // An offset within buffer where a data is saved on reading.
-    size_t read_offset = 0;
+    // Flag whether the rest of a too long line should be skipped until a new line.
+    bool skip = false;
 
-    // Flag if a buffer starts from a new line. Assuming the first line is new.
-    bool new_line = true;
-
-    // The last buffer character is reserved for terminating '\0'.
-    while ((bytes_read = read(fd, buffer + read_offset, sizeof(buffer) - read_offset - 1)) != 0) {
-        if (bytes_read < 0) {
+    for (;;) {
+        const ssize_t bytes_read = read(fd, buffer + length, sizeof(buffer) - length - 1);
+        if (bytes_read <= 0) {
+            // The last line may have no new line character.
+            if (!bytes_read && length && !skip) {
+                buffer[length] = '\0';
+                ndcrash_parse_memory_map_line(buffer, callback, data);
+            }
             goto func_end;
         }
-        buffer[bytes_read + read_offset] = '\0';
-        if (new_line) {
-            // Obtaining start and end addresses
-            unsigned long int start, end;
-            if (sscanf(buffer, "%lx-%lx", &start, &end) != 2) {
+        length += (size_t) bytes_read;
+
+        // Processing all complete lines.
+        char *line = buffer;
+        char * const buffer_end = buffer + length;
+        for (;;) {
+            char * const newline = (char *) memchr(line, '\n', (size_t) (buffer_end - line));
+            if (!newline) break;
+            *newline = '\0';
+            if (skip) {
+                skip = false;
+            } else if (!ndcrash_parse_memory_map_line(line, callback, data)) {
                 goto func_end;
             }
-            bool stop = false;
-            callback(start, end, data, &stop);
-            if (stop) {
+            line = newline + 1;
+        }
+
+        length = (size_t) (buffer_end - line);
+        if (line == buffer && length == sizeof(buffer) - 1) {
+            // A line doesn't fit to buffer: parsing it with a truncated path and skipping the rest.
+            buffer[length] = '\0';
+            if (!skip && !ndcrash_parse_memory_map_line(buffer, callback, data)) {
                 goto func_end;
             }
-        }
-        // Searching for a new line.
-        ssize_t newline_pos = 0;
-        for (; newline_pos != bytes_read; ++newline_pos) {
-            if (buffer[newline_pos] == '\n') break;
-        }
-        if (newline_pos != bytes_read) {
-            // How many bytes was read AFTER newline pos.
-            read_offset = (size_t) (bytes_read - newline_pos - 1);
-            // Moving memory, a byte after new line should be at the beginning of buffer.
-            memmove(buffer, buffer + newline_pos + 1, read_offset);
-            new_line = true;
+            skip = true;
+            length = 0;
         } else {
-            read_offset = 0;
-            new_line = false;
+            // Moving an incomplete line to the beginning of buffer.
+            memmove(buffer, line, length);
         }
     }
 
     func_end:
     close(fd);
-}
\ No newline at end of file
+}
+
+/**
+ * Callback for a memory map parsing function. Finds an end of a mapping containing an address.
+ * For arguments description see ndcrash_memory_map_entry_callback type definition.
+ */
+static void ndcrash_memory_map_find_end_callback(const struct ndcrash_memory_map_entry *entry, void *data, bool *stop) {
+    uintptr_t * const bounds = (uintptr_t *) data;
+    if (entry->start <= bounds[0] && bounds[0] < entry->end) {
+        bounds[1] = entry->end;
+        *stop = true;
+    }
+}
+
+uintptr_t ndcrash_memory_map_find_end(pid_t pid, uintptr_t address) {
+    uintptr_t bounds[2] = { address, address };
+    ndcrash_parse_memory_map(pid, &ndcrash_memory_map_find_end_callback, bounds);
+    return bounds[1];
+}
@@ -5,21 +5,54 @@
 #include <sys/types.h>
 
 /**
- * Callback type for a memory map parser. Note that now only getting start and end addresses is
- * supported.
- * @param start Start address of region, inclusive.
- * @param end End address of region, exclusive.
+ * A single entry of memory map, corresponds to a line of /proc/<pid>/maps file.
+ */
+struct ndcrash_memory_map_entry {
+
+    /// Start address of region, inclusive.
+    uintptr_t start;
+
+    /// End address of region, exclusive.
+    uintptr_t end;
+
+    /// Access flags of region: bit mask of PROT_READ, PROT_WRITE and PROT_EXEC values.
+    int prot;
+
+    /// Offset of region within a mapped file. 0 for anonymous memory.
+    uintptr_t offset;
+
+    /// Inode of a mapped file. 0 for anonymous memory.
+    unsigned long inode;
+
+    /// Path of a mapped file or a pseudo-path like [stack]. Empty string for anonymous memory.
+    /// Truncated if a line is longer than parser buffer. Valid only during a callback call.
+    const char *path;
+};
+
+/**
+ * Callback type for a memory map parser.
+ * @param entry Parsed memory map entry.
  * @param data Auxiliary data passed from parsing function.
  * @param stop Pointer to a flag which allows us to stop memory maps parsing.
  */
-typedef void (*ndcrash_memory_map_entry_callback)(uintptr_t start, uintptr_t end, void *data, bool *stop);
+typedef void (*ndcrash_memory_map_entry_callback)(const struct ndcrash_memory_map_entry *entry, void *data, bool *stop);
 
 /**
  * Parses memory map for specified pid. Calls callback for each line of map providing values to it.
+ * Uses only a stack buffer, signal safe.
  * @param pid Process id which memory map to parse.
  * @param callback Callback which is called for each line during parsing.
  * @param data Auxiliary data passed to callback.
  */
 void ndcrash_parse_memory_map(pid_t pid, ndcrash_memory_map_entry_callback callback, void *data);
 
+/**
+ * Finds an end of a mapping containing an address, for example an end of a stack mapping
+ * containing sp value. Used by unwinders to read stack memory only within its bounds. Signal safe.
+ * @param pid Process id which memory map to parse.
+ * @param address Address to look for.
+ * @return End of a mapping, exclusive. Equal to address if it isn't mapped.
+ */
+uintptr_t ndcrash_memory_map_find_end(pid_t pid, uintptr_t address);
+
 #endif //NDCRASH_MEMORY_MAP_H
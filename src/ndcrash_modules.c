@@ -0,0 +1,435 @@
+#include "ndcrash_modules.h"
+#include "ndcrash_log.h"
+#include "ndcrash_memory_map.h"
+#include "ndcrash_utils.h"
+#include "ndcrash_dwarf.h"
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef ENABLE_INPROCESS
+
+/// Maximum count of executable segments, typically a module has only one.
+#define NDCRASH_MAX_EXEC_RANGES (NDCRASH_MAX_MODULES * 2)
+
+/**
+ * Table of loaded modules sorted by start address.
+ */
+struct ndcrash_modules_table {
+
+    /// Count of filled elements in modules array.
+    size_t count;
+
+    /// Module descriptions, sorted by start address.
+    struct ndcrash_module modules[NDCRASH_MAX_MODULES];
+
+    /// Count of filled elements in exec_ranges array.
+    size_t exec_ranges_count;
+
+    /// Executable segments of modules, sorted by start address.
+    struct ndcrash_exec_range exec_ranges[NDCRASH_MAX_EXEC_RANGES];
+};
+
+/// Two tables allocated by mmap: one is published for a signal handler, another is filled on refresh.
+static struct ndcrash_modules_table *ndcrash_modules_tables = NULL;
+
+/// Published table which is used for lookup. Switched atomically on refresh, NULL if not initialized.
+static struct ndcrash_modules_table *ndcrash_modules_active = NULL;
+
+/// Mutex that serializes refresh calls from different threads.
+static pthread_mutex_t ndcrash_modules_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// Count of signal handlers that use a registry now, see ndcrash_modules_acquire.
+static int ndcrash_modules_readers = 0;
+
+/**
+ * Callback for dl_iterate_phdr. Appends a module to a table passed as data argument.
+ */
+static int ndcrash_modules_iterate_callback(struct dl_phdr_info *info, size_t size, void *data) {
+    struct ndcrash_modules_table * const table = (struct ndcrash_modules_table *) data;
+    if (table->count >= NDCRASH_MAX_MODULES) {
+        NDCRASHLOG(WARN, "Modules count exceeds limit %d, skipping the rest.", NDCRASH_MAX_MODULES);
+        return 1;
+    }
+
+    // Calculating module bounds by its loadable segments.
+    uintptr_t start = UINTPTR_MAX, end = 0;
+    for (size_t i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr) * const phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_LOAD) continue;
+        const uintptr_t segment_start = info->dlpi_addr + phdr->p_vaddr;
+        const uintptr_t segment_end = segment_start + phdr->p_memsz;
+        if (segment_start < start) start = segment_start;
+        if (segment_end > end) end = segment_end;
+    }
+    if (start >= end) return 0;
+
+    const uintptr_t page_mask = (uintptr_t) getpagesize() - 1;
+    struct ndcrash_module * const module = &table->modules[table->count];
+    module->start = start & ~page_mask;
+    module->end = (end + page_mask) & ~page_mask;
+    module->load_bias = info->dlpi_addr;
+    module->phdr = info->dlpi_phdr;
+    module->phnum = info->dlpi_phnum;
+    module->offset = 0;
+    module->name[0] = '\0';
+    if (info->dlpi_name && *info->dlpi_name) {
+        strncpy(module->name, info->dlpi_name, sizeof(module->name) - 1);
+        module->name[sizeof(module->name) - 1] = '\0';
+    } else if (!table->count) {
+        // The first module is always a main executable, some linkers report it without a name.
+        const ssize_t length = readlink("/proc/self/exe", module->name, sizeof(module->name) - 1);
+        module->name[length > 0 ? length : 0] = '\0';
+    }
+    module->is_system = ndcrash_is_system_module(module->name);
+    memset(&module->symbols, 0, sizeof(module->symbols));
+    module->build_id_size = 0;
+    ++table->count;
+    return 0;
+}
+
+/**
+ * Comparison function for qsort, orders modules by start address.
+ */
+static int ndcrash_modules_compare(const void *a, const void *b) {
+    const uintptr_t start_a = ((const struct ndcrash_module *) a)->start;
+    const uintptr_t start_b = ((const struct ndcrash_module *) b)->start;
+    return start_a < start_b ? -1 : start_a > start_b;
+}
+
+/**
+ * Fills a table of executable segments by already sorted modules. Segments of different modules
+ * don't overlap so they are sorted too.
+ */
+static void ndcrash_modules_fill_exec_ranges(struct ndcrash_modules_table *table) {
+    table->exec_ranges_count = 0;
+    for (size_t i = 0; i < table->count; ++i) {
+        const struct ndcrash_module * const module = &table->modules[i];
+        for (size_t j = 0; j < module->phnum; ++j) {
+            const ElfW(Phdr) * const phdr = &module->phdr[j];
+            if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_X)) continue;
+            if (table->exec_ranges_count >= NDCRASH_MAX_EXEC_RANGES) return;
+            struct ndcrash_exec_range * const range = &table->exec_ranges[table->exec_ranges_count++];
+            range->start = module->load_bias + phdr->p_vaddr;
+            range->end = range->start + phdr->p_memsz;
+            range->module = module;
+        }
+    }
+}
+
+/**
+ * Looks for a module with the same file and load address in another table.
+ * @return Pointer to found module or NULL.
+ */
+static struct ndcrash_module *ndcrash_modules_find_same(
+        struct ndcrash_modules_table *table,
+        const struct ndcrash_module *module) {
+    if (!table) return NULL;
+    for (size_t i = 0; i < table->count; ++i) {
+        struct ndcrash_module * const candidate = &table->modules[i];
+        if (candidate->load_bias == module->load_bias && !strcmp(candidate->name, module->name)) {
+            return candidate;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Checks whether a segment is within a loaded part of a module, so it can be read from memory.
+ * @return Flag value.
+ */
+static bool ndcrash_modules_is_loaded(const struct ndcrash_module *module, const ElfW(Phdr) *segment) {
+    for (size_t i = 0; i < module->phnum; ++i) {
+        const ElfW(Phdr) * const phdr = &module->phdr[i];
+        if (phdr->p_type != PT_LOAD) continue;
+        if (segment->p_vaddr >= phdr->p_vaddr &&
+            segment->p_vaddr + segment->p_memsz <= phdr->p_vaddr + phdr->p_filesz) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads GNU build-id of a module from its PT_NOTE segments mapped to memory.
+ */
+static void ndcrash_modules_read_build_id(struct ndcrash_module *module) {
+    module->build_id_size = 0;
+    for (size_t i = 0; i < module->phnum && !module->build_id_size; ++i) {
+        const ElfW(Phdr) * const phdr = &module->phdr[i];
+        if (phdr->p_type != PT_NOTE || !ndcrash_modules_is_loaded(module, phdr)) continue;
+        module->build_id_size = ndcrash_elf_parse_build_id(
+                (const void *) (module->load_bias + phdr->p_vaddr), phdr->p_memsz, module->build_id);
+    }
+}
+
+/**
+ * Locates a binary search table of .eh_frame_hdr section of a module by PT_GNU_EH_FRAME segment.
+ * Only a table with 4-byte entries relative to a section start is used, linkers always produce it.
+ */
+static void ndcrash_modules_read_eh_frame_hdr(struct ndcrash_module *module) {
+    module->eh_frame_hdr = 0;
+    module->eh_frame_table = NULL;
+    module->eh_frame_table_count = 0;
+    for (size_t i = 0; i < module->phnum; ++i) {
+        const ElfW(Phdr) * const phdr = &module->phdr[i];
+        if (phdr->p_type != PT_GNU_EH_FRAME || !ndcrash_modules_is_loaded(module, phdr)) continue;
+
+        // Header: version, eh_frame_ptr encoding, fde_count encoding, table encoding, then
+        // eh_frame_ptr value, fde_count value and a table.
+        const uint8_t * const hdr = (const uint8_t *) (module->load_bias + phdr->p_vaddr);
+        if (phdr->p_memsz < 12 ||
+            hdr[0] != 1 ||
+            (hdr[1] & 0x0f) != DW_EH_PE_sdata4 ||
+            hdr[2] != DW_EH_PE_udata4 ||
+            hdr[3] != (DW_EH_PE_datarel | DW_EH_PE_sdata4)) {
+            return;
+        }
+        uint32_t count;
+        memcpy(&count, hdr + 8, sizeof(count));
+        if (12 + (uint64_t) count * 2 * sizeof(int32_t) > phdr->p_memsz) return;
+        module->eh_frame_hdr = (uintptr_t) hdr;
+        module->eh_frame_table = (const int32_t *) (hdr + 12);
+        module->eh_frame_table_count = count;
+        return;
+    }
+}
+
+#ifdef __arm__
+/**
+ * Locates .ARM.exidx unwinding table of a module by PT_ARM_EXIDX segment.
+ */
+static void ndcrash_modules_read_arm_exidx(struct ndcrash_module *module) {
+    module->arm_exidx = NULL;
+    module->arm_exidx_count = 0;
+    for (size_t i = 0; i < module->phnum; ++i) {
+        const ElfW(Phdr) * const phdr = &module->phdr[i];
+        if (phdr->p_type != PT_ARM_EXIDX || !ndcrash_modules_is_loaded(module, phdr)) continue;
+        module->arm_exidx = (const uint32_t *) (module->load_bias + phdr->p_vaddr);
+        module->arm_exidx_count = phdr->p_memsz / (2 * sizeof(uint32_t));
+        return;
+    }
+}
+#endif
+
+/**
+ * Fills symbols and build-ids for all modules of a new table. They are taken from a previous table
+ * for modules that have been already loaded, otherwise symbols are read from module files and
+ * build-ids are read from module memory.
+ */
+static void ndcrash_modules_fill_symbols(
+        struct ndcrash_modules_table *table,
+        struct ndcrash_modules_table *previous) {
+    for (size_t i = 0; i < table->count; ++i) {
+        struct ndcrash_module * const module = &table->modules[i];
+        const struct ndcrash_module * const same = ndcrash_modules_find_same(previous, module);
+        if (same) {
+            module->symbols = same->symbols;
+            memcpy(module->build_id, same->build_id, same->build_id_size);
+            module->build_id_size = same->build_id_size;
+            continue;
+        }
+        if (module->name[0] == '/') {
+            // A library loaded from APK is named like "base.apk!/lib/abi/libname.so", its image
+            // is stored within APK file at a module offset.
+            char path[NDCRASH_MAX_MODULE_NAME_LENGTH];
+            strcpy(path, module->name);
+            char * const separator = module->offset ? strstr(path, "!/") : NULL;
+            if (separator) *separator = '\0';
+            ndcrash_elf_load_symbols(path, module->offset, !module->is_system, &module->symbols);
+        }
+        ndcrash_modules_read_build_id(module);
+    }
+}
+
+/**
+ * Callback for a memory map parser. Sets a file offset for a module which starts at a mapping
+ * start address. For arguments description see ndcrash_memory_map_entry_callback type definition.
+ */
+static void ndcrash_modules_maps_callback(const struct ndcrash_memory_map_entry *entry, void *data, bool *stop) {
+    struct ndcrash_modules_table * const table = (struct ndcrash_modules_table *) data;
+    if (!entry->offset) return;
+
+    // Binary search by start address, modules are sorted.
+    size_t low = 0, high = table->count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (table->modules[middle].start < entry->start) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < table->count && table->modules[low].start == entry->start) {
+        table->modules[low].offset = entry->offset;
+    }
+}
+
+/**
+ * Frees symbols of modules from a previous table that aren't used in a new table anymore.
+ */
+static void ndcrash_modules_free_unused_symbols(
+        struct ndcrash_modules_table *previous,
+        struct ndcrash_modules_table *table) {
+    if (!previous) return;
+    for (size_t i = 0; i < previous->count; ++i) {
+        struct ndcrash_module * const module = &previous->modules[i];
+        if (!table || !ndcrash_modules_find_same(table, module)) {
+            ndcrash_elf_free_symbols(&module->symbols);
+        }
+    }
+}
+
+void ndcrash_modules_acquire() {
+    __atomic_add_fetch(&ndcrash_modules_readers, 1, __ATOMIC_SEQ_CST);
+
+    // A published table is loaded after a counter increment becomes visible to refresh.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void ndcrash_modules_release() {
+    __atomic_sub_fetch(&ndcrash_modules_readers, 1, __ATOMIC_SEQ_CST);
+}
+
+void ndcrash_modules_wait_released() {
+    // Handlers are rare and short, polling is enough. A process is usually terminated after a
+    // handler, so waiting doesn't last long either way.
+    while (__atomic_load_n(&ndcrash_modules_readers, __ATOMIC_SEQ_CST)) {
+        usleep(1000);
+    }
+}
+
+bool ndcrash_modules_init() {
+    if (ndcrash_modules_tables) return true;
+    void * const tables = mmap(
+            NULL,
+            sizeof(struct ndcrash_modules_table) * 2,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0);
+    if (tables == MAP_FAILED) {
+        NDCRASHLOG(ERROR, "Couldn't allocate modules registry: %s (%d)", strerror(errno), errno);
+        return false;
+    }
+    ndcrash_modules_tables = (struct ndcrash_modules_table *) tables;
+    ndcrash_modules_refresh();
+    return true;
+}
+
+void ndcrash_modules_deinit() {
+    if (!ndcrash_modules_tables) return;
+    pthread_mutex_lock(&ndcrash_modules_mutex);
+    struct ndcrash_modules_table * const previous = ndcrash_modules_active;
+    __atomic_store_n(&ndcrash_modules_active, NULL, __ATOMIC_SEQ_CST);
+    ndcrash_modules_wait_released();
+    ndcrash_modules_free_unused_symbols(previous, NULL);
+    munmap(ndcrash_modules_tables, sizeof(struct ndcrash_modules_table) * 2);
+    ndcrash_modules_tables = NULL;
+    pthread_mutex_unlock(&ndcrash_modules_mutex);
+}
+
+void ndcrash_modules_refresh() {
+    pthread_mutex_lock(&ndcrash_modules_mutex);
+    if (ndcrash_modules_tables) {
+        // Filling a table that isn't published. A signal handler may use a published one meanwhile.
+        // Symbols are owned by a published table.
+        struct ndcrash_modules_table * const previous = ndcrash_modules_active;
+        struct ndcrash_modules_table * const table =
+                previous == ndcrash_modules_tables ? ndcrash_modules_tables + 1 : ndcrash_modules_tables;
+        table->count = 0;
+        dl_iterate_phdr(&ndcrash_modules_iterate_callback, table);
+        qsort(table->modules, table->count, sizeof(struct ndcrash_module), &ndcrash_modules_compare);
+        ndcrash_modules_fill_exec_ranges(table);
+        for (size_t i = 0; i < table->count; ++i) {
+            ndcrash_modules_read_eh_frame_hdr(&table->modules[i]);
+#ifdef __arm__
+            ndcrash_modules_read_arm_exidx(&table->modules[i]);
+#endif
+        }
+        // Offsets are needed to load symbols of libraries loaded from APK.
+        ndcrash_parse_memory_map(getpid(), &ndcrash_modules_maps_callback, table);
+        ndcrash_modules_fill_symbols(table, previous);
+        __atomic_store_n(&ndcrash_modules_active, table, __ATOMIC_SEQ_CST);
+
+        // A previous table and its symbols may be still used by a signal handler that has started
+        // before publishing. It's reused by the next refresh, so waiting for handlers here.
+        ndcrash_modules_wait_released();
+        ndcrash_modules_free_unused_symbols(previous, table);
+    }
+    pthread_mutex_unlock(&ndcrash_modules_mutex);
+}
+
+const struct ndcrash_module *ndcrash_modules_find(uintptr_t address) {
+    const struct ndcrash_modules_table * const table =
+            __atomic_load_n(&ndcrash_modules_active, __ATOMIC_ACQUIRE);
+    if (!table) return NULL;
+
+    // Binary search for the first module with start address greater than searched address.
+    size_t low = 0, high = table->count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (address < table->modules[middle].start) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    if (!low) return NULL;
+    const struct ndcrash_module * const module = &table->modules[low - 1];
+    return address < module->end ? module : NULL;
+}
+
+const struct ndcrash_exec_range *ndcrash_modules_exec_ranges(size_t *count) {
+    const struct ndcrash_modules_table * const table =
+            __atomic_load_n(&ndcrash_modules_active, __ATOMIC_ACQUIRE);
+    *count = table ? table->exec_ranges_count : 0;
+    return table ? table->exec_ranges : NULL;
+}
+
+const struct ndcrash_exec_range *ndcrash_modules_find_exec(uintptr_t address) {
+    const struct ndcrash_modules_table * const table =
+            __atomic_load_n(&ndcrash_modules_active, __ATOMIC_ACQUIRE);
+    if (!table) return NULL;
+
+    // The same binary search as for modules.
+    size_t low = 0, high = table->exec_ranges_count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (address < table->exec_ranges[middle].start) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    if (!low) return NULL;
+    const struct ndcrash_exec_range * const range = &table->exec_ranges[low - 1];
+    return address < range->end ? range : NULL;
+}
+
+void ndcrash_modules_add_frame(struct ndcrash_frames *frames, uintptr_t pc, uintptr_t lookup_pc) {
+    const struct ndcrash_module * const module = ndcrash_modules_find(pc);
+    if (!module) {
+        ndcrash_frames_add(frames, pc, pc, NULL, NULL, 0, 0);
+        return;
+    }
+    uintptr_t func_offset = 0;
+    const char * const func_name = frames->defer_symbols ?
+            NULL : ndcrash_elf_find_symbol(&module->symbols, lookup_pc - module->load_bias, &func_offset);
+    if (func_name) {
+        func_offset += pc - lookup_pc;
+    }
+    ndcrash_frames_add(
+            frames,
+            pc,
+            pc - module->load_bias,
+            module->name,
+            func_name,
+            func_offset,
+            lookup_pc != pc ? ndcrash_frame_return_address : 0);
+}
+
+#endif //ENABLE_INPROCESS
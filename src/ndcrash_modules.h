@@ -0,0 +1,167 @@
+#ifndef NDCRASH_MODULES_H
+#define NDCRASH_MODULES_H
+#include "ndcrash_private.h"
+#include "ndcrash_elf.h"
+#include "ndcrash_frames.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <link.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Describes a single ELF module (executable or shared library) loaded to a current process. All
+ * data is copied on registry refresh, so it's safe to use it from a signal handler.
+ */
+struct ndcrash_module {
+
+    /// Start address of a module, inclusive. Page-aligned start of the lowest PT_LOAD segment.
+    uintptr_t start;
+
+    /// End address of a module, exclusive. Page-aligned end of the highest PT_LOAD segment.
+    uintptr_t end;
+
+    /// Load bias: difference between run-time addresses and ELF virtual addresses of a module.
+    uintptr_t load_bias;
+
+    /// Program headers of a module. Points to module memory, valid while a module is loaded.
+    const ElfW(Phdr) *phdr;
+
+    /// Count of program headers.
+    size_t phnum;
+
+    /// Flag whether a module is a part of Android system (system library, runtime, [vdso] etc).
+    bool is_system;
+
+    /// Offset of the first module mapping within a file. Non-zero for libraries loaded from APK
+    /// directly without extraction.
+    uintptr_t offset;
+
+    /// Full path to a module file. Empty string if unknown.
+    char name[NDCRASH_MAX_MODULE_NAME_LENGTH];
+
+    /// GNU build-id of a module read from its PT_NOTE segment. Read once per loaded module.
+    uint8_t build_id[NDCRASH_ELF_BUILD_ID_MAX_SIZE];
+
+    /// Size of build_id in bytes, 0 if a module has no build-id.
+    size_t build_id_size;
+
+    /// Address of .eh_frame_hdr section of a module, a base for values of eh_frame_table.
+    uintptr_t eh_frame_hdr;
+
+    /// Binary search table of .eh_frame_hdr section: pairs of an initial location of a function
+    /// and an address of its FDE, both relative to eh_frame_hdr and sorted by location. Points to
+    /// module memory. NULL if a module has no such table or its encoding isn't supported.
+    const int32_t *eh_frame_table;
+
+    /// Count of pairs in eh_frame_table.
+    size_t eh_frame_table_count;
+
+#ifdef __arm__
+    /// Sorted unwinding index table of .ARM.exidx section: pairs of words. Points to module memory.
+    /// NULL if a module has no such table.
+    const uint32_t *arm_exidx;
+
+    /// Count of pairs in arm_exidx.
+    size_t arm_exidx_count;
+#endif
+
+    /// Function symbols of a module loaded from its file. Only exported symbols are loaded for
+    /// system modules. Empty if a module file couldn't be read.
+    struct ndcrash_elf_symbols symbols;
+};
+
+/**
+ * Describes an executable segment of a loaded module.
+ */
+struct ndcrash_exec_range {
+
+    /// Start address of a segment, inclusive.
+    uintptr_t start;
+
+    /// End address of a segment, exclusive.
+    uintptr_t end;
+
+    /// Module containing this segment.
+    const struct ndcrash_module *module;
+};
+
+/**
+ * Initializes a registry of loaded modules: allocates memory for it and fills it in for the first
+ * time. Not signal safe, should be called on in-process mode initialization.
+ * @return Flag whether initialization is successful.
+ */
+bool ndcrash_modules_init();
+
+/**
+ * Frees all memory used by a registry of loaded modules.
+ */
+void ndcrash_modules_deinit();
+
+/**
+ * Re-reads a list of loaded modules by dl_iterate_phdr. Should be called after a library is loaded
+ * or unloaded. Symbols and build-ids are loaded only for modules that weren't loaded on previous
+ * refresh. A previous table isn't reused and its symbols aren't freed until all signal handlers
+ * that could see it have called ndcrash_modules_release. Not signal safe.
+ */
+void ndcrash_modules_refresh();
+
+/**
+ * Marks a registry as used by a signal handler. Lookup results and unwinders data published on
+ * initialization stay valid until ndcrash_modules_release is called. Signal safe.
+ */
+void ndcrash_modules_acquire();
+
+/**
+ * Releases a registry acquired by ndcrash_modules_acquire. Signal safe.
+ */
+void ndcrash_modules_release();
+
+/**
+ * Waits until no signal handler uses a registry. Data retired by a refresh, for example previous
+ * unwinders state, may be freed after that. Not signal safe.
+ */
+void ndcrash_modules_wait_released();
+
+/**
+ * Looks for a module containing a specified address. Signal safe: doesn't perform any system call
+ * or memory allocation, uses only data collected on previous refresh.
+ * @param address Address to search, for example program counter value.
+ * @return Pointer to module description or NULL if not found.
+ */
+const struct ndcrash_module *ndcrash_modules_find(uintptr_t address);
+
+/**
+ * Retrieves a table of executable segments of loaded modules built on previous refresh. Useful for
+ * quick preliminary checks before ndcrash_modules_find_exec call. Signal safe.
+ * @param count Pointer where to write count of segments.
+ * @return Pointer to the first segment, segments are sorted by address. NULL if there is no table.
+ */
+const struct ndcrash_exec_range *ndcrash_modules_exec_ranges(size_t *count);
+
+/**
+ * Looks for an executable segment of a loaded module containing a specified address. Signal safe,
+ * uses a sorted table of executable segments built on previous refresh.
+ * @param address Address to search, for example a value from a stack.
+ * @return Pointer to executable segment description or NULL if address isn't within executable code.
+ */
+const struct ndcrash_exec_range *ndcrash_modules_find_exec(uintptr_t address);
+
+/**
+ * Adds a frame to a backtrace looking for a module and a function name. Signal safe.
+ * @param frames Frames buffer.
+ * @param pc Program counter value.
+ * @param lookup_pc Address of an instruction for a function name lookup: pc for a crashed frame,
+ * a previous instruction for return addresses because a call may be the last instruction of a
+ * function. Function offset is still calculated for pc.
+ */
+void ndcrash_modules_add_frame(struct ndcrash_frames *frames, uintptr_t pc, uintptr_t lookup_pc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_MODULES_H
@@ -7,7 +7,6 @@
 #include <malloc.h>
 #include <unistd.h>
 #include <asm/unistd.h>
-#include <android/log.h>
 #include <sys/socket.h>
 #include <linux/un.h>
 #include <string.h>
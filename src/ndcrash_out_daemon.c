@@ -5,40 +5,121 @@
 #include "ndcrash_log.h"
 #include "ndcrash_utils.h"
 #include "ndcrash_fd_utils.h"
+#include "ndcrash_frames.h"
+#include "ndcrash_memory_map.h"
+#include "ndcrash_remote_memory.h"
+#include "ndcrash_elf.h"
+#include "ndcrash_out_executor.h"
+#include "ndcrash_unwind_chain.h"
 #include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/socket.h>
-#include <android/log.h>
 #include <linux/un.h>
 #include <sys/param.h>
 #include <sys/ptrace.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 #include <string.h>
 #include <errno.h>
 
 #ifdef ENABLE_OUTOFPROCESS
 
+/**
+ * Cached GNU build-id of a module file.
+ */
+struct ndcrash_out_build_id {
+
+    /// Inode of a module file.
+    unsigned long inode;
+
+    /// Offset of ELF image within a file.
+    uintptr_t offset;
+
+    /// Path of a module file.
+    char path[NDCRASH_MAX_MODULE_NAME_LENGTH];
+
+    /// Build-id value.
+    uint8_t build_id[NDCRASH_ELF_BUILD_ID_MAX_SIZE];
+
+    /// Size of build_id in bytes, 0 if a module has no build-id.
+    size_t build_id_size;
+};
+
+/**
+ * State of a client connection.
+ */
+enum ndcrash_out_client_state {
+
+    /// A client slot is free.
+    ndcrash_out_client_free,
+
+    /// Receiving a message from a crashed process.
+    ndcrash_out_client_receiving,
+
+    /// A report is created, waiting until a response can be sent.
+    ndcrash_out_client_responding,
+};
+
+/**
+ * Connection of a crashed process. Every state has a deadline, a connection is closed when it
+ * passes, so a client that doesn't send a message can't block other ones.
+ */
+struct ndcrash_out_client {
+
+    /// Current state.
+    enum ndcrash_out_client_state state;
+
+    /// Client socket, non-blocking.
+    int sock;
+
+    /// Message being received.
+    struct ndcrash_out_message message;
+
+    /// Count of received message bytes.
+    size_t received;
+
+    /// Monotonic time in milliseconds when a connection is closed unless a state is changed.
+    int64_t deadline;
+};
+
 struct ndcrash_out_daemon_context {
 
-    /// Pointer to unwinder initialization function.
-    ndcrash_out_unwinder_init_func_ptr unwinder_init;
+    /// Unwinders in order of trying: an unwinder passed on daemon start, then fallback ones.
+    const struct ndcrash_out_unwinder_info *unwinders[NDCRASH_MAX_UNWINDERS];
+
+    /// Count of filled elements in unwinders array.
+    size_t unwinders_count;
+
+    /// Results of unwinders initialization functions for a report that is being created.
+    /// Unwinders are initialized on the first use, fallback ones are often not needed.
+    void *unwinders_data[NDCRASH_MAX_UNWINDERS];
 
-    /// Pointer to unwinder de-initialization function.
-    ndcrash_out_unwinder_deinit_func_ptr unwinder_deinit;
+    /// Flags whether an unwinder has been initialized for a report that is being created.
+    bool unwinders_initialized[NDCRASH_MAX_UNWINDERS];
 
-    /// Pointer to unwinding function.
-    ndcrash_out_unwind_func_ptr unwind_function;
+    /// Identifier of a crashed thread of a report that is being created, passed to unwinders
+    /// initialization functions.
+    pid_t report_tid;
 
     /// Path to a log file. Null if not set.
     char *log_file;
 
-    /// Pipes that we use to stop a daemon.
+    /// Pipes that we use to stop a daemon. -1 if not created.
     int interruptor[2];
 
     /// Daemon thread.
     pthread_t daemon_thread;
 
+    /// Flag whether a daemon thread is started.
+    bool daemon_started;
+
+    /// Count of reports passed to an executor, used for unique report file names.
+    unsigned int submitted_reports_count;
+
     /// Daemon lifecycle callbacks. See docs for ndcrash_out_start_daemon.
     ndcrash_daemon_start_stop_callback start_callback;
     ndcrash_daemon_crash_callback crash_callback;
@@ -47,16 +128,60 @@ struct ndcrash_out_daemon_context {
     /// Argument for daemon lifecycle callbacks. Passed to initialization function.
     void *callback_arg;
 
+    /// Executor of callbacks. Not started if callbacks are run on a daemon thread.
+    struct ndcrash_out_executor executor;
+
+    /// Client connections, used only by a daemon thread.
+    struct ndcrash_out_client clients[NDCRASH_OUT_MAX_CLIENTS];
+
     /// Socket address that is used to communicate with debugger.
     struct sockaddr_un socket_address;
 
+    /// Frames buffer filled by an unwinder, re-used for every thread.
+    struct ndcrash_frames frames;
+
+    /// Memory block of frames buffer, allocated on daemon start.
+    void *frames_memory;
+
+    /// Frames buffer that keeps a previous backtrace while fallback unwinders are tried.
+    struct ndcrash_frames spare_frames;
+
+    /// Memory block of spare frames buffer, NULL if there are no fallback unwinders.
+    void *spare_frames_memory;
+
+    /// Program counters of all frames of a report that is being created. Used for a list of
+    /// referenced modules at the end of a report.
+    uintptr_t *report_pcs;
+
+    /// Count of filled elements in report_pcs array.
+    size_t report_pcs_count;
+
+    /// Count of allocated elements in report_pcs array.
+    size_t report_pcs_capacity;
+
+    /// Build-ids of module files that have been already read, kept for a daemon lifetime.
+    struct ndcrash_out_build_id *build_ids;
+
+    /// Count of filled elements in build_ids array.
+    size_t build_ids_count;
+
+    /// Count of allocated elements in build_ids array.
+    size_t build_ids_capacity;
+
 };
 
 /// Global instance of out-of-process daemon context.
 struct ndcrash_out_daemon_context *ndcrash_out_daemon_context_instance = NULL;
 
+/// Crash callback policy for a daemon that is started next.
+static enum ndcrash_crash_callback_policy ndcrash_out_crash_callback_policy = ndcrash_crash_callback_inline;
+
 /// Constant for listening socket backlog argument.
-static const int SOCKET_BACKLOG = 1;
+static const int SOCKET_BACKLOG = NDCRASH_OUT_MAX_CLIENTS;
+
+/// Epoll event tags of listening socket and interruptor pipe. Client events are tagged by a slot index.
+#define NDCRASH_OUT_EPOLL_LISTEN UINT64_MAX
+#define NDCRASH_OUT_EPOLL_INTERRUPTOR (UINT64_MAX - 1)
 
 
 /**
@@ -90,6 +215,220 @@ static void ndcrash_out_ptrace_detach(pid_t tid) {
     }
 }
 
+/**
+ * A thread being unwound by a chain of unwinders.
+ */
+struct ndcrash_out_unwind_thread {
+
+    /// Thread identifier.
+    pid_t tid;
+
+    /// Processor context of a thread, NULL if it should be obtained by ptrace.
+    struct ucontext *context;
+};
+
+/**
+ * Runs an unwinder of a chain, initializes it if it hasn't been used for a current report yet.
+ * For arguments description see ndcrash_unwind_tier_func_ptr typedef.
+ */
+static const char *ndcrash_out_daemon_unwind_tier(struct ndcrash_frames *frames, size_t index, void *arg) {
+    struct ndcrash_out_daemon_context * const ctx = ndcrash_out_daemon_context_instance;
+    const struct ndcrash_out_unwind_thread * const thread = (const struct ndcrash_out_unwind_thread *) arg;
+    const struct ndcrash_out_unwinder_info * const unwinder = ctx->unwinders[index];
+    if (!ctx->unwinders_initialized[index]) {
+        ctx->unwinders_data[index] = unwinder->init(ctx->report_tid);
+        ctx->unwinders_initialized[index] = true;
+    }
+    unwinder->unwind(frames, thread->tid, thread->context, ctx->unwinders_data[index]);
+    return unwinder->name;
+}
+
+/**
+ * Unwinds a thread stack and writes a backtrace to a report.
+ * @param outfile Output file descriptor for a crash report.
+ * @param tid Thread identifier.
+ * @param context Processor context of a thread, NULL if it should be obtained by ptrace.
+ */
+static void ndcrash_out_daemon_unwind_and_dump(int outfile, pid_t tid, struct ucontext *context) {
+    struct ndcrash_out_daemon_context * const ctx = ndcrash_out_daemon_context_instance;
+    struct ndcrash_out_unwind_thread thread = { tid, context };
+    struct ndcrash_unwind_stats stats;
+    const struct ndcrash_frames * const frames = ndcrash_unwind_chain(
+            &ctx->frames,
+            ctx->spare_frames_memory ? &ctx->spare_frames : NULL,
+            ctx->unwinders_count,
+            &ndcrash_out_daemon_unwind_tier,
+            &thread,
+            &stats);
+    ndcrash_frames_emit(outfile, frames);
+    if (ctx->unwinders_count > 1) {
+        ndcrash_unwind_stats_dump(outfile, &stats);
+    }
+
+    // Remembering program counters for a list of referenced modules. If memory couldn't be
+    // allocated program counters are added while there is space, a modules list is incomplete.
+    if (ctx->report_pcs_count + frames->count > ctx->report_pcs_capacity) {
+        const size_t capacity = ctx->report_pcs_capacity * 2 + frames->count;
+        uintptr_t * const report_pcs = (uintptr_t *) realloc(ctx->report_pcs, capacity * sizeof(uintptr_t));
+        if (report_pcs) {
+            ctx->report_pcs = report_pcs;
+            ctx->report_pcs_capacity = capacity;
+        } else {
+            NDCRASHLOG(ERROR, "Couldn't allocate memory for %u program counters, modules list may be incomplete.", (unsigned) capacity);
+        }
+    }
+    for (size_t i = 0; i < frames->count && ctx->report_pcs_count < ctx->report_pcs_capacity; ++i) {
+        if (frames->frames[i].pc) {
+            ctx->report_pcs[ctx->report_pcs_count++] = frames->frames[i].pc;
+        }
+    }
+}
+
+/**
+ * Retrieves GNU build-id of a module file. It's read from a file only once, then a cached value
+ * is used.
+ * @param path Path of a module file.
+ * @param inode Inode of a module file.
+ * @param offset Offset of ELF image within a file.
+ * @return Pointer to cached build-id or NULL if a memory couldn't be allocated.
+ */
+static const struct ndcrash_out_build_id *ndcrash_out_daemon_get_build_id(
+        const char *path,
+        unsigned long inode,
+        uintptr_t offset) {
+    struct ndcrash_out_daemon_context * const ctx = ndcrash_out_daemon_context_instance;
+    for (size_t i = 0; i < ctx->build_ids_count; ++i) {
+        const struct ndcrash_out_build_id * const item = &ctx->build_ids[i];
+        if (item->inode == inode && item->offset == offset && !strcmp(item->path, path)) return item;
+    }
+    if (ctx->build_ids_count == ctx->build_ids_capacity) {
+        const size_t capacity = ctx->build_ids_capacity ? ctx->build_ids_capacity * 2 : 32;
+        struct ndcrash_out_build_id * const build_ids = (struct ndcrash_out_build_id *) realloc(
+                ctx->build_ids, capacity * sizeof(struct ndcrash_out_build_id));
+        if (!build_ids) return NULL;
+        ctx->build_ids = build_ids;
+        ctx->build_ids_capacity = capacity;
+    }
+    struct ndcrash_out_build_id * const item = &ctx->build_ids[ctx->build_ids_count++];
+    item->inode = inode;
+    item->offset = offset;
+    strncpy(item->path, path, sizeof(item->path) - 1);
+    item->path[sizeof(item->path) - 1] = '\0';
+    item->build_id_size = ndcrash_elf_read_build_id(path, offset, item->build_id);
+    return item;
+}
+
+/**
+ * State of a memory map parsing for a list of referenced modules.
+ */
+struct ndcrash_out_modules_state {
+
+    /// Output file descriptor for a crash report.
+    int outfile;
+
+    /// Crashed process identifier.
+    pid_t pid;
+
+    /// Sorted program counters of report frames.
+    const uintptr_t *pcs;
+
+    /// Count of elements in pcs array.
+    size_t pcs_count;
+
+    /// Index of the first program counter which is not processed yet.
+    size_t pc_index;
+
+    /// Start address and file offset of the first mapping of a current module.
+    uintptr_t start;
+    uintptr_t offset;
+
+    /// Inode of a current module file, 0 if a current mapping isn't a file.
+    unsigned long inode;
+
+    /// Path of a current module file.
+    char path[NDCRASH_MAX_MODULE_NAME_LENGTH];
+
+    /// Flag whether a current module has been written to a report.
+    bool written;
+
+    /// Flag whether a title of modules list has been written.
+    bool has_title;
+};
+
+/**
+ * Callback for a memory map parser. A module starts at a mapping that contains ELF header or at
+ * a mapping of another file, following mappings of the same file belong to it. Thus several
+ * libraries mapped from one APK file are separate modules. Writes a module line if any program
+ * counter is within its mappings. For arguments description see ndcrash_memory_map_entry_callback
+ * type definition.
+ */
+static void ndcrash_out_modules_maps_callback(const struct ndcrash_memory_map_entry *entry, void *data, bool *stop) {
+    struct ndcrash_out_modules_state * const state = (struct ndcrash_out_modules_state *) data;
+    if (entry->inode != state->inode ||
+        strncmp(entry->path, state->path, sizeof(state->path) - 1) ||
+        (entry->inode && (entry->prot & PROT_READ) && ndcrash_remote_has_elf_header(state->pid, entry->start))) {
+        state->start = entry->start;
+        state->offset = entry->offset;
+        state->inode = entry->inode;
+        strncpy(state->path, entry->path, sizeof(state->path) - 1);
+        state->path[sizeof(state->path) - 1] = '\0';
+        state->written = false;
+    }
+
+    // Skipping program counters before this mapping, then checking if any is within it.
+    while (state->pc_index < state->pcs_count && state->pcs[state->pc_index] < entry->start) {
+        ++state->pc_index;
+    }
+    if (state->pc_index == state->pcs_count) {
+        *stop = true;
+        return;
+    }
+    if (state->pcs[state->pc_index] >= entry->end || !state->inode || state->written) return;
+
+    if (!state->has_title) {
+        ndcrash_dump_modules_title(state->outfile);
+        state->has_title = true;
+    }
+    const struct ndcrash_out_build_id * const build_id =
+            ndcrash_out_daemon_get_build_id(state->path, state->inode, state->offset);
+    ndcrash_dump_module_line(
+            state->outfile,
+            state->start,
+            state->offset,
+            state->path,
+            build_id ? build_id->build_id : NULL,
+            build_id ? build_id->build_id_size : 0);
+    state->written = true;
+}
+
+/**
+ * Comparison function for qsort, orders program counters ascending.
+ */
+static int ndcrash_out_compare_pcs(const void *a, const void *b) {
+    const uintptr_t pc_a = *(const uintptr_t *) a;
+    const uintptr_t pc_b = *(const uintptr_t *) b;
+    return pc_a < pc_b ? -1 : pc_a > pc_b;
+}
+
+/**
+ * Writes a list of modules referenced by frames of a report, ordered by load address. Modules are
+ * found in a memory map of a crashed process, it's parsed once.
+ * @param outfile Output file descriptor for a crash report.
+ * @param pid Crashed process identifier.
+ */
+static void ndcrash_out_daemon_dump_modules(int outfile, pid_t pid) {
+    struct ndcrash_out_daemon_context * const ctx = ndcrash_out_daemon_context_instance;
+    if (!ctx->report_pcs_count) return;
+    qsort(ctx->report_pcs, ctx->report_pcs_count, sizeof(uintptr_t), &ndcrash_out_compare_pcs);
+    struct ndcrash_out_modules_state state;
+    memset(&state, 0, sizeof(state));
+    state.outfile = outfile;
+    state.pid = pid;
+    state.pcs = ctx->report_pcs;
+    state.pcs_count = ctx->report_pcs_count;
+    ndcrash_parse_memory_map(pid, &ndcrash_out_modules_maps_callback, &state);
+}
+
 /**
  * Creates and fills a new crash dump.
  * @param message A message received from a signal handler.
@@ -128,11 +467,14 @@ static bool ndcrash_out_daemon_create_report(struct ndcrash_out_message *message
             message->faultaddr,
             &message->context);
 
-    // Unwinder initialization, should be done before any thread unwinding.
-    void * const unwinder_data = ndcrash_out_daemon_context_instance->unwinder_init(message->tid);
+    // Unwinders are initialized on the first use.
+    ndcrash_out_daemon_context_instance->report_pcs_count = 0;
+    ndcrash_out_daemon_context_instance->report_tid = message->tid;
+    memset(ndcrash_out_daemon_context_instance->unwinders_initialized, 0,
+           sizeof(ndcrash_out_daemon_context_instance->unwinders_initialized));
 
     // Stack unwinding for a main thread.
-    ndcrash_out_daemon_context_instance->unwind_function(outfile, message->tid, &message->context, unwinder_data);
+    ndcrash_out_daemon_unwind_and_dump(outfile, message->tid, &message->context);
 
 #ifdef ENABLE_OUTOFPROCESS_ALL_THREADS
     // Processing other threads: printing a header and stack trace.
@@ -145,17 +487,26 @@ static bool ndcrash_out_daemon_create_report(struct ndcrash_out_message *message
         ndcrash_dump_other_thread_header(outfile, message->pid, *it);
 
         // Stack unwinding for a secondary thread.
-        ndcrash_out_daemon_context_instance->unwind_function(outfile, *it, NULL, unwinder_data);
+        ndcrash_out_daemon_unwind_and_dump(outfile, *it, NULL);
     }
 #endif //ENABLE_OUTOFPROCESS_ALL_THREADS
 
-    // Unwinder de-initialization.
-    ndcrash_out_daemon_context_instance->unwinder_deinit(unwinder_data);
+    // De-initialization of unwinders that have been used.
+    for (size_t i = 0; i < ndcrash_out_daemon_context_instance->unwinders_count; ++i) {
+        if (ndcrash_out_daemon_context_instance->unwinders_initialized[i]) {
+            ndcrash_out_daemon_context_instance->unwinders[i]->deinit(
+                    ndcrash_out_daemon_context_instance->unwinders_data[i]);
+        }
+    }
+
+    // Appending a list of modules referenced by backtraces.
+    ndcrash_out_daemon_dump_modules(outfile, message->pid);
 
     // Final line of crash dump.
     ndcrash_dump_write_line(outfile, " ");
 
     // Closing output file.
+    ndcrash_output_flush();
     if (outfile >= 0) {
         //Closing file
         close(outfile);
@@ -176,73 +527,180 @@ static bool ndcrash_out_daemon_create_report(struct ndcrash_out_message *message
 }
 
 /**
- * Processes a client request: receives a data from client and creates a crash report.
- * @param clientsock A socket to communicate with a client.
+ * Runs a crash callback for a created report if it's set. We do it after detaching from crashing
+ * process and responding to it because at this point it can terminate. A callback may perform some
+ * long operation, for example, synchronous networking and we shouldn't allow any bad UX
+ * with a hang of application. In modern Android service has "a window of several minutes in which
+ * it is still allowed to create and use services" so it won't be a problem. A callback is
+ * queued to an executor thread if it's started, so the next crashing process isn't blocked. In this
+ * case a report is renamed to a unique file "<log_file>.<pid>.<number>" because the next crash
+ * overwrites log_file before a queued callback is run.
+ * @param pid Crashed process identifier.
  */
-static void ndcrash_out_daemon_process_client(int clientsock) {
-    struct ndcrash_out_message message = {0, 0};
-    ssize_t overall_read = 0;
-    do {
-        fd_set fdset;
-        FD_ZERO(&fdset);
-        FD_SET(clientsock, &fdset);
-        FD_SET(ndcrash_out_daemon_context_instance->interruptor[0], &fdset);
-        const int select_result = select(
-                MAX(clientsock, ndcrash_out_daemon_context_instance->interruptor[0]) + 1, &fdset,
-                NULL, NULL, NULL);
-        if (select_result < 0) {
-            NDCRASHLOG(ERROR, "Select on recv error: %s (%d)", strerror(errno), errno);
-            close(clientsock);
-            return;
-        }
-        if (FD_ISSET(ndcrash_out_daemon_context_instance->interruptor[0], &fdset)) {
-            // Interrupting by pipe.
-            close(clientsock);
-            return;
+static void ndcrash_out_daemon_run_crash_callback(pid_t pid) {
+    struct ndcrash_out_daemon_context * const ctx = ndcrash_out_daemon_context_instance;
+    if (!ctx->crash_callback) return;
+    if (!ctx->executor.started) {
+        ctx->crash_callback(ctx->log_file, ctx->callback_arg);
+        return;
+    }
+
+    // Enough space for a dot-separated pid and a number.
+    const size_t report_file_size = strlen(ctx->log_file) + 24;
+    char * const report_file = (char *) malloc(report_file_size);
+    if (!report_file) {
+        NDCRASHLOG(ERROR, "Couldn't allocate memory for a report file name, crash callback is skipped.");
+        return;
+    }
+    snprintf(report_file, report_file_size, "%s.%d.%u", ctx->log_file, (int) pid, ++ctx->submitted_reports_count);
+    if (rename(ctx->log_file, report_file) < 0) {
+        NDCRASHLOG(ERROR, "Couldn't rename report file to %s: %s (%d)", report_file, strerror(errno), errno);
+        free(report_file);
+        return;
+    }
+    if (!ndcrash_out_executor_submit(&ctx->executor, report_file)) {
+        // A call is dropped, a report is kept in log_file as if there is no executor.
+        rename(report_file, ctx->log_file);
+        free(report_file);
+    }
+}
+
+/**
+ * Closes a client connection and frees its slot. A socket is removed from epoll by closing.
+ */
+static void ndcrash_out_client_close(struct ndcrash_out_client *client) {
+    close(client->sock);
+    client->sock = -1;
+    client->state = ndcrash_out_client_free;
+}
+
+/**
+ * Sends a response byte to a client. If a socket buffer is full a client waits for EPOLLOUT
+ * until its deadline, otherwise a connection is closed.
+ */
+static void ndcrash_out_client_respond(struct ndcrash_out_client *client, int epollfd) {
+    const ssize_t sent = send(client->sock, "\0", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (client->state != ndcrash_out_client_responding) {
+            struct epoll_event event;
+            event.events = EPOLLOUT;
+            event.data.u64 = (uint64_t) (client - ndcrash_out_daemon_context_instance->clients);
+            epoll_ctl(epollfd, EPOLL_CTL_MOD, client->sock, &event);
+            client->state = ndcrash_out_client_responding;
+            client->deadline = ndcrash_time_ms() + NDCRASH_OUT_CLIENT_TIMEOUT_MS;
         }
+        return;
+    }
+    ndcrash_out_client_close(client);
+}
+
+/**
+ * Receives available data from a client without blocking. When a whole message is received
+ * creates a crash report and responds.
+ */
+static void ndcrash_out_client_receive(struct ndcrash_out_client *client, int epollfd) {
+    while (client->received < sizeof(struct ndcrash_out_message)) {
         const ssize_t bytes_read = recv(
-                clientsock,
-                (char *) &message + overall_read,
-                sizeof(struct ndcrash_out_message) - overall_read,
-                MSG_NOSIGNAL);
-        if (bytes_read < 0) {
-            NDCRASHLOG(ERROR, "Recv error: %s (%d)", strerror(errno), errno);
-            close(clientsock);
+                client->sock,
+                (char *) &client->message + client->received,
+                sizeof(struct ndcrash_out_message) - client->received,
+                MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) {
+            if (bytes_read < 0) {
+                NDCRASHLOG(ERROR, "Recv error: %s (%d)", strerror(errno), errno);
+            }
+            ndcrash_out_client_close(client);
             return;
         }
-        overall_read += bytes_read;
-    } while (overall_read < sizeof(struct ndcrash_out_message));
+        client->received += (size_t) bytes_read;
+    }
 
-    NDCRASHLOG(INFO, "Client info received, pid: %d tid: %d", message.pid, message.tid);
+    NDCRASHLOG(INFO, "Client info received, pid: %d tid: %d", client->message.pid, client->message.tid);
 
-    // Creating a report.
-    const bool report_file_created = ndcrash_out_daemon_create_report(&message);
+    // Creating a report, a crashed process waits for a response until it's finished.
+    const bool report_file_created = ndcrash_out_daemon_create_report(&client->message);
+    ndcrash_out_client_respond(client, epollfd);
+    if (report_file_created) {
+        ndcrash_out_daemon_run_crash_callback(client->message.pid);
+    }
+}
 
-    //Write 1 byte as a response.
-    write(clientsock, "\0", 1);
+/**
+ * Accepts all pending connections. If all client slots are busy a client with the earliest
+ * deadline is disconnected: real crashing processes send a message right after connection, so
+ * the oldest pending client is most likely a stalled one.
+ */
+static void ndcrash_out_daemon_accept(int listensock, int epollfd) {
+    struct ndcrash_out_client * const clients = ndcrash_out_daemon_context_instance->clients;
+    for (;;) {
+        const int clientsock = accept4(listensock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientsock < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                NDCRASHLOG(ERROR, "Accept failed, error: %s (%d)", strerror(errno), errno);
+            }
+            return;
+        }
 
-    // Closing a connection.
-    close(clientsock);
+        struct ndcrash_out_client *client = NULL;
+        for (size_t i = 0; i < NDCRASH_OUT_MAX_CLIENTS; ++i) {
+            if (clients[i].state == ndcrash_out_client_free) {
+                client = &clients[i];
+                break;
+            }
+            if (!client || clients[i].deadline < client->deadline) {
+                client = &clients[i];
+            }
+        }
+        if (client->state != ndcrash_out_client_free) {
+            NDCRASHLOG(WARN, "Too many clients, disconnecting socket %d", client->sock);
+            ndcrash_out_client_close(client);
+        }
 
-    // Running successful unwinding callback if it's set. We do it after detaching and disconnecting
-    // from crashing process because at this point it can terminate. A callback may perform some
-    // long operation, for example, synchronous networking and we shouldn't allow any bad UX
-    // with a hang of application. In modern Android service has "a window of several minutes in which
-    // it is still allowed to create and use services" so it won't be a problem.
-    if (report_file_created && ndcrash_out_daemon_context_instance->crash_callback) {
-        ndcrash_out_daemon_context_instance->crash_callback(
-                ndcrash_out_daemon_context_instance->log_file,
-                ndcrash_out_daemon_context_instance->callback_arg
-        );
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = (uint64_t) (client - clients);
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, clientsock, &event) < 0) {
+            NDCRASHLOG(ERROR, "Couldn't add client to epoll: %s (%d)", strerror(errno), errno);
+            close(clientsock);
+            continue;
+        }
+        client->sock = clientsock;
+        client->state = ndcrash_out_client_receiving;
+        client->received = 0;
+        client->deadline = ndcrash_time_ms() + NDCRASH_OUT_CLIENT_TIMEOUT_MS;
+        NDCRASHLOG(INFO, "Client connected, socket: %d", clientsock);
     }
 }
 
+/**
+ * Closes connections of clients whose deadline has passed.
+ * @return Time until the nearest deadline in milliseconds or -1 if there are no clients.
+ */
+static int ndcrash_out_daemon_check_deadlines() {
+    struct ndcrash_out_client * const clients = ndcrash_out_daemon_context_instance->clients;
+    const int64_t now = ndcrash_time_ms();
+    int64_t timeout = -1;
+    for (size_t i = 0; i < NDCRASH_OUT_MAX_CLIENTS; ++i) {
+        if (clients[i].state == ndcrash_out_client_free) continue;
+        if (clients[i].deadline <= now) {
+            NDCRASHLOG(WARN, "Client timeout, disconnecting socket %d", clients[i].sock);
+            ndcrash_out_client_close(&clients[i]);
+        } else if (timeout < 0 || clients[i].deadline - now < timeout) {
+            timeout = clients[i].deadline - now;
+        }
+    }
+    return (int) timeout;
+}
+
 /**
  * An entry point to a daemon. This function is passed to pthread as a thread main function.
  */
 static void *ndcrash_out_daemon_function(void *arg) {
     // Creating socket
-    const int listensock = socket(PF_LOCAL, SOCK_STREAM, 0);
+    const int listensock = socket(PF_LOCAL, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (listensock < 0) {
         NDCRASHLOG(ERROR, "Couldn't create socket, error: %s (%d)", strerror(errno), errno);
         return NULL;
@@ -267,47 +725,75 @@ static void *ndcrash_out_daemon_function(void *arg) {
         return NULL;
     }
 
+    // Serving listening socket, interruptor pipe and clients in a single event loop.
+    const int epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd < 0) {
+        NDCRASHLOG(ERROR, "Couldn't create epoll, error: %s (%d)", strerror(errno), errno);
+        close(listensock);
+        return NULL;
+    }
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = NDCRASH_OUT_EPOLL_LISTEN;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, listensock, &event);
+        event.data.u64 = NDCRASH_OUT_EPOLL_INTERRUPTOR;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, ndcrash_out_daemon_context_instance->interruptor[0], &event);
+    }
+    struct ndcrash_out_client * const clients = ndcrash_out_daemon_context_instance->clients;
+    for (size_t i = 0; i < NDCRASH_OUT_MAX_CLIENTS; ++i) {
+        clients[i].state = ndcrash_out_client_free;
+        clients[i].sock = -1;
+    }
+
     NDCRASHLOG(INFO, "Daemon is successfuly started, accepting connections...");
 
-    if (ndcrash_out_daemon_context_instance->start_callback) {
+    // Start and stop callbacks are run on an executor thread if it's started.
+    if (ndcrash_out_daemon_context_instance->start_callback &&
+        !ndcrash_out_daemon_context_instance->executor.started) {
         ndcrash_out_daemon_context_instance->start_callback(
                 ndcrash_out_daemon_context_instance->callback_arg);
     }
 
-    // Accepting connections in a cycle.
-    for (;;) {
-        fd_set fdset;
-        FD_ZERO(&fdset);
-        FD_SET(listensock, &fdset);
-        FD_SET(ndcrash_out_daemon_context_instance->interruptor[0], &fdset);
-        const int select_result = select(
-                MAX(listensock, ndcrash_out_daemon_context_instance->interruptor[0]) + 1, &fdset,
-                NULL, NULL, NULL);
-        if (select_result < 0) {
-            NDCRASHLOG(ERROR, "Select on accept error: %s (%d)", strerror(errno), errno);
+    bool interrupted = false;
+    while (!interrupted) {
+        struct epoll_event events[NDCRASH_OUT_MAX_CLIENTS + 2];
+        const int timeout = ndcrash_out_daemon_check_deadlines();
+        const int count = epoll_wait(epollfd, events, NDCRASH_OUT_MAX_CLIENTS + 2, timeout);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            NDCRASHLOG(ERROR, "Epoll wait error: %s (%d)", strerror(errno), errno);
             break;
         }
-        if (FD_ISSET(ndcrash_out_daemon_context_instance->interruptor[0], &fdset)) {
-            // Interrupting by pipe.
-            break;
+        for (int i = 0; i < count; ++i) {
+            const uint64_t tag = events[i].data.u64;
+            if (tag == NDCRASH_OUT_EPOLL_INTERRUPTOR) {
+                // Interrupting by pipe.
+                interrupted = true;
+            } else if (tag == NDCRASH_OUT_EPOLL_LISTEN) {
+                ndcrash_out_daemon_accept(listensock, epollfd);
+            } else if (tag < NDCRASH_OUT_MAX_CLIENTS) {
+                // A client may have been closed by handling of a previous event.
+                struct ndcrash_out_client * const client = &clients[tag];
+                if (client->state == ndcrash_out_client_receiving) {
+                    ndcrash_out_client_receive(client, epollfd);
+                } else if (client->state == ndcrash_out_client_responding) {
+                    ndcrash_out_client_respond(client, epollfd);
+                }
+            }
         }
+    }
 
-        struct sockaddr_storage ss;
-        struct sockaddr *addrp = (struct sockaddr *) &ss;
-        socklen_t alen = sizeof(ss);
-        int clientsock = accept(listensock, addrp, &alen);
-        if (clientsock == -1) {
-            NDCRASHLOG(ERROR, "Accept failed, error: %s (%d)", strerror(errno), errno);
-            continue;
+    for (size_t i = 0; i < NDCRASH_OUT_MAX_CLIENTS; ++i) {
+        if (clients[i].state != ndcrash_out_client_free) {
+            ndcrash_out_client_close(&clients[i]);
         }
-
-        NDCRASHLOG(INFO, "Client connected, socket: %d", clientsock);
-        ndcrash_out_daemon_process_client(clientsock);
     }
-
+    close(epollfd);
     close(listensock);
 
-    if (ndcrash_out_daemon_context_instance->stop_callback) {
+    if (ndcrash_out_daemon_context_instance->stop_callback &&
+        !ndcrash_out_daemon_context_instance->executor.started) {
         ndcrash_out_daemon_context_instance->stop_callback(
                 ndcrash_out_daemon_context_instance->callback_arg);
     }
@@ -341,41 +827,57 @@ enum ndcrash_error ndcrash_out_start_daemon(
     ndcrash_out_daemon_context_instance->crash_callback = crash_callback;
     ndcrash_out_daemon_context_instance->stop_callback = stop_callback;
     ndcrash_out_daemon_context_instance->callback_arg = callback_arg;
+    ndcrash_out_daemon_context_instance->interruptor[0] = -1;
+    ndcrash_out_daemon_context_instance->interruptor[1] = -1;
 
     // Filling in socket address.
     ndcrash_out_fill_sockaddr(socket_name, &ndcrash_out_daemon_context_instance->socket_address);
 
-    // Checking if unwinder is supported. Setting unwind function.
-    switch (unwinder) {
-#ifdef ENABLE_LIBCORKSCREW
-        case ndcrash_unwinder_libcorkscrew:
-            ndcrash_out_daemon_context_instance->unwinder_init = &ndcrash_out_init_libcorkscrew;
-            ndcrash_out_daemon_context_instance->unwinder_deinit = &ndcrash_out_deinit_libcorkscrew;
-            ndcrash_out_daemon_context_instance->unwind_function = &ndcrash_out_unwind_libcorkscrew;
-            break;
-#endif
-#ifdef ENABLE_LIBUNWIND
-        case ndcrash_unwinder_libunwind:
-            ndcrash_out_daemon_context_instance->unwinder_init = &ndcrash_out_init_libunwind;
-            ndcrash_out_daemon_context_instance->unwinder_deinit = &ndcrash_out_deinit_libunwind;
-            ndcrash_out_daemon_context_instance->unwind_function = &ndcrash_out_unwind_libunwind;
-            break;
-#endif
-#ifdef ENABLE_LIBUNWINDSTACK
-        case ndcrash_unwinder_libunwindstack:
-            ndcrash_out_daemon_context_instance->unwinder_init = &ndcrash_out_init_libunwindstack;
-            ndcrash_out_daemon_context_instance->unwinder_deinit = &ndcrash_out_deinit_libunwindstack;
-            ndcrash_out_daemon_context_instance->unwind_function = &ndcrash_out_unwind_libunwindstack;
-            break;
-#endif
-        default: // To suppress a warning.
-            break;
-    }
-    if (!ndcrash_out_daemon_context_instance->unwind_function) {
-        ndcrash_out_deinit();
+    // Checking if unwinder is supported. Fallback unwinders that aren't supported are skipped.
+    struct ndcrash_out_daemon_context * const ctx = ndcrash_out_daemon_context_instance;
+    const struct ndcrash_out_unwinder_info * const primary = ndcrash_out_find_unwinder(unwinder);
+    if (!primary) {
+        ndcrash_out_stop_daemon();
         return ndcrash_error_not_supported;
     }
+    ctx->unwinders[ctx->unwinders_count++] = primary;
+    size_t fallbacks_count = 0;
+    const enum ndcrash_unwinder * const fallbacks = ndcrash_get_fallback_unwinders(&fallbacks_count);
+    for (size_t i = 0; i < fallbacks_count; ++i) {
+        const struct ndcrash_out_unwinder_info * const fallback = ndcrash_out_find_unwinder(fallbacks[i]);
+        if (!fallback) {
+            NDCRASHLOG(WARN, "Fallback unwinder %d isn't supported, skipping.", (int) fallbacks[i]);
+            continue;
+        }
+        size_t j = 0;
+        for (; j < ctx->unwinders_count; ++j) {
+            if (ctx->unwinders[j] == fallback) break;
+        }
+        if (j == ctx->unwinders_count) {
+            ctx->unwinders[ctx->unwinders_count++] = fallback;
+        }
+    }
 
+    // Allocating a frames buffer, a daemon thread unwinds crashed processes one by one.
+    ndcrash_out_daemon_context_instance->frames_memory =
+            malloc(ndcrash_frames_memory_size(NDCRASH_MAX_FRAMES, NDCRASH_FRAMES_STRINGS_SIZE));
+    if (!ndcrash_out_daemon_context_instance->frames_memory) {
+        ndcrash_out_stop_daemon();
+        return ndcrash_error_memory;
+    }
+    ndcrash_frames_init(
+            &ndcrash_out_daemon_context_instance->frames,
+            ndcrash_out_daemon_context_instance->frames_memory,
+            NDCRASH_MAX_FRAMES,
+            NDCRASH_FRAMES_STRINGS_SIZE);
+    if (ctx->unwinders_count > 1) {
+        ctx->spare_frames_memory = malloc(ndcrash_frames_memory_size(NDCRASH_MAX_FRAMES, NDCRASH_FRAMES_STRINGS_SIZE));
+        if (!ctx->spare_frames_memory) {
+            ndcrash_out_stop_daemon();
+            return ndcrash_error_memory;
+        }
+        ndcrash_frames_init(&ctx->spare_frames, ctx->spare_frames_memory, NDCRASH_MAX_FRAMES, NDCRASH_FRAMES_STRINGS_SIZE);
+    }
 
     // Copying log file path if set.
     if (log_file) {
@@ -388,42 +890,83 @@ enum ndcrash_error ndcrash_out_start_daemon(
 
     // Creating interruption pipes.
     if (pipe(ndcrash_out_daemon_context_instance->interruptor) < 0 ||
-        !ndcrash_set_nonblock(ndcrash_out_daemon_context_instance->interruptor[0] ||
-                              !ndcrash_set_nonblock(
-                                      ndcrash_out_daemon_context_instance->interruptor[1]))) {
+        !ndcrash_set_nonblock(ndcrash_out_daemon_context_instance->interruptor[0]) ||
+        !ndcrash_set_nonblock(ndcrash_out_daemon_context_instance->interruptor[1])) {
         ndcrash_out_stop_daemon();
         return ndcrash_error_pipe;
     }
 
+    // Starting an executor thread for callbacks if needed. Without a crash callback there's
+    // nothing to offload, start and stop callbacks are run on a daemon thread then.
+    if (crash_callback && ndcrash_out_crash_callback_policy != ndcrash_crash_callback_inline) {
+        struct ndcrash_out_executor * const executor = &ndcrash_out_daemon_context_instance->executor;
+        executor->start_callback = start_callback;
+        executor->crash_callback = crash_callback;
+        executor->stop_callback = stop_callback;
+        executor->callback_arg = callback_arg;
+        executor->policy = ndcrash_out_crash_callback_policy;
+        if (!ndcrash_out_executor_start(executor)) {
+            ndcrash_out_stop_daemon();
+            return ndcrash_error_thread;
+        }
+    }
+
     // Creating a daemon thread.
     const int res = pthread_create(&ndcrash_out_daemon_context_instance->daemon_thread, NULL,
                                    ndcrash_out_daemon_function, NULL);
     if (res) {
+        // A thread value is unspecified on failure, a daemon isn't marked as started so it isn't
+        // joined. Pipes and an executor are released by a stop function.
+        NDCRASHLOG(ERROR, "Couldn't create daemon thread: %s (%d)", strerror(res), res);
+        ndcrash_out_stop_daemon();
         return ndcrash_error_thread;
     }
+    ndcrash_out_daemon_context_instance->daemon_started = true;
 
     return ndcrash_ok;
 }
 
 bool ndcrash_out_stop_daemon() {
     if (!ndcrash_out_daemon_context_instance) return false;
-    if (ndcrash_out_daemon_context_instance->daemon_thread) {
-        // Writing to pipe in order to interrupt select.
+    if (ndcrash_out_daemon_context_instance->daemon_started) {
+        // Writing to pipe in order to interrupt epoll wait.
         if (write(ndcrash_out_daemon_context_instance->interruptor[1], (void *) "\0", 1) < 0) {
             return false;
         }
         pthread_join(ndcrash_out_daemon_context_instance->daemon_thread, NULL);
-        close(ndcrash_out_daemon_context_instance->interruptor[0]);
-        close(ndcrash_out_daemon_context_instance->interruptor[1]);
     }
+    for (int i = 0; i < 2; ++i) {
+        if (ndcrash_out_daemon_context_instance->interruptor[i] >= 0) {
+            close(ndcrash_out_daemon_context_instance->interruptor[i]);
+        }
+    }
+
+    // Queued crash callbacks are run before an executor is stopped.
+    ndcrash_out_executor_stop(&ndcrash_out_daemon_context_instance->executor);
     if (ndcrash_out_daemon_context_instance->log_file) {
         free(ndcrash_out_daemon_context_instance->log_file);
     }
+    if (ndcrash_out_daemon_context_instance->frames_memory) {
+        free(ndcrash_out_daemon_context_instance->frames_memory);
+    }
+    if (ndcrash_out_daemon_context_instance->spare_frames_memory) {
+        free(ndcrash_out_daemon_context_instance->spare_frames_memory);
+    }
+    if (ndcrash_out_daemon_context_instance->report_pcs) {
+        free(ndcrash_out_daemon_context_instance->report_pcs);
+    }
+    if (ndcrash_out_daemon_context_instance->build_ids) {
+        free(ndcrash_out_daemon_context_instance->build_ids);
+    }
     free(ndcrash_out_daemon_context_instance);
     ndcrash_out_daemon_context_instance = NULL;
     return true;
 }
 
+void ndcrash_out_set_crash_callback_policy(enum ndcrash_crash_callback_policy policy) {
+    ndcrash_out_crash_callback_policy = policy;
+}
+
 void *ndcrash_out_get_daemon_callbacks_arg() {
     if (!ndcrash_out_daemon_context_instance) return NULL;
     return ndcrash_out_daemon_context_instance->callback_arg;
@@ -0,0 +1,123 @@
+#include "ndcrash_out_executor.h"
+#include "ndcrash_log.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ENABLE_OUTOFPROCESS
+
+/// Queue size should be a power of 2, indexes are taken by a bit mask.
+#if NDCRASH_OUT_CALLBACK_QUEUE_SIZE & (NDCRASH_OUT_CALLBACK_QUEUE_SIZE - 1)
+#error NDCRASH_OUT_CALLBACK_QUEUE_SIZE should be a power of 2
+#endif
+
+/**
+ * Pushes a task to a queue. Called only from a daemon thread.
+ * @return Flag whether a task is pushed, false if a queue is full.
+ */
+static bool ndcrash_out_executor_push(struct ndcrash_out_executor *executor, char *report_file) {
+    const size_t tail = __atomic_load_n(&executor->tail, __ATOMIC_RELAXED);
+    const size_t head = __atomic_load_n(&executor->head, __ATOMIC_ACQUIRE);
+    if (tail - head >= NDCRASH_OUT_CALLBACK_QUEUE_SIZE) return false;
+    executor->tasks[tail & (NDCRASH_OUT_CALLBACK_QUEUE_SIZE - 1)] = report_file;
+    __atomic_store_n(&executor->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Pops a task from a queue. Called only from an executor thread.
+ * @return Flag whether a task is popped, false if a queue is empty.
+ */
+static bool ndcrash_out_executor_pop(struct ndcrash_out_executor *executor, char **report_file) {
+    const size_t head = __atomic_load_n(&executor->head, __ATOMIC_RELAXED);
+    const size_t tail = __atomic_load_n(&executor->tail, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+    *report_file = executor->tasks[head & (NDCRASH_OUT_CALLBACK_QUEUE_SIZE - 1)];
+    __atomic_store_n(&executor->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Waits on a semaphore, retrying when interrupted by a signal.
+ */
+static void ndcrash_out_executor_wait(sem_t *semaphore) {
+    while (sem_wait(semaphore) < 0 && errno == EINTR);
+}
+
+/**
+ * An entry point of executor thread. Runs crash callbacks until it's stopped and a queue is empty.
+ */
+static void *ndcrash_out_executor_function(void *arg) {
+    struct ndcrash_out_executor * const executor = (struct ndcrash_out_executor *) arg;
+    if (executor->start_callback) {
+        executor->start_callback(executor->callback_arg);
+    }
+    for (;;) {
+        ndcrash_out_executor_wait(&executor->tasks_semaphore);
+        char *report_file;
+        if (ndcrash_out_executor_pop(executor, &report_file)) {
+            executor->crash_callback(report_file, executor->callback_arg);
+            free(report_file);
+            sem_post(&executor->slots_semaphore);
+        } else if (__atomic_load_n(&executor->stopping, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    if (executor->stop_callback) {
+        executor->stop_callback(executor->callback_arg);
+    }
+    return NULL;
+}
+
+bool ndcrash_out_executor_start(struct ndcrash_out_executor *executor) {
+    executor->head = 0;
+    executor->tail = 0;
+    executor->stopping = false;
+    executor->dropped = 0;
+    if (sem_init(&executor->tasks_semaphore, 0, 0) < 0) {
+        NDCRASHLOG(ERROR, "Couldn't create executor semaphore: %s (%d)", strerror(errno), errno);
+        return false;
+    }
+    if (sem_init(&executor->slots_semaphore, 0, 0) < 0) {
+        NDCRASHLOG(ERROR, "Couldn't create executor semaphore: %s (%d)", strerror(errno), errno);
+        sem_destroy(&executor->tasks_semaphore);
+        return false;
+    }
+    const int res = pthread_create(&executor->thread, NULL, ndcrash_out_executor_function, executor);
+    if (res) {
+        NDCRASHLOG(ERROR, "Couldn't create executor thread: %s (%d)", strerror(res), res);
+        sem_destroy(&executor->tasks_semaphore);
+        sem_destroy(&executor->slots_semaphore);
+        return false;
+    }
+    executor->started = true;
+    return true;
+}
+
+bool ndcrash_out_executor_submit(struct ndcrash_out_executor *executor, char *report_file) {
+    while (!ndcrash_out_executor_push(executor, report_file)) {
+        if (executor->policy != ndcrash_crash_callback_wait) {
+            ++executor->dropped;
+            NDCRASHLOG(WARN, "Crash callback queue is full, call is dropped (%zu dropped overall)",
+                       executor->dropped);
+            return false;
+        }
+
+        // Every popped task posts a slot, a queue is checked again after that.
+        ndcrash_out_executor_wait(&executor->slots_semaphore);
+    }
+    sem_post(&executor->tasks_semaphore);
+    return true;
+}
+
+void ndcrash_out_executor_stop(struct ndcrash_out_executor *executor) {
+    if (!executor->started) return;
+    __atomic_store_n(&executor->stopping, true, __ATOMIC_RELEASE);
+    sem_post(&executor->tasks_semaphore);
+    pthread_join(executor->thread, NULL);
+    sem_destroy(&executor->tasks_semaphore);
+    sem_destroy(&executor->slots_semaphore);
+    executor->started = false;
+}
+
+#endif //ENABLE_OUTOFPROCESS
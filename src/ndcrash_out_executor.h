@@ -0,0 +1,91 @@
+#ifndef NDCRASH_OUT_EXECUTOR_H
+#define NDCRASH_OUT_EXECUTOR_H
+#include "ndcrash.h"
+#include "ndcrash_private.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ENABLE_OUTOFPROCESS
+
+/**
+ * Executor of daemon callbacks. Crash callback calls are passed from a daemon thread to an executor
+ * thread through a bounded single-producer single-consumer lock-free queue, so a daemon thread
+ * returns to accepting clients immediately after a report is written.
+ */
+struct ndcrash_out_executor {
+
+    /// Daemon lifecycle callbacks and their argument. See docs for ndcrash_out_start_daemon.
+    ndcrash_daemon_start_stop_callback start_callback;
+    ndcrash_daemon_crash_callback crash_callback;
+    ndcrash_daemon_start_stop_callback stop_callback;
+    void *callback_arg;
+
+    /// What to do when a queue is full.
+    enum ndcrash_crash_callback_policy policy;
+
+    /// Queue ring buffer: report paths passed to a crash callback. Paths are owned by a queue and
+    /// freed after a callback returns.
+    char *tasks[NDCRASH_OUT_CALLBACK_QUEUE_SIZE];
+
+    /// Count of popped tasks, written only by an executor thread.
+    size_t head;
+
+    /// Count of pushed tasks, written only by a daemon thread.
+    size_t tail;
+
+    /// Posted for every pushed task and on stop, an executor thread waits on it.
+    sem_t tasks_semaphore;
+
+    /// Posted for every popped task, a daemon thread waits on it if a queue is full.
+    sem_t slots_semaphore;
+
+    /// Flag whether an executor thread should exit after all queued tasks are run.
+    bool stopping;
+
+    /// Count of crash callback calls dropped because a queue was full.
+    size_t dropped;
+
+    /// Executor thread.
+    pthread_t thread;
+
+    /// Flag whether an executor thread is started.
+    bool started;
+};
+
+/**
+ * Starts an executor thread. Callbacks and policy should be filled before. A start callback is
+ * run on an executor thread before any crash callback.
+ * @param executor Executor instance.
+ * @return Flag whether a thread is started.
+ */
+bool ndcrash_out_executor_start(struct ndcrash_out_executor *executor);
+
+/**
+ * Queues a crash callback call. Should be called only from a daemon thread.
+ * @param executor Executor instance.
+ * @param report_file Report path to pass to a callback allocated by malloc. If a call is queued an
+ * executor owns it and frees it after a callback, otherwise it stays owned by a caller.
+ * @return Flag whether a call is queued, false if it's dropped because a queue is full.
+ */
+bool ndcrash_out_executor_submit(struct ndcrash_out_executor *executor, char *report_file);
+
+/**
+ * Stops an executor thread. Queued callbacks are run before, then a stop callback is run.
+ * Does nothing if an executor isn't started.
+ * @param executor Executor instance.
+ */
+void ndcrash_out_executor_stop(struct ndcrash_out_executor *executor);
+
+#endif //ENABLE_OUTOFPROCESS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_OUT_EXECUTOR_H
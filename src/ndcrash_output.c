@@ -0,0 +1,221 @@
+#include "ndcrash_output.h"
+#include "ndcrash_log.h"
+#include "ndcrash_private.h"
+#include "ndcrash_format.h"
+#include <sys/mman.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+/**
+ * Write buffer of file or fd output.
+ */
+struct ndcrash_output_buffer {
+
+    /// File descriptor where buffered data should be written.
+    int fd;
+
+    /// Count of buffered bytes.
+    size_t length;
+
+    /// Buffered data.
+    char data[NDCRASH_OUTPUT_BUFFER_SIZE];
+};
+
+/// Enabled outputs, bit mask of ndcrash_output values. Log and file are enabled by default.
+static unsigned ndcrash_output_flags = ndcrash_output_log | ndcrash_output_file;
+
+/// File descriptor for fd output, negative value if not set.
+static int ndcrash_output_fd_value = -1;
+
+/// Callback for callback output.
+static ndcrash_output_callback_func ndcrash_output_callback_ptr = NULL;
+
+/// Argument for callback.
+static void *ndcrash_output_callback_arg = NULL;
+
+/// Memory of ring output, allocated by mmap. NULL if not set.
+static char *ndcrash_output_ring_data = NULL;
+
+/// Size of ring output memory.
+static size_t ndcrash_output_ring_size = 0;
+
+/// Total count of bytes written to ring output, a position of next byte is this value modulo size.
+static size_t ndcrash_output_ring_written = 0;
+
+/// Buffer of file output.
+static struct ndcrash_output_buffer ndcrash_output_file_buffer = { -1, 0, { 0 } };
+
+/// Buffer of fd output.
+static struct ndcrash_output_buffer ndcrash_output_fd_buffer = { -1, 0, { 0 } };
+
+/**
+ * Writes all data to a file descriptor handling partial writes.
+ */
+static void ndcrash_output_write_all(int fd, const char *data, size_t length) {
+    while (length) {
+        const ssize_t written = write(fd, data, length);
+        if (written <= 0) return;
+        data += written;
+        length -= (size_t) written;
+    }
+}
+
+/**
+ * Writes buffered data of an output to its file descriptor.
+ */
+static void ndcrash_output_buffer_flush(struct ndcrash_output_buffer *buffer) {
+    if (buffer->length && buffer->fd >= 0) {
+        ndcrash_output_write_all(buffer->fd, buffer->data, buffer->length);
+    }
+    buffer->length = 0;
+}
+
+/**
+ * Appends data to output buffer. Buffered data is written when a buffer is full or when data is
+ * going to be written to another file descriptor.
+ */
+static void ndcrash_output_buffer_write(struct ndcrash_output_buffer *buffer, int fd, const char *data, size_t length) {
+    if (buffer->fd != fd) {
+        ndcrash_output_buffer_flush(buffer);
+        buffer->fd = fd;
+    }
+    if (buffer->length + length > sizeof(buffer->data)) {
+        ndcrash_output_buffer_flush(buffer);
+        if (length > sizeof(buffer->data)) {
+            ndcrash_output_write_all(fd, data, length);
+            return;
+        }
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+/**
+ * Appends data to ring output overwriting the oldest data.
+ */
+static void ndcrash_output_ring_write(const char *data, size_t length) {
+    char * const ring = ndcrash_output_ring_data;
+    const size_t size = ndcrash_output_ring_size;
+    if (!ring) return;
+    if (length > size) {
+        data += length - size;
+        ndcrash_output_ring_written += length - size;
+        length = size;
+    }
+    const size_t position = ndcrash_output_ring_written % size;
+    const size_t first_part = length < size - position ? length : size - position;
+    memcpy(ring + position, data, first_part);
+    memcpy(ring, data + first_part, length - first_part);
+    ndcrash_output_ring_written += length;
+}
+
+void ndcrash_set_outputs(unsigned outputs) {
+    ndcrash_output_flags = outputs;
+}
+
+void ndcrash_set_output_fd(int fd) {
+    ndcrash_output_buffer_flush(&ndcrash_output_fd_buffer);
+    ndcrash_output_fd_value = fd;
+}
+
+void ndcrash_set_output_callback(ndcrash_output_callback_func callback, void *arg) {
+    ndcrash_output_callback_arg = arg;
+    ndcrash_output_callback_ptr = callback;
+}
+
+bool ndcrash_set_output_ring(size_t size) {
+    if (ndcrash_output_ring_data) {
+        munmap(ndcrash_output_ring_data, ndcrash_output_ring_size);
+        ndcrash_output_ring_data = NULL;
+        ndcrash_output_ring_size = 0;
+    }
+    ndcrash_output_ring_written = 0;
+    if (!size) return true;
+    void * const memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return false;
+    ndcrash_output_ring_size = size;
+    ndcrash_output_ring_data = (char *) memory;
+    return true;
+}
+
+size_t ndcrash_get_output_ring(char *buffer, size_t size) {
+    const char * const ring = ndcrash_output_ring_data;
+    if (!ring || !size) return 0;
+    const size_t written = ndcrash_output_ring_written;
+    const size_t stored = written < ndcrash_output_ring_size ? written : ndcrash_output_ring_size;
+    const size_t length = stored < size ? stored : size;
+
+    // Copying the last length bytes in order of writing.
+    const size_t start = (written - length) % ndcrash_output_ring_size;
+    const size_t first_part =
+            length < ndcrash_output_ring_size - start ? length : ndcrash_output_ring_size - start;
+    memcpy(buffer, ring + start, first_part);
+    memcpy(buffer + first_part, ring, length - first_part);
+    return length;
+}
+
+bool ndcrash_output_is_enabled(enum ndcrash_output output) {
+    return (ndcrash_output_flags & output) != 0;
+}
+
+void ndcrash_output_write_line(int fd, char *line, size_t length) {
+    const unsigned flags = ndcrash_output_flags;
+
+#ifdef __ANDROID__
+    // Android log requires a null-terminated line without a new line character.
+    if (flags & ndcrash_output_log) {
+        __android_log_write(ANDROID_LOG_ERROR, NDCRASH_LOG_TAG, line);
+    }
+#endif
+
+    // All other outputs take a line with a new line character.
+    line[length++] = '\n';
+#ifndef __ANDROID__
+    if (flags & ndcrash_output_log) {
+        ndcrash_output_write_all(STDERR_FILENO, line, length);
+    }
+#endif
+    if ((flags & ndcrash_output_file) && fd > 0) {
+        ndcrash_output_buffer_write(&ndcrash_output_file_buffer, fd, line, length);
+    }
+    if ((flags & ndcrash_output_fd) && ndcrash_output_fd_value >= 0) {
+        ndcrash_output_buffer_write(&ndcrash_output_fd_buffer, ndcrash_output_fd_value, line, length);
+    }
+    if (flags & ndcrash_output_ring) {
+        ndcrash_output_ring_write(line, length);
+    }
+    if ((flags & ndcrash_output_callback) && ndcrash_output_callback_ptr) {
+        ndcrash_output_callback_ptr(line, length, ndcrash_output_callback_arg);
+    }
+}
+
+void ndcrash_output_flush() {
+    ndcrash_output_buffer_flush(&ndcrash_output_file_buffer);
+    ndcrash_output_file_buffer.fd = -1;
+    ndcrash_output_buffer_flush(&ndcrash_output_fd_buffer);
+}
+
+void ndcrash_output_print(int level, const char *format, ...) {
+    if (!(ndcrash_output_flags & ndcrash_output_log)) return;
+
+    // Formatting by ndcrash_vformat because this function may be called from a signal handler.
+    char buffer[NDCRASH_LOG_BUFFER_SIZE];
+    va_list args;
+    va_start(args, format);
+#ifdef __ANDROID__
+    ndcrash_vformat(buffer, sizeof(buffer), format, args);
+    __android_log_write(level, NDCRASH_LOG_TAG, buffer);
+#else
+    // Adding a tag prefix in order to distinguish library messages in standard error stream.
+    size_t printed = ndcrash_format(buffer, sizeof(buffer), "%s: ", NDCRASH_LOG_TAG);
+    printed += ndcrash_vformat(buffer + printed, sizeof(buffer) - printed, format, args);
+    buffer[printed] = '\n';
+    ndcrash_output_write_all(STDERR_FILENO, buffer, printed + 1);
+#endif
+    va_end(args);
+}
@@ -0,0 +1,44 @@
+#ifndef NDCRASH_OUTPUT_H
+#define NDCRASH_OUTPUT_H
+#include "ndcrash.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Checks whether an output is enabled by ndcrash_set_outputs.
+ * @param output Output to check.
+ * @return Flag value.
+ */
+bool ndcrash_output_is_enabled(enum ndcrash_output output);
+
+/**
+ * Writes a crash report line to all enabled outputs. Signal safe if a callback is signal safe.
+ * @param fd Report file descriptor used by file output, 0 or negative value if it shouldn't be used.
+ * @param line Null-terminated line without a new line character. Character at index length is
+ * replaced by a new line character.
+ * @param length Line length in bytes.
+ */
+void ndcrash_output_write_line(int fd, char *line, size_t length);
+
+/**
+ * Writes all buffered data of file and fd outputs. Should be called before a report file is closed.
+ */
+void ndcrash_output_flush();
+
+/**
+ * Writes a diagnostic message of a library to a log output. Used by NDCRASHLOG macro.
+ * @param level Message level, one of NDCRASH_LOG_LEVEL_* constants.
+ * @param format Message format.
+ * @param ... Format arguments.
+ */
+void ndcrash_output_print(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_OUTPUT_H
@@ -42,12 +42,27 @@ struct ndcrash_out_message
     struct ucontext context;
 };
 
+struct ndcrash_frames;
+
 /**
  * Type of pointer to unwinding function for in-process unwinding.
- * @param outfile Output file descriptor for a crash dump.
+ * @param frames Empty frames buffer to fill, it's written to a crash report after unwinding.
  * @param context processor state at a moment of crash.
  */
-typedef void (*ndcrash_in_unwind_func_ptr)(int outfile, struct ucontext *context);
+typedef void (*ndcrash_in_unwind_func_ptr)(struct ndcrash_frames *frames, struct ucontext *context);
+
+/**
+ * Type of pointer to unwinder initialization function for in-process unwinding. Called on
+ * initialization and every time when a list of loaded modules is refreshed. Does a work that isn't
+ * signal safe, for example, parses a memory map, in order to avoid it in a signal handler.
+ */
+typedef void (*ndcrash_in_unwinder_init_func_ptr)();
+
+/**
+ * Type of pointer to unwinder de-initialization function for in-process unwinding. Should free
+ * resources allocated by in-process unwinder initialization function.
+ */
+typedef void (*ndcrash_in_unwinder_deinit_func_ptr)();
 
 /**
  * Type of pointer to unwinder initialization function for out-of-process unwinding. Does some
@@ -65,14 +80,14 @@ typedef void * (*ndcrash_out_unwinder_init_func_ptr)(pid_t pid);
 
 /**
  * Type of pointer to unwinding function for out-of-process unwinding.
- * @param outfile Output file descriptor for a crash dump.
+ * @param frames Empty frames buffer to fill, it's written to a crash report after unwinding.
  * @param tid Thread id being unwound.
  * @param context A processor context (all register values) where to start unwinding. If null
  * a context is obtained by ptrace. Typically it's non-null for a main thread and null for all
  * other threads.
  * @param data A result of initialization function. Theoretically may be null.
  */
-typedef void (*ndcrash_out_unwind_func_ptr)(int outfile, pid_t tid, struct ucontext *context, void *data);
+typedef void (*ndcrash_out_unwind_func_ptr)(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data);
 
 /**
  * Type of pointer to unwinder de-initialization function. Should free resources allocated by
@@ -86,9 +101,131 @@ typedef void (*ndcrash_out_unwinder_deinit_func_ptr)(void *data);
 #define NDCRASH_MAX_FRAMES 128
 #endif
 
+/// This macro allows us to configure maximum count of unwinders in a chain: a primary unwinder and
+/// fallback ones set by ndcrash_set_fallback_unwinders.
+#ifndef NDCRASH_MAX_UNWINDERS
+#define NDCRASH_MAX_UNWINDERS 4
+#endif
+
+/// This macro allows us to configure a default minimum count of frames of a backtrace that isn't
+/// passed to fallback unwinders.
+#ifndef NDCRASH_UNWIND_MIN_FRAMES
+#define NDCRASH_UNWIND_MIN_FRAMES 4
+#endif
+
 /// This macro allows us to configure maximum function name length. Used for buffer size.
 #ifndef NDCRASH_MAX_FUNCTION_NAME_LENGTH
 #define NDCRASH_MAX_FUNCTION_NAME_LENGTH 128
 #endif
 
+/// This macro allows us to configure maximum count of loaded modules tracked in in-process mode.
+#ifndef NDCRASH_MAX_MODULES
+#define NDCRASH_MAX_MODULES 512
+#endif
+
+/// This macro allows us to configure maximum module path length. Used for buffer size.
+#ifndef NDCRASH_MAX_MODULE_NAME_LENGTH
+#define NDCRASH_MAX_MODULE_NAME_LENGTH 256
+#endif
+
+/// This macro allows us to configure a size of storage for module and function names of a single
+/// thread backtrace. Function names that don't fit are discarded.
+#ifndef NDCRASH_FRAMES_STRINGS_SIZE
+#define NDCRASH_FRAMES_STRINGS_SIZE (16 * 1024)
+#endif
+
+/// This macro allows us to configure a size of memory region reserved for in-process unwinders.
+/// Used for allocations in a signal handler instead of heap.
+#ifndef NDCRASH_IN_ARENA_SIZE
+#define NDCRASH_IN_ARENA_SIZE (256 * 1024)
+#endif
+
+/// This macro allows us to configure a size of alternate signal stack installed for threads in
+/// in-process mode. Default bionic stack (SIGSTKSZ) is too small for most unwinders.
+#ifndef NDCRASH_IN_ALTSTACK_SIZE
+#define NDCRASH_IN_ALTSTACK_SIZE (64 * 1024)
+#endif
+
+/// This macro allows us to configure maximum count of thread stacks whose bounds are recorded when
+/// an alternate stack is installed in in-process mode. Unwinders find stack bounds of these threads
+/// without memory map parsing in a signal handler.
+#ifndef NDCRASH_IN_MAX_THREAD_STACKS
+#define NDCRASH_IN_MAX_THREAD_STACKS 256
+#endif
+
+/// This macro allows us to configure maximum count of other threads unwound in in-process mode.
+#ifndef NDCRASH_IN_MAX_THREADS
+#define NDCRASH_IN_MAX_THREADS 64
+#endif
+
+/// This macro allows us to configure how long a crashing thread waits for other threads contexts
+/// in in-process mode, in milliseconds.
+#ifndef NDCRASH_IN_THREADS_TIMEOUT_MS
+#define NDCRASH_IN_THREADS_TIMEOUT_MS 1000
+#endif
+
+/// This macro allows us to configure a real-time signal that is sent to other threads on crash
+/// in in-process mode in order to obtain their contexts.
+#ifndef NDCRASH_IN_THREADS_SIGNAL
+#define NDCRASH_IN_THREADS_SIGNAL (SIGRTMIN + 10)
+#endif
+
+/// This macro allows us to configure maximum count of threads that crash simultaneously with a
+/// thread that creates a report in in-process mode. Their data is appended to a report.
+#ifndef NDCRASH_IN_MAX_CRASHED_THREADS
+#define NDCRASH_IN_MAX_CRASHED_THREADS 4
+#endif
+
+/// This macro allows us to configure how long a thread that crashed simultaneously with another
+/// one waits for a report completion in in-process mode, in milliseconds.
+#ifndef NDCRASH_IN_CRASH_WAIT_MS
+#define NDCRASH_IN_CRASH_WAIT_MS 10000
+#endif
+
+/// This macro allows us to configure a size of memory-mapped report buffer in in-process mode.
+/// Lines that don't fit are discarded.
+#ifndef NDCRASH_IN_REPORT_BUFFER_SIZE
+#define NDCRASH_IN_REPORT_BUFFER_SIZE (256 * 1024)
+#endif
+
+/// This macro allows us to configure a capacity of crash callback queue in out-of-process mode.
+/// Should be a power of 2.
+#ifndef NDCRASH_OUT_CALLBACK_QUEUE_SIZE
+#define NDCRASH_OUT_CALLBACK_QUEUE_SIZE 8
+#endif
+
+/// This macro allows us to configure maximum count of simultaneous client connections served by
+/// out-of-process daemon.
+#ifndef NDCRASH_OUT_MAX_CLIENTS
+#define NDCRASH_OUT_MAX_CLIENTS 16
+#endif
+
+/// This macro allows us to configure how long out-of-process daemon waits for a client message
+/// or a possibility to send a response, in milliseconds.
+#ifndef NDCRASH_OUT_CLIENT_TIMEOUT_MS
+#define NDCRASH_OUT_CLIENT_TIMEOUT_MS 5000
+#endif
+
+/// This macro allows us to configure a size of memory window read from a crashed process at once
+/// by out-of-process unwinders. Should be a power of 2.
+#ifndef NDCRASH_REMOTE_WINDOW_SIZE
+#define NDCRASH_REMOTE_WINDOW_SIZE 4096
+#endif
+
+/// This macro allows us to configure maximum size of stack copied from a crashed process by
+/// out-of-process "stackscan" unwinder. A stack is scanned from a stack pointer.
+#ifndef NDCRASH_OUT_STACKSCAN_MAX_SIZE
+#define NDCRASH_OUT_STACKSCAN_MAX_SIZE (1024 * 1024)
+#endif
+
+/// This macro allows us to configure maximum length of crash report line. Used for buffer size.
+#ifndef NDCRASH_LOG_BUFFER_SIZE
+#define NDCRASH_LOG_BUFFER_SIZE 256
+#endif
+
+/// This macro allows us to configure a size of write buffer for file and fd outputs.
+#ifndef NDCRASH_OUTPUT_BUFFER_SIZE
+#define NDCRASH_OUTPUT_BUFFER_SIZE 4096
+#endif
+
 #endif //NDCRASH_PRIVATE_H
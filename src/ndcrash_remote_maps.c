@@ -0,0 +1,118 @@
+#include "ndcrash_remote_maps.h"
+#include "ndcrash_memory_map.h"
+#include "ndcrash_remote_memory.h"
+#include "ndcrash_utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifdef ENABLE_OUTOFPROCESS
+
+/// State of memory map parsing.
+struct ndcrash_remote_maps_state {
+
+    /// Memory map to fill.
+    struct ndcrash_remote_maps *maps;
+
+    /// Process identifier, its memory is read to find ELF headers.
+    pid_t pid;
+};
+
+/**
+ * Callback for a memory map parsing function, fills mappings array. Sets capacity to 0 if memory
+ * allocation has failed. For arguments description see ndcrash_memory_map_entry_callback type
+ * definition.
+ */
+static void ndcrash_remote_maps_callback(const struct ndcrash_memory_map_entry *entry, void *data, bool *stop) {
+    const struct ndcrash_remote_maps_state * const state = (const struct ndcrash_remote_maps_state *) data;
+    struct ndcrash_remote_maps * const maps = state->maps;
+    if (maps->count == maps->capacity) {
+        const size_t capacity = maps->capacity ? maps->capacity * 2 : 64;
+        struct ndcrash_remote_mapping * const mappings = (struct ndcrash_remote_mapping *)
+                realloc(maps->mappings, capacity * sizeof(struct ndcrash_remote_mapping));
+        if (!mappings) {
+            maps->capacity = 0;
+            *stop = true;
+            return;
+        }
+        maps->mappings = mappings;
+        maps->capacity = capacity;
+    }
+    struct ndcrash_remote_mapping * const mapping = &maps->mappings[maps->count];
+    memset(mapping, 0, sizeof(struct ndcrash_remote_mapping));
+    mapping->start = entry->start;
+    mapping->end = entry->end;
+    mapping->prot = entry->prot;
+    mapping->offset = entry->offset;
+    strncpy(mapping->path, entry->path, sizeof(mapping->path) - 1);
+    mapping->is_system = ndcrash_is_system_module(mapping->path);
+
+    // A module continues while mappings of the same file follow. A mapping from zero offset or
+    // with ELF header at its start begins a new one: several libraries may be loaded from a single
+    // APK file, each of them starts at its own offset.
+    const struct ndcrash_remote_mapping * const previous = maps->count ? mapping - 1 : NULL;
+    if (previous &&
+        mapping->path[0] &&
+        mapping->offset &&
+        !strcmp(previous->path, mapping->path) &&
+        !((mapping->prot & PROT_READ) && ndcrash_remote_has_elf_header(state->pid, mapping->start))) {
+        mapping->base = previous->base;
+        mapping->base_index = previous->base_index;
+    } else {
+        mapping->base = mapping->start;
+        mapping->base_index = maps->count;
+    }
+    ++maps->count;
+}
+
+bool ndcrash_remote_maps_load(pid_t pid, struct ndcrash_remote_maps *maps) {
+    memset(maps, 0, sizeof(struct ndcrash_remote_maps));
+    struct ndcrash_remote_maps_state state = { maps, pid };
+    ndcrash_parse_memory_map(pid, &ndcrash_remote_maps_callback, &state);
+    if (!maps->capacity || !maps->count) {
+        ndcrash_remote_maps_free(maps);
+        return false;
+    }
+    return true;
+}
+
+void ndcrash_remote_maps_free(struct ndcrash_remote_maps *maps) {
+    for (size_t i = 0; i < maps->count; ++i) {
+        ndcrash_elf_free_symbols(&maps->mappings[i].symbols);
+    }
+    free(maps->mappings);
+    memset(maps, 0, sizeof(struct ndcrash_remote_maps));
+}
+
+const struct ndcrash_remote_mapping *ndcrash_remote_maps_find(const struct ndcrash_remote_maps *maps, uintptr_t address) {
+    size_t low = 0, high = maps->count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        const struct ndcrash_remote_mapping * const mapping = &maps->mappings[middle];
+        if (address < mapping->start) {
+            high = middle;
+        } else if (address >= mapping->end) {
+            low = middle + 1;
+        } else {
+            return mapping;
+        }
+    }
+    return NULL;
+}
+
+const char *ndcrash_remote_maps_find_symbol(
+        struct ndcrash_remote_maps *maps,
+        const struct ndcrash_remote_mapping *mapping,
+        uintptr_t rel_pc,
+        uintptr_t *offset) {
+    struct ndcrash_remote_mapping * const module = &maps->mappings[mapping->base_index];
+    if (!module->symbols_loaded) {
+        module->symbols_loaded = true;
+        if (module->path[0] == '/') {
+            ndcrash_elf_load_symbols(module->path, module->offset, !module->is_system, &module->symbols);
+        }
+    }
+    return ndcrash_elf_find_symbol(&module->symbols, rel_pc, offset);
+}
+
+#endif //ENABLE_OUTOFPROCESS
@@ -0,0 +1,109 @@
+#ifndef NDCRASH_REMOTE_MAPS_H
+#define NDCRASH_REMOTE_MAPS_H
+#include "ndcrash_private.h"
+#include "ndcrash_elf.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A mapping of another process, corresponds to a line of its memory map. Used by out-of-process
+ * unwinders which look for modules and function names without libraries of a platform.
+ */
+struct ndcrash_remote_mapping {
+
+    /// Start address of a mapping, inclusive.
+    uintptr_t start;
+
+    /// End address of a mapping, exclusive.
+    uintptr_t end;
+
+    /// Access flags of a mapping: bit mask of PROT_READ, PROT_WRITE and PROT_EXEC values.
+    int prot;
+
+    /// Offset of a mapping within a file.
+    uintptr_t offset;
+
+    /// Start address of a module: a start of the first consecutive mapping of the same file that
+    /// begins with ELF header. Relative program counter values are calculated from it.
+    uintptr_t base;
+
+    /// Index of a mapping where a module starts, its symbols are stored there.
+    size_t base_index;
+
+    /// Flag whether a mapped file belongs to Android system. See ndcrash_is_system_module.
+    bool is_system;
+
+    /// Flag whether loading of symbols has been tried.
+    bool symbols_loaded;
+
+    /// Function symbols of a module, valid only for a mapping where a module starts.
+    struct ndcrash_elf_symbols symbols;
+
+    /// Path of a mapped file or a pseudo-path. Empty string for anonymous memory.
+    char path[NDCRASH_MAX_MODULE_NAME_LENGTH];
+};
+
+/**
+ * Memory map of another process.
+ */
+struct ndcrash_remote_maps {
+
+    /// Mappings sorted by address.
+    struct ndcrash_remote_mapping *mappings;
+
+    /// Count of filled mappings.
+    size_t count;
+
+    /// Count of allocated mappings.
+    size_t capacity;
+};
+
+/**
+ * Reads a memory map of a process. Not signal safe, allocates memory.
+ * @param pid Process identifier.
+ * @param maps Memory map to fill.
+ * @return Flag whether reading is successful. A memory map is empty on failure.
+ */
+bool ndcrash_remote_maps_load(pid_t pid, struct ndcrash_remote_maps *maps);
+
+/**
+ * Frees a memory map and all loaded symbols.
+ * @param maps Memory map previously filled by ndcrash_remote_maps_load.
+ */
+void ndcrash_remote_maps_free(struct ndcrash_remote_maps *maps);
+
+/**
+ * Finds a mapping containing an address by binary search.
+ * @param maps Memory map.
+ * @param address Address to look for.
+ * @return Mapping or NULL if an address isn't mapped.
+ */
+const struct ndcrash_remote_mapping *ndcrash_remote_maps_find(const struct ndcrash_remote_maps *maps, uintptr_t address);
+
+/**
+ * Looks for a function name. Symbols of a module are loaded from its file when it's needed for
+ * the first time. For a library loaded from APK directly they are read from an ELF image at a
+ * module offset within APK file.
+ * @param maps Memory map.
+ * @param mapping Mapping containing an address.
+ * @param rel_pc Address relative to a module base.
+ * @param offset Pointer where to write an offset of address from function start.
+ * @return Function name or NULL if not found.
+ */
+const char *ndcrash_remote_maps_find_symbol(
+        struct ndcrash_remote_maps *maps,
+        const struct ndcrash_remote_mapping *mapping,
+        uintptr_t rel_pc,
+        uintptr_t *offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_REMOTE_MAPS_H
@@ -0,0 +1,156 @@
+#include "ndcrash_remote_memory.h"
+#include "ndcrash_ucontext.h"
+#include "ndcrash_log.h"
+#include <elf.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#ifdef ENABLE_OUTOFPROCESS
+
+bool ndcrash_remote_get_registers(pid_t tid, const struct ucontext *context, struct ndcrash_remote_registers *registers) {
+    if (context) {
+        registers->pc = ndcrash_pc_from_ucontext(context);
+        registers->sp = ndcrash_sp_from_ucontext(context);
+        registers->fp = ndcrash_fp_from_ucontext(context);
+#if defined(__arm__)
+        registers->lr = context->uc_mcontext.arm_lr;
+#elif defined(__aarch64__)
+        registers->lr = context->uc_mcontext.regs[30];
+#else
+        registers->lr = 0;
+#endif
+        return true;
+    }
+#if defined(__aarch64__)
+    // For arm64 modern PTRACE_GETREGSET request should be executed.
+    struct user_pt_regs r;
+    struct iovec io;
+    io.iov_base = &r;
+    io.iov_len = sizeof(r);
+    if (ptrace(PTRACE_GETREGSET, tid, (void *)NT_PRSTATUS, &io) == -1) goto error;
+    registers->pc = r.pc;
+    registers->sp = r.sp;
+    registers->fp = r.regs[29];
+    registers->lr = r.regs[30];
+#elif defined(__x86_64__)
+    struct user_regs_struct r;
+    if (ptrace(PTRACE_GETREGS, tid, 0, &r) == -1) goto error;
+    registers->pc = r.rip;
+    registers->sp = r.rsp;
+    registers->fp = r.rbp;
+    registers->lr = 0;
+#else
+    struct pt_regs r;
+    if (ptrace(PTRACE_GETREGS, tid, 0, &r) == -1) goto error;
+#if defined(__arm__)
+    registers->pc = r.ARM_pc;
+    registers->sp = r.ARM_sp;
+    registers->fp = r.ARM_fp;
+    registers->lr = r.ARM_lr;
+#else
+    registers->pc = r.eip;
+    registers->sp = r.esp;
+    registers->fp = r.ebp;
+    registers->lr = 0;
+#endif
+#endif
+    return true;
+    // C-style error processing.
+error:
+    NDCRASHLOG(ERROR, "Couldn't get registers by ptrace: %s (%d)", strerror(errno), errno);
+    return false;
+}
+
+/**
+ * Reads memory of another process word by word by ptrace.
+ * For arguments description see ndcrash_remote_read.
+ */
+static size_t ndcrash_remote_read_ptrace(pid_t pid, uintptr_t address, void *buffer, size_t size) {
+    size_t result = 0;
+    while (result < size) {
+        // PTRACE_PEEKDATA returns a word value, errno distinguishes an error from -1 value.
+        const uintptr_t word_address = (address + result) & ~(uintptr_t) (sizeof(long) - 1);
+        const size_t skip = address + result - word_address;
+        errno = 0;
+        const long word = ptrace(PTRACE_PEEKDATA, pid, (void *) word_address, NULL);
+        if (errno) break;
+        size_t length = sizeof(long) - skip;
+        if (length > size - result) {
+            length = size - result;
+        }
+        memcpy((uint8_t *) buffer + result, (const uint8_t *) &word + skip, length);
+        result += length;
+    }
+    return result;
+}
+
+size_t ndcrash_remote_read(pid_t pid, uintptr_t address, void *buffer, size_t size) {
+    // Using a system call directly, process_vm_readv wrapper is available only since API 23.
+    struct iovec local = { buffer, size };
+    struct iovec remote = { (void *) address, size };
+    const ssize_t result = syscall(__NR_process_vm_readv, pid, &local, 1, &remote, 1, 0);
+    if (result >= 0) return (size_t) result;
+    if (errno == ENOSYS || errno == EPERM) {
+        return ndcrash_remote_read_ptrace(pid, address, buffer, size);
+    }
+    return 0;
+}
+
+uintptr_t ndcrash_remote_rewind_pc(pid_t pid, uintptr_t pc) {
+#ifdef __arm__
+    if (pc & 1) {
+        // Thumb mode.
+        uint32_t value;
+        if (ndcrash_remote_read(pid, pc - 5, &value, sizeof(value)) == sizeof(value) &&
+            (value & 0xe000f000) != 0xe000f000) {
+            return pc - 2;
+        }
+    }
+    return pc - 4;
+#else
+    return ndcrash_rewind_pc(pc);
+#endif
+}
+
+bool ndcrash_remote_has_elf_header(pid_t pid, uintptr_t address) {
+    unsigned char ident[SELFMAG];
+    return ndcrash_remote_read(pid, address, ident, sizeof(ident)) == sizeof(ident) &&
+           !memcmp(ident, ELFMAG, SELFMAG);
+}
+
+void ndcrash_remote_window_init(struct ndcrash_remote_window *window, pid_t pid) {
+    window->pid = pid;
+    window->start = 0;
+    window->size = 0;
+}
+
+bool ndcrash_remote_window_read(
+        struct ndcrash_remote_window *window,
+        uintptr_t address,
+        void *buffer,
+        size_t size,
+        uintptr_t limit) {
+    if (address > limit || limit - address < size) return false;
+    if (address < window->start || address - window->start + size > window->size) {
+        // A window is aligned, so the next values of a growing address are usually cached.
+        uintptr_t start = address & ~(uintptr_t) (NDCRASH_REMOTE_WINDOW_SIZE - 1);
+        if (address + size > start + NDCRASH_REMOTE_WINDOW_SIZE) {
+            start = address;
+        }
+        size_t length = NDCRASH_REMOTE_WINDOW_SIZE;
+        if (limit - start < length) {
+            length = limit - start;
+        }
+        window->start = start;
+        window->size = ndcrash_remote_read(window->pid, start, window->data, length);
+        if (address - window->start + size > window->size) return false;
+    }
+    memcpy(buffer, window->data + (address - window->start), size);
+    return true;
+}
+
+#endif //ENABLE_OUTOFPROCESS
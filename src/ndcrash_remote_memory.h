@@ -0,0 +1,117 @@
+#ifndef NDCRASH_REMOTE_MEMORY_H
+#define NDCRASH_REMOTE_MEMORY_H
+#include "ndcrash_private.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Window of memory of another process cached by a bulk read. Used to read many small values,
+ * for example stack frame records, without a system call for every value.
+ */
+struct ndcrash_remote_window {
+
+    /// Process identifier which memory is read.
+    pid_t pid;
+
+    /// Start address of cached memory.
+    uintptr_t start;
+
+    /// Count of valid bytes in data, 0 if nothing is cached.
+    size_t size;
+
+    /// Cached memory.
+    uint8_t data[NDCRASH_REMOTE_WINDOW_SIZE];
+};
+
+/**
+ * Register values of a thread of another process that are required for unwinding.
+ */
+struct ndcrash_remote_registers {
+
+    /// Program counter.
+    uintptr_t pc;
+
+    /// Stack pointer.
+    uintptr_t sp;
+
+    /// Frame pointer.
+    uintptr_t fp;
+
+    /// Link register, 0 on x86.
+    uintptr_t lr;
+};
+
+/**
+ * Gets registers of a thread of another process required for unwinding.
+ * @param tid Thread identifier, a thread should be attached by ptrace if context is NULL.
+ * @param context Processor context of a thread. If NULL registers are obtained by ptrace.
+ * @param registers Pointer to a structure to fill.
+ * @return Flag whether registers are obtained.
+ */
+bool ndcrash_remote_get_registers(pid_t tid, const struct ucontext *context, struct ndcrash_remote_registers *registers);
+
+/**
+ * Reads memory of another process. Uses process_vm_readv, if it's unavailable falls back to
+ * PTRACE_PEEKDATA, a process should be attached by ptrace in this case.
+ * @param pid Process or thread identifier.
+ * @param address Address in a remote process.
+ * @param buffer Where to copy memory.
+ * @param size Count of bytes to read.
+ * @return Count of read bytes, less than size if a part of memory isn't readable.
+ */
+size_t ndcrash_remote_read(pid_t pid, uintptr_t address, void *buffer, size_t size);
+
+/**
+ * Rewinds program counter value of another process to an address of a previous instruction.
+ * See ndcrash_rewind_pc, on arm an instruction is read from memory of another process.
+ * @param pid Process identifier.
+ * @param pc Program counter value to rewind.
+ * @return Rewound program counter value.
+ */
+uintptr_t ndcrash_remote_rewind_pc(pid_t pid, uintptr_t pc);
+
+/**
+ * Checks whether memory of another process contains ELF header magic at specified address. Used to
+ * find where a module image starts, for example a library mapped directly from an APK file.
+ * @param pid Process identifier.
+ * @param address Address in a remote process, usually a start of a mapping.
+ * @return Flag whether ELF magic is read at an address.
+ */
+bool ndcrash_remote_has_elf_header(pid_t pid, uintptr_t address);
+
+/**
+ * Initializes an empty window.
+ * @param window Window to initialize.
+ * @param pid Process or thread identifier which memory is read.
+ */
+void ndcrash_remote_window_init(struct ndcrash_remote_window *window, pid_t pid);
+
+/**
+ * Reads a value from memory of another process through a window. If a value isn't cached a window
+ * is filled by a bulk read starting from an address aligned by a window size, a read never crosses
+ * a limit address.
+ * @param window Window.
+ * @param address Address of a value in a remote process.
+ * @param buffer Where to copy a value.
+ * @param size Size of a value, not greater than NDCRASH_REMOTE_WINDOW_SIZE.
+ * @param limit Address after the last readable byte, for example a stack end.
+ * @return Flag whether a value is read.
+ */
+bool ndcrash_remote_window_read(
+        struct ndcrash_remote_window *window,
+        uintptr_t address,
+        void *buffer,
+        size_t size,
+        uintptr_t limit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_REMOTE_MEMORY_H
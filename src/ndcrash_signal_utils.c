@@ -171,7 +171,8 @@ const char *ndcrash_get_sigcode(int signo, int code) {
 bool ndcrash_register_signal_handler(ndcrash_signal_handler_function handler, struct sigaction old_handlers[NSIG]) {
     struct sigaction sigactionstruct;
     memset(&sigactionstruct, 0, sizeof(sigactionstruct));
-    sigactionstruct.sa_flags = SA_SIGINFO;
+    // Using an alternate stack, otherwise a handler can't run on stack overflow.
+    sigactionstruct.sa_flags = SA_SIGINFO | SA_ONSTACK;
     sigactionstruct.sa_sigaction = handler;
     for (int index = 0; index < NUM_SIGNALS_TO_CATCH; ++index) {
         const int signo = SIGNALS_TO_CATCH[index];
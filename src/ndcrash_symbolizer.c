@@ -0,0 +1,145 @@
+#include "ndcrash_symbolizer.h"
+#include "ndcrash_frames.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_arena.h"
+#include <stdint.h>
+
+#ifdef ENABLE_INPROCESS
+
+/**
+ * A frame that requires a function name lookup.
+ */
+struct ndcrash_symbolizer_entry {
+
+    /// Module containing frame pc.
+    const struct ndcrash_module *module;
+
+    /// Address to look for, ELF virtual address of a module.
+    uintptr_t address;
+
+    /// Frame where to write a result.
+    struct ndcrash_frame *frame;
+};
+
+/**
+ * Compares entries by module and address.
+ * @return Flag whether a is less than b.
+ */
+static inline bool ndcrash_symbolizer_less(
+        const struct ndcrash_symbolizer_entry *a,
+        const struct ndcrash_symbolizer_entry *b) {
+    if (a->module != b->module) return (uintptr_t) a->module < (uintptr_t) b->module;
+    return a->address < b->address;
+}
+
+/**
+ * Moves an entry down a heap until heap property is restored.
+ */
+static void ndcrash_symbolizer_sift_down(struct ndcrash_symbolizer_entry *entries, size_t root, size_t count) {
+    for (;;) {
+        size_t child = root * 2 + 1;
+        if (child >= count) break;
+        if (child + 1 < count && ndcrash_symbolizer_less(&entries[child], &entries[child + 1])) {
+            ++child;
+        }
+        if (!ndcrash_symbolizer_less(&entries[root], &entries[child])) break;
+        const struct ndcrash_symbolizer_entry tmp = entries[root];
+        entries[root] = entries[child];
+        entries[child] = tmp;
+        root = child;
+    }
+}
+
+/**
+ * Sorts entries by module and address. Heap sort is used because qsort may allocate memory.
+ */
+static void ndcrash_symbolizer_sort(struct ndcrash_symbolizer_entry *entries, size_t count) {
+    for (size_t i = count / 2; i > 0; --i) {
+        ndcrash_symbolizer_sift_down(entries, i - 1, count);
+    }
+    for (size_t end = count; end > 1; --end) {
+        const struct ndcrash_symbolizer_entry tmp = entries[0];
+        entries[0] = entries[end - 1];
+        entries[end - 1] = tmp;
+        ndcrash_symbolizer_sift_down(entries, 0, end - 1);
+    }
+}
+
+/**
+ * Calculates a distance from frame pc to an address used for a function name lookup.
+ */
+static inline uintptr_t ndcrash_symbolizer_rewind(const struct ndcrash_frame *frame) {
+    return (frame->flags & ndcrash_frame_return_address) ? 1 : 0;
+}
+
+/**
+ * Writes a lookup result to a frame.
+ * @param frame Frame to fill.
+ * @param symbol Function name or NULL if not found.
+ * @param offset Offset of a lookup address from function start, pc offset is written to a frame.
+ */
+static inline void ndcrash_symbolizer_set(struct ndcrash_frame *frame, const char *symbol, uintptr_t offset) {
+    frame->symbol = symbol;
+    frame->offset = symbol ? offset + ndcrash_symbolizer_rewind(frame) : 0;
+    frame->flags &= ~ndcrash_frame_symbol_deferred;
+}
+
+void ndcrash_symbolize_frames(struct ndcrash_frames * const *backtraces, size_t count) {
+    // Collecting frames to resolve.
+    size_t entries_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        entries_count += backtraces[i]->count;
+    }
+    struct ndcrash_symbolizer_entry * const entries = (struct ndcrash_symbolizer_entry *)
+            ndcrash_arena_alloc(entries_count * sizeof(struct ndcrash_symbolizer_entry));
+    entries_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < backtraces[i]->count; ++j) {
+            struct ndcrash_frame * const frame = &backtraces[i]->frames[j];
+            if (!(frame->flags & ndcrash_frame_symbol_deferred)) continue;
+            const struct ndcrash_module * const module = frame->pc ? ndcrash_modules_find(frame->pc) : NULL;
+            if (!module || !module->symbols.count) {
+                ndcrash_symbolizer_set(frame, NULL, 0);
+                continue;
+            }
+            if (!entries) {
+                // Arena is exhausted, falling back to a lookup for every frame.
+                uintptr_t offset = 0;
+                const char * const symbol = ndcrash_elf_find_symbol(
+                        &module->symbols, frame->pc - module->load_bias - ndcrash_symbolizer_rewind(frame), &offset);
+                ndcrash_symbolizer_set(frame, symbol, offset);
+                continue;
+            }
+            struct ndcrash_symbolizer_entry * const entry = &entries[entries_count++];
+            entry->module = module;
+            entry->address = frame->pc - module->load_bias - ndcrash_symbolizer_rewind(frame);
+            entry->frame = frame;
+        }
+    }
+    if (!entries_count) return;
+
+    // Walking symbols of every module once, equal addresses are looked up once.
+    ndcrash_symbolizer_sort(entries, entries_count);
+    const struct ndcrash_symbolizer_entry *previous = NULL;
+    size_t index = 0;
+    for (size_t i = 0; i < entries_count; ++i) {
+        struct ndcrash_symbolizer_entry * const entry = &entries[i];
+        if (previous && previous->module == entry->module && previous->address == entry->address) {
+            ndcrash_symbolizer_set(
+                    entry->frame,
+                    previous->frame->symbol,
+                    previous->frame->offset - ndcrash_symbolizer_rewind(previous->frame));
+            continue;
+        }
+        if (!previous || previous->module != entry->module) {
+            index = 0;
+        }
+        uintptr_t offset = 0;
+        const char * const symbol = ndcrash_elf_find_symbol_sequential(
+                &entry->module->symbols, entry->address, &index, &offset);
+        ndcrash_symbolizer_set(entry->frame, symbol, offset);
+        previous = entry;
+    }
+}
+
+#endif //ENABLE_INPROCESS
@@ -0,0 +1,26 @@
+#ifndef NDCRASH_SYMBOLIZER_H
+#define NDCRASH_SYMBOLIZER_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ndcrash_frames;
+
+/**
+ * Resolves function names of frames marked by ndcrash_frame_symbol_deferred flag for several
+ * backtraces at once. Unique pairs of module and relative pc are looked up in order of ascending
+ * address, so a symbols table of every module is walked only once and the same return addresses
+ * found in different threads are looked up once. Uses a list of loaded modules collected on
+ * in-process mode initialization and arena memory, signal safe.
+ * @param backtraces Array of pointers to frames buffers.
+ * @param count Count of elements in backtraces array.
+ */
+void ndcrash_symbolize_frames(struct ndcrash_frames * const *backtraces, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_SYMBOLIZER_H
@@ -0,0 +1,105 @@
+#ifndef NDCRASH_UCONTEXT_H
+#define NDCRASH_UCONTEXT_H
+#include "ndcrash_private.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Extracts program counter (instruction pointer) value from passed ucontext structure.
+ * @param uc Pointer to ucontext structure.
+ * @return Program counter value.
+ */
+static inline uintptr_t ndcrash_pc_from_ucontext(const struct ucontext *uc) {
+#if defined(__arm__)
+    return uc->uc_mcontext.arm_pc;
+#elif defined(__aarch64__)
+    return uc->uc_mcontext.pc;
+#elif defined(__i386__)
+    return uc->uc_mcontext.gregs[REG_EIP];
+#elif defined(__x86_64__)
+    return uc->uc_mcontext.gregs[REG_RIP];
+#endif
+}
+
+/**
+ * Extracts stack pointer value from passed ucontext structure.
+ * @param uc Pointer to ucontext structure.
+ * @return Stack pointer value.
+ */
+static inline uintptr_t ndcrash_sp_from_ucontext(const struct ucontext *uc) {
+#if defined(__arm__)
+    return uc->uc_mcontext.arm_sp;
+#elif defined(__aarch64__)
+    return uc->uc_mcontext.sp;
+#elif defined(__i386__)
+    return uc->uc_mcontext.gregs[REG_ESP];
+#elif defined(__x86_64__)
+    return uc->uc_mcontext.gregs[REG_RSP];
+#endif
+}
+
+/**
+ * Extracts frame pointer value from passed ucontext structure: x29 on arm64, ebp/rbp on x86,
+ * r11 on arm.
+ * @param uc Pointer to ucontext structure.
+ * @return Frame pointer value.
+ */
+static inline uintptr_t ndcrash_fp_from_ucontext(const struct ucontext *uc) {
+#if defined(__arm__)
+    return uc->uc_mcontext.arm_fp;
+#elif defined(__aarch64__)
+    return uc->uc_mcontext.regs[29];
+#elif defined(__i386__)
+    return uc->uc_mcontext.gregs[REG_EBP];
+#elif defined(__x86_64__)
+    return uc->uc_mcontext.gregs[REG_RBP];
+#endif
+}
+
+/**
+ * Removes a pointer authentication code from a return address on arm64. Uses XPACLRI instruction
+ * which is a NOP on processors without pointer authentication, so it's safe on any device.
+ * @param address Return address read from a stack or a register.
+ * @return Return address without a pointer authentication code.
+ */
+static inline uintptr_t ndcrash_strip_pac(uintptr_t address) {
+#ifdef __aarch64__
+    register uintptr_t x30 __asm__("x30") = address;
+    __asm__("hint #7" : "+r"(x30)); // XPACLRI
+    return x30;
+#else
+    return address;
+#endif
+}
+
+/**
+ * Rewinds program counter value to an address of a previous instruction. On arm an instruction
+ * is read to detect its size, so it may be used only for addresses of a current process.
+ * @param pc Program counter value to rewind.
+ * @return Rewound program counter value.
+ */
+static inline uintptr_t ndcrash_rewind_pc(uintptr_t pc) {
+#ifdef __arm__
+    if (pc & 1) {
+        // Thumb mode.
+        const uintptr_t value = *((uintptr_t *)(pc - 5));
+        if ((value & 0xe000f000) != 0xe000f000) {
+            return pc - 2;
+        }
+    }
+    return pc - 4;
+#elif defined(__aarch64__)
+    return pc < 4 ? pc : pc - 4;
+#elif defined(__i386__) || defined(__x86_64__)
+    return pc - 1;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_UCONTEXT_H
@@ -0,0 +1,115 @@
+#include "ndcrash_unwind_chain.h"
+#include "ndcrash_frames.h"
+#include "ndcrash_dump.h"
+#include "ndcrash_format.h"
+#include "ndcrash_utils.h"
+#include "sizeofa.h"
+#include <string.h>
+
+/// Fallback unwinders in order of trying.
+static enum ndcrash_unwinder ndcrash_fallback_unwinders[NDCRASH_MAX_UNWINDERS - 1];
+
+/// Count of filled elements in ndcrash_fallback_unwinders array.
+static size_t ndcrash_fallback_unwinders_count = 0;
+
+/// Minimum count of frames of a backtrace that passes a quality check.
+static size_t ndcrash_unwind_min_frames = NDCRASH_UNWIND_MIN_FRAMES;
+
+/// Functions a thread starts from. A backtrace reaching any of them is complete regardless of its depth.
+static const char * const THREAD_START_FUNCTIONS[] = {
+        "__start_thread",
+        "__pthread_start",
+        "__libc_init",
+        "start_thread",
+        "__clone",
+        "clone",
+        "_start",
+};
+
+void ndcrash_set_fallback_unwinders(const enum ndcrash_unwinder *unwinders, size_t count, size_t min_frames) {
+    if (!unwinders || count > sizeofa(ndcrash_fallback_unwinders)) {
+        count = unwinders ? sizeofa(ndcrash_fallback_unwinders) : 0;
+    }
+    if (count) {
+        memcpy(ndcrash_fallback_unwinders, unwinders, count * sizeof(enum ndcrash_unwinder));
+    }
+    ndcrash_fallback_unwinders_count = count;
+    ndcrash_unwind_min_frames = min_frames ? min_frames : NDCRASH_UNWIND_MIN_FRAMES;
+}
+
+const enum ndcrash_unwinder *ndcrash_get_fallback_unwinders(size_t *count) {
+    *count = ndcrash_fallback_unwinders_count;
+    return ndcrash_fallback_unwinders;
+}
+
+/**
+ * Checks whether a backtrace is good enough to not try other unwinders.
+ * @param frames Backtrace.
+ * @return Flag value.
+ */
+static bool ndcrash_unwind_is_complete(const struct ndcrash_frames *frames) {
+    if (frames->count >= ndcrash_unwind_min_frames || ndcrash_frames_full(frames)) return true;
+    if (!frames->count) return false;
+
+    // Function names aren't available here if they are deferred, only depth is checked then.
+    const char * const symbol = frames->frames[frames->count - 1].symbol;
+    if (!symbol) return false;
+    for (size_t i = 0; i < sizeofa(THREAD_START_FUNCTIONS); ++i) {
+        if (!strcmp(symbol, THREAD_START_FUNCTIONS[i])) return true;
+    }
+    return false;
+}
+
+struct ndcrash_frames *ndcrash_unwind_chain(
+        struct ndcrash_frames *frames,
+        struct ndcrash_frames *spare,
+        size_t count,
+        ndcrash_unwind_tier_func_ptr unwind,
+        void *arg,
+        struct ndcrash_unwind_stats *stats) {
+    struct ndcrash_frames *best = NULL;
+    stats->count = 0;
+    stats->used = 0;
+    for (size_t i = 0; i < count && stats->count < NDCRASH_MAX_UNWINDERS; ++i) {
+        // A buffer with the best result so far is kept, the other one is filled.
+        struct ndcrash_frames * const target = best == frames ? spare : frames;
+        if (!target) break;
+        ndcrash_frames_reset(target);
+        const int64_t start = ndcrash_time_us();
+        const char * const name = unwind(target, i, arg);
+        if (!name) continue;
+        struct ndcrash_unwind_tier * const tier = &stats->tiers[stats->count++];
+        tier->name = name;
+        tier->time_us = ndcrash_time_us() - start;
+        tier->frames_count = target->count;
+        tier->complete = ndcrash_unwind_is_complete(target);
+        if (!best || tier->complete || target->count > best->count) {
+            best = target;
+            stats->used = stats->count - 1;
+        }
+        if (tier->complete) break;
+    }
+    if (!best) {
+        ndcrash_frames_reset(frames);
+        best = frames;
+    }
+    return best;
+}
+
+void ndcrash_unwind_stats_dump(int outfile, const struct ndcrash_unwind_stats *stats) {
+    char line[NDCRASH_LOG_BUFFER_SIZE];
+    size_t length = ndcrash_format(line, sizeof(line), "    unwinders:");
+    for (size_t i = 0; i < stats->count; ++i) {
+        const struct ndcrash_unwind_tier * const tier = &stats->tiers[i];
+        length += ndcrash_format(
+                line + length,
+                sizeof(line) - length,
+                "%s %s %zu frames %zuus%s",
+                i ? "," : "",
+                tier->name,
+                tier->frames_count,
+                (size_t) tier->time_us,
+                i == stats->used ? " (used)" : "");
+    }
+    ndcrash_dump_write_line(outfile, "%s", line);
+}
@@ -0,0 +1,97 @@
+#ifndef NDCRASH_UNWIND_CHAIN_H
+#define NDCRASH_UNWIND_CHAIN_H
+#include "ndcrash.h"
+#include "ndcrash_private.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ndcrash_frames;
+
+/**
+ * Result of a single unwinder of a chain for one thread.
+ */
+struct ndcrash_unwind_tier {
+
+    /// Unwinder name.
+    const char *name;
+
+    /// Unwinding time in microseconds.
+    int64_t time_us;
+
+    /// Count of unwound frames.
+    size_t frames_count;
+
+    /// Flag whether a backtrace has passed a quality check.
+    bool complete;
+};
+
+/**
+ * Results of all unwinders of a chain that have been tried for one thread.
+ */
+struct ndcrash_unwind_stats {
+
+    /// Tried unwinders in order of trying.
+    struct ndcrash_unwind_tier tiers[NDCRASH_MAX_UNWINDERS];
+
+    /// Count of filled elements in tiers array.
+    size_t count;
+
+    /// Index of a tier which backtrace is written to a report.
+    size_t used;
+};
+
+/**
+ * Type of pointer to a function that runs an unwinder of a chain.
+ * @param frames Empty frames buffer to fill.
+ * @param index Index of an unwinder in a chain.
+ * @param arg Argument passed to ndcrash_unwind_chain.
+ * @return Unwinder name, NULL if an unwinder can't be used for this thread and it's skipped.
+ */
+typedef const char *(*ndcrash_unwind_tier_func_ptr)(struct ndcrash_frames *frames, size_t index, void *arg);
+
+/**
+ * Retrieves fallback unwinders set by ndcrash_set_fallback_unwinders.
+ * @param count Where to write a count of fallback unwinders.
+ * @return Array of fallback unwinders in order of trying.
+ */
+const enum ndcrash_unwinder *ndcrash_get_fallback_unwinders(size_t *count);
+
+/**
+ * Runs unwinders of a chain one by one until a backtrace passes a quality check: it has at least
+ * a configured count of frames or it reaches a thread start function. If no backtrace passes a
+ * check the deepest one is used. Signal safe if unwinders are.
+ * @param frames Frames buffer for a result.
+ * @param spare Frames buffer of the same capacity used by fallback unwinders, it allows to keep
+ * a previous result. NULL if only the first unwinder should be run.
+ * @param count Count of unwinders in a chain.
+ * @param unwind Function that runs an unwinder.
+ * @param arg Argument for unwind function.
+ * @param stats Where to write results of tried unwinders.
+ * @return Frames buffer containing a used backtrace, frames or spare.
+ */
+struct ndcrash_frames *ndcrash_unwind_chain(
+        struct ndcrash_frames *frames,
+        struct ndcrash_frames *spare,
+        size_t count,
+        ndcrash_unwind_tier_func_ptr unwind,
+        void *arg,
+        struct ndcrash_unwind_stats *stats);
+
+/**
+ * Writes results of tried unwinders to a crash report. Example:
+ * "    unwinders: cxxabi 2 frames 35us, libunwind 17 frames 840us (used)"
+ * @param outfile Output file descriptor for a crash report.
+ * @param stats Results of tried unwinders.
+ */
+void ndcrash_unwind_stats_dump(int outfile, const struct ndcrash_unwind_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_UNWIND_CHAIN_H
@@ -0,0 +1,185 @@
+#include "ndcrash_unwinders.h"
+#include <stddef.h>
+
+/// Frame pointer unwinder is available only for architectures with a consistent frame record layout.
+#if defined(ENABLE_FRAMEPOINTER) && (defined(__aarch64__) || defined(__x86_64__) || defined(__i386__))
+#define NDCRASH_FRAMEPOINTER_SUPPORTED
+#endif
+
+/// DWARF CFI unwinder is available only for architectures where .eh_frame is used for unwinding.
+#if defined(ENABLE_CFI) && (defined(__aarch64__) || defined(__x86_64__) || defined(__i386__))
+#define NDCRASH_CFI_SUPPORTED
+#endif
+
+/// ARM EHABI unwinder uses .ARM.exidx tables which exist only on 32-bit arm.
+#if defined(ENABLE_EHABI) && defined(__arm__)
+#define NDCRASH_EHABI_SUPPORTED
+#endif
+
+#ifdef ENABLE_INPROCESS
+
+/// Registry of unwinders supported in in-process mode.
+static const struct ndcrash_in_unwinder_info ndcrash_in_unwinders[] = {
+#ifdef ENABLE_LIBCORKSCREW
+        {
+                ndcrash_unwinder_libcorkscrew,
+                "libcorkscrew",
+                &ndcrash_in_init_libcorkscrew,
+                &ndcrash_in_deinit_libcorkscrew,
+                &ndcrash_in_unwind_libcorkscrew,
+                true,
+        },
+#endif
+#ifdef ENABLE_LIBUNWIND
+        {
+                ndcrash_unwinder_libunwind,
+                "libunwind",
+                &ndcrash_in_init_libunwind,
+                &ndcrash_in_deinit_libunwind,
+                &ndcrash_in_unwind_libunwind,
+                true,
+        },
+#endif
+#ifdef ENABLE_LIBUNWINDSTACK
+        {
+                ndcrash_unwinder_libunwindstack,
+                "libunwindstack",
+                &ndcrash_in_init_libunwindstack,
+                &ndcrash_in_deinit_libunwindstack,
+                &ndcrash_in_unwind_libunwindstack,
+                true,
+        },
+#endif
+#ifdef ENABLE_CXXABI
+        {
+                ndcrash_unwinder_cxxabi,
+                "cxxabi",
+                NULL,
+                NULL,
+                &ndcrash_in_unwind_cxxabi,
+                false,
+        },
+#endif
+#ifdef ENABLE_STACKSCAN
+        {
+                ndcrash_unwinder_stackscan,
+                "stackscan",
+                NULL,
+                NULL,
+                &ndcrash_in_unwind_stackscan,
+                true,
+        },
+#endif
+#ifdef NDCRASH_FRAMEPOINTER_SUPPORTED
+        {
+                ndcrash_unwinder_framepointer,
+                "framepointer",
+                NULL,
+                NULL,
+                &ndcrash_in_unwind_framepointer,
+                true,
+        },
+#endif
+#ifdef NDCRASH_CFI_SUPPORTED
+        {
+                ndcrash_unwinder_cfi,
+                "cfi",
+                NULL,
+                NULL,
+                &ndcrash_in_unwind_cfi,
+                true,
+        },
+#endif
+#ifdef NDCRASH_EHABI_SUPPORTED
+        {
+                ndcrash_unwinder_ehabi,
+                "ehabi",
+                NULL,
+                NULL,
+                &ndcrash_in_unwind_ehabi,
+                true,
+        },
+#endif
+        // Terminating element, also makes an array non-empty when no unwinder is enabled.
+        { (enum ndcrash_unwinder) -1, NULL, NULL, NULL, NULL, false },
+};
+
+const struct ndcrash_in_unwinder_info *ndcrash_in_find_unwinder(enum ndcrash_unwinder unwinder) {
+    for (const struct ndcrash_in_unwinder_info *it = ndcrash_in_unwinders; it->unwind; ++it) {
+        if (it->unwinder == unwinder) return it;
+    }
+    return NULL;
+}
+
+#endif //ENABLE_INPROCESS
+
+#ifdef ENABLE_OUTOFPROCESS
+
+/// Registry of unwinders supported in out-of-process mode.
+static const struct ndcrash_out_unwinder_info ndcrash_out_unwinders[] = {
+#ifdef ENABLE_LIBCORKSCREW
+        {
+                ndcrash_unwinder_libcorkscrew,
+                "libcorkscrew",
+                &ndcrash_out_init_libcorkscrew,
+                &ndcrash_out_deinit_libcorkscrew,
+                &ndcrash_out_unwind_libcorkscrew,
+        },
+#endif
+#ifdef ENABLE_LIBUNWIND
+        {
+                ndcrash_unwinder_libunwind,
+                "libunwind",
+                &ndcrash_out_init_libunwind,
+                &ndcrash_out_deinit_libunwind,
+                &ndcrash_out_unwind_libunwind,
+        },
+#endif
+#ifdef ENABLE_LIBUNWINDSTACK
+        {
+                ndcrash_unwinder_libunwindstack,
+                "libunwindstack",
+                &ndcrash_out_init_libunwindstack,
+                &ndcrash_out_deinit_libunwindstack,
+                &ndcrash_out_unwind_libunwindstack,
+        },
+#endif
+#ifdef ENABLE_STACKSCAN
+        {
+                ndcrash_unwinder_stackscan,
+                "stackscan",
+                &ndcrash_out_init_stackscan,
+                &ndcrash_out_deinit_stackscan,
+                &ndcrash_out_unwind_stackscan,
+        },
+#endif
+#ifdef NDCRASH_FRAMEPOINTER_SUPPORTED
+        {
+                ndcrash_unwinder_framepointer,
+                "framepointer",
+                &ndcrash_out_init_framepointer,
+                &ndcrash_out_deinit_framepointer,
+                &ndcrash_out_unwind_framepointer,
+        },
+#endif
+#ifdef NDCRASH_EHABI_SUPPORTED
+        {
+                ndcrash_unwinder_ehabi,
+                "ehabi",
+                &ndcrash_out_init_ehabi,
+                &ndcrash_out_deinit_ehabi,
+                &ndcrash_out_unwind_ehabi,
+        },
+#endif
+        // Terminating element, also makes an array non-empty when no unwinder is enabled.
+        { (enum ndcrash_unwinder) -1, NULL, NULL, NULL, NULL },
+};
+
+const struct ndcrash_out_unwinder_info *ndcrash_out_find_unwinder(enum ndcrash_unwinder unwinder) {
+    for (const struct ndcrash_out_unwinder_info *it = ndcrash_out_unwinders; it->unwind; ++it) {
+        if (it->unwinder == unwinder) return it;
+    }
+    return NULL;
+}
+
+#endif //ENABLE_OUTOFPROCESS
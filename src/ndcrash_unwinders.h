@@ -1,34 +1,119 @@
 #ifndef NDCRASH_UNWINDERS_H
 #define NDCRASH_UNWINDERS_H
+#include "ndcrash.h"
 #include "ndcrash_private.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct ucontext;
+struct ndcrash_frames;
 
 // See ndcrash_in_unwind_func_ptr for arguments description.
-void ndcrash_in_unwind_libcorkscrew(int outfile, struct ucontext *context);
-void ndcrash_in_unwind_libunwind(int outfile, struct ucontext *context);
-void ndcrash_in_unwind_libunwindstack(int outfile, struct ucontext *context);
-void ndcrash_in_unwind_cxxabi(int outfile, struct ucontext *context);
-void ndcrash_in_unwind_stackscan(int outfile, struct ucontext *context);
+void ndcrash_in_unwind_libcorkscrew(struct ndcrash_frames *frames, struct ucontext *context);
+void ndcrash_in_unwind_libunwind(struct ndcrash_frames *frames, struct ucontext *context);
+void ndcrash_in_unwind_libunwindstack(struct ndcrash_frames *frames, struct ucontext *context);
+void ndcrash_in_unwind_cxxabi(struct ndcrash_frames *frames, struct ucontext *context);
+void ndcrash_in_unwind_stackscan(struct ndcrash_frames *frames, struct ucontext *context);
+void ndcrash_in_unwind_framepointer(struct ndcrash_frames *frames, struct ucontext *context);
+void ndcrash_in_unwind_cfi(struct ndcrash_frames *frames, struct ucontext *context);
+void ndcrash_in_unwind_ehabi(struct ndcrash_frames *frames, struct ucontext *context);
+
+// In-process unwinder initialization functions. See ndcrash_in_unwinder_init_func_ptr typedef.
+void ndcrash_in_init_libcorkscrew();
+void ndcrash_in_init_libunwind();
+void ndcrash_in_init_libunwindstack();
+
+// In-process unwinder de-initialization functions. See ndcrash_in_unwinder_deinit_func_ptr typedef.
+void ndcrash_in_deinit_libcorkscrew();
+void ndcrash_in_deinit_libunwind();
+void ndcrash_in_deinit_libunwindstack();
 
 // Unwinder initialization functions. See ndcrash_out_unwinder_init_func_ptr typedef.
 void * ndcrash_out_init_libcorkscrew(pid_t pid);
 void * ndcrash_out_init_libunwind(pid_t pid);
 void * ndcrash_out_init_libunwindstack(pid_t pid);
+void * ndcrash_out_init_stackscan(pid_t pid);
+void * ndcrash_out_init_framepointer(pid_t pid);
+void * ndcrash_out_init_ehabi(pid_t pid);
 
 // Unwinder de-initialization functions. See ndcrash_out_unwinder_deinit_func_ptr typedef.
 void ndcrash_out_deinit_libcorkscrew(void *data);
 void ndcrash_out_deinit_libunwind(void *data);
 void ndcrash_out_deinit_libunwindstack(void *data);
+void ndcrash_out_deinit_stackscan(void *data);
+void ndcrash_out_deinit_framepointer(void *data);
+void ndcrash_out_deinit_ehabi(void *data);
 
 // See ndcrash_out_unwind_func_ptr for arguments description.
-void ndcrash_out_unwind_libcorkscrew(int outfile, pid_t tid, struct ucontext *context, void *data);
-void ndcrash_out_unwind_libunwind(int outfile, pid_t tid, struct ucontext *context, void *data);
-void ndcrash_out_unwind_libunwindstack(int outfile, pid_t tid, struct ucontext *context, void *data);
+void ndcrash_out_unwind_libcorkscrew(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data);
+void ndcrash_out_unwind_libunwind(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data);
+void ndcrash_out_unwind_libunwindstack(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data);
+void ndcrash_out_unwind_stackscan(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data);
+void ndcrash_out_unwind_framepointer(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data);
+void ndcrash_out_unwind_ehabi(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data);
+
+/**
+ * Description of an unwinder for in-process mode, an element of unwinders registry.
+ */
+struct ndcrash_in_unwinder_info {
+
+    /// Unwinder identifier.
+    enum ndcrash_unwinder unwinder;
+
+    /// Unwinder name that is written to a report.
+    const char *name;
+
+    /// Pointer to unwinder initialization function. NULL if an unwinder doesn't need it.
+    ndcrash_in_unwinder_init_func_ptr init;
+
+    /// Pointer to unwinder de-initialization function. NULL if an unwinder doesn't need it.
+    ndcrash_in_unwinder_deinit_func_ptr deinit;
+
+    /// Pointer to unwinding function.
+    ndcrash_in_unwind_func_ptr unwind;
+
+    /// Flag whether unwinding function is able to unwind a thread other than a current one by its
+    /// context. Used for all threads unwinding.
+    bool unwind_other_threads;
+};
+
+/**
+ * Description of an unwinder for out-of-process mode, an element of unwinders registry.
+ */
+struct ndcrash_out_unwinder_info {
+
+    /// Unwinder identifier.
+    enum ndcrash_unwinder unwinder;
+
+    /// Unwinder name that is written to a report.
+    const char *name;
+
+    /// Pointer to unwinder initialization function.
+    ndcrash_out_unwinder_init_func_ptr init;
+
+    /// Pointer to unwinder de-initialization function.
+    ndcrash_out_unwinder_deinit_func_ptr deinit;
+
+    /// Pointer to unwinding function.
+    ndcrash_out_unwind_func_ptr unwind;
+};
+
+/**
+ * Finds an unwinder for in-process mode in a registry of unwinders enabled at build time.
+ * @param unwinder Unwinder identifier.
+ * @return Unwinder description or NULL if it isn't supported.
+ */
+const struct ndcrash_in_unwinder_info *ndcrash_in_find_unwinder(enum ndcrash_unwinder unwinder);
+
+/**
+ * Finds an unwinder for out-of-process mode in a registry of unwinders enabled at build time.
+ * @param unwinder Unwinder identifier.
+ * @return Unwinder description or NULL if it isn't supported.
+ */
+const struct ndcrash_out_unwinder_info *ndcrash_out_find_unwinder(enum ndcrash_unwinder unwinder);
 
 #ifdef __cplusplus
 }
@@ -1,9 +1,13 @@
 #include "ndcrash_utils.h"
+#include "ndcrash_format.h"
 #include <string.h>
 #include <sys/socket.h>
 #include <dirent.h>
-#include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 void ndcrash_out_fill_sockaddr(const char *socket_name, struct sockaddr_un *out_addr) {
     size_t socket_name_length = strlen(socket_name);
@@ -18,11 +22,21 @@ void ndcrash_out_fill_sockaddr(const char *socket_name, struct sockaddr_un *out_
     memcpy(out_addr->sun_path + 1, socket_name, socket_name_length);
 }
 
+bool ndcrash_is_system_module(const char *name) {
+    return strstr(name, "/system/") ||
+           strstr(name, "libc.so") ||
+           strstr(name, "libart.so") ||
+           strstr(name, "libdvm.so") ||
+           strstr(name, "libcutils.so") ||
+           strstr(name, "libandroid_runtime.so") ||
+           strstr(name, "libbcc.so");
+}
+
 size_t ndcrash_get_threads(pid_t pid, pid_t *out, size_t size) {
 
     // Should have sufficient space to save "/proc/2147483647/task" including \0.
     char path[22];
-    snprintf(path, sizeof(path), "/proc/%d/task", (int) pid);
+    ndcrash_format(path, sizeof(path), "/proc/%d/task", (int) pid);
 
     // Opening a directory for iteration.
     DIR *dir = opendir(path);
@@ -42,4 +56,27 @@ size_t ndcrash_get_threads(pid_t pid, pid_t *out, size_t size) {
     closedir(dir);
 
     return it - out;
-}
\ No newline at end of file
+}
+
+void ndcrash_futex_wait(int *futex, int value, int timeout_ms) {
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+    syscall(__NR_futex, futex, FUTEX_WAIT, value, timeout_ms >= 0 ? &timeout : NULL, NULL, 0);
+}
+
+void ndcrash_futex_wake(int *futex) {
+    syscall(__NR_futex, futex, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+int64_t ndcrash_time_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+int64_t ndcrash_time_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <linux/un.h>
 #include <sys/types.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,6 +16,14 @@ extern "C" {
  */
 void ndcrash_out_fill_sockaddr(const char *socket_name, struct sockaddr_un *out_addr);
 
+/**
+ * Check whether a specified module file name belongs to Android system: system libraries, runtime,
+ * compiled framework code etc.
+ * @param name Full path to a module file.
+ * @return Flag value.
+ */
+bool ndcrash_is_system_module(const char *name);
+
 /**
  * Gets all identifiers of threads of passed process excluding main thread.
  *
@@ -25,6 +34,33 @@ void ndcrash_out_fill_sockaddr(const char *socket_name, struct sockaddr_un *out_
  */
 size_t ndcrash_get_threads(pid_t pid, pid_t *out, size_t size);
 
+/**
+ * Waits on a futex while its value is equal to a specified one. May return earlier, for example,
+ * if a signal is received. Signal safe.
+ * @param futex Pointer to a futex value.
+ * @param value Expected futex value.
+ * @param timeout_ms Waiting timeout in milliseconds, negative value means infinite waiting.
+ */
+void ndcrash_futex_wait(int *futex, int value, int timeout_ms);
+
+/**
+ * Wakes all threads waiting on a futex. Signal safe.
+ * @param futex Pointer to a futex value.
+ */
+void ndcrash_futex_wake(int *futex);
+
+/**
+ * Gets a value of monotonic clock in milliseconds. Signal safe.
+ * @return Clock value.
+ */
+int64_t ndcrash_time_ms();
+
+/**
+ * Gets a value of monotonic clock in microseconds. Signal safe.
+ * @return Clock value.
+ */
+int64_t ndcrash_time_us();
+
 #ifdef __cplusplus
 }
 #endif
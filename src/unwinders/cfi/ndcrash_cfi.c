@@ -0,0 +1,759 @@
+#include "ndcrash_unwinders.h"
+#include "ndcrash_frames.h"
+#include "ndcrash_private.h"
+#include "ndcrash_altstack.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_ucontext.h"
+#include "ndcrash_dwarf.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(ENABLE_INPROCESS) && (defined(__aarch64__) || defined(__x86_64__) || defined(__i386__))
+
+/*
+ * DWARF call frame information unwinder. An FDE of a function is found by binary search in
+ * .eh_frame_hdr table of a module located on modules refresh, then CIE and FDE instructions are
+ * interpreted up to a program counter value. Register state has a fixed size, all memory reads
+ * are checked against stack bounds, no memory is allocated, so it's signal safe. DWARF expressions
+ * aren't supported, unwinding stops on a frame that requires them.
+ */
+
+#if defined(__aarch64__)
+/// Count of tracked DWARF registers: x0-x30 and sp.
+#define NDCRASH_CFI_REGS_COUNT 32
+/// DWARF number of a stack pointer register.
+#define NDCRASH_CFI_REG_SP 31
+/// DWARF number of a return address column.
+#define NDCRASH_CFI_REG_RA 30
+#elif defined(__x86_64__)
+/// Count of tracked DWARF registers: rax, rdx, rcx, rbx, rsi, rdi, rbp, rsp, r8-r15 and rip.
+#define NDCRASH_CFI_REGS_COUNT 17
+#define NDCRASH_CFI_REG_SP 7
+#define NDCRASH_CFI_REG_RA 16
+#elif defined(__i386__)
+/// Count of tracked DWARF registers: eax, ecx, edx, ebx, esp, ebp, esi, edi and eip.
+#define NDCRASH_CFI_REGS_COUNT 9
+#define NDCRASH_CFI_REG_SP 4
+#define NDCRASH_CFI_REG_RA 8
+#endif
+
+/// Maximum depth of DW_CFA_remember_state.
+#define NDCRASH_CFI_STATE_STACK_SIZE 8
+
+/**
+ * Rule of register recovery for a caller frame.
+ */
+enum ndcrash_cfi_rule_type {
+
+    /// Register isn't changed by a callee.
+    ndcrash_cfi_rule_same = 0,
+
+    /// Register value can't be recovered.
+    ndcrash_cfi_rule_undefined,
+
+    /// Register is saved at CFA + value.
+    ndcrash_cfi_rule_offset,
+
+    /// Register value is CFA + value.
+    ndcrash_cfi_rule_val_offset,
+
+    /// Register value is saved in a register with value number.
+    ndcrash_cfi_rule_register,
+};
+
+/**
+ * Register recovery rule.
+ */
+struct ndcrash_cfi_rule {
+
+    /// Rule type, a value of ndcrash_cfi_rule_type.
+    uint8_t type;
+
+    /// Rule argument, its meaning depends on type.
+    intptr_t value;
+};
+
+/**
+ * A row of call frame information table: how to calculate CFA and recover registers.
+ */
+struct ndcrash_cfi_row {
+
+    /// CFA is a value of this register plus cfa_offset.
+    uint32_t cfa_register;
+
+    /// Offset of CFA from cfa_register value.
+    intptr_t cfa_offset;
+
+    /// Rules of all tracked registers.
+    struct ndcrash_cfi_rule rules[NDCRASH_CFI_REGS_COUNT];
+};
+
+/**
+ * Parsed common information entry.
+ */
+struct ndcrash_cfi_cie {
+
+    /// Code alignment factor, multiplier of advance_loc operands.
+    uintptr_t code_align;
+
+    /// Data alignment factor, multiplier of offset operands.
+    intptr_t data_align;
+
+    /// Number of a return address column.
+    uint32_t ra_register;
+
+    /// Encoding of pointers in FDE.
+    uint8_t fde_encoding;
+
+    /// Flag whether FDE has augmentation data.
+    bool has_augmentation_data;
+
+    /// Flag whether FDE describes a signal trampoline, its caller's pc isn't a return address.
+    bool signal_frame;
+
+    /// Initial instructions.
+    const uint8_t *instructions;
+
+    /// End of initial instructions.
+    const uint8_t *end;
+};
+
+/**
+ * Interpreter state of call frame instructions.
+ */
+struct ndcrash_cfi_state {
+
+    /// Current row.
+    struct ndcrash_cfi_row row;
+
+    /// Row after CIE initial instructions, used by DW_CFA_restore.
+    struct ndcrash_cfi_row initial;
+
+    /// Stack of rows for DW_CFA_remember_state and DW_CFA_restore_state.
+    struct ndcrash_cfi_row stack[NDCRASH_CFI_STATE_STACK_SIZE];
+
+    /// Count of rows in stack.
+    size_t stack_size;
+};
+
+/**
+ * Registers of a frame being unwound.
+ */
+struct ndcrash_cfi_regs {
+
+    /// Values of DWARF registers.
+    uintptr_t values[NDCRASH_CFI_REGS_COUNT];
+
+    /// Program counter value.
+    uintptr_t pc;
+};
+
+/**
+ * Reads unsigned LEB128 value.
+ * @param p Pointer to a current position, advanced after reading.
+ * @param end End of readable data.
+ * @param result Where to write a value.
+ * @return Flag whether a value is read.
+ */
+static bool ndcrash_cfi_read_uleb(const uint8_t **p, const uint8_t *end, uintptr_t *result) {
+    uintptr_t value = 0;
+    unsigned shift = 0;
+    while (*p < end) {
+        const uint8_t byte = *(*p)++;
+        if (shift < sizeof(uintptr_t) * 8) {
+            value |= (uintptr_t) (byte & 0x7f) << shift;
+        }
+        shift += 7;
+        if (!(byte & 0x80)) {
+            *result = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads signed LEB128 value. See ndcrash_cfi_read_uleb for arguments description.
+ */
+static bool ndcrash_cfi_read_sleb(const uint8_t **p, const uint8_t *end, intptr_t *result) {
+    uintptr_t value = 0;
+    unsigned shift = 0;
+    while (*p < end) {
+        const uint8_t byte = *(*p)++;
+        if (shift < sizeof(uintptr_t) * 8) {
+            value |= (uintptr_t) (byte & 0x7f) << shift;
+        }
+        shift += 7;
+        if (!(byte & 0x80)) {
+            if (shift < sizeof(uintptr_t) * 8 && (byte & 0x40)) {
+                value |= ~(uintptr_t) 0 << shift;
+            }
+            *result = (intptr_t) value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads fixed-size value of unaligned data.
+ * @param p Pointer to a current position, advanced after reading.
+ * @param end End of readable data.
+ * @param result Where to copy a value.
+ * @param size Size of a value.
+ * @return Flag whether a value is read.
+ */
+static bool ndcrash_cfi_read_fixed(const uint8_t **p, const uint8_t *end, void *result, size_t size) {
+    if ((size_t) (end - *p) < size) return false;
+    memcpy(result, *p, size);
+    *p += size;
+    return true;
+}
+
+/**
+ * Reads a pointer encoded by DW_EH_PE_* encoding. Indirect values aren't dereferenced, they are
+ * used only for a personality routine which isn't needed for unwinding.
+ * @param p Pointer to a current position, advanced after reading.
+ * @param end End of readable data.
+ * @param encoding Encoding of a value.
+ * @param result Where to write a value.
+ * @return Flag whether a value is read.
+ */
+static bool ndcrash_cfi_read_encoded(const uint8_t **p, const uint8_t *end, uint8_t encoding, uintptr_t *result) {
+    const uintptr_t position = (uintptr_t) *p;
+    uintptr_t value;
+    switch (encoding & 0x0f) {
+        case DW_EH_PE_absptr:
+            if (!ndcrash_cfi_read_fixed(p, end, &value, sizeof(value))) return false;
+            break;
+        case DW_EH_PE_uleb128:
+            if (!ndcrash_cfi_read_uleb(p, end, &value)) return false;
+            break;
+        case DW_EH_PE_sleb128: {
+            intptr_t signed_value;
+            if (!ndcrash_cfi_read_sleb(p, end, &signed_value)) return false;
+            value = (uintptr_t) signed_value;
+            break;
+        }
+        case DW_EH_PE_udata2: {
+            uint16_t v;
+            if (!ndcrash_cfi_read_fixed(p, end, &v, sizeof(v))) return false;
+            value = v;
+            break;
+        }
+        case DW_EH_PE_sdata2: {
+            int16_t v;
+            if (!ndcrash_cfi_read_fixed(p, end, &v, sizeof(v))) return false;
+            value = (uintptr_t) (intptr_t) v;
+            break;
+        }
+        case DW_EH_PE_udata4: {
+            uint32_t v;
+            if (!ndcrash_cfi_read_fixed(p, end, &v, sizeof(v))) return false;
+            value = v;
+            break;
+        }
+        case DW_EH_PE_sdata4: {
+            int32_t v;
+            if (!ndcrash_cfi_read_fixed(p, end, &v, sizeof(v))) return false;
+            value = (uintptr_t) (intptr_t) v;
+            break;
+        }
+        case DW_EH_PE_udata8:
+        case DW_EH_PE_sdata8: {
+            uint64_t v;
+            if (!ndcrash_cfi_read_fixed(p, end, &v, sizeof(v))) return false;
+            value = (uintptr_t) v;
+            break;
+        }
+        default:
+            return false;
+    }
+    switch (encoding & 0x70) {
+        case DW_EH_PE_absptr:
+            break;
+        case DW_EH_PE_pcrel:
+            value += position;
+            break;
+        default:
+            // Other applications aren't used in .eh_frame of Android modules.
+            return false;
+    }
+    *result = value;
+    return true;
+}
+
+/**
+ * Reads a length of CIE or FDE and checks that an entry is within a module.
+ * @param p Pointer to an entry start, set to a position after a length.
+ * @param module_end End of a module memory.
+ * @param end Where to write an end of an entry.
+ * @return Flag whether an entry is valid.
+ */
+static bool ndcrash_cfi_read_length(const uint8_t **p, uintptr_t module_end, const uint8_t **end) {
+    if ((uintptr_t) *p + sizeof(uint32_t) > module_end) return false;
+    uint32_t length;
+    memcpy(&length, *p, sizeof(length));
+    *p += sizeof(length);
+    // 64-bit DWARF format isn't produced for .eh_frame, zero length is a terminator.
+    if (!length || length == UINT32_MAX || length > module_end - (uintptr_t) *p) return false;
+    *end = *p + length;
+    return true;
+}
+
+/**
+ * Parses a common information entry.
+ * @param p CIE start.
+ * @param module_end End of a module memory.
+ * @param cie Where to write parsed values.
+ * @return Flag whether parsing is successful.
+ */
+static bool ndcrash_cfi_parse_cie(const uint8_t *p, uintptr_t module_end, struct ndcrash_cfi_cie *cie) {
+    const uint8_t *end;
+    if (!ndcrash_cfi_read_length(&p, module_end, &end)) return false;
+    uint32_t id;
+    if (!ndcrash_cfi_read_fixed(&p, end, &id, sizeof(id)) || id) return false;
+    if (p >= end) return false;
+    const uint8_t version = *p++;
+    if (version != 1 && version != 3 && version != 4) return false;
+    const char * const augmentation = (const char *) p;
+    while (p < end && *p) ++p;
+    if (p++ >= end) return false;
+    if (version == 4) {
+        // Address size and segment selector size.
+        if (end - p < 2) return false;
+        p += 2;
+    }
+    intptr_t data_align;
+    if (!ndcrash_cfi_read_uleb(&p, end, &cie->code_align) ||
+        !ndcrash_cfi_read_sleb(&p, end, &data_align)) {
+        return false;
+    }
+    cie->data_align = data_align;
+    if (version == 1) {
+        if (p >= end) return false;
+        cie->ra_register = *p++;
+    } else {
+        uintptr_t ra_register;
+        if (!ndcrash_cfi_read_uleb(&p, end, &ra_register)) return false;
+        cie->ra_register = (uint32_t) ra_register;
+    }
+    if (cie->ra_register >= NDCRASH_CFI_REGS_COUNT) return false;
+    cie->fde_encoding = DW_EH_PE_absptr;
+    cie->has_augmentation_data = false;
+    cie->signal_frame = false;
+    if (augmentation[0] == 'z') {
+        uintptr_t length;
+        if (!ndcrash_cfi_read_uleb(&p, end, &length) || length > (uintptr_t) (end - p)) return false;
+        const uint8_t * const data_end = p + length;
+        cie->has_augmentation_data = true;
+        for (const char *c = augmentation + 1; *c; ++c) {
+            switch (*c) {
+                case 'R':
+                    if (p >= data_end) return false;
+                    cie->fde_encoding = *p++;
+                    break;
+                case 'L':
+                    if (p >= data_end) return false;
+                    ++p;
+                    break;
+                case 'P': {
+                    if (p >= data_end) return false;
+                    const uint8_t encoding = *p++;
+                    uintptr_t personality;
+                    if (!ndcrash_cfi_read_encoded(&p, data_end, encoding, &personality)) return false;
+                    break;
+                }
+                case 'S':
+                    cie->signal_frame = true;
+                    break;
+                default:
+                    // Unknown augmentations (for example 'B' or 'G') don't have data or their data
+                    // is skipped by augmentation length.
+                    break;
+            }
+        }
+        p = data_end;
+    } else if (augmentation[0]) {
+        return false;
+    }
+    cie->instructions = p;
+    cie->end = end;
+    return true;
+}
+
+/**
+ * Looks for an FDE of a function containing a specified address.
+ * @param module Module containing an address.
+ * @param pc Address to look for.
+ * @param cie Where to write parsed CIE.
+ * @param instructions Where to write a start of FDE instructions.
+ * @param end Where to write an end of FDE instructions.
+ * @param start Where to write a start address of a function.
+ * @return Flag whether FDE is found.
+ */
+static bool ndcrash_cfi_find_fde(
+        const struct ndcrash_module *module,
+        uintptr_t pc,
+        struct ndcrash_cfi_cie *cie,
+        const uint8_t **instructions,
+        const uint8_t **end,
+        uintptr_t *start) {
+    const int32_t * const table = module->eh_frame_table;
+    if (!table) return false;
+
+    // Binary search for the last entry with initial location not greater than pc.
+    size_t low = 0, high = module->eh_frame_table_count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (pc < module->eh_frame_hdr + (intptr_t) table[middle * 2]) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    if (!low) return false;
+    const uintptr_t fde = module->eh_frame_hdr + (intptr_t) table[(low - 1) * 2 + 1];
+    if (fde < module->start || fde >= module->end) return false;
+
+    const uint8_t *p = (const uint8_t *) fde;
+    const uint8_t *fde_end;
+    if (!ndcrash_cfi_read_length(&p, module->end, &fde_end)) return false;
+    uint32_t cie_offset;
+    const uintptr_t cie_pointer = (uintptr_t) p;
+    if (!ndcrash_cfi_read_fixed(&p, fde_end, &cie_offset, sizeof(cie_offset)) || !cie_offset) return false;
+    const uintptr_t cie_address = cie_pointer - cie_offset;
+    if (cie_offset > cie_pointer || cie_address < module->start) return false;
+    if (!ndcrash_cfi_parse_cie((const uint8_t *) cie_address, module->end, cie)) return false;
+
+    uintptr_t pc_begin, pc_range;
+    if (!ndcrash_cfi_read_encoded(&p, fde_end, cie->fde_encoding, &pc_begin) ||
+        !ndcrash_cfi_read_encoded(&p, fde_end, cie->fde_encoding & 0x0f, &pc_range)) {
+        return false;
+    }
+    if (pc < pc_begin || pc - pc_begin >= pc_range) return false;
+    if (cie->has_augmentation_data) {
+        uintptr_t length;
+        if (!ndcrash_cfi_read_uleb(&p, fde_end, &length) || length > (uintptr_t) (fde_end - p)) return false;
+        p += length;
+    }
+    *instructions = p;
+    *end = fde_end;
+    *start = pc_begin;
+    return true;
+}
+
+/**
+ * Sets a register rule. Rules of untracked registers, for example floating point ones, are ignored.
+ */
+static inline void ndcrash_cfi_set_rule(struct ndcrash_cfi_row *row, uintptr_t reg, uint8_t type, intptr_t value) {
+    if (reg >= NDCRASH_CFI_REGS_COUNT) return;
+    row->rules[reg].type = type;
+    row->rules[reg].value = value;
+}
+
+/**
+ * Executes call frame instructions until a location exceeds a specified pc.
+ * @param state Interpreter state.
+ * @param cie Parsed CIE, alignment factors are taken from it.
+ * @param p Instructions start.
+ * @param end Instructions end.
+ * @param location Initial location: a function start address.
+ * @param pc Address for which a row is calculated.
+ * @return Flag whether instructions are executed successfully.
+ */
+static bool ndcrash_cfi_execute(
+        struct ndcrash_cfi_state *state,
+        const struct ndcrash_cfi_cie *cie,
+        const uint8_t *p,
+        const uint8_t *end,
+        uintptr_t location,
+        uintptr_t pc) {
+    struct ndcrash_cfi_row * const row = &state->row;
+    while (p < end) {
+        const uint8_t opcode = *p++;
+        const uint8_t operand = opcode & 0x3f;
+        uintptr_t reg, offset, delta;
+        intptr_t soffset;
+        switch (opcode & 0xc0) {
+            case DW_CFA_advance_loc:
+                location += operand * cie->code_align;
+                if (location > pc) return true;
+                continue;
+            case DW_CFA_offset:
+                if (!ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                ndcrash_cfi_set_rule(row, operand, ndcrash_cfi_rule_offset, (intptr_t) offset * cie->data_align);
+                continue;
+            case DW_CFA_restore:
+                if (operand < NDCRASH_CFI_REGS_COUNT) {
+                    row->rules[operand] = state->initial.rules[operand];
+                }
+                continue;
+            default:
+                break;
+        }
+        switch (opcode) {
+            case DW_CFA_nop:
+            case DW_CFA_AARCH64_negate_ra_state:
+                // Return addresses are always stripped of pointer authentication codes.
+                break;
+            case DW_CFA_set_loc:
+                if (!ndcrash_cfi_read_encoded(&p, end, cie->fde_encoding, &location)) return false;
+                if (location > pc) return true;
+                break;
+            case DW_CFA_advance_loc1:
+            case DW_CFA_advance_loc2:
+            case DW_CFA_advance_loc4: {
+                const uint8_t format = opcode == DW_CFA_advance_loc1 ? 0 :
+                                       opcode == DW_CFA_advance_loc2 ? DW_EH_PE_udata2 : DW_EH_PE_udata4;
+                if (format) {
+                    if (!ndcrash_cfi_read_encoded(&p, end, format, &delta)) return false;
+                } else {
+                    if (p >= end) return false;
+                    delta = *p++;
+                }
+                location += delta * cie->code_align;
+                if (location > pc) return true;
+                break;
+            }
+            case DW_CFA_offset_extended:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_offset, (intptr_t) offset * cie->data_align);
+                break;
+            case DW_CFA_offset_extended_sf:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_sleb(&p, end, &soffset)) return false;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_offset, soffset * cie->data_align);
+                break;
+            case DW_CFA_GNU_negative_offset_extended:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_offset, -(intptr_t) offset * cie->data_align);
+                break;
+            case DW_CFA_val_offset:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_val_offset, (intptr_t) offset * cie->data_align);
+                break;
+            case DW_CFA_val_offset_sf:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_sleb(&p, end, &soffset)) return false;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_val_offset, soffset * cie->data_align);
+                break;
+            case DW_CFA_restore_extended:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg)) return false;
+                if (reg < NDCRASH_CFI_REGS_COUNT) {
+                    row->rules[reg] = state->initial.rules[reg];
+                }
+                break;
+            case DW_CFA_undefined:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg)) return false;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_undefined, 0);
+                break;
+            case DW_CFA_same_value:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg)) return false;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_same, 0);
+                break;
+            case DW_CFA_register:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                if (offset < NDCRASH_CFI_REGS_COUNT) {
+                    ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_register, (intptr_t) offset);
+                } else {
+                    ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_undefined, 0);
+                }
+                break;
+            case DW_CFA_remember_state:
+                if (state->stack_size >= NDCRASH_CFI_STATE_STACK_SIZE) return false;
+                state->stack[state->stack_size++] = *row;
+                break;
+            case DW_CFA_restore_state:
+                if (!state->stack_size) return false;
+                *row = state->stack[--state->stack_size];
+                break;
+            case DW_CFA_def_cfa:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                if (reg >= NDCRASH_CFI_REGS_COUNT) return false;
+                row->cfa_register = (uint32_t) reg;
+                row->cfa_offset = (intptr_t) offset;
+                break;
+            case DW_CFA_def_cfa_sf:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_sleb(&p, end, &soffset)) return false;
+                if (reg >= NDCRASH_CFI_REGS_COUNT) return false;
+                row->cfa_register = (uint32_t) reg;
+                row->cfa_offset = soffset * cie->data_align;
+                break;
+            case DW_CFA_def_cfa_register:
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || reg >= NDCRASH_CFI_REGS_COUNT) return false;
+                row->cfa_register = (uint32_t) reg;
+                break;
+            case DW_CFA_def_cfa_offset:
+                if (!ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                row->cfa_offset = (intptr_t) offset;
+                break;
+            case DW_CFA_def_cfa_offset_sf:
+                if (!ndcrash_cfi_read_sleb(&p, end, &soffset)) return false;
+                row->cfa_offset = soffset * cie->data_align;
+                break;
+            case DW_CFA_GNU_args_size:
+                if (!ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                break;
+            case DW_CFA_expression:
+            case DW_CFA_val_expression:
+                // A register becomes unknown, unwinding stops only if it's needed.
+                if (!ndcrash_cfi_read_uleb(&p, end, &reg) || !ndcrash_cfi_read_uleb(&p, end, &offset)) return false;
+                if (offset > (uintptr_t) (end - p)) return false;
+                p += offset;
+                ndcrash_cfi_set_rule(row, reg, ndcrash_cfi_rule_undefined, 0);
+                break;
+            default:
+                // Including DW_CFA_def_cfa_expression.
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Bounds of a stack where saved registers are read from.
+ */
+struct ndcrash_cfi_stack {
+
+    /// Stack pointer value of a crashed frame, inclusive.
+    uintptr_t start;
+
+    /// End of a stack mapping, exclusive.
+    uintptr_t end;
+};
+
+/**
+ * Unwinds a single frame: calculates CFA and recovers registers of a caller.
+ * @param regs Registers of a current frame, replaced by caller registers.
+ * @param stack Stack bounds, saved registers are read only within them.
+ * @param lookup_pc Address used to find FDE and a row: pc or pc - 1 for return addresses.
+ * @param signal_frame Where to write a flag whether a frame is a signal trampoline.
+ * @return Flag whether unwinding is successful.
+ */
+static bool ndcrash_cfi_step(
+        struct ndcrash_cfi_regs *regs,
+        const struct ndcrash_cfi_stack *stack,
+        uintptr_t lookup_pc,
+        bool *signal_frame) {
+    const struct ndcrash_module * const module = ndcrash_modules_find(lookup_pc);
+    if (!module) return false;
+    struct ndcrash_cfi_cie cie;
+    const uint8_t *instructions, *end;
+    uintptr_t start;
+    if (!ndcrash_cfi_find_fde(module, lookup_pc, &cie, &instructions, &end, &start)) return false;
+    *signal_frame = cie.signal_frame;
+
+    struct ndcrash_cfi_state state;
+    memset(&state.row, 0, sizeof(state.row));
+    state.stack_size = 0;
+    if (!ndcrash_cfi_execute(&state, &cie, cie.instructions, cie.end, start, UINTPTR_MAX)) return false;
+    state.initial = state.row;
+    if (!ndcrash_cfi_execute(&state, &cie, instructions, end, start, lookup_pc)) return false;
+
+    const struct ndcrash_cfi_row * const row = &state.row;
+    const uintptr_t cfa = regs->values[row->cfa_register] + row->cfa_offset;
+    if (cfa < stack->start || cfa > stack->end) return false;
+
+    struct ndcrash_cfi_regs caller;
+    for (size_t i = 0; i < NDCRASH_CFI_REGS_COUNT; ++i) {
+        const struct ndcrash_cfi_rule * const rule = &row->rules[i];
+        switch (rule->type) {
+            case ndcrash_cfi_rule_same:
+                caller.values[i] = regs->values[i];
+                break;
+            case ndcrash_cfi_rule_undefined:
+                caller.values[i] = 0;
+                break;
+            case ndcrash_cfi_rule_offset: {
+                const uintptr_t address = cfa + rule->value;
+                if (address < stack->start || address > stack->end - sizeof(uintptr_t)) return false;
+                caller.values[i] = *(const uintptr_t *) address;
+                break;
+            }
+            case ndcrash_cfi_rule_val_offset:
+                caller.values[i] = cfa + rule->value;
+                break;
+            case ndcrash_cfi_rule_register:
+                caller.values[i] = regs->values[rule->value];
+                break;
+        }
+    }
+
+    // A return address column is undefined for the outermost frame.
+    if (row->rules[cie.ra_register].type == ndcrash_cfi_rule_undefined) return false;
+    caller.pc = ndcrash_strip_pac(caller.values[cie.ra_register]);
+    caller.values[NDCRASH_CFI_REG_SP] = cfa;
+    if (!caller.pc) return false;
+
+    // A caller frame can't be below a callee one unless a callee is a signal trampoline. CFA may be
+    // equal to sp only for a leaf function, it's checked that unwinding doesn't stay in place.
+    const uintptr_t sp = regs->values[NDCRASH_CFI_REG_SP];
+    if (!cie.signal_frame && (cfa < sp || (cfa == sp && caller.pc == regs->pc))) return false;
+    *regs = caller;
+    return true;
+}
+
+/**
+ * Fills initial register values from a signal context.
+ */
+static void ndcrash_cfi_regs_from_ucontext(struct ndcrash_cfi_regs *regs, const struct ucontext *context) {
+#if defined(__aarch64__)
+    for (size_t i = 0; i < 31; ++i) {
+        regs->values[i] = context->uc_mcontext.regs[i];
+    }
+    regs->values[31] = context->uc_mcontext.sp;
+#elif defined(__x86_64__)
+    static const int gregs[NDCRASH_CFI_REGS_COUNT] = {
+            REG_RAX, REG_RDX, REG_RCX, REG_RBX, REG_RSI, REG_RDI, REG_RBP, REG_RSP,
+            REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15, REG_RIP,
+    };
+    for (size_t i = 0; i < NDCRASH_CFI_REGS_COUNT; ++i) {
+        regs->values[i] = context->uc_mcontext.gregs[gregs[i]];
+    }
+#elif defined(__i386__)
+    static const int gregs[NDCRASH_CFI_REGS_COUNT] = {
+            REG_EAX, REG_ECX, REG_EDX, REG_EBX, REG_ESP, REG_EBP, REG_ESI, REG_EDI, REG_EIP,
+    };
+    for (size_t i = 0; i < NDCRASH_CFI_REGS_COUNT; ++i) {
+        regs->values[i] = context->uc_mcontext.gregs[gregs[i]];
+    }
+#endif
+    regs->pc = ndcrash_pc_from_ucontext(context);
+}
+
+void ndcrash_in_unwind_cfi(struct ndcrash_frames *frames, struct ucontext *context) {
+    struct ndcrash_cfi_regs regs;
+    ndcrash_cfi_regs_from_ucontext(&regs, context);
+
+    struct ndcrash_cfi_stack stack;
+    stack.start = regs.values[NDCRASH_CFI_REG_SP];
+    stack.end = ndcrash_altstack_find_stack_end(stack.start);
+
+    ndcrash_modules_add_frame(frames, regs.pc, regs.pc);
+    bool signal_frame = false;
+    if (!ndcrash_cfi_step(&regs, &stack, regs.pc, &signal_frame)) {
+        // A crashed frame may have no FDE, for example after a call by invalid pointer. Its caller
+        // is found by a return address which isn't saved yet by a prologue.
+#if defined(__aarch64__)
+        regs.pc = ndcrash_strip_pac(regs.values[NDCRASH_CFI_REG_RA]);
+#else
+        const uintptr_t sp = regs.values[NDCRASH_CFI_REG_SP];
+        if (sp < stack.start || sp > stack.end - sizeof(uintptr_t)) return;
+        regs.pc = *(const uintptr_t *) sp;
+        regs.values[NDCRASH_CFI_REG_SP] = sp + sizeof(uintptr_t);
+#endif
+        signal_frame = false;
+        if (!ndcrash_modules_find(regs.pc)) return;
+    }
+
+    while (!ndcrash_frames_full(frames)) {
+        // A return address points after a call instruction which may be the last one of a
+        // function, so a previous byte is used to find FDE. Signal trampolines have exact pc.
+        ndcrash_modules_add_frame(frames, regs.pc, signal_frame ? regs.pc : regs.pc - 1);
+        const uintptr_t lookup_pc = signal_frame ? regs.pc : regs.pc - 1;
+        if (!ndcrash_cfi_step(&regs, &stack, lookup_pc, &signal_frame)) break;
+    }
+}
+
+#endif //defined(ENABLE_INPROCESS) && (defined(__aarch64__) || defined(__x86_64__) || defined(__i386__))
@@ -0,0 +1,642 @@
+#include "ndcrash_unwinders.h"
+#include "ndcrash_frames.h"
+#include "ndcrash_private.h"
+#include "ndcrash_altstack.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_ucontext.h"
+#include "ndcrash_log.h"
+#include "ndcrash_remote_memory.h"
+#include "ndcrash_remote_maps.h"
+#include <elf.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+
+#ifdef __arm__
+
+/*
+ * ARM exception handling ABI unwinder. An entry of a function is found by binary search in a
+ * sorted .ARM.exidx table, unwinding instructions of compact personality routines (inline or in
+ * .ARM.extab) are decoded to register updates. All memory is read through a callback, so the same
+ * code is used for a current process and for a crashed one.
+ */
+
+/// Value of the second word of .ARM.exidx entry for functions that can't be unwound.
+#define NDCRASH_EHABI_CANTUNWIND 1
+
+/// Maximum size of unwinding instructions of a single function: 3 bytes in the first word and
+/// up to 255 additional words.
+#define NDCRASH_EHABI_MAX_INSTRUCTIONS (3 + 255 * 4)
+
+/// Register numbers.
+#define NDCRASH_EHABI_SP 13
+#define NDCRASH_EHABI_LR 14
+#define NDCRASH_EHABI_PC 15
+
+/**
+ * Type of pointer to a function which reads a word of memory.
+ * @param address Address of a word.
+ * @param value Where to write a value.
+ * @param arg Auxiliary data.
+ * @return Flag whether a word is read.
+ */
+typedef bool (*ndcrash_ehabi_read_func_ptr)(uintptr_t address, uint32_t *value, void *arg);
+
+/**
+ * Registers of a frame being unwound.
+ */
+struct ndcrash_ehabi_regs {
+
+    /// Values of r0-r15.
+    uint32_t r[16];
+};
+
+/**
+ * Decodes a 31-bit place-relative offset.
+ * @param address Address of a word containing an offset.
+ * @param value Word value.
+ * @return Absolute address.
+ */
+static inline uintptr_t ndcrash_ehabi_prel31(uintptr_t address, uint32_t value) {
+    return address + (uintptr_t) ((int32_t) (value << 1) >> 1);
+}
+
+/**
+ * Looks for .ARM.exidx entry of a function containing an address.
+ * @param exidx Address of a table.
+ * @param count Count of entries.
+ * @param pc Address to look for, without thumb bit.
+ * @param read Memory reading function.
+ * @param arg Argument of memory reading function.
+ * @return Address of an entry or 0 if not found.
+ */
+static uintptr_t ndcrash_ehabi_find_entry(
+        uintptr_t exidx,
+        size_t count,
+        uintptr_t pc,
+        ndcrash_ehabi_read_func_ptr read,
+        void *arg) {
+    size_t low = 0, high = count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        const uintptr_t entry = exidx + middle * 8;
+        uint32_t word;
+        if (!read(entry, &word, arg)) return 0;
+        if (pc < ndcrash_ehabi_prel31(entry, word)) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low ? exidx + (low - 1) * 8 : 0;
+}
+
+/**
+ * Collects unwinding instructions of a function.
+ * @param entry Address of .ARM.exidx entry.
+ * @param read Memory reading function.
+ * @param arg Argument of memory reading function.
+ * @param out Buffer of NDCRASH_EHABI_MAX_INSTRUCTIONS bytes for instructions.
+ * @return Count of instruction bytes, 0 if a function can't be unwound or a personality routine
+ * isn't supported.
+ */
+static size_t ndcrash_ehabi_get_instructions(
+        uintptr_t entry,
+        ndcrash_ehabi_read_func_ptr read,
+        void *arg,
+        uint8_t *out) {
+    uint32_t word;
+    if (!read(entry + 4, &word, arg) || word == NDCRASH_EHABI_CANTUNWIND) return 0;
+
+    // Compact model inlined to an index table, only personality routine 0 may be there.
+    if (word & 0x80000000) {
+        if ((word >> 24) != 0x80) return 0;
+        out[0] = (uint8_t) (word >> 16);
+        out[1] = (uint8_t) (word >> 8);
+        out[2] = (uint8_t) word;
+        return 3;
+    }
+
+    // An entry of .ARM.extab section.
+    uintptr_t extab = ndcrash_ehabi_prel31(entry + 4, word);
+    if (!read(extab, &word, arg)) return 0;
+    size_t count = 0, words;
+    if (word & 0x80000000) {
+        switch ((word >> 24) & 0x0f) {
+            case 0:
+                // Personality routine 0: 3 instructions in the same word.
+                out[count++] = (uint8_t) (word >> 16);
+                words = 0;
+                break;
+            case 1:
+            case 2:
+                // Personality routines 1 and 2: count of additional words, then 2 instructions.
+                words = (word >> 16) & 0xff;
+                break;
+            default:
+                return 0;
+        }
+    } else {
+        // Generic personality routine, for example __gxx_personality_v0. Its data starts with
+        // instructions in the same format as for personality routine 1.
+        extab += 4;
+        if (!read(extab, &word, arg)) return 0;
+        words = word >> 24;
+        out[count++] = (uint8_t) (word >> 16);
+    }
+    out[count++] = (uint8_t) (word >> 8);
+    out[count++] = (uint8_t) word;
+    for (size_t i = 0; i < words; ++i) {
+        if (!read(extab + 4 + i * 4, &word, arg)) return 0;
+        out[count++] = (uint8_t) (word >> 24);
+        out[count++] = (uint8_t) (word >> 16);
+        out[count++] = (uint8_t) (word >> 8);
+        out[count++] = (uint8_t) word;
+    }
+    return count;
+}
+
+/**
+ * Pops registers from a virtual stack.
+ * @param regs Registers.
+ * @param vsp Virtual stack pointer, advanced after popping.
+ * @param mask Bit mask of registers to pop, bit 0 is r0.
+ * @param read Memory reading function.
+ * @param arg Argument of memory reading function.
+ * @return Flag whether all registers are read.
+ */
+static bool ndcrash_ehabi_pop(
+        struct ndcrash_ehabi_regs *regs,
+        uint32_t *vsp,
+        uint32_t mask,
+        ndcrash_ehabi_read_func_ptr read,
+        void *arg) {
+    // If sp is popped it's assigned after all other registers.
+    uint32_t sp = 0;
+    for (unsigned i = 0; i < 16; ++i) {
+        if (!(mask & (1u << i))) continue;
+        uint32_t value;
+        if (!read(*vsp, &value, arg)) return false;
+        *vsp += 4;
+        if (i == NDCRASH_EHABI_SP) {
+            sp = value;
+        } else {
+            regs->r[i] = value;
+        }
+    }
+    if (mask & (1u << NDCRASH_EHABI_SP)) {
+        *vsp = sp;
+    }
+    return true;
+}
+
+/**
+ * Executes unwinding instructions, updates registers to values of a caller frame.
+ * @param regs Registers.
+ * @param instructions Instruction bytes.
+ * @param count Count of instruction bytes.
+ * @param read Memory reading function.
+ * @param arg Argument of memory reading function.
+ * @return Flag whether execution is successful.
+ */
+static bool ndcrash_ehabi_execute(
+        struct ndcrash_ehabi_regs *regs,
+        const uint8_t *instructions,
+        size_t count,
+        ndcrash_ehabi_read_func_ptr read,
+        void *arg) {
+    uint32_t vsp = regs->r[NDCRASH_EHABI_SP];
+    bool pc_set = false;
+    const uint8_t *p = instructions;
+    const uint8_t * const end = instructions + count;
+    while (p < end) {
+        const uint8_t op = *p++;
+        if ((op & 0xc0) == 0x00) {
+            vsp += ((op & 0x3f) << 2) + 4;
+        } else if ((op & 0xc0) == 0x40) {
+            vsp -= ((op & 0x3f) << 2) + 4;
+        } else if ((op & 0xf0) == 0x80) {
+            if (p >= end) return false;
+            const uint32_t mask = ((op & 0x0f) << 12) | ((uint32_t) *p++ << 4);
+            // Zero mask means "refuse to unwind".
+            if (!mask) return false;
+            if (!ndcrash_ehabi_pop(regs, &vsp, mask, read, arg)) return false;
+            pc_set = pc_set || (mask & (1u << NDCRASH_EHABI_PC));
+        } else if ((op & 0xf0) == 0x90) {
+            const unsigned reg = op & 0x0f;
+            if (reg == NDCRASH_EHABI_SP || reg == NDCRASH_EHABI_PC) return false;
+            vsp = regs->r[reg];
+        } else if ((op & 0xf0) == 0xa0) {
+            // Pop r4-r[4+nnn], also r14 if bit 3 is set.
+            uint32_t mask = ((1u << ((op & 0x07) + 1)) - 1) << 4;
+            if (op & 0x08) {
+                mask |= 1u << NDCRASH_EHABI_LR;
+            }
+            if (!ndcrash_ehabi_pop(regs, &vsp, mask, read, arg)) return false;
+        } else if (op == 0xb0) {
+            break;
+        } else if (op == 0xb1) {
+            if (p >= end) return false;
+            const uint8_t mask = *p++;
+            if (!mask || (mask & 0xf0)) return false;
+            if (!ndcrash_ehabi_pop(regs, &vsp, mask, read, arg)) return false;
+        } else if (op == 0xb2) {
+            uint32_t value = 0;
+            unsigned shift = 0;
+            uint8_t byte;
+            do {
+                if (p >= end || shift >= 32) return false;
+                byte = *p++;
+                value |= (uint32_t) (byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            vsp += 0x204 + (value << 2);
+        } else if (op == 0xb3 || op == 0xc8 || op == 0xc9) {
+            // VFP registers D[ssss]-D[ssss+cccc], FSTMFDX format has an additional word.
+            if (p >= end) return false;
+            vsp += (((*p++ & 0x0f) + 1) << 3) + (op == 0xb3 ? 4 : 0);
+        } else if ((op & 0xf8) == 0xb8) {
+            // VFP registers D[8]-D[8+nnn] saved by FSTMFDX.
+            vsp += (((op & 0x07) + 1) << 3) + 4;
+        } else if ((op & 0xf8) == 0xd0) {
+            // VFP registers D[8]-D[8+nnn] saved by VPUSH.
+            vsp += ((op & 0x07) + 1) << 3;
+        } else if (op == 0xc6) {
+            // iWMMXt registers wR[ssss]-wR[ssss+cccc].
+            if (p >= end) return false;
+            vsp += ((*p++ & 0x0f) + 1) << 3;
+        } else if (op == 0xc7) {
+            // iWMMXt registers wCGR under mask.
+            if (p >= end) return false;
+            const uint8_t mask = *p++;
+            if (!mask || (mask & 0xf0)) return false;
+            vsp += (uint32_t) __builtin_popcount(mask) << 2;
+        } else if ((op & 0xf8) == 0xc0) {
+            // iWMMXt registers wR[10]-wR[10+nnn].
+            vsp += ((op & 0x07) + 1) << 3;
+        } else {
+            // Spare or reserved instruction.
+            return false;
+        }
+    }
+    regs->r[NDCRASH_EHABI_SP] = vsp;
+    if (!pc_set) {
+        regs->r[NDCRASH_EHABI_PC] = regs->r[NDCRASH_EHABI_LR];
+    }
+    return true;
+}
+
+/**
+ * Unwinds a single frame.
+ * @param regs Registers of a current frame, replaced by caller registers.
+ * @param exidx Address of .ARM.exidx table of a module containing lookup_pc.
+ * @param count Count of entries in a table.
+ * @param lookup_pc Address used to find an entry: pc or rewound return address.
+ * @param read Memory reading function.
+ * @param arg Argument of memory reading function.
+ * @return Flag whether unwinding is successful.
+ */
+static bool ndcrash_ehabi_step(
+        struct ndcrash_ehabi_regs *regs,
+        uintptr_t exidx,
+        size_t count,
+        uintptr_t lookup_pc,
+        ndcrash_ehabi_read_func_ptr read,
+        void *arg) {
+    const uintptr_t entry = ndcrash_ehabi_find_entry(exidx, count, lookup_pc & ~(uintptr_t) 1, read, arg);
+    if (!entry) return false;
+    uint8_t instructions[NDCRASH_EHABI_MAX_INSTRUCTIONS];
+    const size_t instructions_count = ndcrash_ehabi_get_instructions(entry, read, arg, instructions);
+    if (!instructions_count) return false;
+
+    struct ndcrash_ehabi_regs caller = *regs;
+    if (!ndcrash_ehabi_execute(&caller, instructions, instructions_count, read, arg)) return false;
+
+    // A caller frame can't be below a callee one, unwinding shouldn't stay in place.
+    const uint32_t sp = regs->r[NDCRASH_EHABI_SP];
+    const uint32_t caller_sp = caller.r[NDCRASH_EHABI_SP];
+    if (caller_sp < sp || (caller_sp == sp && caller.r[NDCRASH_EHABI_PC] == regs->r[NDCRASH_EHABI_PC])) return false;
+    if (!caller.r[NDCRASH_EHABI_PC]) return false;
+    *regs = caller;
+    return true;
+}
+
+/**
+ * Fills registers from a signal context.
+ */
+static void ndcrash_ehabi_regs_from_ucontext(struct ndcrash_ehabi_regs *regs, const struct ucontext *context) {
+    // Registers r0-r15 are stored sequentially in sigcontext starting from arm_r0.
+    memcpy(regs->r, &context->uc_mcontext.arm_r0, sizeof(regs->r));
+}
+
+/**
+ * Stack bounds where the saved registers are read from.
+ */
+struct ndcrash_ehabi_stack {
+
+    /// Stack pointer value of a crashed frame, inclusive.
+    uintptr_t start;
+
+    /// End of a stack mapping, exclusive.
+    uintptr_t end;
+};
+
+#ifdef ENABLE_INPROCESS
+
+/**
+ * Argument of a memory reading function in in-process mode.
+ */
+struct ndcrash_in_ehabi_memory {
+
+    /// Stack bounds.
+    struct ndcrash_ehabi_stack stack;
+
+    /// Module which tables are read.
+    const struct ndcrash_module *module;
+};
+
+/**
+ * Reads a word of a current process. Only a stack and loaded segments of a current module are
+ * readable. See ndcrash_ehabi_read_func_ptr for arguments description.
+ */
+static bool ndcrash_in_ehabi_read(uintptr_t address, uint32_t *value, void *arg) {
+    const struct ndcrash_in_ehabi_memory * const memory = (const struct ndcrash_in_ehabi_memory *) arg;
+    if (address & 3) return false;
+    bool readable = address >= memory->stack.start && address < memory->stack.end;
+    const struct ndcrash_module * const module = memory->module;
+    for (size_t i = 0; !readable && module && i < module->phnum; ++i) {
+        const ElfW(Phdr) * const phdr = &module->phdr[i];
+        if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_R)) continue;
+        const uintptr_t start = module->load_bias + phdr->p_vaddr;
+        readable = address >= start && address - start < phdr->p_filesz;
+    }
+    if (!readable) return false;
+    *value = *(const uint32_t *) address;
+    return true;
+}
+
+/**
+ * Unwinds a frame of a current process. See ndcrash_ehabi_step for arguments description.
+ */
+static bool ndcrash_in_ehabi_step(
+        struct ndcrash_ehabi_regs *regs,
+        struct ndcrash_in_ehabi_memory *memory,
+        uintptr_t lookup_pc) {
+    memory->module = ndcrash_modules_find(lookup_pc & ~(uintptr_t) 1);
+    if (!memory->module || !memory->module->arm_exidx) return false;
+    return ndcrash_ehabi_step(
+            regs,
+            (uintptr_t) memory->module->arm_exidx,
+            memory->module->arm_exidx_count,
+            lookup_pc,
+            &ndcrash_in_ehabi_read,
+            memory);
+}
+
+void ndcrash_in_unwind_ehabi(struct ndcrash_frames *frames, struct ucontext *context) {
+    struct ndcrash_ehabi_regs regs;
+    ndcrash_ehabi_regs_from_ucontext(&regs, context);
+
+    struct ndcrash_in_ehabi_memory memory;
+    memory.stack.start = regs.r[NDCRASH_EHABI_SP];
+    memory.stack.end = ndcrash_altstack_find_stack_end(memory.stack.start);
+    memory.module = NULL;
+
+    const uintptr_t crash_pc = regs.r[NDCRASH_EHABI_PC] & ~(uintptr_t) 1;
+    ndcrash_modules_add_frame(frames, crash_pc, crash_pc);
+    if (!ndcrash_in_ehabi_step(&regs, &memory, regs.r[NDCRASH_EHABI_PC])) {
+        // A crashed frame may have no index entry, for example after a call by invalid pointer.
+        // Its caller is found by lr.
+        regs.r[NDCRASH_EHABI_PC] = regs.r[NDCRASH_EHABI_LR];
+    }
+
+    while (!ndcrash_frames_full(frames)) {
+        const uintptr_t pc = regs.r[NDCRASH_EHABI_PC];
+
+        // A previous instruction is read to rewind a return address, so it should be within
+        // executable code of a loaded module. Otherwise it's garbage and a backtrace ends.
+        const struct ndcrash_exec_range * const range = ndcrash_modules_find_exec(pc & ~(uintptr_t) 1);
+        if (!range || (pc & ~(uintptr_t) 1) - range->start < sizeof(uint32_t)) break;
+        const uintptr_t rewound = ndcrash_rewind_pc(pc);
+        ndcrash_modules_add_frame(frames, pc & ~(uintptr_t) 1, rewound & ~(uintptr_t) 1);
+        if (!ndcrash_in_ehabi_step(&regs, &memory, rewound)) break;
+    }
+}
+
+#endif //ENABLE_INPROCESS
+
+#ifdef ENABLE_OUTOFPROCESS
+
+/**
+ * Location of .ARM.exidx table of a module in a crashed process.
+ */
+struct ndcrash_out_ehabi_table {
+
+    /// Flag whether a table has been looked for.
+    bool loaded;
+
+    /// Address of a table, 0 if a module has no table.
+    uintptr_t exidx;
+
+    /// Count of entries.
+    size_t count;
+};
+
+/**
+ * Data of out-of-process EHABI unwinder for a crashed process.
+ */
+struct ndcrash_out_ehabi_data {
+
+    /// Crashed process identifier.
+    pid_t pid;
+
+    /// Memory map of a crashed process.
+    struct ndcrash_remote_maps maps;
+
+    /// Tables of modules, an index is a base_index of a mapping.
+    struct ndcrash_out_ehabi_table *tables;
+
+    /// Window for stack reading.
+    struct ndcrash_remote_window stack_window;
+
+    /// Window for reading of unwinding tables.
+    struct ndcrash_remote_window table_window;
+
+    /// Bounds of a stack of a thread being unwound.
+    struct ndcrash_ehabi_stack stack;
+};
+
+void *ndcrash_out_init_ehabi(pid_t pid) {
+    struct ndcrash_out_ehabi_data * const ehdata = (struct ndcrash_out_ehabi_data *)
+            malloc(sizeof(struct ndcrash_out_ehabi_data));
+    if (!ehdata) return NULL;
+    if (!ndcrash_remote_maps_load(pid, &ehdata->maps)) {
+        NDCRASHLOG(ERROR, "ehabi: Couldn't read a memory map of process %d.", (int) pid);
+        free(ehdata);
+        return NULL;
+    }
+    ehdata->tables = (struct ndcrash_out_ehabi_table *) calloc(ehdata->maps.count, sizeof(struct ndcrash_out_ehabi_table));
+    if (!ehdata->tables) {
+        ndcrash_remote_maps_free(&ehdata->maps);
+        free(ehdata);
+        return NULL;
+    }
+    ehdata->pid = pid;
+    ndcrash_remote_window_init(&ehdata->stack_window, pid);
+    ndcrash_remote_window_init(&ehdata->table_window, pid);
+    return ehdata;
+}
+
+void ndcrash_out_deinit_ehabi(void *data) {
+    if (!data) return;
+    struct ndcrash_out_ehabi_data * const ehdata = (struct ndcrash_out_ehabi_data *) data;
+    ndcrash_remote_maps_free(&ehdata->maps);
+    free(ehdata->tables);
+    free(ehdata);
+}
+
+/**
+ * Reads a word of a crashed process. Stack and readable mappings are read through separate
+ * windows. See ndcrash_ehabi_read_func_ptr for arguments description.
+ */
+static bool ndcrash_out_ehabi_read(uintptr_t address, uint32_t *value, void *arg) {
+    struct ndcrash_out_ehabi_data * const ehdata = (struct ndcrash_out_ehabi_data *) arg;
+    if (address & 3) return false;
+    if (address >= ehdata->stack.start && address < ehdata->stack.end) {
+        return ndcrash_remote_window_read(&ehdata->stack_window, address, value, sizeof(*value), ehdata->stack.end);
+    }
+    const struct ndcrash_remote_mapping * const mapping = ndcrash_remote_maps_find(&ehdata->maps, address);
+    if (!mapping || !(mapping->prot & PROT_READ)) return false;
+    return ndcrash_remote_window_read(&ehdata->table_window, address, value, sizeof(*value), mapping->end);
+}
+
+/**
+ * Looks for .ARM.exidx table of a module by reading its ELF header and program headers from
+ * memory of a crashed process.
+ * @param ehdata Unwinder data.
+ * @param mapping Mapping where a module starts with ELF header. It's mapped from a file start or
+ * from an offset within APK file for a library loaded from APK directly.
+ * @param table Table location to fill.
+ */
+static void ndcrash_out_ehabi_load_table(
+        struct ndcrash_out_ehabi_data *ehdata,
+        const struct ndcrash_remote_mapping *mapping,
+        struct ndcrash_out_ehabi_table *table) {
+    table->loaded = true;
+    table->exidx = 0;
+    table->count = 0;
+    Elf32_Ehdr ehdr;
+    if (ndcrash_remote_read(ehdata->pid, mapping->start, &ehdr, sizeof(ehdr)) != sizeof(ehdr) ||
+        memcmp(ehdr.e_ident, ELFMAG, SELFMAG) ||
+        ehdr.e_phentsize != sizeof(Elf32_Phdr)) {
+        return;
+    }
+    uintptr_t min_vaddr = UINTPTR_MAX;
+    const Elf32_Phdr *exidx = NULL;
+    Elf32_Phdr phdrs[32];
+    const size_t phnum = ehdr.e_phnum < 32 ? ehdr.e_phnum : 32;
+    const size_t size = phnum * sizeof(Elf32_Phdr);
+    if (ndcrash_remote_read(ehdata->pid, mapping->start + ehdr.e_phoff, phdrs, size) != size) return;
+    for (size_t i = 0; i < phnum; ++i) {
+        if (phdrs[i].p_type == PT_LOAD && phdrs[i].p_vaddr < min_vaddr) {
+            min_vaddr = phdrs[i].p_vaddr;
+        } else if (phdrs[i].p_type == PT_ARM_EXIDX) {
+            exidx = &phdrs[i];
+        }
+    }
+    if (!exidx || min_vaddr == UINTPTR_MAX) return;
+    // A module base is a start of the lowest segment aligned to a page.
+    const uintptr_t load_bias = mapping->start - (min_vaddr & ~(uintptr_t) (getpagesize() - 1));
+    table->exidx = load_bias + exidx->p_vaddr;
+    table->count = exidx->p_memsz / 8;
+}
+
+/**
+ * Unwinds a frame of a crashed process. See ndcrash_ehabi_step for arguments description.
+ */
+static bool ndcrash_out_ehabi_step(
+        struct ndcrash_ehabi_regs *regs,
+        struct ndcrash_out_ehabi_data *ehdata,
+        uintptr_t lookup_pc) {
+    const struct ndcrash_remote_mapping * const mapping = ndcrash_remote_maps_find(&ehdata->maps, lookup_pc & ~(uintptr_t) 1);
+    if (!mapping || !(mapping->prot & PROT_EXEC)) return false;
+    struct ndcrash_out_ehabi_table * const table = &ehdata->tables[mapping->base_index];
+    if (!table->loaded) {
+        ndcrash_out_ehabi_load_table(ehdata, &ehdata->maps.mappings[mapping->base_index], table);
+    }
+    if (!table->exidx) return false;
+    return ndcrash_ehabi_step(regs, table->exidx, table->count, lookup_pc, &ndcrash_out_ehabi_read, ehdata);
+}
+
+/**
+ * Adds a frame to a backtrace looking for a module and a function name.
+ * @param frames Frames buffer.
+ * @param maps Memory map of a process.
+ * @param pc Program counter value, may have thumb bit.
+ * @param rewound Address of an instruction for a function name lookup: pc for a crashed frame,
+ * a call instruction for return addresses.
+ */
+static void ndcrash_out_ehabi_add_frame(
+        struct ndcrash_frames *frames,
+        struct ndcrash_remote_maps *maps,
+        uintptr_t pc,
+        uintptr_t rewound) {
+    pc &= ~(uintptr_t) 1;
+    rewound &= ~(uintptr_t) 1;
+    const struct ndcrash_remote_mapping * const mapping = ndcrash_remote_maps_find(maps, pc);
+    if (!mapping || !(mapping->prot & PROT_EXEC)) {
+        ndcrash_frames_add(frames, pc, pc, mapping ? mapping->path : NULL, NULL, 0, 0);
+        return;
+    }
+    uintptr_t func_offset = 0;
+    const char * const func_name = ndcrash_remote_maps_find_symbol(maps, mapping, rewound - mapping->base, &func_offset);
+    if (func_name) {
+        func_offset += pc - rewound;
+    }
+    ndcrash_frames_add(frames, pc, pc - mapping->base, mapping->path, func_name, func_offset, 0);
+}
+
+void ndcrash_out_unwind_ehabi(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data) {
+    struct ndcrash_out_ehabi_data * const ehdata = (struct ndcrash_out_ehabi_data *) data;
+    if (!ehdata) return;
+    struct ndcrash_ehabi_regs regs;
+    if (context) {
+        ndcrash_ehabi_regs_from_ucontext(&regs, context);
+    } else {
+        struct pt_regs r;
+        if (ptrace(PTRACE_GETREGS, tid, 0, &r) == -1) {
+            NDCRASHLOG(ERROR, "ehabi: Couldn't get registers by ptrace: %s (%d)", strerror(errno), errno);
+            return;
+        }
+        for (size_t i = 0; i < 16; ++i) {
+            regs.r[i] = (uint32_t) r.uregs[i];
+        }
+    }
+
+    const struct ndcrash_remote_mapping * const stack = ndcrash_remote_maps_find(&ehdata->maps, regs.r[NDCRASH_EHABI_SP]);
+    ehdata->stack.start = regs.r[NDCRASH_EHABI_SP];
+    ehdata->stack.end = stack ? stack->end : ehdata->stack.start;
+
+    ndcrash_out_ehabi_add_frame(frames, &ehdata->maps, regs.r[NDCRASH_EHABI_PC], regs.r[NDCRASH_EHABI_PC]);
+    if (!ndcrash_out_ehabi_step(&regs, ehdata, regs.r[NDCRASH_EHABI_PC])) {
+        // The same fallback as in in-process mode.
+        regs.r[NDCRASH_EHABI_PC] = regs.r[NDCRASH_EHABI_LR];
+        if (!ndcrash_remote_maps_find(&ehdata->maps, regs.r[NDCRASH_EHABI_PC] & ~(uintptr_t) 1)) return;
+    }
+
+    while (!ndcrash_frames_full(frames)) {
+        const uintptr_t pc = regs.r[NDCRASH_EHABI_PC];
+        const uintptr_t rewound = ndcrash_remote_rewind_pc(ehdata->pid, pc);
+        ndcrash_out_ehabi_add_frame(frames, &ehdata->maps, pc, rewound);
+        if (!ndcrash_out_ehabi_step(&regs, ehdata, rewound)) break;
+    }
+}
+
+#endif //ENABLE_OUTOFPROCESS
+
+#endif //__arm__
@@ -0,0 +1,269 @@
+#include "ndcrash_unwinders.h"
+#include "ndcrash_frames.h"
+#include "ndcrash_private.h"
+#include "ndcrash_altstack.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_ucontext.h"
+#include "ndcrash_elf.h"
+#include "ndcrash_log.h"
+#include "ndcrash_remote_memory.h"
+#include "ndcrash_remote_maps.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__aarch64__) || defined(__x86_64__) || defined(__i386__)
+
+/*
+ * Frame record layout is the same for all supported architectures: a frame pointer register
+ * points to a saved frame pointer of a caller, a return address is saved right after it. On arm64
+ * it's x29 and x30 saved by "stp x29, x30, [sp, #-N]!", on x86 it's "push ebp/rbp" done right
+ * after "call". 32-bit arm isn't supported because thumb and arm code use different registers and
+ * layouts of frame records.
+ *
+ * A function that doesn't create a frame record (a leaf function or a function built with
+ * -fomit-frame-pointer) isn't visible. On arm64 a caller of a crashed function is taken from lr
+ * when a crashed function has no active frame record: x29 doesn't point to a record above sp, pc
+ * is at a prologue or epilogue instruction, or lr points outside of a crashed function (a leaf
+ * function, detected only if its symbol is known). lr is skipped if it's equal to a return address
+ * of the first record.
+ */
+
+/// Alignment of a frame record address. A record may be stored at any 8-byte aligned offset from
+/// sp on arm64, so it's a pointer size on all architectures.
+#define NDCRASH_FRAMEPOINTER_ALIGN sizeof(uintptr_t)
+
+/// Size of a frame record: saved frame pointer and return address.
+#define NDCRASH_FRAMEPOINTER_RECORD_SIZE (2 * sizeof(uintptr_t))
+
+/**
+ * Checks whether a frame pointer value points to a valid frame record.
+ * @param fp Frame pointer value.
+ * @param lower Minimum allowed address: stack pointer for the first record, an end of previous
+ * record for others, so a chain is strictly monotonic and can't loop.
+ * @param end Stack end address, exclusive.
+ * @return Flag whether a frame record may be read.
+ */
+static inline bool ndcrash_framepointer_valid(uintptr_t fp, uintptr_t lower, uintptr_t end) {
+    return !(fp & (NDCRASH_FRAMEPOINTER_ALIGN - 1)) &&
+           fp >= lower &&
+           fp < end &&
+           end - fp >= NDCRASH_FRAMEPOINTER_RECORD_SIZE;
+}
+
+#ifdef __aarch64__
+/**
+ * Checks whether an instruction is executed while a function frame record isn't active: x29 still
+ * points to a record of a caller and a return address is only in lr. Recognized instructions are
+ * PACIASP, BTI C, "stp x29, x30, [sp, #imm]" (including pre-index form), "sub sp, sp, #imm" and
+ * "add x29, sp, #imm" (including "mov x29, sp") of a prologue, AUTIASP and RET of an epilogue.
+ * @param instruction Instruction at a crashed pc.
+ * @return Flag whether lr contains a return address to a caller.
+ */
+static inline bool ndcrash_framepointer_outside_record(uint32_t instruction) {
+    return instruction == 0xd503233f ||                 // PACIASP
+           instruction == 0xd503245f ||                 // BTI C
+           (instruction & 0xffc07fff) == 0xa9807bfd ||  // STP x29, x30, [sp, #imm]!
+           (instruction & 0xffc07fff) == 0xa9007bfd ||  // STP x29, x30, [sp, #imm]
+           (instruction & 0xff8003ff) == 0xd10003ff ||  // SUB sp, sp, #imm
+           (instruction & 0xff8003ff) == 0x910003fd ||  // ADD x29, sp, #imm
+           instruction == 0xd50323bf ||                 // AUTIASP
+           instruction == 0xd65f03c0;                   // RET
+}
+#endif
+
+#ifdef ENABLE_INPROCESS
+
+#ifdef __aarch64__
+/**
+ * Checks whether a return address is outside of a function containing pc. A stale lr of a function
+ * that has already called something points into this function.
+ * @param pc Program counter value.
+ * @param return_address Return address value.
+ * @return Flag whether a return address is in another function, false if a function of pc isn't
+ * known.
+ */
+static bool ndcrash_in_framepointer_other_function(uintptr_t pc, uintptr_t return_address) {
+    const struct ndcrash_module * const module = ndcrash_modules_find(pc);
+    uintptr_t offset = 0, return_offset = 0;
+    if (!module || !ndcrash_elf_find_symbol(&module->symbols, pc - module->load_bias, &offset)) return false;
+    return ndcrash_modules_find(return_address - 1) != module ||
+           !ndcrash_elf_find_symbol(&module->symbols, return_address - 1 - module->load_bias, &return_offset) ||
+           pc - offset != return_address - 1 - return_offset;
+}
+#endif
+
+void ndcrash_in_unwind_framepointer(struct ndcrash_frames *frames, struct ucontext *context) {
+    const uintptr_t pc = ndcrash_pc_from_ucontext(context);
+    ndcrash_modules_add_frame(frames, pc, pc);
+
+    // Stack bounds: frame records are read only within a mapping containing sp. If it's not found
+    // an end is equal to sp and no record is read.
+    uintptr_t bounds[2];
+    bounds[0] = ndcrash_sp_from_ucontext(context);
+    bounds[1] = ndcrash_altstack_find_stack_end(bounds[0]);
+
+    uintptr_t lower = bounds[0];
+    uintptr_t fp = ndcrash_fp_from_ucontext(context);
+#ifdef __aarch64__
+    {
+        // A caller from lr, see a description at the beginning of this file. An instruction is
+        // read only if pc is within executable code.
+        const uintptr_t lr = ndcrash_strip_pac(context->uc_mcontext.regs[30]);
+        const bool has_record = ndcrash_framepointer_valid(fp, lower, bounds[1]);
+        bool use_lr = lr && !has_record;
+        if (lr && has_record && lr != ndcrash_strip_pac(((const uintptr_t *) fp)[1])) {
+            const struct ndcrash_exec_range * const range = ndcrash_modules_find_exec(pc);
+            use_lr = (range && range->end - pc >= sizeof(uint32_t) &&
+                      ndcrash_framepointer_outside_record(*(const uint32_t *) pc)) ||
+                     ndcrash_in_framepointer_other_function(pc, lr);
+        }
+        if (use_lr) {
+            ndcrash_modules_add_frame(frames, lr, lr - 1);
+        }
+    }
+#endif
+    while (!ndcrash_frames_full(frames) && ndcrash_framepointer_valid(fp, lower, bounds[1])) {
+        const uintptr_t * const record = (const uintptr_t *) fp;
+        const uintptr_t return_address = ndcrash_strip_pac(record[1]);
+        if (!return_address) break;
+        ndcrash_modules_add_frame(frames, return_address, return_address - 1);
+        lower = fp + NDCRASH_FRAMEPOINTER_RECORD_SIZE;
+        fp = record[0];
+    }
+}
+
+#endif //ENABLE_INPROCESS
+
+#ifdef ENABLE_OUTOFPROCESS
+
+/**
+ * Data of out-of-process frame pointer unwinder for a crashed process.
+ */
+struct ndcrash_out_framepointer_data {
+
+    /// Memory map of a crashed process.
+    struct ndcrash_remote_maps maps;
+
+    /// Window for stack reading. Stack memory isn't changed while a process is stopped, so it's
+    /// shared for all threads.
+    struct ndcrash_remote_window window;
+};
+
+void *ndcrash_out_init_framepointer(pid_t pid) {
+    struct ndcrash_out_framepointer_data * const fpdata = (struct ndcrash_out_framepointer_data *)
+            malloc(sizeof(struct ndcrash_out_framepointer_data));
+    if (!fpdata) return NULL;
+    if (!ndcrash_remote_maps_load(pid, &fpdata->maps)) {
+        NDCRASHLOG(ERROR, "framepointer: Couldn't read a memory map of process %d.", (int) pid);
+        free(fpdata);
+        return NULL;
+    }
+    ndcrash_remote_window_init(&fpdata->window, pid);
+    return fpdata;
+}
+
+void ndcrash_out_deinit_framepointer(void *data) {
+    if (!data) return;
+    struct ndcrash_out_framepointer_data * const fpdata = (struct ndcrash_out_framepointer_data *) data;
+    ndcrash_remote_maps_free(&fpdata->maps);
+    free(fpdata);
+}
+
+/**
+ * Adds a frame to a backtrace looking for a module and a function name.
+ * @param frames Frames buffer.
+ * @param maps Memory map of a process.
+ * @param pc Program counter value.
+ * @param return_address Flag whether pc is a return address. Function name is looked up for a
+ * previous instruction then because a call may be the last instruction of a function.
+ */
+static void ndcrash_out_framepointer_add(
+        struct ndcrash_frames *frames,
+        struct ndcrash_remote_maps *maps,
+        uintptr_t pc,
+        bool return_address) {
+    const struct ndcrash_remote_mapping * const mapping = ndcrash_remote_maps_find(maps, pc);
+    if (!mapping || !(mapping->prot & PROT_EXEC)) {
+        ndcrash_frames_add(frames, pc, pc, mapping ? mapping->path : NULL, NULL, 0, 0);
+        return;
+    }
+    const uintptr_t rel_pc = pc - mapping->base;
+    uintptr_t func_offset = 0;
+    const char * const func_name = ndcrash_remote_maps_find_symbol(
+            maps, mapping, return_address ? rel_pc - 1 : rel_pc, &func_offset);
+    if (func_name && return_address) {
+        ++func_offset;
+    }
+    ndcrash_frames_add(frames, pc, rel_pc, mapping->path, func_name, func_offset, 0);
+}
+
+#ifdef __aarch64__
+/**
+ * Checks whether a return address is outside of a function containing pc. See
+ * ndcrash_in_framepointer_other_function for details.
+ */
+static bool ndcrash_out_framepointer_other_function(
+        struct ndcrash_remote_maps *maps,
+        uintptr_t pc,
+        uintptr_t return_address) {
+    const struct ndcrash_remote_mapping * const mapping = ndcrash_remote_maps_find(maps, pc);
+    if (!mapping || !(mapping->prot & PROT_EXEC)) return false;
+    uintptr_t offset = 0, return_offset = 0;
+    if (!ndcrash_remote_maps_find_symbol(maps, mapping, pc - mapping->base, &offset)) return false;
+    const struct ndcrash_remote_mapping * const return_mapping = ndcrash_remote_maps_find(maps, return_address - 1);
+    return !return_mapping ||
+           return_mapping->base != mapping->base ||
+           !ndcrash_remote_maps_find_symbol(maps, return_mapping, return_address - 1 - mapping->base, &return_offset) ||
+           pc - offset != return_address - 1 - return_offset;
+}
+#endif
+
+void ndcrash_out_unwind_framepointer(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data) {
+    struct ndcrash_out_framepointer_data * const fpdata = (struct ndcrash_out_framepointer_data *) data;
+    struct ndcrash_remote_registers registers;
+    if (!fpdata || !ndcrash_remote_get_registers(tid, context, &registers)) return;
+    ndcrash_out_framepointer_add(frames, &fpdata->maps, registers.pc, false);
+
+    // Frame records are read only within a mapping containing sp.
+    const struct ndcrash_remote_mapping * const stack = ndcrash_remote_maps_find(&fpdata->maps, registers.sp);
+#ifdef __aarch64__
+    {
+        // A caller from lr, see a description at the beginning of this file.
+        const uintptr_t lr = ndcrash_strip_pac(registers.lr);
+        uintptr_t record[2] = { 0, 0 };
+        const bool has_record = stack &&
+                ndcrash_framepointer_valid(registers.fp, registers.sp, stack->end) &&
+                ndcrash_remote_window_read(&fpdata->window, registers.fp, record, sizeof(record), stack->end);
+        bool use_lr = lr && !has_record;
+        if (lr && has_record && lr != ndcrash_strip_pac(record[1])) {
+            uint32_t instruction = 0;
+            use_lr = (ndcrash_remote_read(tid, registers.pc, &instruction, sizeof(instruction)) == sizeof(instruction) &&
+                      ndcrash_framepointer_outside_record(instruction)) ||
+                     ndcrash_out_framepointer_other_function(&fpdata->maps, registers.pc, lr);
+        }
+        if (use_lr) {
+            ndcrash_out_framepointer_add(frames, &fpdata->maps, lr, true);
+        }
+    }
+#endif
+    if (!stack) return;
+
+    uintptr_t lower = registers.sp;
+    uintptr_t fp = registers.fp;
+    while (!ndcrash_frames_full(frames) && ndcrash_framepointer_valid(fp, lower, stack->end)) {
+        uintptr_t record[2];
+        if (!ndcrash_remote_window_read(&fpdata->window, fp, record, sizeof(record), stack->end)) break;
+        const uintptr_t return_address = ndcrash_strip_pac(record[1]);
+        if (!return_address) break;
+        ndcrash_out_framepointer_add(frames, &fpdata->maps, return_address, true);
+        lower = fp + NDCRASH_FRAMEPOINTER_RECORD_SIZE;
+        fp = record[0];
+    }
+}
+
+#endif //ENABLE_OUTOFPROCESS
+
+#endif //defined(__aarch64__) || defined(__x86_64__) || defined(__i386__)
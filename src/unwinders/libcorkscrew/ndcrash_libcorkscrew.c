@@ -1,8 +1,17 @@
 #include "ndcrash_unwinders.h"
-#include "ndcrash_dump.h"
+#include "ndcrash_frames.h"
 #include "ndcrash_private.h"
+#include "ndcrash_log.h"
+#include "ndcrash_arena.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_libcorkscrew_arch.h"
 #include <corkscrew/backtrace.h>
 #include <corkscrew/backtrace-arch.h>
+#include <corkscrew/map_info.h>
+#include <corkscrew/symbol_table.h>
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
 
 #if defined(__arm__) || defined(__i386__)
 
@@ -16,53 +25,172 @@ static const int LIBCORKSCREW_IN_MAX_FRAMES =
         NDCRASH_MAX_FRAMES;
 #endif
 
-void ndcrash_common_unwind_libcorkscrew(int outfile, backtrace_symbol_t *backtrace_symbols, ssize_t frame_count) {
+void ndcrash_common_unwind_libcorkscrew(
+        struct ndcrash_frames *frames,
+        const backtrace_frame_t *backtrace_frames,
+        const backtrace_symbol_t *backtrace_symbols,
+        ssize_t frame_count) {
     for (ssize_t i = 0; i < frame_count; ++i) {
         const backtrace_symbol_t *symbol = backtrace_symbols + i;
-        ndcrash_dump_backtrace_line(
-                outfile,
-                i,
+        if (!ndcrash_frames_add(
+                frames,
+                backtrace_frames[i].absolute_pc,
                 symbol->relative_pc,
                 symbol->map_name,
                 symbol->symbol_name,
-                symbol->relative_pc - symbol->relative_symbol_addr);
+                symbol->relative_pc - symbol->relative_symbol_addr,
+                0)) {
+            break;
+        }
     }
 }
 
 #ifdef ENABLE_INPROCESS
 
-void ndcrash_in_unwind_libcorkscrew(int outfile, struct ucontext *context) {
-    map_info_t *map_info = acquire_my_map_info_list();
-    backtrace_frame_t frames[LIBCORKSCREW_IN_MAX_FRAMES] = { { 0, 0, 0 } };
+/// List of memory maps of a current process acquired on initialization.
+static map_info_t *ndcrash_in_libcorkscrew_map_info = NULL;
+
+void ndcrash_in_init_libcorkscrew() {
+    // Parsing /proc/self/maps here in order to avoid it in a signal handler: it allocates a memory
+    // for every map entry.
+    map_info_t * const map_info = acquire_my_map_info_list();
+    map_info_t * const old_map_info =
+            __atomic_exchange_n(&ndcrash_in_libcorkscrew_map_info, map_info, __ATOMIC_SEQ_CST);
+    if (old_map_info) {
+        // An old list may be used by a signal handler that has started before publishing.
+        ndcrash_modules_wait_released();
+        release_my_map_info_list(old_map_info);
+    }
+}
+
+void ndcrash_in_deinit_libcorkscrew() {
+    map_info_t * const map_info =
+            __atomic_exchange_n(&ndcrash_in_libcorkscrew_map_info, NULL, __ATOMIC_SEQ_CST);
+    if (map_info) {
+        ndcrash_modules_wait_released();
+        release_my_map_info_list(map_info);
+    }
+}
+
+void ndcrash_in_unwind_libcorkscrew(struct ndcrash_frames *frames, struct ucontext *context) {
+    map_info_t * const map_info = __atomic_load_n(&ndcrash_in_libcorkscrew_map_info, __ATOMIC_ACQUIRE);
+
+    // Frames and symbols arrays are allocated from arena instead of stack.
+    backtrace_frame_t * const backtrace_frames = (backtrace_frame_t *) ndcrash_arena_alloc(
+            sizeof(backtrace_frame_t) * LIBCORKSCREW_IN_MAX_FRAMES);
+    backtrace_symbol_t * const backtrace_symbols = (backtrace_symbol_t *) ndcrash_arena_alloc(
+            sizeof(backtrace_symbol_t) * LIBCORKSCREW_IN_MAX_FRAMES);
+    if (!map_info || !backtrace_frames || !backtrace_symbols) {
+        NDCRASHLOG(ERROR, "libcorkscrew: Not initialized or arena is exhausted.");
+        return;
+    }
+
+    // Arena blocks may be reused after rewinding, they contain data of a previous unwinder.
+    memset(backtrace_frames, 0, sizeof(backtrace_frame_t) * LIBCORKSCREW_IN_MAX_FRAMES);
+    memset(backtrace_symbols, 0, sizeof(backtrace_symbol_t) * LIBCORKSCREW_IN_MAX_FRAMES);
 
     // Unwinding stack.
-    const ssize_t frame_count = unwind_backtrace_signal_arch(NULL, context, map_info, frames, 0, LIBCORKSCREW_IN_MAX_FRAMES);
+    const ssize_t frame_count = unwind_backtrace_signal_arch(NULL, context, map_info, backtrace_frames, 0, LIBCORKSCREW_IN_MAX_FRAMES);
 
     //Getting symbols information.
-    backtrace_symbol_t backtrace_symbols[LIBCORKSCREW_IN_MAX_FRAMES] = { { 0, 0, NULL, NULL } };
-    get_backtrace_symbols(frames, (size_t)frame_count, backtrace_symbols);
+    get_backtrace_symbols(backtrace_frames, (size_t)frame_count, backtrace_symbols);
 
-    ndcrash_common_unwind_libcorkscrew(outfile, backtrace_symbols, frame_count);
+    ndcrash_common_unwind_libcorkscrew(frames, backtrace_frames, backtrace_symbols, frame_count);
 
     free_backtrace_symbols(backtrace_symbols, (size_t)frame_count);
-    release_my_map_info_list(map_info);
 }
 
 #endif //ENABLE_INPROCESS
 
 #ifdef ENABLE_OUTOFPROCESS
 
+/**
+ * Data of out-of-process libcorkscrew unwinder for a crashed process. Unlike load_ptrace_context
+ * a ptrace context is created without symbol tables, a table of a module is loaded only when a
+ * module is met in a backtrace and is reused for all threads.
+ */
+struct ndcrash_out_libcorkscrew_data {
+
+    /// Context passed to libcorkscrew, map list and per-map unwinding data.
+    ptrace_context_t *context;
+
+    /// Flags whether a symbol table has been loaded for a map, index is a position in a map list.
+    bool *symbols_loaded;
+};
+
+/**
+ * Fills libcorkscrew data of a map that is required for unwinding: exception tables location.
+ * Does the same as load_ptrace_context but doesn't load a symbol table.
+ */
+static void ndcrash_out_libcorkscrew_load_map_data(pid_t pid, map_info_t *mi) {
+    if (!mi->is_executable || !mi->is_readable) return;
+    uint32_t magic;
+    if (!try_get_word_ptrace(pid, mi->start, &magic) || memcmp(&magic, ELFMAG, SELFMAG)) return;
+    map_info_data_t * const data = (map_info_data_t *) calloc(1, sizeof(map_info_data_t));
+    if (!data) return;
+    mi->data = data;
+    load_ptrace_map_info_data_arch(pid, mi, data);
+}
+
 void * ndcrash_out_init_libcorkscrew(pid_t pid) {
-    return load_ptrace_context(pid);
+    struct ndcrash_out_libcorkscrew_data * const ckdata = (struct ndcrash_out_libcorkscrew_data *)
+            calloc(1, sizeof(struct ndcrash_out_libcorkscrew_data));
+    if (!ckdata) return NULL;
+    ckdata->context = (ptrace_context_t *) calloc(1, sizeof(ptrace_context_t));
+    if (!ckdata->context) {
+        free(ckdata);
+        return NULL;
+    }
+    ckdata->context->pid = pid;
+    ckdata->context->map_info_list = load_map_info_list(pid);
+    size_t count = 0;
+    for (map_info_t *mi = ckdata->context->map_info_list; mi; mi = mi->next, ++count) {
+        ndcrash_out_libcorkscrew_load_map_data(pid, mi);
+    }
+    ckdata->symbols_loaded = (bool *) calloc(count ? count : 1, sizeof(bool));
+    if (!ckdata->symbols_loaded) {
+        free_ptrace_context(ckdata->context);
+        free(ckdata);
+        return NULL;
+    }
+    return ckdata;
 }
 
 void ndcrash_out_deinit_libcorkscrew(void *data) {
-    free_ptrace_context((ptrace_context_t *) data);
+    if (!data) return;
+    struct ndcrash_out_libcorkscrew_data * const ckdata = (struct ndcrash_out_libcorkscrew_data *) data;
+    // Frees symbol tables that have been loaded as well.
+    free_ptrace_context(ckdata->context);
+    free(ckdata->symbols_loaded);
+    free(ckdata);
 }
 
-void ndcrash_out_unwind_libcorkscrew(int outfile, pid_t tid, struct ucontext *context, void *data) {
-    ptrace_context_t * const ptrace_context = (ptrace_context_t *) data;
-    backtrace_frame_t frames[NDCRASH_MAX_FRAMES] = { { 0, 0, 0 } };
+/**
+ * Loads symbol tables of modules containing backtrace frames if they haven't been loaded yet.
+ * A failed attempt isn't repeated.
+ */
+static void ndcrash_out_libcorkscrew_load_symbols(
+        struct ndcrash_out_libcorkscrew_data *ckdata,
+        const backtrace_frame_t *backtrace_frames,
+        ssize_t frame_count) {
+    for (ssize_t i = 0; i < frame_count; ++i) {
+        const uintptr_t pc = backtrace_frames[i].absolute_pc;
+        size_t index = 0;
+        map_info_t *mi = ckdata->context->map_info_list;
+        for (; mi && !(pc >= mi->start && pc < mi->end); mi = mi->next, ++index);
+        if (!mi || !mi->data || ckdata->symbols_loaded[index]) continue;
+        ckdata->symbols_loaded[index] = true;
+        if (mi->name[0]) {
+            ((map_info_data_t *) mi->data)->symbol_table = load_symbol_table(mi->name);
+        }
+    }
+}
+
+void ndcrash_out_unwind_libcorkscrew(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data) {
+    struct ndcrash_out_libcorkscrew_data * const ckdata = (struct ndcrash_out_libcorkscrew_data *) data;
+    if (!ckdata) return;
+    ptrace_context_t * const ptrace_context = ckdata->context;
+    backtrace_frame_t backtrace_frames[NDCRASH_MAX_FRAMES] = { { 0, 0, 0 } };
 
     // Collecting backtrace
     ssize_t frame_count;
@@ -71,24 +199,28 @@ void ndcrash_out_unwind_libcorkscrew(int outfile, pid_t tid, struct ucontext *co
                 tid,
                 context,
                 ptrace_context,
-                frames,
+                backtrace_frames,
                 0,
                 NDCRASH_MAX_FRAMES);
     } else {
         frame_count = unwind_backtrace_ptrace_arch(
                 tid,
                 ptrace_context,
-                frames,
+                backtrace_frames,
                 0,
                 NDCRASH_MAX_FRAMES);
     }
+    if (frame_count < 0) {
+        frame_count = 0;
+    }
 
-    // Getting symbols information.
+    // Getting symbols information, only modules met in a backtrace are loaded.
+    ndcrash_out_libcorkscrew_load_symbols(ckdata, backtrace_frames, frame_count);
     backtrace_symbol_t backtrace_symbols[NDCRASH_MAX_FRAMES] = { { 0, 0, NULL, NULL } };
-    get_backtrace_symbols_ptrace(ptrace_context, frames, (size_t)frame_count, backtrace_symbols);
+    get_backtrace_symbols_ptrace(ptrace_context, backtrace_frames, (size_t)frame_count, backtrace_symbols);
 
     // Running common unwinding function.
-    ndcrash_common_unwind_libcorkscrew(outfile, backtrace_symbols, frame_count);
+    ndcrash_common_unwind_libcorkscrew(frames, backtrace_frames, backtrace_symbols, frame_count);
 
     // Freeing memory.
     free_backtrace_symbols(backtrace_symbols, (size_t)frame_count);
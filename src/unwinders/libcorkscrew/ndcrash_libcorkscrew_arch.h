@@ -0,0 +1,45 @@
+#ifndef NDCRASH_LIBCORKSCREW_ARCH_H
+#define NDCRASH_LIBCORKSCREW_ARCH_H
+#include <corkscrew/map_info.h>
+#include <corkscrew/symbol_table.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Declarations of libcorkscrew internals used by out-of-process mode to load exception tables of
+ * a map without loading its symbol table. They are declared only in a private ptrace-arch.h header
+ * of libcorkscrew, which isn't a part of its public include directory, so they are copied here.
+ * The layout must match AOSP libcorkscrew/ptrace-arch.h. If that header is included as well, its
+ * include guard makes these declarations skipped.
+ */
+#ifndef _CORKSCREW_PTRACE_ARCH_H
+
+/// Architecture specific data of a map, filled by load_ptrace_map_info_data_arch.
+typedef struct {
+#ifdef __arm__
+    uintptr_t exidx_start;
+    size_t exidx_size;
+#elif defined(__mips__) || defined(__i386__)
+    uintptr_t eh_frame_hdr;
+#endif
+    symbol_table_t* symbol_table;
+} map_info_data_t;
+
+/// Loads architecture specific data of a map: exception tables location.
+void load_ptrace_map_info_data_arch(pid_t pid, map_info_t* mi, map_info_data_t* data);
+
+/// Frees architecture specific data of a map.
+void free_ptrace_map_info_data_arch(map_info_t* mi, map_info_data_t* data);
+
+#endif //_CORKSCREW_PTRACE_ARCH_H
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //NDCRASH_LIBCORKSCREW_ARCH_H
@@ -1,15 +1,15 @@
 #include "ndcrash_unwinders.h"
-#include "ndcrash_dump.h"
+#include "ndcrash_frames.h"
 #include "ndcrash_log.h"
 #include "ndcrash_private.h"
-#include "sizeofa.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_arena.h"
+#include "ndcrash_remote_maps.h"
 #include <libunwind.h>
 #include <libunwind-ptrace.h>
 #include <libunwind_i.h>
-#include <mempool.h>
 #include <string.h>
 #include <ucontext.h>
-#include <android/log.h>
 #include <stdbool.h>
 #include <malloc.h>
 
@@ -36,75 +36,102 @@ static void ndcrash_libunwind_get_context(struct ucontext *context, unw_context_
 
 #ifdef ENABLE_INPROCESS
 
-void ndcrash_in_unwind_libunwind(int outfile, struct ucontext *context) {
-    // Parsing local /proc/pid/maps
-    unw_map_local_create();
+/// Flag whether local memory map of libunwind has been created by initialization function.
+static bool ndcrash_in_libunwind_map_created = false;
+
+void ndcrash_in_init_libunwind() {
+    // Re-creating local /proc/pid/maps cache. It's used by libunwind internally for memory access
+    // checks and ELF images lookup. Doing it here in order to avoid parsing in a signal handler.
+    if (ndcrash_in_libunwind_map_created) {
+        // A cache can't be replaced atomically, it's destroyed when no signal handler uses it.
+        // A handler that starts before it's created again doesn't find maps.
+        ndcrash_modules_wait_released();
+        unw_map_local_destroy();
+    }
+    ndcrash_in_libunwind_map_created = !unw_map_local_create();
+    if (!ndcrash_in_libunwind_map_created) {
+        NDCRASHLOG(ERROR, "libunwind: Call unw_map_local_create failed.");
+    }
+}
+
+void ndcrash_in_deinit_libunwind() {
+    if (ndcrash_in_libunwind_map_created) {
+        ndcrash_modules_wait_released();
+        unw_map_local_destroy();
+        ndcrash_in_libunwind_map_created = false;
+    }
+}
 
+void ndcrash_in_unwind_libunwind(struct ndcrash_frames *frames, struct ucontext *context) {
     // Cursor - the main structure used for unwinding with a huge size. Allocating on stack is undesirable
-    // due to limited alternate signal stack size. malloc isn't signal safe. Using libunwind memory pools.
-    struct mempool cursor_pool;
-    mempool_init(&cursor_pool, sizeof(unw_cursor_t), 0);
-    unw_cursor_t * const unw_cursor = mempool_alloc(&cursor_pool);
+    // due to limited alternate signal stack size. malloc isn't signal safe. Using ndcrash arena.
+    unw_cursor_t * const unw_cursor = (unw_cursor_t *) ndcrash_arena_alloc(sizeof(unw_cursor_t));
 
     // Buffer for function name.
-    char unw_function_name[NDCRASH_MAX_FUNCTION_NAME_LENGTH];
+    char * const unw_function_name = (char *) ndcrash_arena_alloc(NDCRASH_MAX_FUNCTION_NAME_LENGTH);
 
-    // Initializing context instance (processor state).
-    unw_context_t unw_ctx;
-    ndcrash_libunwind_get_context(context, &unw_ctx);
+    // Context instance (processor state). It's a copy of ucontext on some architectures, also huge.
+    unw_context_t * const unw_ctx = (unw_context_t *) ndcrash_arena_alloc(sizeof(unw_context_t));
+
+    if (!unw_cursor || !unw_function_name || !unw_ctx) {
+        NDCRASHLOG(ERROR, "libunwind: Arena is exhausted, couldn't allocate a cursor.");
+        return;
+    }
+
+    // Initializing context instance.
+    ndcrash_libunwind_get_context(context, unw_ctx);
 
     // Initializing cursor for unwinding from passed processor context.
-    if (!unw_init_local(unw_cursor, &unw_ctx)) {
+    if (!unw_init_local(unw_cursor, unw_ctx)) {
 
-        for (int i = 0; i < NDCRASH_MAX_FRAMES; ++i) {
+        for (;;) {
             // Getting program counter value for the a current stack frame.
             unw_word_t regip;
             unw_get_reg(unw_cursor, UNW_REG_IP, &regip);
 
-            // Looking for a function name.
+            // Looking for a function name unless it's resolved later by a batch symbolizer.
             unw_word_t func_offset;
-            const bool func_name_found = unw_get_proc_name(
-                    unw_cursor, unw_function_name, sizeof(unw_function_name), &func_offset) > 0;
-
-            // Looking for a object (shared library) where a function is located.
-            unw_map_cursor_t proc_map_cursor;
-            unw_map_local_cursor_get(&proc_map_cursor);
-            bool maps_found = false;
-            unw_map_t proc_map_item;
-            while (unw_map_cursor_get_next(&proc_map_cursor, &proc_map_item) > 0) {
-                if (regip >= proc_map_item.start && regip < proc_map_item.end) {
-                    maps_found = true;
-                    regip -= proc_map_item.start; // Making relative.
-                    break;
-                }
-            }
-
-            // Writing a backtrace line.
-            ndcrash_dump_backtrace_line(
-                    outfile,
-                    i,
-                    regip, // Relative if maps is found
-                    maps_found ? proc_map_item.path : NULL,
+            const bool func_name_found = !frames->defer_symbols && unw_get_proc_name(
+                    unw_cursor, unw_function_name, NDCRASH_MAX_FUNCTION_NAME_LENGTH, &func_offset) > 0;
+
+            // Looking for a object (shared library) where a function is located. Using a list
+            // of modules collected on initialization.
+            const struct ndcrash_module * const module = ndcrash_modules_find(regip);
+
+            // Adding a frame, stopping if a buffer is full.
+            const bool has_space = ndcrash_frames_add(
+                    frames,
+                    regip,
+                    module ? regip - module->load_bias : regip, // Relative if module is found
+                    module ? module->name : NULL,
                     func_name_found ? unw_function_name : NULL,
-                    func_offset);
+                    func_offset,
+                    0);
 
             // Trying to switch to a previous stack frame.
-            if (unw_step(unw_cursor) <= 0) break;
+            if (!has_space || unw_step(unw_cursor) <= 0) break;
         }
     }
-
-    // Freeing a memory for cursor.
-    mempool_free(&cursor_pool, unw_cursor);
-
-    // Destroying local /proc/pid/maps
-    unw_map_local_destroy();
-
 }
 
 #endif //ENABLE_INPROCESS
 
 #ifdef ENABLE_OUTOFPROCESS
 
+/**
+ * Data of out-of-process libunwind unwinder for a crashed process, shared by all threads.
+ */
+struct ndcrash_out_libunwind_data {
+
+    /// Cache of /proc/pid/maps used by libunwind.
+    unw_map_cursor_t proc_map_cursor;
+
+    /// Memory map with function names index. A sorted symbols table of a module is built when a
+    /// module is met for the first time and is used for all following frames and threads instead
+    /// of _UPT_get_proc_name that scans an ELF file on every call.
+    struct ndcrash_remote_maps maps;
+};
+
 /**
  * Structure that we use as "void *arg" parameter for accessor callbacks.
  */
@@ -113,6 +140,9 @@ struct ndcrash_out_libunwind_as_arg {
     /// Pointer to _UPT callbacks argument that they originally use. A result of _UPT_create.
     void *upt_info;
 
+    /// Unwinder data, used for function names lookup.
+    struct ndcrash_out_libunwind_data *data;
+
     /// Processor context in the moment of crash. We use it to implement or own access_reg callback.
     unw_context_t unw_ctx;
 };
@@ -244,11 +274,41 @@ static int ndcrash_out_libunwind_access_fpreg(unw_addr_space_t as, unw_regnum_t
     return result;
 }
 
+/**
+ * Looks for a function name in a crashed process using symbols index of unwinder data.
+ * @param data Unwinder data.
+ * @param ip Absolute address.
+ * @param offp Pointer where to write an offset of address from function start.
+ * @return Function name or NULL if not found.
+ */
+static const char *ndcrash_out_libunwind_find_symbol(struct ndcrash_out_libunwind_data *data, unw_word_t ip, unw_word_t *offp) {
+    const struct ndcrash_remote_mapping * const mapping = ndcrash_remote_maps_find(&data->maps, ip);
+    if (!mapping) return NULL;
+    uintptr_t offset = 0;
+    const char * const name = ndcrash_remote_maps_find_symbol(&data->maps, mapping, ip - mapping->base, &offset);
+    if (name) {
+        *offp = offset;
+    }
+    return name;
+}
+
 static int ndcrash_out_libunwind_get_proc_name(unw_addr_space_t as, unw_word_t ip, char *buf, size_t buf_len, unw_word_t *offp, void *arg) {
-    as->acc = _UPT_accessors;
-    const int result = _UPT_get_proc_name(as, ip, buf, buf_len, offp, ((struct ndcrash_out_libunwind_as_arg *) arg)->upt_info);
-    as->acc = ndcrash_libunwind_accessors;
-    return result;
+    const char * const name = ndcrash_out_libunwind_find_symbol(((struct ndcrash_out_libunwind_as_arg *) arg)->data, ip, offp);
+    if (!name) {
+        // Not found in the index, for example a module file couldn't be read. Falling back to
+        // _UPT_get_proc_name, it looks up a module by libunwind memory map and scans its ELF file.
+        as->acc = _UPT_accessors;
+        const int result = _UPT_get_proc_name(as, ip, buf, buf_len, offp, ((struct ndcrash_out_libunwind_as_arg *) arg)->upt_info);
+        as->acc = ndcrash_libunwind_accessors;
+        return result;
+    }
+    if (!buf_len) return -UNW_ENOMEM;
+    strncpy(buf, name, buf_len);
+    if (buf[buf_len - 1]) {
+        buf[buf_len - 1] = '\0';
+        return -UNW_ENOMEM;
+    }
+    return 0;
 }
 
 static int ndcrash_out_libunwind_resume(unw_addr_space_t as, unw_cursor_t *c, void *arg) {
@@ -275,23 +335,34 @@ unw_accessors_t ndcrash_libunwind_accessors = {
 };
 
 void * ndcrash_out_init_libunwind(pid_t pid) {
+    struct ndcrash_out_libunwind_data * const lwdata = (struct ndcrash_out_libunwind_data *)
+            malloc(sizeof(struct ndcrash_out_libunwind_data));
+    if (!lwdata) return NULL;
+
     // Initializing a single instance of /proc/pid/maps cache before any thread unwinding.
-    unw_map_cursor_t * const proc_map_cursor = (unw_map_cursor_t *) malloc(sizeof(unw_map_cursor_t));
-    if (unw_map_cursor_create(proc_map_cursor, pid)) { // Returns 0 on success.
+    if (unw_map_cursor_create(&lwdata->proc_map_cursor, pid)) { // Returns 0 on success.
         NDCRASHLOG(ERROR, "libunwind: Call unw_map_cursor_create failed.");
     }
-    return proc_map_cursor;
+
+    // Symbols aren't loaded here, only when a module is met in a backtrace.
+    if (!ndcrash_remote_maps_load(pid, &lwdata->maps)) {
+        NDCRASHLOG(ERROR, "libunwind: Couldn't read a memory map of process %d.", (int) pid);
+    }
+    return lwdata;
 }
 
 void ndcrash_out_deinit_libunwind(void *data) {
     if (!data) return;
-    unw_map_cursor_t * const proc_map_cursor = (unw_map_cursor_t *) data;
-    unw_map_cursor_destroy(proc_map_cursor);
-    free(data);
+    struct ndcrash_out_libunwind_data * const lwdata = (struct ndcrash_out_libunwind_data *) data;
+    unw_map_cursor_destroy(&lwdata->proc_map_cursor);
+    ndcrash_remote_maps_free(&lwdata->maps);
+    free(lwdata);
 }
 
-void ndcrash_out_unwind_libunwind(int outfile, pid_t tid, struct ucontext *context, void *data) {
-    unw_map_cursor_t * const proc_map_cursor = (unw_map_cursor_t *) data;
+void ndcrash_out_unwind_libunwind(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data) {
+    if (!data) return;
+    struct ndcrash_out_libunwind_data * const lwdata = (struct ndcrash_out_libunwind_data *) data;
+    unw_map_cursor_t * const proc_map_cursor = &lwdata->proc_map_cursor;
     unw_map_cursor_reset(proc_map_cursor);
 
     // If context is specified we use a special wrappers around _UPT_accessors in order to access register
@@ -304,6 +375,7 @@ void ndcrash_out_unwind_libunwind(int outfile, pid_t tid, struct ucontext *conte
 
         struct ndcrash_out_libunwind_as_arg ndcrash_as_arg;
         ndcrash_as_arg.upt_info = _UPT_create(tid);
+        ndcrash_as_arg.data = lwdata;
         void *unw_arg;
         // If context is specified it should be filled. Otherwise it will be obtained by upt accessors.
         if (context) {
@@ -315,24 +387,25 @@ void ndcrash_out_unwind_libunwind(int outfile, pid_t tid, struct ucontext *conte
 
         if (ndcrash_as_arg.upt_info) {
             unw_cursor_t unw_cursor;
-            char unw_function_name[NDCRASH_MAX_FUNCTION_NAME_LENGTH];
+            char func_name_buffer[NDCRASH_MAX_FUNCTION_NAME_LENGTH];
             if (unw_init_remote(&unw_cursor, addr_space, unw_arg) >= 0) {
-                for (int i = 0; i < NDCRASH_MAX_FRAMES; ++i) {
+                for (;;) {
                     // Getting function data and name.
                     unw_word_t regip;
                     unw_get_reg(&unw_cursor, UNW_REG_IP, &regip);
+                    const unw_word_t pc = regip;
                     unw_map_t proc_map_item = {0, 0, 0, 0, "", 0};
                     unw_map_cursor_reset(proc_map_cursor);
 
-                    // Looking for a function name.
-                    unw_word_t func_offset;
-                    const bool func_name_found = unw_get_proc_name_by_ip(
-                            addr_space,
-                            regip,
-                            unw_function_name,
-                            sizeofa(unw_function_name),
-                            &func_offset,
-                            unw_arg) >= 0 && unw_function_name[0] != '\0';
+                    // Looking for a function name. Using the index directly, accessors may be
+                    // not wrapped when a context isn't specified. If it's not found there falling
+                    // back to get_proc_name accessor.
+                    unw_word_t func_offset = 0;
+                    const char *func_name = ndcrash_out_libunwind_find_symbol(lwdata, regip, &func_offset);
+                    if (!func_name && unw_get_proc_name_by_ip(
+                            addr_space, regip, func_name_buffer, sizeof(func_name_buffer), &func_offset, unw_arg) >= 0) {
+                        func_name = func_name_buffer;
+                    }
 
                     // Looking for a object (shared library) where a function is located.
                     bool maps_found = false;
@@ -344,17 +417,18 @@ void ndcrash_out_unwind_libunwind(int outfile, pid_t tid, struct ucontext *conte
                         }
                     }
 
-                    // Writing a backtrace line.
-                    ndcrash_dump_backtrace_line(
-                            outfile,
-                            i,
+                    // Adding a frame, stopping if a buffer is full.
+                    const bool has_space = ndcrash_frames_add(
+                            frames,
+                            pc,
                             regip, // Relative if maps is found
                             maps_found ? proc_map_item.path : NULL,
-                            func_name_found ? unw_function_name : NULL,
-                            func_offset);
+                            func_name,
+                            func_offset,
+                            0);
 
                     // Trying to switch to a previous stack frame.
-                    if (unw_step(&unw_cursor) <= 0) break;
+                    if (!has_space || unw_step(&unw_cursor) <= 0) break;
                 }
             } else {
                 NDCRASHLOG(ERROR, "libunwind: Failed to initialize a cursor.");
@@ -1,13 +1,23 @@
 #include "ndcrash_unwinders.h"
 #include "ndcrash_log.h"
-#include "ndcrash_dump.h"
+#include "ndcrash_frames.h"
 #include "ndcrash_private.h"
-#include <android/log.h>
+#include "ndcrash_modules.h"
 #include <unwindstack/Elf.h>
 #include <unwindstack/MapInfo.h>
 #include <unwindstack/Maps.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
+#include <unwindstack/RegsArm.h>
+#include <unwindstack/RegsArm64.h>
+#include <unwindstack/RegsX86.h>
+#include <unwindstack/RegsX86_64.h>
+#include <unwindstack/MachineArm.h>
+#include <unwindstack/MachineArm64.h>
+#include <unwindstack/MachineX86.h>
+#include <unwindstack/MachineX86_64.h>
+#include <sys/mman.h>
+#include <string.h>
 
 
 extern "C" {
@@ -18,45 +28,36 @@ using namespace unwindstack;
 
 /**
  * Common unwinding method for in-process and out-of-process.
- * @param outfile Output file descriptor for a crash dump.
- * @param context Processor context to unwind a stack.
+ * @param frames Frames buffer to fill.
+ * @param regs Processor registers to unwind a stack, modified during unwinding.
  * @param maps Parsed libunwindstack memory maps instance.
  * @param memory libunwindstack Memory instance.
+ * @param unw_function_name String used as a buffer for function names. If it's NULL function names
+ * are taken from symbols tables of modules loaded on in-process initialization and are copied to
+ * a frames buffer directly, libunwindstack isn't used for names lookup.
  * @param withDebugData Flag whether to use GNU debug symbols data on unwinding.
  */
 static inline void ndcrash_common_unwind_libunwindstack(
-        int outfile,
-        const std::unique_ptr<Regs> &regs,
+        struct ndcrash_frames *frames,
+        Regs *regs,
         Maps &maps,
         const std::shared_ptr<Memory> &memory,
+        std::string *unw_function_name,
         bool withDebugData) {
-    // String for function name.
-    std::string unw_function_name;
+    for (size_t frame_num = 0; !ndcrash_frames_full(frames); frame_num++) {
+        const uintptr_t pc = (uintptr_t)regs->pc();
 
-    for (size_t frame_num = 0; frame_num < NDCRASH_MAX_FRAMES; frame_num++) {
         // Looking for a map info item for pc on this unwinding step.
-        MapInfo * const map_info = maps.Find(regs->pc());
+        MapInfo * const map_info = maps.Find(pc);
         if (!map_info) {
-            ndcrash_dump_backtrace_line(
-                    outfile,
-                    (int)frame_num,
-                    (intptr_t)regs->pc(),
-                    NULL,
-                    NULL,
-                    0);
+            ndcrash_frames_add(frames, pc, pc, NULL, NULL, 0, 0);
             break;
         }
 
         // Loading data from ELF
         Elf * const elf = map_info->GetElf(memory, withDebugData);
         if (!elf) {
-            ndcrash_dump_backtrace_line(
-                    outfile,
-                    (int)frame_num,
-                    (intptr_t)regs->pc(),
-                    map_info->name.c_str(),
-                    NULL,
-                    0);
+            ndcrash_frames_add(frames, pc, pc, map_info->name.c_str(), NULL, 0, 0);
             break;
         }
 
@@ -70,30 +71,38 @@ static inline void ndcrash_common_unwind_libunwindstack(
             adjusted_rel_pc -= regs->GetPcAdjustment(rel_pc, elf);
         }
 
-        // Getting function name and writing value to a log.
-        uint64_t func_offset = 0;
-        if (elf->GetFunctionName(rel_pc, &unw_function_name, &func_offset)) {
-            ndcrash_dump_backtrace_line(
-                    outfile,
-                    (int)frame_num,
-                    (intptr_t)rel_pc,
-                    map_info->name.c_str(),
-                    unw_function_name.c_str(),
-                    (intptr_t) func_offset);
+        // Getting function name and adding a frame. Name lookup is skipped if it's resolved later
+        // by a batch symbolizer.
+        const char *func_name = NULL;
+        uintptr_t func_offset = 0;
+        if (frames->defer_symbols) {
+            // Resolved later.
+        } else if (unw_function_name) {
+            uint64_t offset = 0;
+            if (elf->GetFunctionName(rel_pc, unw_function_name, &offset)) {
+                func_name = unw_function_name->c_str();
+                func_offset = (uintptr_t)offset;
+            }
         } else {
-            unw_function_name.clear();
-            ndcrash_dump_backtrace_line(
-                    outfile,
-                    (int)frame_num,
-                    (intptr_t)rel_pc,
-                    map_info->name.c_str(),
-                    NULL,
-                    0);
+#ifdef ENABLE_INPROCESS
+            const struct ndcrash_module * const module = ndcrash_modules_find(pc);
+            if (module) {
+                func_name = ndcrash_elf_find_symbol(&module->symbols, pc - module->load_bias, &func_offset);
+            }
+#endif
         }
+        ndcrash_frames_add(
+                frames,
+                pc,
+                (uintptr_t)rel_pc,
+                map_info->name.c_str(),
+                func_name,
+                func_name ? func_offset : 0,
+                0);
 
         // Trying to switch to a next frame.
         bool finished = false;
-        if (!elf->Step(rel_pc, adjusted_rel_pc, map_info->elf_offset, regs.get(), memory.get(), &finished)) {
+        if (!elf->Step(rel_pc, adjusted_rel_pc, map_info->elf_offset, regs, memory.get(), &finished)) {
             break;
         }
     }
@@ -103,23 +112,168 @@ static inline void ndcrash_common_unwind_libunwindstack(
 
 #ifdef ENABLE_INPROCESS
 
-void ndcrash_in_unwind_libunwindstack(int outfile, struct ucontext *context) {
-    // Initializing /proc/self/maps cache.
+/// Registers class for a current architecture.
+#if defined(__arm__)
+typedef RegsArm ndcrash_in_libunwindstack_regs;
+#elif defined(__aarch64__)
+typedef RegsArm64 ndcrash_in_libunwindstack_regs;
+#elif defined(__i386__)
+typedef RegsX86 ndcrash_in_libunwindstack_regs;
+#elif defined(__x86_64__)
+typedef RegsX86_64 ndcrash_in_libunwindstack_regs;
+#else
+#error Architecture is not supported.
+#endif
+
+/**
+ * Objects used for in-process unwinding. All of them are constructed on initialization in order
+ * to avoid heap usage by these objects in a signal handler. Note that libunwindstack still may use
+ * heap internally on unwinding, for example DWARF sections cache entries on the first step through
+ * a function, so this unwinder isn't safe for crashes caused by heap corruption.
+ */
+struct ndcrash_in_libunwindstack_state {
+
+    /// Memory map of a current process.
     LocalMaps maps;
-    if (!maps.Parse()) {
+
+    /// Accessor for a memory of a current process.
+    std::shared_ptr<Memory> memory;
+
+    /// Registers instance, refilled from a context of every unwound thread. RegsImpl keeps values
+    /// in a std::vector, so it's constructed here instead of a signal handler.
+    ndcrash_in_libunwindstack_regs regs;
+
+    /// Flag whether this state is being used by a signal handler.
+    bool busy;
+};
+
+/// State for in-process unwinding that is created on initialization. Replaced on modules refresh.
+static ndcrash_in_libunwindstack_state *ndcrash_in_libunwindstack_instance = NULL;
+
+/**
+ * Fills a pre-constructed registers instance by values from ucontext. Unlike
+ * Regs::CreateFromUcontext it doesn't use heap.
+ * @param regs Registers instance to fill, values of a previous thread are cleared.
+ * @param context Processor context of a thread.
+ */
+static void ndcrash_in_libunwindstack_fill_regs(Regs *regs, const struct ucontext *context) {
+    const mcontext_t * const ctx = &context->uc_mcontext;
+#if defined(__arm__)
+    uint32_t * const raw = static_cast<uint32_t *>(regs->RawData());
+    memset(raw, 0, sizeof(*raw) * regs->total_regs());
+    // Registers r0-r15 are stored sequentially in sigcontext.
+    memcpy(raw, &ctx->arm_r0, sizeof(uint32_t) * ARM_REG_LAST);
+#elif defined(__aarch64__)
+    uint64_t * const raw = static_cast<uint64_t *>(regs->RawData());
+    memset(raw, 0, sizeof(*raw) * regs->total_regs());
+    memcpy(raw, ctx->regs, sizeof(uint64_t) * ARM64_REG_R31);
+    raw[ARM64_REG_SP] = ctx->sp;
+    raw[ARM64_REG_PC] = ctx->pc;
+#elif defined(__i386__)
+    uint32_t * const raw = static_cast<uint32_t *>(regs->RawData());
+    memset(raw, 0, sizeof(*raw) * regs->total_regs());
+    raw[X86_REG_EAX] = ctx->gregs[REG_EAX];
+    raw[X86_REG_ECX] = ctx->gregs[REG_ECX];
+    raw[X86_REG_EDX] = ctx->gregs[REG_EDX];
+    raw[X86_REG_EBX] = ctx->gregs[REG_EBX];
+    raw[X86_REG_ESP] = ctx->gregs[REG_ESP];
+    raw[X86_REG_EBP] = ctx->gregs[REG_EBP];
+    raw[X86_REG_ESI] = ctx->gregs[REG_ESI];
+    raw[X86_REG_EDI] = ctx->gregs[REG_EDI];
+    raw[X86_REG_EIP] = ctx->gregs[REG_EIP];
+#elif defined(__x86_64__)
+    uint64_t * const raw = static_cast<uint64_t *>(regs->RawData());
+    memset(raw, 0, sizeof(*raw) * regs->total_regs());
+    raw[X86_64_REG_RAX] = ctx->gregs[REG_RAX];
+    raw[X86_64_REG_RDX] = ctx->gregs[REG_RDX];
+    raw[X86_64_REG_RCX] = ctx->gregs[REG_RCX];
+    raw[X86_64_REG_RBX] = ctx->gregs[REG_RBX];
+    raw[X86_64_REG_RSI] = ctx->gregs[REG_RSI];
+    raw[X86_64_REG_RDI] = ctx->gregs[REG_RDI];
+    raw[X86_64_REG_RBP] = ctx->gregs[REG_RBP];
+    raw[X86_64_REG_RSP] = ctx->gregs[REG_RSP];
+    raw[X86_64_REG_R8] = ctx->gregs[REG_R8];
+    raw[X86_64_REG_R9] = ctx->gregs[REG_R9];
+    raw[X86_64_REG_R10] = ctx->gregs[REG_R10];
+    raw[X86_64_REG_R11] = ctx->gregs[REG_R11];
+    raw[X86_64_REG_R12] = ctx->gregs[REG_R12];
+    raw[X86_64_REG_R13] = ctx->gregs[REG_R13];
+    raw[X86_64_REG_R14] = ctx->gregs[REG_R14];
+    raw[X86_64_REG_R15] = ctx->gregs[REG_R15];
+    raw[X86_64_REG_RIP] = ctx->gregs[REG_RIP];
+#endif
+}
+
+void ndcrash_in_init_libunwindstack() {
+    std::unique_ptr<ndcrash_in_libunwindstack_state> state(new ndcrash_in_libunwindstack_state);
+    state->busy = false;
+
+    // Initializing /proc/self/maps cache. Doing it here in order to avoid parsing in a signal handler.
+    if (!state->maps.Parse()) {
         NDCRASHLOG(ERROR, "libunwindstack: failed to parse local /proc/pid/maps.");
         return;
     }
-    // Unwinding stack.
-    const std::shared_ptr<Memory> memory(new MemoryLocal);
+    state->memory.reset(new MemoryLocal);
+
+    // Loading ELF data for all executable maps. Otherwise it's loaded lazily on first access that
+    // happens in a signal handler. GNU debug data is disabled as well as in a signal handler.
+    for (auto &map_info : state->maps) {
+        if (map_info->flags & PROT_EXEC) {
+            map_info->GetElf(state->memory, false);
+        }
+    }
+
+    // Publishing a new instance. An old one is deleted when signal handlers that have started
+    // before publishing and may use it are finished.
+    ndcrash_in_libunwindstack_state * const old_state =
+            __atomic_exchange_n(&ndcrash_in_libunwindstack_instance, state.release(), __ATOMIC_SEQ_CST);
+    if (old_state) {
+        ndcrash_modules_wait_released();
+        delete old_state;
+    }
+}
+
+void ndcrash_in_deinit_libunwindstack() {
+    ndcrash_in_libunwindstack_state * const old_state = __atomic_exchange_n(
+            &ndcrash_in_libunwindstack_instance,
+            (ndcrash_in_libunwindstack_state *) NULL,
+            __ATOMIC_SEQ_CST);
+    if (old_state) {
+        ndcrash_modules_wait_released();
+        delete old_state;
+    }
+}
+
+void ndcrash_in_unwind_libunwindstack(struct ndcrash_frames *frames, struct ucontext *context) {
+    // Using objects constructed on initialization.
+    ndcrash_in_libunwindstack_state * const state =
+            __atomic_load_n(&ndcrash_in_libunwindstack_instance, __ATOMIC_ACQUIRE);
+    if (!state) {
+        NDCRASHLOG(ERROR, "libunwindstack: in-process unwinder isn't initialized.");
+        return;
+    }
+
+    // Pre-constructed registers can't be shared between threads that crash simultaneously.
+    // Simultaneous crashes are serialized by a signal handler, this is only a safety check.
+    if (__atomic_exchange_n(&state->busy, true, __ATOMIC_ACQUIRE)) {
+        NDCRASHLOG(ERROR, "libunwindstack: in-process unwinder is busy.");
+        return;
+    }
+    Regs * const regs = &state->regs;
+    ndcrash_in_libunwindstack_fill_regs(regs, context);
+
     // GNU debug symbols usage is disabled, it's quite expensive and unwinding may fail because
-    // in signal handler we have a very limited stack size.
+    // in signal handler we have a very limited stack size. Function names are taken from modules
+    // symbols tables and copied to a frames buffer, libunwindstack would assign them to a string.
     ndcrash_common_unwind_libunwindstack(
-            outfile,
-            std::unique_ptr<Regs>(Regs::CreateFromUcontext(Regs::CurrentArch(), context)),
-            maps,
-            memory,
+            frames,
+            regs,
+            state->maps,
+            state->memory,
+            NULL,
             false);
+
+    __atomic_store_n(&state->busy, false, __ATOMIC_RELEASE);
 }
 
 #endif //ENABLE_INPROCESS
@@ -139,7 +293,7 @@ void ndcrash_out_deinit_libunwindstack(void *data) {
     delete static_cast<RemoteMaps *>(data);
 }
 
-void ndcrash_out_unwind_libunwindstack(int outfile, pid_t tid, struct ucontext *context, void *data) {
+void ndcrash_out_unwind_libunwindstack(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data) {
     RemoteMaps * const maps = static_cast<RemoteMaps *>(data);
     const std::shared_ptr<Memory> memory(new MemoryRemote(tid));
     std::unique_ptr<Regs> regs;
@@ -152,7 +306,8 @@ void ndcrash_out_unwind_libunwindstack(int outfile, pid_t tid, struct ucontext *
             return;
         }
     }
-    ndcrash_common_unwind_libunwindstack(outfile, regs, *maps, memory, true);
+    std::string unw_function_name;
+    ndcrash_common_unwind_libunwindstack(frames, regs.get(), *maps, memory, &unw_function_name, true);
 }
 
 #endif //ENABLE_OUTOFPROCESS
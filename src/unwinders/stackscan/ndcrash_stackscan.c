@@ -1,123 +1,258 @@
 #include "ndcrash_unwinders.h"
-#include "ndcrash_dump.h"
+#include "ndcrash_frames.h"
 #include "ndcrash_private.h"
-#include "ndcrash_memory_map.h"
+#include "ndcrash_altstack.h"
 #include "ndcrash_utils.h"
+#include "ndcrash_modules.h"
+#include "ndcrash_ucontext.h"
+#include "ndcrash_remote_memory.h"
+#include "ndcrash_remote_maps.h"
+#include "ndcrash_log.h"
 #include <unwind.h>
-#include <dlfcn.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
+#if (defined(__aarch64__) || defined(__arm__)) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__x86_64__) && defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__i386__) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-#ifdef ENABLE_INPROCESS
+/// Count of stack elements that are checked at once by ndcrash_stackscan_block_mask.
+#define NDCRASH_STACKSCAN_BLOCK 4
 
 /**
- * Extracts program counter (instruction pointer) value from passed ucontext structure.
- * @param uc Pointer to ucontext structure.
- * @return Program counter value.
+ * Checks a block of NDCRASH_STACKSCAN_BLOCK stack elements whether they are within [start, end)
+ * range. Uses SIMD instructions where it's possible.
+ * @param words Pointer to stack elements.
+ * @param start Range start, inclusive.
+ * @param end Range end, exclusive.
+ * @return Bit mask, i-th bit is set if i-th element is within a range.
  */
-static uintptr_t ndcrash_pc_from_ucontext(const ucontext_t *uc) {
-#if defined(__arm__)
-    return uc->uc_mcontext.arm_pc;
-#elif defined(__aarch64__)
-    return uc->uc_mcontext.pc;
-#elif defined(__i386__)
-    return uc->uc_mcontext.gregs[REG_EIP];
-#elif defined(__x86_64__)
-    return uc->uc_mcontext.gregs[REG_RIP];
+static inline unsigned ndcrash_stackscan_block_mask(const uintptr_t *words, uintptr_t start, uintptr_t end) {
+#if defined(__aarch64__) && defined(__ARM_NEON)
+    const uint64x2_t vstart = vdupq_n_u64(start), vend = vdupq_n_u64(end);
+    const uint64x2_t lo = vld1q_u64((const uint64_t *) words);
+    const uint64x2_t hi = vld1q_u64((const uint64_t *) words + 2);
+    const uint64x2_t mlo = vandq_u64(vcgeq_u64(lo, vstart), vcltq_u64(lo, vend));
+    const uint64x2_t mhi = vandq_u64(vcgeq_u64(hi, vstart), vcltq_u64(hi, vend));
+    return (unsigned) (vgetq_lane_u64(mlo, 0) & 1) |
+           (unsigned) (vgetq_lane_u64(mlo, 1) & 2) |
+           (unsigned) (vgetq_lane_u64(mhi, 0) & 4) |
+           (unsigned) (vgetq_lane_u64(mhi, 1) & 8);
+#elif defined(__arm__) && defined(__ARM_NEON)
+    const uint32x4_t v = vld1q_u32((const uint32_t *) words);
+    const uint32x4_t m = vandq_u32(vcgeq_u32(v, vdupq_n_u32(start)), vcltq_u32(v, vdupq_n_u32(end)));
+    const uint32x4_t bits = { 1, 2, 4, 8 };
+    const uint32x4_t r = vandq_u32(m, bits);
+    return vgetq_lane_u32(r, 0) | vgetq_lane_u32(r, 1) | vgetq_lane_u32(r, 2) | vgetq_lane_u32(r, 3);
+#elif defined(__x86_64__) && defined(__SSE4_2__)
+    // There is no unsigned comparison, flipping a sign bit to use signed one.
+    const __m128i sign = _mm_set1_epi64x((long long) 0x8000000000000000ULL);
+    const __m128i vstart = _mm_xor_si128(_mm_set1_epi64x((long long) start), sign);
+    const __m128i vend = _mm_xor_si128(_mm_set1_epi64x((long long) end), sign);
+    const __m128i lo = _mm_xor_si128(_mm_loadu_si128((const __m128i *) words), sign);
+    const __m128i hi = _mm_xor_si128(_mm_loadu_si128((const __m128i *) words + 1), sign);
+    // Element is within a range if !(start > element) && end > element.
+    const __m128i mlo = _mm_andnot_si128(_mm_cmpgt_epi64(vstart, lo), _mm_cmpgt_epi64(vend, lo));
+    const __m128i mhi = _mm_andnot_si128(_mm_cmpgt_epi64(vstart, hi), _mm_cmpgt_epi64(vend, hi));
+    return (unsigned) _mm_movemask_pd(_mm_castsi128_pd(mlo)) |
+           ((unsigned) _mm_movemask_pd(_mm_castsi128_pd(mhi)) << 2);
+#elif defined(__i386__) && defined(__SSE2__)
+    const __m128i sign = _mm_set1_epi32((int) 0x80000000U);
+    const __m128i vstart = _mm_xor_si128(_mm_set1_epi32((int) start), sign);
+    const __m128i vend = _mm_xor_si128(_mm_set1_epi32((int) end), sign);
+    const __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *) words), sign);
+    const __m128i m = _mm_andnot_si128(_mm_cmpgt_epi32(vstart, v), _mm_cmpgt_epi32(vend, v));
+    return (unsigned) _mm_movemask_ps(_mm_castsi128_ps(m));
+#else
+    unsigned mask = 0;
+    for (unsigned i = 0; i < NDCRASH_STACKSCAN_BLOCK; ++i) {
+        if (words[i] >= start && words[i] < end) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
 #endif
 }
 
+/// Maximum count of coarse address ranges checked by a prefilter. Executable segments are merged
+/// into them, segments of system and application libraries are far apart on 64-bit architectures,
+/// so a single range would cover almost every stack value.
+#define NDCRASH_STACKSCAN_RANGES 4
+
 /**
- * Extracts stack pointer value from passed ucontext structure.
- * @param uc Pointer to ucontext structure.
- * @return Stack pointer value.
+ * Coarse address ranges covering executable code, sorted by address.
  */
-static uintptr_t ndcrash_sp_from_ucontext(const ucontext_t *uc) {
-#if defined(__arm__)
-    return uc->uc_mcontext.arm_sp;
-#elif defined(__aarch64__)
-    return uc->uc_mcontext.sp;
-#elif defined(__i386__)
-    return uc->uc_mcontext.gregs[REG_ESP];
-#elif defined(__x86_64__)
-    return uc->uc_mcontext.gregs[REG_RSP];
-#endif
-}
+struct ndcrash_stackscan_ranges {
+
+    /// Count of filled ranges.
+    size_t count;
+
+    /// Range starts, inclusive. One extra element is used while ranges are added.
+    uintptr_t start[NDCRASH_STACKSCAN_RANGES + 1];
+
+    /// Range ends, exclusive.
+    uintptr_t end[NDCRASH_STACKSCAN_RANGES + 1];
+};
 
 /**
- * Rewinds program counter value to an address of a previous instruction.
- * @param pc Program counter value to rewind.
- * @return Rewound program counter value.
+ * Adds an address range to coarse ranges. Ranges should be added in ascending order. When count of
+ * ranges exceeds NDCRASH_STACKSCAN_RANGES two neighbours with the smallest gap are merged, so the
+ * largest gaps between executable segments are kept.
+ * @param ranges Coarse ranges, should be zeroed before the first call.
+ * @param start Start of a range, inclusive.
+ * @param end End of a range, exclusive.
  */
-static uintptr_t ndcrash_rewind_pc(uintptr_t pc) {
-#ifdef __arm__
-    if (pc & 1) {
-        // Thumb mode.
-        const uintptr_t value = *((uintptr_t *)(pc - 5));
-        if ((value & 0xe000f000) != 0xe000f000) {
-            return pc - 2;
+static void ndcrash_stackscan_ranges_add(struct ndcrash_stackscan_ranges *ranges, uintptr_t start, uintptr_t end) {
+    if (ranges->count && start <= ranges->end[ranges->count - 1]) {
+        if (end > ranges->end[ranges->count - 1]) {
+            ranges->end[ranges->count - 1] = end;
         }
+        return;
     }
-    return pc - 4;
-#elif defined(__aarch64__)
-    return pc < 4 ? pc : pc - 4;
-#elif defined(__i386__) || defined(__x86_64__)
-    return pc - 1;
-#endif
+    ranges->start[ranges->count] = start;
+    ranges->end[ranges->count] = end;
+    if (++ranges->count <= NDCRASH_STACKSCAN_RANGES) return;
+    size_t merged = 0;
+    for (size_t i = 1; i + 1 < ranges->count; ++i) {
+        if (ranges->start[i + 1] - ranges->end[i] < ranges->start[merged + 1] - ranges->end[merged]) {
+            merged = i;
+        }
+    }
+    ranges->end[merged] = ranges->end[merged + 1];
+    for (size_t i = merged + 1; i + 1 < ranges->count; ++i) {
+        ranges->start[i] = ranges->start[i + 1];
+        ranges->end[i] = ranges->end[i + 1];
+    }
+    --ranges->count;
+}
+
+/**
+ * Checks a block of NDCRASH_STACKSCAN_BLOCK stack elements whether they are within coarse ranges.
+ * @param words Pointer to stack elements.
+ * @param ranges Coarse ranges.
+ * @return Bit mask, i-th bit is set if i-th element is within any range.
+ */
+static inline unsigned ndcrash_stackscan_ranges_mask(const uintptr_t *words, const struct ndcrash_stackscan_ranges *ranges) {
+    unsigned mask = 0;
+    for (size_t i = 0; i < ranges->count; ++i) {
+        mask |= ndcrash_stackscan_block_mask(words, ranges->start[i], ranges->end[i]);
+    }
+    return mask;
 }
 
 /**
- * Check whether a specified library file name can be added to a backtrace. We don't add functions
- * from system libraries.
- * @return Flag value.
+ * Checks a single stack element whether it's within coarse ranges.
+ * @param word Stack element.
+ * @param ranges Coarse ranges.
+ * @return 1 if an element is within any range, otherwise 0.
  */
-static bool ndcrash_dl_fname_can_be_added(const char *library_file_name) {
-    if (!library_file_name || !library_file_name[0]) return false;
-    return !strstr(library_file_name, "/system/") &&
-           !strstr(library_file_name, "libc.so") &&
-           !strstr(library_file_name, "libart.so") &&
-           !strstr(library_file_name, "libdvm.so") &&
-           !strstr(library_file_name, "libcutils.so") &&
-           !strstr(library_file_name, "libandroid_runtime.so") &&
-           !strstr(library_file_name, "libbcc.so") &&
-           !strstr(library_file_name, "base.odex") &&
-           !strstr(library_file_name, "[vdso]");
+static inline unsigned ndcrash_stackscan_ranges_contain(uintptr_t word, const struct ndcrash_stackscan_ranges *ranges) {
+    for (size_t i = 0; i < ranges->count; ++i) {
+        if (word >= ranges->start[i] && word < ranges->end[i]) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Type of pointer to a function that checks a stack element and adds it to a backtrace if it
+ * points to a function. See ndcrash_try_unwind_frame for arguments description.
+ */
+typedef void (*ndcrash_stackscan_frame_func_ptr)(uintptr_t addr, struct ndcrash_frames *frames, bool rewind, void *arg);
+
+/**
+ * Scans a copy of stack by blocks of elements, each element of block is passed to a frame function
+ * only if it has passed bounds check. Most of stack elements are out of executable code ranges and
+ * are skipped without a table lookup.
+ * @param stack_content Pointer to the first stack element.
+ * @param stack_end Pointer after the last stack element.
+ * @param ranges Coarse ranges of executable code.
+ * @param frames Frames buffer where to add frames.
+ * @param try_frame Function which checks an element and adds a frame.
+ * @param arg Argument passed to a frame function.
+ * @param skip_value Value which is skipped if it's found while frames count is equal to
+ * skip_frames_count. Used for lr value on 32-bit arm, the same value is usually saved to a stack.
+ * @param skip_frames_count Frames count for skip_value, SIZE_MAX if nothing is skipped.
+ */
+static void ndcrash_stackscan_scan(
+        const uintptr_t *stack_content,
+        const uintptr_t *stack_end,
+        const struct ndcrash_stackscan_ranges *ranges,
+        struct ndcrash_frames *frames,
+        ndcrash_stackscan_frame_func_ptr try_frame,
+        void *arg,
+        uintptr_t skip_value,
+        size_t skip_frames_count) {
+    for (; stack_content != stack_end && !ndcrash_frames_full(frames);) {
+        unsigned mask;
+        unsigned block_size;
+        if (stack_end - stack_content >= NDCRASH_STACKSCAN_BLOCK) {
+            mask = ndcrash_stackscan_ranges_mask(stack_content, ranges);
+            block_size = NDCRASH_STACKSCAN_BLOCK;
+        } else {
+            mask = ndcrash_stackscan_ranges_contain(*stack_content, ranges);
+            block_size = 1;
+        }
+        for (unsigned i = 0; mask && !ndcrash_frames_full(frames); ++i, mask >>= 1) {
+            if (!(mask & 1)) continue;
+            const uintptr_t value = stack_content[i];
+            if (frames->count == skip_frames_count && value == skip_value) {
+                skip_frames_count = SIZE_MAX;
+                continue;
+            }
+            try_frame(value, frames, true, arg);
+        }
+        stack_content += block_size;
+    }
 }
 
+#ifdef ENABLE_INPROCESS
 
 /**
  * Looks for a function containing specified address and adds it to a backtrace if found.
  * @param addr Address value to search a function. This may be a program counter value (for the
  * first frame) or any value from a stack.
- * @param outfile A file descriptor where to write a crash dump.
- * @param frameno A pointer to frame number which is incremented when a function is found.
+ * @param frames Frames buffer where to add a frame.
  * @param rewind A flag whether to perform addr rewinding to a previous instruction. Typically it's
- * not required for program counter value but required for values from stack.
+ * not required for program counter value but required for values from stack. Also it means that
+ * an address is taken from a stack.
+ * @param arg Unused, see ndcrash_stackscan_frame_func_ptr.
  */
-static void ndcrash_try_unwind_frame(uintptr_t addr, int outfile, int *frameno, bool rewind) {
-    Dl_info info;
-    // Accepting only stack items that have function name.
+static void ndcrash_try_unwind_frame(uintptr_t addr, struct ndcrash_frames *frames, bool rewind, void *arg) {
+    // Cheap check first: an address should be within executable code of a loaded module.
     // Also ignoring all system functions.
-    if (addr && dladdr((void *) addr, &info) && info.dli_sname && ndcrash_dl_fname_can_be_added(info.dli_fname)) {
+    const struct ndcrash_exec_range * const range = ndcrash_modules_find_exec(addr);
+    if (!range || range->module->is_system || !range->module->name[0]) return;
+    const struct ndcrash_module * const module = range->module;
+
+    // Accepting only stack items that have function name. Looking for it in a symbols table
+    // loaded on initialization, this doesn't require a dynamic linker lock unlike dladdr.
+    uintptr_t func_offset;
+    const char * const func_name = ndcrash_elf_find_symbol(&module->symbols, addr - module->load_bias, &func_offset);
+    if (func_name) {
         // If function is found assuming it's a return address. But really it may be a pointer to
         // a function saved to a function argument or a local variable. In this case it will be added
         // to a backtrace. This is not a bug, it's a drawback of this unwinding algorithm.
         if (rewind) {
-            addr = ndcrash_rewind_pc(addr);
-        }
-        // Not allowing negative offsets.
-        if (addr >= (uintptr_t) info.dli_saddr) {
-            // Writing a line to a log with frame number increment.
-            ndcrash_dump_backtrace_line(
-                    outfile,
-                    (*frameno)++,
-                    (uintptr_t) addr - (uintptr_t) info.dli_fbase,
-                    info.dli_fname,
-                    info.dli_sname,
-                    addr - (uintptr_t) info.dli_saddr
-            );
+            const uintptr_t rewound = ndcrash_rewind_pc(addr);
+            // Not allowing negative offsets.
+            if (addr - rewound > func_offset) return;
+            func_offset -= addr - rewound;
+            addr = rewound;
         }
+        ndcrash_frames_add(
+                frames,
+                addr,
+                addr - module->load_bias,
+                module->name,
+                func_name,
+                func_offset,
+                rewind ? ndcrash_frame_scanned : 0);
     }
 }
 
@@ -134,36 +269,17 @@ typedef struct {
 
 } ndcrash_stackscan_stack_t;
 
-/**
- * Callback for a memory map parsing function. We use it to make sure that used stack bounds don't
- * run out of stack memory area to prevent a crash. For arguments description see
- * ndcrash_memory_map_entry_callback type definition.
- */
-static void ndcrash_stackscan_maps_callback(uintptr_t start, uintptr_t end, void *data, bool *stop) {
-    ndcrash_stackscan_stack_t *stack = (ndcrash_stackscan_stack_t *) data;
-    if (start <= stack->sp && stack->sp < end) {
-        if (stack->end > end) {
-            stack->end = end;
-        }
-        *stop = true;
-    }
-}
-
-void ndcrash_in_unwind_stackscan(int outfile, struct ucontext *context) {
-
-    // Program counter is always the first element
-    int frameno = 0;
+void ndcrash_in_unwind_stackscan(struct ndcrash_frames *frames, struct ucontext *context) {
 
     // The first backtrace element is always program counter.
-    ndcrash_try_unwind_frame(ndcrash_pc_from_ucontext(context), outfile, &frameno, false);
+    ndcrash_try_unwind_frame(ndcrash_pc_from_ucontext(context), frames, false, NULL);
 
 #ifdef __arm__
     // For 32-bit arm architecture the second backtrace element is always lr register.
-    // Third and following are obtained from stack.
-    {
-        int frameno2 = frameno; // Not incrementing frameno.
-        ndcrash_try_unwind_frame(context->uc_mcontext.arm_lr, outfile, &frameno2, true);
-    }
+    // Third and following are obtained from stack. The same value is usually saved to a stack,
+    // it's skipped if it's the first found stack element.
+    ndcrash_try_unwind_frame(context->uc_mcontext.arm_lr, frames, true, NULL);
+    const size_t lr_frames_count = frames->count;
 #endif
 
     // Filling in initial stack bounds to scan.
@@ -171,23 +287,168 @@ void ndcrash_in_unwind_stackscan(int outfile, struct ucontext *context) {
     stack.sp = ndcrash_sp_from_ucontext(context);
     stack.end = stack.sp + getpagesize();
 
-    // Searching sp value in memory map in order to avoid walking out of stack bounds.
-    ndcrash_parse_memory_map(getpid(), &ndcrash_stackscan_maps_callback, &stack);
+    // Limiting by stack bounds in order to avoid walking out of stack memory.
+    const uintptr_t stack_end = ndcrash_altstack_find_stack_end(stack.sp);
+    if (stack.end > stack_end) {
+        stack.end = stack_end;
+    }
 
-    // Scanning a stack by simple iteration of each stack element.
-    uintptr_t *stack_content = (uintptr_t *) stack.sp;
-    uintptr_t *const stack_end = (uintptr_t *) stack.end;
+    // Coarse ranges of executable code of non-system modules. Most of stack elements are out of
+    // them and are skipped without a table lookup.
+    struct ndcrash_stackscan_ranges ranges;
+    memset(&ranges, 0, sizeof(ranges));
+    size_t exec_ranges_count;
+    const struct ndcrash_exec_range * const exec_ranges = ndcrash_modules_exec_ranges(&exec_ranges_count);
+    for (size_t i = 0; i < exec_ranges_count; ++i) {
+        if (exec_ranges[i].module->is_system || !exec_ranges[i].module->name[0]) continue;
+        ndcrash_stackscan_ranges_add(&ranges, exec_ranges[i].start, exec_ranges[i].end);
+    }
+    if (!ranges.count) return;
 
-    for (; stack_content != stack_end && frameno < NDCRASH_MAX_FRAMES; ++stack_content) {
 #ifdef __arm__
-        // The second backtrace line may already been included from lr.
-        if (frameno == 1 && *stack_content == context->uc_mcontext.arm_lr) {
-            ++frameno;
-            continue;
+    const uintptr_t skip_value = context->uc_mcontext.arm_lr;
+#else
+    const uintptr_t skip_value = 0;
+    const size_t lr_frames_count = SIZE_MAX;
+#endif
+    ndcrash_stackscan_scan(
+            (const uintptr_t *) stack.sp,
+            (const uintptr_t *) stack.end,
+            &ranges,
+            frames,
+            &ndcrash_try_unwind_frame,
+            NULL,
+            skip_value,
+            lr_frames_count);
+}
+
+#endif //ENABLE_INPROCESS
+
+#ifdef ENABLE_OUTOFPROCESS
+
+/**
+ * Data of out-of-process stackscan unwinder for a crashed process.
+ */
+struct ndcrash_out_stackscan_data {
+
+    /// Crashed process identifier.
+    pid_t pid;
+
+    /// Memory map of a crashed process.
+    struct ndcrash_remote_maps maps;
+
+    /// Buffer for a copy of a scanned stack, reused for all threads.
+    uintptr_t *stack;
+
+    /// Size of stack buffer in bytes.
+    size_t stack_size;
+};
+
+void *ndcrash_out_init_stackscan(pid_t pid) {
+    struct ndcrash_out_stackscan_data * const ssdata = (struct ndcrash_out_stackscan_data *)
+            malloc(sizeof(struct ndcrash_out_stackscan_data));
+    if (!ssdata) return NULL;
+    if (!ndcrash_remote_maps_load(pid, &ssdata->maps)) {
+        NDCRASHLOG(ERROR, "stackscan: Couldn't read a memory map of process %d.", (int) pid);
+        free(ssdata);
+        return NULL;
+    }
+    ssdata->pid = pid;
+    ssdata->stack = NULL;
+    ssdata->stack_size = 0;
+    return ssdata;
+}
+
+void ndcrash_out_deinit_stackscan(void *data) {
+    if (!data) return;
+    struct ndcrash_out_stackscan_data * const ssdata = (struct ndcrash_out_stackscan_data *) data;
+    ndcrash_remote_maps_free(&ssdata->maps);
+    free(ssdata->stack);
+    free(ssdata);
+}
+
+/**
+ * Looks for a function containing specified address in a crashed process and adds it to a
+ * backtrace if found. Function names are taken from module files. See ndcrash_try_unwind_frame
+ * for arguments description, arg is a pointer to ndcrash_out_stackscan_data.
+ */
+static void ndcrash_out_try_unwind_frame(uintptr_t addr, struct ndcrash_frames *frames, bool rewind, void *arg) {
+    struct ndcrash_out_stackscan_data * const ssdata = (struct ndcrash_out_stackscan_data *) arg;
+    const struct ndcrash_remote_mapping * const mapping = ndcrash_remote_maps_find(&ssdata->maps, addr);
+    if (!mapping || !(mapping->prot & PROT_EXEC) || mapping->is_system || !mapping->path[0]) return;
+
+    uintptr_t func_offset;
+    const char * const func_name = ndcrash_remote_maps_find_symbol(
+            &ssdata->maps, mapping, addr - mapping->base, &func_offset);
+    if (func_name) {
+        if (rewind) {
+            const uintptr_t rewound = ndcrash_remote_rewind_pc(ssdata->pid, addr);
+            // Not allowing negative offsets.
+            if (addr - rewound > func_offset) return;
+            func_offset -= addr - rewound;
+            addr = rewound;
         }
+        ndcrash_frames_add(
+                frames,
+                addr,
+                addr - mapping->base,
+                mapping->path,
+                func_name,
+                func_offset,
+                rewind ? ndcrash_frame_scanned : 0);
+    }
+}
+
+void ndcrash_out_unwind_stackscan(struct ndcrash_frames *frames, pid_t tid, struct ucontext *context, void *data) {
+    struct ndcrash_out_stackscan_data * const ssdata = (struct ndcrash_out_stackscan_data *) data;
+    struct ndcrash_remote_registers registers;
+    if (!ssdata || !ndcrash_remote_get_registers(tid, context, &registers)) return;
+
+    // The first backtrace element is always program counter.
+    ndcrash_out_try_unwind_frame(registers.pc, frames, false, ssdata);
+
+#ifdef __arm__
+    // For 32-bit arm architecture the second backtrace element is always lr register.
+    ndcrash_out_try_unwind_frame(registers.lr, frames, true, ssdata);
+    const size_t lr_frames_count = frames->count;
+#else
+    const size_t lr_frames_count = SIZE_MAX;
 #endif
-        ndcrash_try_unwind_frame(*stack_content, outfile, &frameno, true);
+
+    // A stack is copied from a mapping containing sp by a single read.
+    const struct ndcrash_remote_mapping * const stack = ndcrash_remote_maps_find(&ssdata->maps, registers.sp);
+    if (!stack) return;
+    const uintptr_t sp = registers.sp & ~(uintptr_t) (sizeof(uintptr_t) - 1);
+    size_t size = stack->end - sp;
+    if (size > NDCRASH_OUT_STACKSCAN_MAX_SIZE) {
+        size = NDCRASH_OUT_STACKSCAN_MAX_SIZE;
     }
+    if (ssdata->stack_size < size) {
+        free(ssdata->stack);
+        ssdata->stack = (uintptr_t *) malloc(size);
+        ssdata->stack_size = ssdata->stack ? size : 0;
+        if (!ssdata->stack) return;
+    }
+    size = ndcrash_remote_read(ssdata->pid, sp, ssdata->stack, size);
+
+    struct ndcrash_stackscan_ranges ranges;
+    memset(&ranges, 0, sizeof(ranges));
+    for (size_t i = 0; i < ssdata->maps.count; ++i) {
+        const struct ndcrash_remote_mapping * const mapping = &ssdata->maps.mappings[i];
+        if (!(mapping->prot & PROT_EXEC) || mapping->is_system || !mapping->path[0]) continue;
+        ndcrash_stackscan_ranges_add(&ranges, mapping->start, mapping->end);
+    }
+    if (!ranges.count) return;
+
+    ndcrash_stackscan_scan(
+            ssdata->stack,
+            ssdata->stack + size / sizeof(uintptr_t),
+            &ranges,
+            frames,
+            &ndcrash_out_try_unwind_frame,
+            ssdata,
+            registers.lr,
+            lr_frames_count);
 }
 
-#endif //ENABLE_INPROCESS
+#endif //ENABLE_OUTOFPROCESS
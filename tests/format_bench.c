@@ -0,0 +1,61 @@
+#include "ndcrash_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/// Default count of iterations of each case, can be overridden by the first argument.
+#define NDCRASH_BENCH_DEFAULT_ITERATIONS 1000000
+
+/// Returns monotonic time in nanoseconds.
+static unsigned long long ndcrash_bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+}
+
+/**
+ * Runs a formatting statement for a number of iterations with ndcrash_format and snprintf, prints
+ * nanoseconds per call for both. Outputs are compared once before timing.
+ */
+#define BENCH(name, iterations, ...) \
+    do { \
+        char expected[256], actual[256]; \
+        snprintf(expected, sizeof(expected), __VA_ARGS__); \
+        ndcrash_format(actual, sizeof(actual), __VA_ARGS__); \
+        if (strcmp(expected, actual)) { \
+            fprintf(stderr, "%s: output differs: \"%s\" vs \"%s\"\n", name, expected, actual); \
+            mismatches++; \
+        } \
+        unsigned long long start = ndcrash_bench_now(); \
+        for (unsigned long i = 0; i < iterations; ++i) { \
+            ndcrash_format(actual, sizeof(actual), __VA_ARGS__); \
+            __asm__ volatile("" : : "r"(actual) : "memory"); \
+        } \
+        const double ndcrash_ns = (double) (ndcrash_bench_now() - start) / iterations; \
+        start = ndcrash_bench_now(); \
+        for (unsigned long i = 0; i < iterations; ++i) { \
+            snprintf(expected, sizeof(expected), __VA_ARGS__); \
+            __asm__ volatile("" : : "r"(expected) : "memory"); \
+        } \
+        const double snprintf_ns = (double) (ndcrash_bench_now() - start) / iterations; \
+        printf("%-16s ndcrash_format %8.1f ns  snprintf %8.1f ns  ratio %5.2f\n", \
+                name, ndcrash_ns, snprintf_ns, snprintf_ns / ndcrash_ns); \
+    } while (0)
+
+int main(int argc, char *argv[]) {
+    const unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : NDCRASH_BENCH_DEFAULT_ITERATIONS;
+    if (!iterations) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+    int mismatches = 0;
+    BENCH("frame", iterations, "    #%02d pc %016llx  %s (%s+%d)\n",
+            12, 0x7f00001234ULL, "/system/lib64/libc.so", "abort", 120);
+    BENCH("register", iterations, "    x%-2d %016lx  ", 9, (unsigned long) 0xffffff80);
+    BENCH("header", iterations, "pid: %d, tid: %d, name: %s  >>> %s <<<\n",
+            1234, 1250, "RenderThread", "com.example");
+    BENCH("precision", iterations, "%.8x %.*d %.3s", 0xabcu, 6, -42, "truncated");
+    BENCH("long literal", iterations, "*** *** *** *** *** *** *** *** *** *** *** *** *** *** %d\n", 1);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+#include "ndcrash_format.h"
+#include "test_utils.h"
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Formats with ndcrash_format and snprintf to buffers of several sizes and checks that results are
+ * the same. ndcrash_format returns count of written characters, so snprintf result is clamped.
+ */
+#define CHECK_SAME(...) \
+    do { \
+        static const size_t sizes[] = { 256, 8, 1 }; \
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) { \
+            char expected[256], actual[256]; \
+            const int expected_result = snprintf(expected, sizes[i], __VA_ARGS__); \
+            const size_t actual_result = ndcrash_format(actual, sizes[i], __VA_ARGS__); \
+            const size_t expected_length = (size_t) expected_result < sizes[i] ? (size_t) expected_result : sizes[i] - 1; \
+            if (strcmp(expected, actual) || actual_result != expected_length) { \
+                fprintf(stderr, "%s:%d: size %zu: expected \"%s\", actual \"%s\"\n", \
+                        __FILE__, __LINE__, sizes[i], expected, actual); \
+                ++ndcrash_test_failures; \
+            } \
+        } \
+    } while (0)
+
+static void test_plain() {
+    CHECK_SAME("%s", "");
+    CHECK_SAME("plain text without conversions");
+    CHECK_SAME("100%% done");
+    CHECK_SAME("%c%c%c", 'a', 'b', 'c');
+}
+
+static void test_signed() {
+    CHECK_SAME("%d %i", 0, 42);
+    CHECK_SAME("%d %d", INT32_MIN, INT32_MAX);
+    CHECK_SAME("%ld %lld", (long) -1234567, (long long) INT64_MIN);
+    CHECK_SAME("%jd %zd %td", (intmax_t) INT64_MAX, (ssize_t) -5, (ptrdiff_t) 77);
+    CHECK_SAME("%hd %hhd", 70000, 300);
+    CHECK_SAME("[%5d] [%-5d] [%05d] [%05d]", 42, 42, 42, -42);
+    CHECK_SAME("[%*d] [%*d]", 6, -7, -6, 7);
+}
+
+static void test_unsigned() {
+    CHECK_SAME("%u %x %X", 0u, 0xdeadbeefu, 0xdeadbeefu);
+    CHECK_SAME("%lu %llx %zx", (unsigned long) -1, (unsigned long long) UINT64_MAX, (size_t) 4096);
+    CHECK_SAME("%hu %hhx", 70000, 0x1ff);
+    CHECK_SAME("%08x %-8x| %16llx", 0xabcu, 0xabcu, 0x1234ULL);
+}
+
+static void test_integer_precision() {
+    CHECK_SAME("[%.5d] [%.5d] [%.1d] [%.0d]", 42, -42, 42, 42);
+    CHECK_SAME("[%.0d] [%.d] [%5.0d] [%-3.0u]", 0, 0, 0, 0u);
+    CHECK_SAME("[%.0x] [%.3x] [%.8X]", 0u, 0u, 0xabcu);
+    CHECK_SAME("[%8.3d] [%-8.3d] [%08.3d] [%08.3d]", 7, 7, 7, -7);
+    CHECK_SAME("[%.*d] [%.*d] [%.*d]", 4, 9, 0, 0, -1, 0);
+    CHECK_SAME("[%*.*x] [%0*.*x]", 10, 6, 0x1fu, 10, -1, 0x1fu);
+    CHECK_SAME("[%.30llu]", (unsigned long long) UINT64_MAX);
+    CHECK_SAME("[%.16lx] [%.8zx]", (unsigned long) 0x1234, (size_t) 0xffffffffu);
+}
+
+static void test_pointer() {
+    CHECK_SAME("%p", (void *) 0x1234);
+    CHECK_SAME("[%20p] [%-20p]", (void *) 0xabcdef, (void *) 0xabcdef);
+    CHECK_SAME("[%.16p]", (void *) 0x42);
+
+    // Null pointer is written as 0x0 unlike glibc (nil).
+    char buffer[16];
+    ndcrash_format(buffer, sizeof(buffer), "%p", NULL);
+    NDCRASH_CHECK(!strcmp(buffer, "0x0"));
+}
+
+static void test_string() {
+    CHECK_SAME("[%s] [%10s] [%-10s]", "abc", "abc", "abc");
+    CHECK_SAME("[%.2s] [%.10s] [%.0s]", "abc", "abc", "abc");
+    CHECK_SAME("[%.*s] [%.*s] [%*.*s]", 1, "abc", -1, "abc", 6, 2, "abc");
+    CHECK_SAME("[%5c] [%-5c]", 'x', 'y');
+}
+
+static void test_report_lines() {
+    // Lines as they are written to crash reports.
+    CHECK_SAME("    #%02d pc %016llx  %s (%s+%d)\n", 3, 0x7f00001234ULL, "/system/lib64/libc.so", "abort", 120);
+    CHECK_SAME("pid: %d, tid: %d, name: %s  >>> %s <<<\n", 1234, 1250, "RenderThread", "com.example");
+    CHECK_SAME("    x%-2d %016lx  ", 9, (unsigned long) 0xffffff80);
+}
+
+static void test_helpers() {
+    char buffer[32];
+    char *end = ndcrash_format_hex(buffer, 0xbeef, 8);
+    *end = '\0';
+    NDCRASH_CHECK(!strcmp(buffer, "0000beef"));
+
+    const char *parse_end = NULL;
+    NDCRASH_CHECK(ndcrash_parse_hex("7f12aB-", &parse_end) == 0x7f12ab);
+    NDCRASH_CHECK(*parse_end == '-');
+    NDCRASH_CHECK(ndcrash_parse_hex("zz", NULL) == 0);
+}
+
+int main() {
+    test_plain();
+    test_signed();
+    test_unsigned();
+    test_integer_precision();
+    test_pointer();
+    test_string();
+    test_report_lines();
+    test_helpers();
+    return NDCRASH_TEST_RESULT();
+}
@@ -0,0 +1,187 @@
+#include "ndcrash_memory_map.h"
+#include "ndcrash_private.h"
+#include "test_utils.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Looked up mapping and results of a lookup.
+struct memory_map_test_lookup {
+    uintptr_t start;
+    bool found;
+    struct ndcrash_memory_map_entry entry;
+    char path[PATH_MAX];
+    size_t entries_count;
+    bool stack_found;
+};
+
+static void memory_map_test_lookup_callback(const struct ndcrash_memory_map_entry *entry, void *data, bool *stop) {
+    struct memory_map_test_lookup * const lookup = (struct memory_map_test_lookup *) data;
+    ++lookup->entries_count;
+    if (!strcmp(entry->path, "[stack]")) {
+        lookup->stack_found = true;
+    }
+    if (entry->start == lookup->start) {
+        lookup->found = true;
+        lookup->entry = *entry;
+        strncpy(lookup->path, entry->path, sizeof(lookup->path) - 1);
+    }
+}
+
+/// Parses a memory map of the current process looking for a mapping starting at an address.
+static struct memory_map_test_lookup memory_map_test_find(const void *start) {
+    struct memory_map_test_lookup lookup;
+    memset(&lookup, 0, sizeof(lookup));
+    lookup.start = (uintptr_t) start;
+    ndcrash_parse_memory_map(getpid(), &memory_map_test_lookup_callback, &lookup);
+    return lookup;
+}
+
+/// Counts lines of a memory map of the current process. Doesn't allocate memory, so a map isn't changed.
+static size_t memory_map_test_count_lines() {
+    const int fd = open("/proc/self/maps", O_RDONLY);
+    if (fd < 0) return 0;
+    size_t count = 0;
+    char buffer[4096];
+    for (ssize_t size; (size = read(fd, buffer, sizeof(buffer))) > 0;) {
+        for (ssize_t i = 0; i < size; ++i) {
+            if (buffer[i] == '\n') ++count;
+        }
+    }
+    close(fd);
+    return count;
+}
+
+/// Creates a file of a size, returns its descriptor.
+static int memory_map_test_create_file(const char *path, size_t size) {
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    NDCRASH_CHECK(fd >= 0);
+    if (fd >= 0) {
+        NDCRASH_CHECK(!ftruncate(fd, (off_t) size));
+    }
+    return fd;
+}
+
+static void test_anonymous(size_t page) {
+    // Three pages with different protection give three entries.
+    char * const memory = (char *) mmap(NULL, page * 3, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    NDCRASH_CHECK(memory != MAP_FAILED);
+    if (memory == MAP_FAILED) return;
+    NDCRASH_CHECK(!mprotect(memory + page, page, PROT_READ));
+    NDCRASH_CHECK(!mprotect(memory + page * 2, page, PROT_NONE));
+
+    struct memory_map_test_lookup lookup = memory_map_test_find(memory);
+    NDCRASH_CHECK(lookup.found);
+    NDCRASH_CHECK(lookup.entry.end == (uintptr_t) (memory + page));
+    NDCRASH_CHECK(lookup.entry.prot == (PROT_READ | PROT_WRITE));
+    NDCRASH_CHECK(lookup.entry.offset == 0);
+    NDCRASH_CHECK(lookup.entry.inode == 0);
+    NDCRASH_CHECK(!strcmp(lookup.path, ""));
+
+    lookup = memory_map_test_find(memory + page);
+    NDCRASH_CHECK(lookup.found);
+    NDCRASH_CHECK(lookup.entry.end == (uintptr_t) (memory + page * 2));
+    NDCRASH_CHECK(lookup.entry.prot == PROT_READ);
+
+    lookup = memory_map_test_find(memory + page * 2);
+    NDCRASH_CHECK(lookup.found);
+    NDCRASH_CHECK(lookup.entry.prot == 0);
+
+    // The whole map is parsed: all lines are reported, up to [stack] near the end.
+    NDCRASH_CHECK(lookup.stack_found);
+    NDCRASH_CHECK(lookup.entries_count == memory_map_test_count_lines());
+
+    // End of a mapping containing an address, an unmapped address is returned as is.
+    NDCRASH_CHECK(ndcrash_memory_map_find_end(getpid(), (uintptr_t) (memory + page + 10)) == (uintptr_t) (memory + page * 2));
+    NDCRASH_CHECK(!munmap(memory + page * 2, page));
+    NDCRASH_CHECK(ndcrash_memory_map_find_end(getpid(), (uintptr_t) (memory + page * 2)) == (uintptr_t) (memory + page * 2));
+    munmap(memory, page * 2);
+}
+
+static void test_file(const char *directory, size_t page) {
+    // Path with spaces, they are a part of a path.
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/mapped file.bin", directory);
+    const int fd = memory_map_test_create_file(path, page * 2);
+    if (fd < 0) return;
+    struct stat st;
+    NDCRASH_CHECK(!fstat(fd, &st));
+    void * const memory = mmap(NULL, page, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, (off_t) page);
+    close(fd);
+    NDCRASH_CHECK(memory != MAP_FAILED);
+    if (memory == MAP_FAILED) return;
+
+    const struct memory_map_test_lookup lookup = memory_map_test_find(memory);
+    NDCRASH_CHECK(lookup.found);
+    NDCRASH_CHECK(lookup.entry.end == (uintptr_t) memory + page);
+    NDCRASH_CHECK(lookup.entry.prot == (PROT_READ | PROT_EXEC));
+    NDCRASH_CHECK(lookup.entry.offset == page);
+    NDCRASH_CHECK(lookup.entry.inode == (unsigned long) st.st_ino);
+    NDCRASH_CHECK(!strcmp(lookup.path, path));
+    munmap(memory, page);
+    unlink(path);
+}
+
+static void test_long_path(const char *directory, size_t page) {
+    // A path longer than a parser buffer is truncated, the rest of a line is skipped and following
+    // lines are parsed as usual.
+    char name[201];
+    memset(name, 'n', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    char subdirectory[PATH_MAX], path[PATH_MAX];
+    snprintf(subdirectory, sizeof(subdirectory), "%s/%s", directory, name);
+    snprintf(path, sizeof(path), "%s/%s", subdirectory, name);
+    NDCRASH_CHECK(strlen(path) > NDCRASH_MAX_MODULE_NAME_LENGTH + 128);
+    mkdir(subdirectory, 0700);
+    const int fd = memory_map_test_create_file(path, page);
+    if (fd < 0) return;
+    void * const memory = mmap(NULL, page, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    NDCRASH_CHECK(memory != MAP_FAILED);
+    if (memory == MAP_FAILED) return;
+
+    const struct memory_map_test_lookup lookup = memory_map_test_find(memory);
+    NDCRASH_CHECK(lookup.found);
+    NDCRASH_CHECK(lookup.entry.end == (uintptr_t) memory + page);
+    NDCRASH_CHECK(strlen(lookup.path) > 0 && strlen(lookup.path) < strlen(path));
+    NDCRASH_CHECK(!strncmp(lookup.path, path, strlen(lookup.path)));
+    NDCRASH_CHECK(lookup.stack_found);
+    NDCRASH_CHECK(lookup.entries_count == memory_map_test_count_lines());
+    munmap(memory, page);
+    unlink(path);
+    rmdir(subdirectory);
+}
+
+static void memory_map_test_stop_callback(const struct ndcrash_memory_map_entry *entry, void *data, bool *stop) {
+    ++*(size_t *) data;
+    *stop = true;
+}
+
+static void test_stop() {
+    size_t count = 0;
+    ndcrash_parse_memory_map(getpid(), &memory_map_test_stop_callback, &count);
+    NDCRASH_CHECK(count == 1);
+
+    // A process that doesn't exist has no map.
+    count = 0;
+    ndcrash_parse_memory_map(INT_MAX, &memory_map_test_stop_callback, &count);
+    NDCRASH_CHECK(count == 0);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <work directory>\n", argv[0]);
+        return 1;
+    }
+    mkdir(argv[1], 0700);
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    test_anonymous(page);
+    test_file(argv[1], page);
+    test_long_path(argv[1], page);
+    test_stop();
+    return NDCRASH_TEST_RESULT();
+}
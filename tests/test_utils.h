@@ -0,0 +1,20 @@
+#ifndef NDCRASH_TEST_UTILS_H
+#define NDCRASH_TEST_UTILS_H
+#include <stdio.h>
+
+/// Count of failed checks of a test executable, returned from main as an exit code.
+static int ndcrash_test_failures = 0;
+
+/// Checks a condition, reports a location of a failed check and continues.
+#define NDCRASH_CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++ndcrash_test_failures; \
+        } \
+    } while (0)
+
+/// Returns from main: 0 if all checks passed.
+#define NDCRASH_TEST_RESULT() (ndcrash_test_failures ? (fprintf(stderr, "%d check(s) failed\n", ndcrash_test_failures), 1) : 0)
+
+#endif //NDCRASH_TEST_UTILS_H
@@ -0,0 +1,308 @@
+#include "bucket_index.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace ndcrash {
+
+/// Magic bytes and format version at the beginning of an index file.
+static const char index_magic[8] = {'N', 'D', 'C', 'R', 'B', 'K', 'T', '2'};
+
+/// Magic bytes of the first format version, it doesn't store signature options.
+static const char index_magic_v1[8] = {'N', 'D', 'C', 'R', 'B', 'K', 'T', '1'};
+
+/**
+ * Appends values to an index buffer.
+ */
+class index_writer {
+public:
+    void uleb(uint64_t value) {
+        do {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            if (value) byte |= 0x80;
+            data_ += (char) byte;
+        } while (value);
+    }
+
+    void sleb(int64_t value) {
+        // Zigzag encoding keeps small negative values short.
+        uleb(((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+    }
+
+    void u64(uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            data_ += (char) (value >> (i * 8));
+        }
+    }
+
+    void string(const std::string &value) {
+        uleb(value.size());
+        data_ += value;
+    }
+
+    void raw(const char *data, size_t size) { data_.append(data, size); }
+
+    const std::string &data() const { return data_; }
+
+private:
+    std::string data_;
+};
+
+/**
+ * Reads values from an index buffer. Any overflow sets an error flag.
+ */
+class index_reader {
+public:
+    explicit index_reader(const std::string &data) : data_(data) {}
+
+    bool ok() const { return ok_; }
+
+    uint64_t uleb() {
+        uint64_t result = 0;
+        for (unsigned shift = 0; ok_; shift += 7) {
+            if (pos_ >= data_.size() || shift >= 64) {
+                ok_ = false;
+                break;
+            }
+            const uint8_t byte = (uint8_t) data_[pos_++];
+            result |= (uint64_t) (byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return result;
+    }
+
+    int64_t sleb() {
+        const uint64_t value = uleb();
+        return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+    }
+
+    uint64_t u64() {
+        if (data_.size() - pos_ < 8) {
+            ok_ = false;
+            return 0;
+        }
+        uint64_t result = 0;
+        for (int i = 0; i < 8; ++i) {
+            result |= (uint64_t) (uint8_t) data_[pos_++] << (i * 8);
+        }
+        return result;
+    }
+
+    std::string string() {
+        const uint64_t size = uleb();
+        if (!ok_ || data_.size() - pos_ < size) {
+            ok_ = false;
+            return std::string();
+        }
+        std::string result = data_.substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+    bool raw(const char *expected, size_t size) {
+        if (data_.compare(pos_, size, expected, size)) {
+            ok_ = false;
+        } else {
+            pos_ += size;
+        }
+        return ok_;
+    }
+
+    /// Skips expected bytes if they are present, doesn't set an error flag otherwise.
+    bool skip(const char *expected, size_t size) {
+        if (data_.compare(pos_, size, expected, size)) return false;
+        pos_ += size;
+        return true;
+    }
+
+private:
+    const std::string &data_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+};
+
+bool bucket_index::load(const std::string &path) {
+    options_ = signature_options();
+    reports_.clear();
+    buckets_.clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        // No index yet.
+        return access(path.c_str(), F_OK) != 0;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    const std::string data = contents.str();
+    index_reader reader(data);
+    if (reader.skip(index_magic_v1, sizeof(index_magic_v1))) {
+        // Options are unknown, an index is rebuilt by a caller.
+        options_.frames = 0;
+    } else {
+        if (!reader.raw(index_magic, sizeof(index_magic))) return false;
+        options_.frames = reader.uleb();
+        const uint64_t skip_modules_count = reader.uleb();
+        for (uint64_t i = 0; i < skip_modules_count && reader.ok(); ++i) {
+            options_.skip_modules.push_back(reader.string());
+        }
+    }
+
+    const uint64_t buckets_count = reader.uleb();
+    for (uint64_t i = 0; i < buckets_count && reader.ok(); ++i) {
+        const uint64_t hash = reader.u64();
+        bucket &item = buckets_[hash];
+        item.signature = reader.string();
+        item.count = reader.uleb();
+        item.first_seen = reader.sleb();
+        item.last_seen = reader.sleb();
+        const uint64_t samples_count = reader.uleb();
+        for (uint64_t j = 0; j < samples_count && reader.ok(); ++j) {
+            const int64_t mtime = reader.sleb();
+            item.samples.emplace_back(mtime, reader.string());
+        }
+    }
+    const uint64_t reports_count = reader.uleb();
+    for (uint64_t i = 0; i < reports_count && reader.ok(); ++i) {
+        std::string report_path = reader.string();
+        report &item = reports_[std::move(report_path)];
+        item.size = reader.uleb();
+        item.mtime = reader.sleb();
+        item.bucket = reader.u64();
+    }
+    if (!reader.ok()) {
+        options_ = signature_options();
+        reports_.clear();
+        buckets_.clear();
+        return false;
+    }
+    return true;
+}
+
+bool bucket_index::save(const std::string &path) const {
+    // Sorting for a deterministic file contents.
+    std::vector<uint64_t> hashes;
+    hashes.reserve(buckets_.size());
+    for (const auto &item : buckets_) {
+        hashes.push_back(item.first);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    std::vector<const std::pair<const std::string, report> *> reports;
+    reports.reserve(reports_.size());
+    for (const auto &item : reports_) {
+        reports.push_back(&item);
+    }
+    std::sort(reports.begin(), reports.end(), [](const std::pair<const std::string, report> *a,
+                                                 const std::pair<const std::string, report> *b) {
+        return a->first < b->first;
+    });
+
+    index_writer writer;
+    writer.raw(index_magic, sizeof(index_magic));
+    writer.uleb(options_.frames);
+    writer.uleb(options_.skip_modules.size());
+    for (const std::string &module : options_.skip_modules) {
+        writer.string(module);
+    }
+    writer.uleb(hashes.size());
+    for (const uint64_t hash : hashes) {
+        const bucket &item = buckets_.at(hash);
+        writer.u64(hash);
+        writer.string(item.signature);
+        writer.uleb(item.count);
+        writer.sleb(item.first_seen);
+        writer.sleb(item.last_seen);
+        writer.uleb(item.samples.size());
+        for (const auto &sample : item.samples) {
+            writer.sleb(sample.first);
+            writer.string(sample.second);
+        }
+    }
+    writer.uleb(reports.size());
+    for (const auto *item : reports) {
+        writer.string(item->first);
+        writer.uleb(item->second.size);
+        writer.sleb(item->second.mtime);
+        writer.u64(item->second.bucket);
+    }
+
+    const std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!(out << writer.data()) || !out.flush()) return false;
+    }
+    return !rename(temp_path.c_str(), path.c_str());
+}
+
+void bucket_index::reset(const signature_options &options) {
+    options_ = options;
+    reports_.clear();
+    buckets_.clear();
+}
+
+bool bucket_index::is_current(const std::string &path, uint64_t size, int64_t mtime) const {
+    const auto it = reports_.find(path);
+    return it != reports_.end() && it->second.size == size && it->second.mtime == mtime;
+}
+
+void bucket_index::remove(const std::string &path, const report &item) {
+    const auto it = buckets_.find(item.bucket);
+    if (it == buckets_.end()) return;
+    bucket &target = it->second;
+    if (!--target.count) {
+        buckets_.erase(it);
+        return;
+    }
+
+    // Seen times are kept: they describe a history of a bucket, not only current reports.
+    target.samples.erase(std::remove_if(target.samples.begin(), target.samples.end(),
+            [&path](const std::pair<int64_t, std::string> &sample) {
+                return sample.second == path;
+            }), target.samples.end());
+}
+
+void bucket_index::erase(const std::string &path) {
+    const auto it = reports_.find(path);
+    if (it == reports_.end()) return;
+    remove(path, it->second);
+    reports_.erase(it);
+}
+
+std::vector<std::string> bucket_index::report_paths() const {
+    std::vector<std::string> result;
+    result.reserve(reports_.size());
+    for (const auto &item : reports_) {
+        result.push_back(item.first);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void bucket_index::add(const std::string &path, uint64_t size, int64_t mtime, uint64_t hash, const std::string &signature) {
+    const auto existing = reports_.find(path);
+    if (existing != reports_.end()) {
+        remove(path, existing->second);
+    }
+    reports_[path] = {size, mtime, hash};
+
+    bucket &target = buckets_[hash];
+    if (!target.count) {
+        target.signature = signature;
+        target.first_seen = mtime;
+        target.last_seen = mtime;
+    } else {
+        target.first_seen = std::min(target.first_seen, mtime);
+        target.last_seen = std::max(target.last_seen, mtime);
+    }
+    ++target.count;
+
+    // The oldest reports are kept as representatives.
+    const std::pair<int64_t, std::string> sample(mtime, path);
+    target.samples.insert(std::upper_bound(target.samples.begin(), target.samples.end(), sample), sample);
+    if (target.samples.size() > max_samples) {
+        target.samples.resize(max_samples);
+    }
+}
+
+} // namespace ndcrash
@@ -0,0 +1,109 @@
+#ifndef NDCRASH_BUCKETER_BUCKET_INDEX_H
+#define NDCRASH_BUCKETER_BUCKET_INDEX_H
+#include "signature.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ndcrash {
+
+/**
+ * Group of reports with the same signature.
+ */
+struct bucket {
+
+    /// Signature text.
+    std::string signature;
+
+    /// Count of reports.
+    uint64_t count = 0;
+
+    /// Modification times of the oldest and the newest report, seconds since epoch.
+    int64_t first_seen = 0;
+    int64_t last_seen = 0;
+
+    /// The oldest reports as (modification time, path), sorted by time.
+    std::vector<std::pair<int64_t, std::string>> samples;
+};
+
+/**
+ * Persistent index of bucketed reports. Besides buckets it keeps size, modification time and
+ * a bucket of every indexed report, so only new and changed reports are processed on update.
+ * Signature options are stored too, signatures computed with other options are not comparable.
+ * Stored as a compact binary file: variable-length integers and length-prefixed strings.
+ */
+class bucket_index {
+public:
+
+    /// Maximum count of representative reports per bucket.
+    static const size_t max_samples = 3;
+
+    /**
+     * Loads an index from a file. A missing file gives an empty index.
+     * @return Flag whether an index is loaded, false if a file is corrupted or can't be read.
+     */
+    bool load(const std::string &path);
+
+    /**
+     * Saves an index to a file. A temporary file is written and then renamed, so an index
+     * isn't corrupted if writing is interrupted.
+     * @return Flag whether an index is saved.
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * Removes all reports and buckets and sets signature options for reports added later.
+     * @param options Signature options.
+     */
+    void reset(const signature_options &options);
+
+    /// Signature options of indexed reports. Frames count is 0 if an index file doesn't store them.
+    const signature_options &options() const { return options_; }
+
+    /// Checks whether a report is indexed and hasn't been changed since.
+    bool is_current(const std::string &path, uint64_t size, int64_t mtime) const;
+
+    /**
+     * Adds a report to a bucket. A report indexed before is removed from its old bucket first.
+     * @param path Report path.
+     * @param size Report file size.
+     * @param mtime Report modification time.
+     * @param hash Signature hash.
+     * @param signature Signature text.
+     */
+    void add(const std::string &path, uint64_t size, int64_t mtime, uint64_t hash, const std::string &signature);
+
+    /// Removes a report from an index if it's indexed.
+    void erase(const std::string &path);
+
+    /// Paths of all indexed reports.
+    std::vector<std::string> report_paths() const;
+
+    /// Buckets by signature hash.
+    const std::unordered_map<uint64_t, bucket> &buckets() const { return buckets_; }
+
+    /// Count of indexed reports.
+    size_t reports_count() const { return reports_.size(); }
+
+private:
+
+    /// Indexed report.
+    struct report {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t bucket;
+    };
+
+    /// Removes a report from its bucket, empty buckets are removed.
+    void remove(const std::string &path, const report &item);
+
+    signature_options options_;
+    std::unordered_map<std::string, report> reports_;
+    std::unordered_map<uint64_t, bucket> buckets_;
+};
+
+} // namespace ndcrash
+
+#endif //NDCRASH_BUCKETER_BUCKET_INDEX_H
@@ -0,0 +1,242 @@
+#include "bucket_index.h"
+#include "signature.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <thread>
+
+using namespace ndcrash;
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s -i <index> [-j <threads>] [-n <frames>] [-x <module>...] [-t <top>] [<report or dir>...]\n"
+            "Groups ndcrash text reports by crash signature and updates a persistent index.\n"
+            "  -i  Index file, created if absent. Only new and changed reports are processed,\n"
+            "      deleted reports are removed from an index.\n"
+            "  -j  Count of worker threads, by default a count of CPU cores.\n"
+            "  -n  Count of top frames in a signature, 5 by default.\n"
+            "  -x  Skip top frames of a module, for example libc.so. May be repeated.\n"
+            "      If -n or -x differ from ones stored in an index, indexed reports are processed again.\n"
+            "  -t  Count of the largest buckets to print, 20 by default, 0 to print all.\n"
+            "Directories are scanned recursively. Without reports an index is only printed.\n",
+            program);
+}
+
+/// Report file to process.
+struct input_file {
+    std::string path;
+    uint64_t size;
+    int64_t mtime;
+
+    /// Results of processing.
+    bool parsed = false;
+    uint64_t hash = 0;
+    std::string signature;
+};
+
+/// Collects regular files of a path recursively.
+static void collect_files(const std::string &path, std::vector<input_file> &result) {
+    struct stat st;
+    if (stat(path.c_str(), &st)) {
+        fprintf(stderr, "Couldn't access %s: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    if (S_ISREG(st.st_mode)) {
+        input_file file;
+        file.path = path;
+        file.size = (uint64_t) st.st_size;
+        file.mtime = (int64_t) st.st_mtime;
+        result.push_back(std::move(file));
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) return;
+    DIR * const dir = opendir(path.c_str());
+    if (!dir) return;
+    std::vector<std::string> children;
+    while (const struct dirent * const item = readdir(dir)) {
+        if (!strcmp(item->d_name, ".") || !strcmp(item->d_name, "..")) continue;
+        children.push_back(path + "/" + item->d_name);
+    }
+    closedir(dir);
+    std::sort(children.begin(), children.end());
+    for (const std::string &child : children) {
+        collect_files(child, result);
+    }
+}
+
+/// Formats time in UTC.
+static std::string format_time(int64_t value) {
+    const time_t time = (time_t) value;
+    struct tm parts;
+    char buffer[32];
+    gmtime_r(&time, &parts);
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &parts);
+    return buffer;
+}
+
+/// Prints the largest buckets.
+static void print_buckets(const bucket_index &index, size_t top) {
+    std::vector<std::pair<uint64_t, const bucket *>> sorted;
+    for (const auto &item : index.buckets()) {
+        sorted.emplace_back(item.first, &item.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint64_t, const bucket *> &a,
+                                               const std::pair<uint64_t, const bucket *> &b) {
+        return a.second->count != b.second->count ? a.second->count > b.second->count : a.first < b.first;
+    });
+    if (top && sorted.size() > top) {
+        sorted.resize(top);
+    }
+    printf("%8s  %-19s  %-19s  %-16s  %s\n", "count", "first seen", "last seen", "bucket", "signature");
+    for (const auto &item : sorted) {
+        printf("%8" PRIu64 "  %s  %s  %016" PRIx64 "  %s\n",
+               item.second->count,
+               format_time(item.second->first_seen).c_str(),
+               format_time(item.second->last_seen).c_str(),
+               item.first,
+               item.second->signature.c_str());
+        for (const auto &sample : item.second->samples) {
+            printf("%8s  sample: %s\n", "", sample.second.c_str());
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string index_path;
+    signature_options options;
+    unsigned threads_count = std::thread::hardware_concurrency();
+    size_t top = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:j:n:x:t:h")) != -1) {
+        switch (opt) {
+            case 'i':
+                index_path = optarg;
+                break;
+            case 'j':
+                threads_count = (unsigned) atoi(optarg);
+                break;
+            case 'n':
+                options.frames = (size_t) atoi(optarg);
+                break;
+            case 'x':
+                options.skip_modules.push_back(optarg);
+                break;
+            case 't':
+                top = (size_t) atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (index_path.empty() || !options.frames) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::sort(options.skip_modules.begin(), options.skip_modules.end());
+    options.skip_modules.erase(std::unique(options.skip_modules.begin(), options.skip_modules.end()),
+                               options.skip_modules.end());
+
+    bucket_index index;
+    if (!index.load(index_path)) {
+        fprintf(stderr, "Couldn't load index %s\n", index_path.c_str());
+        return 2;
+    }
+
+    // Signatures computed with other options can't be mixed, in this case an index is rebuilt:
+    // all indexed reports are processed again.
+    const std::vector<std::string> indexed_paths = index.report_paths();
+    const bool rebuild = !(index.options() == options);
+    bool changed = rebuild;
+    if (rebuild) {
+        if (!indexed_paths.empty()) {
+            fprintf(stderr, "Signature options differ from index, rebuilding it\n");
+        }
+        index.reset(options);
+    }
+
+    // Reports that don't exist anymore are removed from an index.
+    std::vector<input_file> files;
+    size_t removed = 0;
+    for (const std::string &path : indexed_paths) {
+        struct stat st;
+        if (stat(path.c_str(), &st) && errno == ENOENT) {
+            index.erase(path);
+            ++removed;
+            changed = true;
+        } else if (rebuild) {
+            collect_files(path, files);
+        }
+    }
+
+    // Only new and changed reports are processed.
+    for (int i = optind; i < argc; ++i) {
+        collect_files(argv[i], files);
+    }
+    std::sort(files.begin(), files.end(), [](const input_file &a, const input_file &b) {
+        return a.path < b.path;
+    });
+    files.erase(std::unique(files.begin(), files.end(), [](const input_file &a, const input_file &b) {
+        return a.path == b.path;
+    }), files.end());
+    const size_t total_files = files.size();
+    files.erase(std::remove_if(files.begin(), files.end(), [&index](const input_file &file) {
+        return index.is_current(file.path, file.size, file.mtime);
+    }), files.end());
+
+    // Reports are parsed by workers, each report is read only up to a crashed thread backtrace.
+    // Results are merged in order of files, so an index doesn't depend on scheduling.
+    std::atomic<size_t> next(0);
+    auto worker = [&] {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            input_file &file = files[i];
+            std::ifstream in(file.path, std::ios::binary);
+            crash_signature signature;
+            if (!in || !read_signature(in, options, signature)) continue;
+            file.parsed = true;
+            file.hash = signature.hash();
+            file.signature = signature.text();
+        }
+    };
+    if (!threads_count) {
+        threads_count = 1;
+    }
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threads_count && i < files.size(); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    size_t skipped = 0;
+    for (const input_file &file : files) {
+        if (file.parsed) {
+            index.add(file.path, file.size, file.mtime, file.hash, file.signature);
+        } else {
+            // A report could be indexed before it has been changed.
+            index.erase(file.path);
+            ++skipped;
+        }
+    }
+    if ((changed || !files.empty()) && !index.save(index_path)) {
+        fprintf(stderr, "Couldn't save index %s\n", index_path.c_str());
+        return 2;
+    }
+    fprintf(stderr, "Files: %zu, processed: %zu, not reports: %zu, removed: %zu, indexed reports: %zu, buckets: %zu\n",
+            total_files, files.size() - skipped, skipped, removed, index.reports_count(), index.buckets().size());
+
+    print_buckets(index, top);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "signature.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+namespace ndcrash {
+
+std::string crash_signature::text() const {
+    std::string result = signal.empty() ? "?" : signal;
+    for (const std::string &frame : frames) {
+        result += " | ";
+        result += frame;
+    }
+    return result;
+}
+
+uint64_t crash_signature::hash() const {
+    uint64_t result = 0xcbf29ce484222325ULL;
+    for (const char c : text()) {
+        result ^= (uint8_t) c;
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+}
+
+/// Returns a file name of a map.
+static std::string module_name(const std::string &map) {
+    const size_t slash = map.rfind('/');
+    return slash == std::string::npos ? map : map.substr(slash + 1);
+}
+
+std::string normalize_frame(const report_frame &frame) {
+    std::string result = module_name(frame.map);
+    result += '!';
+    if (!frame.function.empty()) {
+        result += frame.function;
+    } else {
+        char buffer[24];
+        snprintf(buffer, sizeof(buffer), "+0x%" PRIx64, frame.pc);
+        result += buffer;
+    }
+    return result;
+}
+
+bool read_signature(std::istream &in, const signature_options &options, crash_signature &result) {
+    result.signal.clear();
+    result.frames.clear();
+    std::string line;
+    report_frame frame;
+    bool backtrace = false;
+    bool skipping = !options.skip_modules.empty();
+    while (std::getline(in, line)) {
+        if (!backtrace) {
+            // "signal 11 (SIGSEGV), code 1 (SEGV_MAPERR), fault addr 0x10"
+            if (result.signal.empty() && !line.compare(0, 7, "signal ")) {
+                const size_t open = line.find('(');
+                const size_t close = line.find(')', open);
+                if (open != std::string::npos && close != std::string::npos) {
+                    result.signal = line.substr(open + 1, close - open - 1);
+                }
+            }
+            backtrace = line == "backtrace:";
+            continue;
+        }
+        if (!parse_frame_line(line, frame)) break;
+        if (frame.map == "<unknown>" && !frame.pc) break;
+        if (skipping) {
+            const std::string module = module_name(frame.map);
+            if (std::find(options.skip_modules.begin(), options.skip_modules.end(), module) != options.skip_modules.end()) continue;
+            skipping = false;
+        }
+        result.frames.push_back(normalize_frame(frame));
+        if (result.frames.size() >= options.frames) break;
+    }
+    return backtrace;
+}
+
+} // namespace ndcrash
@@ -0,0 +1,62 @@
+#ifndef NDCRASH_BUCKETER_SIGNATURE_H
+#define NDCRASH_BUCKETER_SIGNATURE_H
+#include "report_format.h"
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace ndcrash {
+
+/// Settings of signature computation.
+struct signature_options {
+
+    /// Count of top frames of a crashed thread used in a signature.
+    size_t frames = 5;
+
+    /// Modules whose frames are skipped on top of a backtrace, for example libc.so for abort().
+    std::vector<std::string> skip_modules;
+
+    bool operator==(const signature_options &other) const {
+        return frames == other.frames && skip_modules == other.skip_modules;
+    }
+};
+
+/**
+ * Normalized data of a report used for bucketing.
+ */
+struct crash_signature {
+
+    /// Signal name like "SIGSEGV", empty if not found.
+    std::string signal;
+
+    /// Normalized top frames of a crashed thread.
+    std::vector<std::string> frames;
+
+    /// Signature text: a signal and frames separated by " | ".
+    std::string text() const;
+
+    /// Stable 64-bit hash of a signature text (FNV-1a).
+    uint64_t hash() const;
+};
+
+/**
+ * Normalizes a frame to "module!function" if a function is known or "module!+0xrel_pc" otherwise.
+ * A module is a file name without a directory, so the same library installed to different paths
+ * gives the same result.
+ */
+std::string normalize_frame(const report_frame &frame);
+
+/**
+ * Reads a report and computes its signature. Stops reading after a backtrace of a crashed thread,
+ * it's the first one in a report.
+ * @param in Report stream.
+ * @param options Signature settings.
+ * @param result Where to store a signature.
+ * @return Flag whether a report has a backtrace.
+ */
+bool read_signature(std::istream &in, const signature_options &options, crash_signature &result);
+
+} // namespace ndcrash
+
+#endif //NDCRASH_BUCKETER_SIGNATURE_H
@@ -0,0 +1,209 @@
+#include "bucket_index.h"
+#include "signature.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace ndcrash;
+
+/// Count of failed checks, returned from main as an exit code.
+static int failures = 0;
+
+/// Checks a condition, reports a location of a failed check and continues.
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while (0)
+
+/**
+ * Creates a report of the same crash as it looks in a process where libraries are loaded at
+ * load_base and an application is installed to install_dir. Backtrace pcs are relative to modules.
+ * @param function Function name of the top frame.
+ */
+static std::string make_report(uint64_t load_base, const std::string &install_dir, const std::string &function) {
+    const std::string app_lib = install_dir + "/lib/arm64/libapp.so";
+    char modules[512];
+    snprintf(modules, sizeof(modules),
+             "    %016llx 0000000000000000  /system/lib64/libc.so (BuildId: 3e73c6e9)\n"
+             "    %016llx 0000000000000000  %s (BuildId: 9a0b1c2d)\n",
+             (unsigned long long) load_base, (unsigned long long) (load_base + 0x200000), app_lib.c_str());
+    return "pid: 1234, tid: 1250, name: RenderThread  >>> com.example <<<\n"
+           "signal 6 (SIGABRT), code -6 (SI_TKILL), fault addr --------\n"
+           "backtrace:\n"
+           "    #00 pc 000000000006c4d8  /system/lib64/libc.so (abort+120)\n"
+           "    #01 pc 00000000000035d9  " + app_lib + " (" + function + "+9)\n"
+           "    #02 pc 0000000000003a10  " + app_lib + "\n"
+           "    #03 pc 0000000000004b44  " + app_lib + " (Java_com_example_Native_run+28)\n"
+           "\n"
+           "modules:\n" + modules;
+}
+
+/// Computes a signature of a report text.
+static crash_signature signature_of(const std::string &report, const signature_options &options) {
+    std::istringstream in(report);
+    crash_signature result;
+    CHECK(read_signature(in, options, result));
+    return result;
+}
+
+static void test_signature_stability() {
+    signature_options options;
+    options.skip_modules.push_back("libc.so");
+
+    // The same crash in processes with other load addresses and install paths.
+    const crash_signature first = signature_of(make_report(0x7f00000000ULL, "/data/app/com.example-1", "crash"), options);
+    const crash_signature second = signature_of(make_report(0x7fab340000ULL, "/data/app/com.example-2", "crash"), options);
+    CHECK(first.text() == "SIGABRT | libapp.so!crash | libapp.so!+0x3a10 | libapp.so!Java_com_example_Native_run");
+    CHECK(first.text() == second.text());
+    CHECK(first.hash() == second.hash());
+
+    // Another crash site gets another bucket.
+    const crash_signature other = signature_of(make_report(0x7f00000000ULL, "/data/app/com.example-1", "other"), options);
+    CHECK(first.hash() != other.hash());
+
+    // Frames of skipped modules are kept if they aren't on top.
+    options.skip_modules.clear();
+    options.frames = 2;
+    CHECK(signature_of(make_report(0, "/data/app/a", "crash"), options).text() == "SIGABRT | libc.so!abort | libapp.so!crash");
+}
+
+static void test_index_round_trip(const std::string &directory) {
+    const std::string path = directory + "/round-trip.idx";
+    unlink(path.c_str());
+    signature_options options;
+    options.frames = 3;
+    options.skip_modules.push_back("libc.so");
+
+    bucket_index index;
+    CHECK(index.load(path));
+    index.reset(options);
+    index.add("/reports/a.txt", 100, 1000, 1, "SIGSEGV | a");
+    index.add("/reports/b.txt", 200, 2000, 1, "SIGSEGV | a");
+    index.add("/reports/c.txt", 300, 3000, 2, "SIGABRT | c");
+    CHECK(index.save(path));
+
+    bucket_index loaded;
+    CHECK(loaded.load(path));
+    CHECK(loaded.options() == options);
+    CHECK(loaded.reports_count() == 3);
+    CHECK(loaded.buckets().size() == 2);
+    CHECK(loaded.buckets().at(1).count == 2);
+    CHECK(loaded.buckets().at(1).first_seen == 1000);
+    CHECK(loaded.buckets().at(1).last_seen == 2000);
+    CHECK(loaded.buckets().at(1).samples.size() == 2);
+    CHECK(loaded.is_current("/reports/a.txt", 100, 1000));
+    CHECK(!loaded.is_current("/reports/a.txt", 101, 1000));
+    CHECK(!loaded.is_current("/reports/d.txt", 100, 1000));
+
+    // Incremental update: a changed report moves to another bucket, a new one is added, a deleted
+    // one is removed, and the result survives another round trip.
+    loaded.add("/reports/b.txt", 250, 2500, 2, "SIGABRT | c");
+    loaded.add("/reports/d.txt", 400, 4000, 3, "SIGBUS | d");
+    loaded.erase("/reports/a.txt");
+    CHECK(loaded.save(path));
+
+    bucket_index updated;
+    CHECK(updated.load(path));
+    CHECK(updated.reports_count() == 3);
+    CHECK(updated.buckets().count(1) == 0);
+    CHECK(updated.buckets().at(2).count == 2);
+    CHECK(updated.buckets().at(3).count == 1);
+    CHECK(updated.is_current("/reports/b.txt", 250, 2500));
+
+    // A corrupted file isn't loaded.
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "NDCRBKT2garbage";
+    }
+    CHECK(!updated.load(path));
+    CHECK(updated.reports_count() == 0);
+}
+
+/// Writes a file.
+static void write_file(const std::string &path, const std::string &contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+}
+
+/**
+ * Runs a bucketer and returns a value of a counter from its summary line, for example "processed".
+ * @return Counter value or -1 if a run failed or there's no such counter.
+ */
+static long run_bucketer(const std::string &command, const std::string &counter) {
+    FILE * const pipe = popen((command + " 2>&1").c_str(), "r");
+    if (!pipe) return -1;
+    std::string output;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe)) {
+        output += buffer;
+    }
+    if (pclose(pipe)) {
+        fprintf(stderr, "%s failed:\n%s", command.c_str(), output.c_str());
+        return -1;
+    }
+    const size_t position = output.find(counter + ": ");
+    return position == std::string::npos ? -1 : strtol(output.c_str() + position + counter.size() + 2, nullptr, 10);
+}
+
+static void test_incremental_runs(const std::string &bucketer, const std::string &directory) {
+    const std::string reports = directory + "/reports";
+    const std::string index_path = directory + "/runs.idx";
+    mkdir(reports.c_str(), 0755);
+    unlink(index_path.c_str());
+    unlink((reports + "/3.txt").c_str());
+    write_file(reports + "/1.txt", make_report(0x7f00000000ULL, "/data/app/com.example-1", "crash"));
+    write_file(reports + "/2.txt", make_report(0x7fab340000ULL, "/data/app/com.example-2", "crash"));
+    const std::string command = bucketer + " -i " + index_path + " -x libc.so";
+
+    CHECK(run_bucketer(command + " " + reports, "processed") == 2);
+    CHECK(run_bucketer(command + " " + reports, "processed") == 0);
+
+    // Only a new report is processed.
+    write_file(reports + "/3.txt", make_report(0x7f00000000ULL, "/data/app/com.example-1", "other"));
+    CHECK(run_bucketer(command + " " + reports, "processed") == 1);
+    bucket_index index;
+    CHECK(index.load(index_path));
+    CHECK(index.reports_count() == 3);
+    CHECK(index.buckets().size() == 2);
+    CHECK(index.options().frames == signature_options().frames);
+
+    // Another frames count rebuilds an index from indexed reports even if they aren't passed.
+    CHECK(run_bucketer(command + " -n 1", "processed") == 3);
+    CHECK(index.load(index_path));
+    CHECK(index.options().frames == 1);
+    CHECK(index.reports_count() == 3);
+    CHECK(index.buckets().size() == 2);
+    for (const auto &item : index.buckets()) {
+        CHECK(item.second.signature.find(" | ") == item.second.signature.rfind(" | "));
+    }
+    CHECK(run_bucketer(command + " -n 1 " + reports, "processed") == 0);
+
+    // A deleted report is removed.
+    unlink((reports + "/3.txt").c_str());
+    CHECK(run_bucketer(command + " -n 1", "removed") == 1);
+    CHECK(index.load(index_path));
+    CHECK(index.reports_count() == 2);
+    CHECK(index.buckets().size() == 1);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <bucketer> <work directory>\n", argv[0]);
+        return 1;
+    }
+    mkdir(argv[2], 0755);
+    test_signature_stability();
+    test_index_round_trip(argv[2]);
+    test_incremental_runs(argv[1], argv[2]);
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,1130 @@
+#include "dwarf.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ndcrash {
+
+// DWARF constants, only used ones. See DWARF 5 specification, chapter 7.
+
+static const uint64_t DW_TAG_inlined_subroutine = 0x1d;
+static const uint64_t DW_TAG_compile_unit = 0x11;
+static const uint64_t DW_TAG_subprogram = 0x2e;
+static const uint64_t DW_TAG_partial_unit = 0x3c;
+
+static const uint64_t DW_AT_name = 0x03;
+static const uint64_t DW_AT_stmt_list = 0x10;
+static const uint64_t DW_AT_low_pc = 0x11;
+static const uint64_t DW_AT_high_pc = 0x12;
+static const uint64_t DW_AT_comp_dir = 0x1b;
+static const uint64_t DW_AT_abstract_origin = 0x31;
+static const uint64_t DW_AT_specification = 0x47;
+static const uint64_t DW_AT_ranges = 0x55;
+static const uint64_t DW_AT_call_file = 0x58;
+static const uint64_t DW_AT_call_line = 0x59;
+static const uint64_t DW_AT_linkage_name = 0x6e;
+static const uint64_t DW_AT_str_offsets_base = 0x72;
+static const uint64_t DW_AT_addr_base = 0x73;
+static const uint64_t DW_AT_rnglists_base = 0x74;
+static const uint64_t DW_AT_MIPS_linkage_name = 0x2007;
+static const uint64_t DW_AT_GNU_addr_base = 0x2133;
+
+static const uint64_t DW_FORM_addr = 0x01;
+static const uint64_t DW_FORM_block2 = 0x03;
+static const uint64_t DW_FORM_block4 = 0x04;
+static const uint64_t DW_FORM_data2 = 0x05;
+static const uint64_t DW_FORM_data4 = 0x06;
+static const uint64_t DW_FORM_data8 = 0x07;
+static const uint64_t DW_FORM_string = 0x08;
+static const uint64_t DW_FORM_block = 0x09;
+static const uint64_t DW_FORM_block1 = 0x0a;
+static const uint64_t DW_FORM_data1 = 0x0b;
+static const uint64_t DW_FORM_flag = 0x0c;
+static const uint64_t DW_FORM_sdata = 0x0d;
+static const uint64_t DW_FORM_strp = 0x0e;
+static const uint64_t DW_FORM_udata = 0x0f;
+static const uint64_t DW_FORM_ref_addr = 0x10;
+static const uint64_t DW_FORM_ref1 = 0x11;
+static const uint64_t DW_FORM_ref2 = 0x12;
+static const uint64_t DW_FORM_ref4 = 0x13;
+static const uint64_t DW_FORM_ref8 = 0x14;
+static const uint64_t DW_FORM_ref_udata = 0x15;
+static const uint64_t DW_FORM_indirect = 0x16;
+static const uint64_t DW_FORM_sec_offset = 0x17;
+static const uint64_t DW_FORM_exprloc = 0x18;
+static const uint64_t DW_FORM_flag_present = 0x19;
+static const uint64_t DW_FORM_strx = 0x1a;
+static const uint64_t DW_FORM_addrx = 0x1b;
+static const uint64_t DW_FORM_ref_sup4 = 0x1c;
+static const uint64_t DW_FORM_strp_sup = 0x1d;
+static const uint64_t DW_FORM_data16 = 0x1e;
+static const uint64_t DW_FORM_line_strp = 0x1f;
+static const uint64_t DW_FORM_ref_sig8 = 0x20;
+static const uint64_t DW_FORM_implicit_const = 0x21;
+static const uint64_t DW_FORM_loclistx = 0x22;
+static const uint64_t DW_FORM_rnglistx = 0x23;
+static const uint64_t DW_FORM_ref_sup8 = 0x24;
+static const uint64_t DW_FORM_strx1 = 0x25;
+static const uint64_t DW_FORM_strx2 = 0x26;
+static const uint64_t DW_FORM_strx3 = 0x27;
+static const uint64_t DW_FORM_strx4 = 0x28;
+static const uint64_t DW_FORM_addrx1 = 0x29;
+static const uint64_t DW_FORM_addrx2 = 0x2a;
+static const uint64_t DW_FORM_addrx3 = 0x2b;
+static const uint64_t DW_FORM_addrx4 = 0x2c;
+static const uint64_t DW_FORM_GNU_addr_index = 0x1f01;
+static const uint64_t DW_FORM_GNU_str_index = 0x1f02;
+static const uint64_t DW_FORM_GNU_ref_alt = 0x1f20;
+static const uint64_t DW_FORM_GNU_strp_alt = 0x1f21;
+
+static const uint8_t DW_UT_compile = 0x01;
+static const uint8_t DW_UT_partial = 0x03;
+
+static const uint8_t DW_RLE_end_of_list = 0x00;
+static const uint8_t DW_RLE_base_addressx = 0x01;
+static const uint8_t DW_RLE_startx_endx = 0x02;
+static const uint8_t DW_RLE_startx_length = 0x03;
+static const uint8_t DW_RLE_offset_pair = 0x04;
+static const uint8_t DW_RLE_base_address = 0x05;
+static const uint8_t DW_RLE_start_end = 0x06;
+static const uint8_t DW_RLE_start_length = 0x07;
+
+static const uint8_t DW_LNS_copy = 0x01;
+static const uint8_t DW_LNS_advance_pc = 0x02;
+static const uint8_t DW_LNS_advance_line = 0x03;
+static const uint8_t DW_LNS_set_file = 0x04;
+static const uint8_t DW_LNS_const_add_pc = 0x08;
+static const uint8_t DW_LNS_fixed_advance_pc = 0x09;
+static const uint8_t DW_LNE_end_sequence = 0x01;
+static const uint8_t DW_LNE_set_address = 0x02;
+static const uint64_t DW_LNCT_path = 0x1;
+static const uint64_t DW_LNCT_directory_index = 0x2;
+
+/// Maximum depth of abstract_origin and specification references chain.
+static const int MAX_REFERENCE_DEPTH = 8;
+
+/**
+ * Sequential little-endian reader of section data with bounds checking. On overflow it stops at
+ * the end and all following reads return zeros.
+ */
+class dwarf_info::reader {
+public:
+    reader(const section_data &section, uint64_t offset)
+            : begin_(section.data),
+              end_(section.data + section.size),
+              pos_(offset <= section.size ? section.data + offset : end_) {}
+
+    uint64_t offset() const { return (uint64_t) (pos_ - begin_); }
+    bool at_end() const { return pos_ >= end_; }
+    void seek(uint64_t offset) { pos_ = offset <= (uint64_t) (end_ - begin_) ? begin_ + offset : end_; }
+    void skip(uint64_t size) { pos_ = size <= (uint64_t) (end_ - pos_) ? pos_ + size : end_; }
+
+    uint8_t u8() { return (uint8_t) sized(1); }
+    uint16_t u16() { return (uint16_t) sized(2); }
+    uint32_t u32() { return (uint32_t) sized(4); }
+    uint64_t u64() { return sized(8); }
+
+    /// Reads unsigned value of 1-8 bytes.
+    uint64_t sized(unsigned size) {
+        if ((size_t) (end_ - pos_) < size) {
+            pos_ = end_;
+            return 0;
+        }
+        uint64_t result = 0;
+        for (unsigned i = 0; i < size; ++i) {
+            result |= (uint64_t) pos_[i] << (i * 8);
+        }
+        pos_ += size;
+        return result;
+    }
+
+    /// Reads section offset, its size depends on DWARF format.
+    uint64_t section_offset(bool dwarf64) { return dwarf64 ? u64() : u32(); }
+
+    uint64_t uleb() {
+        uint64_t result = 0;
+        unsigned shift = 0;
+        while (pos_ < end_) {
+            const uint8_t byte = *pos_++;
+            if (shift < 64) result |= (uint64_t) (byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) break;
+        }
+        return result;
+    }
+
+    int64_t sleb() {
+        int64_t result = 0;
+        unsigned shift = 0;
+        uint8_t byte = 0;
+        while (pos_ < end_) {
+            byte = *pos_++;
+            if (shift < 64) result |= (int64_t) (byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) break;
+        }
+        if (shift < 64 && (byte & 0x40)) result |= -((int64_t) 1 << shift);
+        return result;
+    }
+
+    /// Reads a null-terminated string. Returns an empty string on overflow.
+    const char *cstr() {
+        const uint8_t * const start = pos_;
+        while (pos_ < end_ && *pos_) ++pos_;
+        if (pos_ == end_) return "";
+        ++pos_;
+        return (const char *) start;
+    }
+
+private:
+    const uint8_t *begin_;
+    const uint8_t *end_;
+    const uint8_t *pos_;
+};
+
+/**
+ * Abbreviation declaration: a tag and attribute specifications of DIE.
+ */
+struct dwarf_info::abbrev {
+
+    /// Attribute name, form and value for DW_FORM_implicit_const.
+    struct spec {
+        uint64_t name;
+        uint64_t form;
+        int64_t implicit_const;
+    };
+
+    uint64_t tag = 0;
+    bool has_children = false;
+    std::vector<spec> specs;
+};
+
+/**
+ * Attribute value. Indexed and offset forms are resolved separately because bases are known only
+ * after a whole compile unit DIE is read.
+ */
+struct dwarf_info::attribute {
+    enum kind_t {
+        none,
+        constant,
+        address,
+        address_index,
+        string,
+        string_offset,
+        line_string_offset,
+        string_index,
+        reference,
+        section_offset,
+        rnglist_index,
+    };
+
+    kind_t kind = none;
+    uint64_t value = 0;
+    const char *str = nullptr;
+};
+
+/**
+ * Compile unit. Header values are read on construction, line table and functions are parsed on
+ * the first lookup.
+ */
+struct dwarf_info::unit {
+
+    /// Row of line number table.
+    struct line_row {
+        uint64_t address;
+        uint32_t file;
+        uint32_t line;
+    };
+
+    /// Contiguous sequence of line table rows.
+    struct line_sequence {
+        uint64_t low;
+        uint64_t high;
+        size_t begin;
+        size_t end;
+    };
+
+    /// Function or inlined subroutine with code.
+    struct function {
+        std::string name;
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;
+        std::vector<size_t> children;
+        uint64_t call_file = 0;
+        unsigned call_line = 0;
+    };
+
+    /// Address range of a top-level function.
+    struct function_range {
+        uint64_t low;
+        uint64_t high;
+        size_t index;
+    };
+
+    /// Offset of unit header in .debug_info.
+    uint64_t offset = 0;
+
+    /// Offset of the first DIE.
+    uint64_t dies = 0;
+
+    /// Offset after the last byte of unit.
+    uint64_t end = 0;
+
+    uint16_t version = 0;
+    uint8_t address_size = 0;
+    bool dwarf64 = false;
+    const std::unordered_map<uint64_t, abbrev> *abbrevs = nullptr;
+
+    /// Values of compile unit DIE attributes.
+    uint64_t str_offsets_base = 0;
+    uint64_t addr_base = 0;
+    uint64_t rnglists_base = 0;
+    uint64_t base_address = 0;
+    const char *comp_dir = "";
+    bool has_lines = false;
+    uint64_t stmt_list = 0;
+
+    /// Guards lazy parsing.
+    std::once_flag parsed;
+
+    /// Line table.
+    std::vector<line_row> rows;
+    std::vector<line_sequence> sequences;
+    std::vector<std::string> files;
+
+    /// Functions tree. Top-level functions are indexed by address ranges.
+    std::vector<function> functions;
+    std::vector<function_range> function_ranges;
+};
+
+dwarf_info::dwarf_info(const elf_file &elf) : address_size_(elf.address_size()) {
+    const struct {
+        const char *name;
+        section_data *data;
+    } sections[] = {
+            {".debug_info", &info_},
+            {".debug_abbrev", &abbrev_},
+            {".debug_line", &line_},
+            {".debug_str", &str_},
+            {".debug_line_str", &line_str_},
+            {".debug_ranges", &ranges_section_},
+            {".debug_rnglists", &rnglists_},
+            {".debug_addr", &addr_},
+            {".debug_str_offsets", &str_offsets_},
+    };
+    for (const auto &item : sections) {
+        const elf_file::section * const section = elf.find_section(item.name);
+        if (section) {
+            item.data->data = section->data;
+            item.data->size = section->size;
+        }
+    }
+    if (info_.data && abbrev_.data) {
+        read_units();
+    }
+}
+
+dwarf_info::~dwarf_info() = default;
+
+const std::unordered_map<uint64_t, dwarf_info::abbrev> *dwarf_info::read_abbrevs(uint64_t offset) {
+    auto it = abbrevs_.find(offset);
+    if (it != abbrevs_.end()) return it->second.get();
+    std::unique_ptr<std::unordered_map<uint64_t, abbrev>> table(new std::unordered_map<uint64_t, abbrev>());
+    reader in(abbrev_, offset);
+    while (!in.at_end()) {
+        const uint64_t code = in.uleb();
+        if (!code) break;
+        abbrev &item = (*table)[code];
+        item.tag = in.uleb();
+        item.has_children = in.u8() != 0;
+        for (;;) {
+            const uint64_t name = in.uleb();
+            const uint64_t form = in.uleb();
+            if (!name && !form) break;
+            const int64_t implicit_const = form == DW_FORM_implicit_const ? in.sleb() : 0;
+            item.specs.push_back({name, form, implicit_const});
+            if (in.at_end()) break;
+        }
+    }
+    const auto *result = table.get();
+    abbrevs_.emplace(offset, std::move(table));
+    return result;
+}
+
+bool dwarf_info::read_attribute(reader &in, const unit &cu, uint64_t form, int64_t implicit_const, attribute &value) const {
+    value = attribute();
+    switch (form) {
+        case DW_FORM_addr:
+            value.kind = attribute::address;
+            value.value = in.sized(cu.address_size);
+            return true;
+        case DW_FORM_data1:
+        case DW_FORM_flag:
+            value.kind = attribute::constant;
+            value.value = in.u8();
+            return true;
+        case DW_FORM_data2:
+            value.kind = attribute::constant;
+            value.value = in.u16();
+            return true;
+        case DW_FORM_data4:
+            value.kind = attribute::constant;
+            value.value = in.u32();
+            return true;
+        case DW_FORM_data8:
+            value.kind = attribute::constant;
+            value.value = in.u64();
+            return true;
+        case DW_FORM_data16:
+            in.skip(16);
+            return true;
+        case DW_FORM_sdata:
+            value.kind = attribute::constant;
+            value.value = (uint64_t) in.sleb();
+            return true;
+        case DW_FORM_udata:
+            value.kind = attribute::constant;
+            value.value = in.uleb();
+            return true;
+        case DW_FORM_flag_present:
+            value.kind = attribute::constant;
+            value.value = 1;
+            return true;
+        case DW_FORM_implicit_const:
+            value.kind = attribute::constant;
+            value.value = (uint64_t) implicit_const;
+            return true;
+        case DW_FORM_string:
+            value.kind = attribute::string;
+            value.str = in.cstr();
+            return true;
+        case DW_FORM_strp:
+            value.kind = attribute::string_offset;
+            value.value = in.section_offset(cu.dwarf64);
+            return true;
+        case DW_FORM_line_strp:
+            value.kind = attribute::line_string_offset;
+            value.value = in.section_offset(cu.dwarf64);
+            return true;
+        case DW_FORM_strp_sup:
+        case DW_FORM_GNU_strp_alt:
+        case DW_FORM_GNU_ref_alt:
+            // Supplementary object files aren't supported.
+            in.section_offset(cu.dwarf64);
+            return true;
+        case DW_FORM_strx:
+        case DW_FORM_GNU_str_index:
+            value.kind = attribute::string_index;
+            value.value = in.uleb();
+            return true;
+        case DW_FORM_strx1:
+        case DW_FORM_strx2:
+        case DW_FORM_strx3:
+        case DW_FORM_strx4:
+            value.kind = attribute::string_index;
+            value.value = in.sized((unsigned) (form - DW_FORM_strx1 + 1));
+            return true;
+        case DW_FORM_addrx:
+        case DW_FORM_GNU_addr_index:
+            value.kind = attribute::address_index;
+            value.value = in.uleb();
+            return true;
+        case DW_FORM_addrx1:
+        case DW_FORM_addrx2:
+        case DW_FORM_addrx3:
+        case DW_FORM_addrx4:
+            value.kind = attribute::address_index;
+            value.value = in.sized((unsigned) (form - DW_FORM_addrx1 + 1));
+            return true;
+        case DW_FORM_ref1:
+            value.kind = attribute::reference;
+            value.value = cu.offset + in.u8();
+            return true;
+        case DW_FORM_ref2:
+            value.kind = attribute::reference;
+            value.value = cu.offset + in.u16();
+            return true;
+        case DW_FORM_ref4:
+            value.kind = attribute::reference;
+            value.value = cu.offset + in.u32();
+            return true;
+        case DW_FORM_ref8:
+            value.kind = attribute::reference;
+            value.value = cu.offset + in.u64();
+            return true;
+        case DW_FORM_ref_udata:
+            value.kind = attribute::reference;
+            value.value = cu.offset + in.uleb();
+            return true;
+        case DW_FORM_ref_addr:
+            value.kind = attribute::reference;
+            value.value = cu.version <= 2 ? in.sized(cu.address_size) : in.section_offset(cu.dwarf64);
+            return true;
+        case DW_FORM_ref_sig8:
+        case DW_FORM_ref_sup8:
+            in.skip(8);
+            return true;
+        case DW_FORM_ref_sup4:
+            in.skip(4);
+            return true;
+        case DW_FORM_sec_offset:
+            value.kind = attribute::section_offset;
+            value.value = in.section_offset(cu.dwarf64);
+            return true;
+        case DW_FORM_exprloc:
+        case DW_FORM_block:
+            in.skip(in.uleb());
+            return true;
+        case DW_FORM_block1:
+            in.skip(in.u8());
+            return true;
+        case DW_FORM_block2:
+            in.skip(in.u16());
+            return true;
+        case DW_FORM_block4:
+            in.skip(in.u32());
+            return true;
+        case DW_FORM_loclistx:
+            in.uleb();
+            return true;
+        case DW_FORM_rnglistx:
+            value.kind = attribute::rnglist_index;
+            value.value = in.uleb();
+            return true;
+        case DW_FORM_indirect:
+            return read_attribute(in, cu, in.uleb(), 0, value);
+        default:
+            // Unknown form, it's impossible to skip it.
+            return false;
+    }
+}
+
+const char *dwarf_info::attribute_string(const unit &cu, const attribute &value) const {
+    const section_data *section = &str_;
+    uint64_t offset = value.value;
+    switch (value.kind) {
+        case attribute::string:
+            return value.str;
+        case attribute::string_offset:
+            break;
+        case attribute::line_string_offset:
+            section = &line_str_;
+            break;
+        case attribute::string_index: {
+            const unsigned entry_size = cu.dwarf64 ? 8 : 4;
+            reader in(str_offsets_, cu.str_offsets_base + offset * entry_size);
+            offset = in.section_offset(cu.dwarf64);
+            break;
+        }
+        default:
+            return nullptr;
+    }
+    if (!section->data || offset >= section->size) return nullptr;
+    return (const char *) section->data + offset;
+}
+
+uint64_t dwarf_info::attribute_address(const unit &cu, const attribute &value) const {
+    if (value.kind == attribute::address) return value.value;
+    if (value.kind != attribute::address_index) return 0;
+    reader in(addr_, cu.addr_base + value.value * cu.address_size);
+    return in.sized(cu.address_size);
+}
+
+void dwarf_info::read_ranges(
+        const unit &cu,
+        const attribute &value,
+        std::vector<std::pair<uint64_t, uint64_t>> &result) const {
+    if (cu.version < 5) {
+        // .debug_ranges: pairs of addresses relative to a base, a pair with maximum address value
+        // selects a new base.
+        const uint64_t max_address = cu.address_size == 8 ? UINT64_MAX : UINT32_MAX;
+        reader in(ranges_section_, value.value);
+        uint64_t base = cu.base_address;
+        while (!in.at_end()) {
+            const uint64_t begin = in.sized(cu.address_size);
+            const uint64_t end = in.sized(cu.address_size);
+            if (!begin && !end) break;
+            if (begin == max_address) {
+                base = end;
+            } else {
+                result.emplace_back(base + begin, base + end);
+            }
+        }
+        return;
+    }
+
+    // .debug_rnglists: typed entries. Indexed form refers to offsets table after rnglists_base.
+    uint64_t offset = value.value;
+    if (value.kind == attribute::rnglist_index) {
+        reader offsets(rnglists_, cu.rnglists_base + value.value * (cu.dwarf64 ? 8 : 4));
+        offset = cu.rnglists_base + offsets.section_offset(cu.dwarf64);
+    }
+    auto indexed_address = [&](uint64_t index) {
+        attribute item;
+        item.kind = attribute::address_index;
+        item.value = index;
+        return attribute_address(cu, item);
+    };
+    reader in(rnglists_, offset);
+    uint64_t base = cu.base_address;
+    while (!in.at_end()) {
+        const uint8_t type = in.u8();
+        if (type == DW_RLE_end_of_list) break;
+        switch (type) {
+            case DW_RLE_base_addressx:
+                base = indexed_address(in.uleb());
+                break;
+            case DW_RLE_startx_endx: {
+                const uint64_t begin = indexed_address(in.uleb());
+                result.emplace_back(begin, indexed_address(in.uleb()));
+                break;
+            }
+            case DW_RLE_startx_length: {
+                const uint64_t begin = indexed_address(in.uleb());
+                result.emplace_back(begin, begin + in.uleb());
+                break;
+            }
+            case DW_RLE_offset_pair: {
+                const uint64_t begin = base + in.uleb();
+                result.emplace_back(begin, base + in.uleb());
+                break;
+            }
+            case DW_RLE_base_address:
+                base = in.sized(cu.address_size);
+                break;
+            case DW_RLE_start_end: {
+                const uint64_t begin = in.sized(cu.address_size);
+                result.emplace_back(begin, in.sized(cu.address_size));
+                break;
+            }
+            case DW_RLE_start_length: {
+                const uint64_t begin = in.sized(cu.address_size);
+                result.emplace_back(begin, begin + in.uleb());
+                break;
+            }
+            default:
+                return;
+        }
+    }
+}
+
+void dwarf_info::read_units() {
+    reader in(info_, 0);
+    while (!in.at_end()) {
+        std::unique_ptr<unit> cu(new unit());
+        cu->offset = in.offset();
+        uint64_t length = in.u32();
+        cu->dwarf64 = length == 0xffffffff;
+        if (cu->dwarf64) {
+            length = in.u64();
+        }
+        cu->end = in.offset() + length;
+        cu->version = in.u16();
+        uint64_t abbrev_offset = 0;
+        bool supported = cu->version >= 2 && cu->version <= 5;
+        if (cu->version >= 5) {
+            // Type units and split units are skipped.
+            const uint8_t type = in.u8();
+            cu->address_size = in.u8();
+            abbrev_offset = in.section_offset(cu->dwarf64);
+            supported = supported && (type == DW_UT_compile || type == DW_UT_partial);
+        } else {
+            abbrev_offset = in.section_offset(cu->dwarf64);
+            cu->address_size = in.u8();
+        }
+        cu->dies = in.offset();
+        if (!length || cu->end > info_.size) break;
+        in.seek(cu->end);
+        if (!supported || (cu->address_size != 4 && cu->address_size != 8)) continue;
+        cu->abbrevs = read_abbrevs(abbrev_offset);
+
+        // Reading compile unit DIE.
+        reader die(info_, cu->dies);
+        const auto abbrev_it = cu->abbrevs->find(die.uleb());
+        if (abbrev_it == cu->abbrevs->end()) continue;
+        const abbrev &cu_abbrev = abbrev_it->second;
+        if (cu_abbrev.tag != DW_TAG_compile_unit && cu_abbrev.tag != DW_TAG_partial_unit) continue;
+        attribute low_pc, high_pc, ranges;
+        bool valid = true;
+        for (const abbrev::spec &spec : cu_abbrev.specs) {
+            attribute value;
+            if (!read_attribute(die, *cu, spec.form, spec.implicit_const, value)) {
+                valid = false;
+                break;
+            }
+            switch (spec.name) {
+                case DW_AT_low_pc:
+                    low_pc = value;
+                    break;
+                case DW_AT_high_pc:
+                    high_pc = value;
+                    break;
+                case DW_AT_ranges:
+                    ranges = value;
+                    break;
+                case DW_AT_stmt_list:
+                    cu->has_lines = true;
+                    cu->stmt_list = value.value;
+                    break;
+                case DW_AT_comp_dir:
+                    // Resolved below, string offsets base may follow.
+                    break;
+                case DW_AT_str_offsets_base:
+                    cu->str_offsets_base = value.value;
+                    break;
+                case DW_AT_addr_base:
+                case DW_AT_GNU_addr_base:
+                    cu->addr_base = value.value;
+                    break;
+                case DW_AT_rnglists_base:
+                    cu->rnglists_base = value.value;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (!valid) continue;
+
+        // The second pass for string attributes, bases are known now.
+        reader names(info_, cu->dies);
+        names.uleb();
+        for (const abbrev::spec &spec : cu_abbrev.specs) {
+            attribute value;
+            read_attribute(names, *cu, spec.form, spec.implicit_const, value);
+            if (spec.name == DW_AT_comp_dir) {
+                const char * const comp_dir = attribute_string(*cu, value);
+                if (comp_dir) cu->comp_dir = comp_dir;
+            }
+        }
+        if (cu->version >= 5 && !cu->str_offsets_base && str_offsets_.data) {
+            // Default base is right after the first offsets table header.
+            cu->str_offsets_base = cu->dwarf64 ? 16 : 8;
+        }
+
+        // Address ranges of a unit.
+        std::vector<std::pair<uint64_t, uint64_t>> unit_ranges;
+        if (low_pc.kind != attribute::none) {
+            cu->base_address = attribute_address(*cu, low_pc);
+        }
+        if (ranges.kind != attribute::none) {
+            read_ranges(*cu, ranges, unit_ranges);
+        } else if (low_pc.kind != attribute::none && high_pc.kind != attribute::none) {
+            const uint64_t high = high_pc.kind == attribute::constant ?
+                    cu->base_address + high_pc.value : attribute_address(*cu, high_pc);
+            unit_ranges.emplace_back(cu->base_address, high);
+        } else {
+            // No ranges in a unit DIE, taking them from functions.
+            unit &parsed = *cu;
+            std::call_once(parsed.parsed, [this, &parsed] { parse_unit(parsed); });
+            for (const unit::function_range &range : parsed.function_ranges) {
+                unit_ranges.emplace_back(range.low, range.high);
+            }
+        }
+        for (const auto &range : unit_ranges) {
+            // Ranges starting at 0 belong to functions removed by a linker.
+            if (range.first && range.first < range.second) {
+                ranges_.push_back({range.first, range.second, cu.get()});
+            }
+        }
+        units_.push_back(std::move(cu));
+    }
+    std::sort(ranges_.begin(), ranges_.end(), [](const unit_range &a, const unit_range &b) {
+        return a.low < b.low;
+    });
+}
+
+void dwarf_info::parse_lines(unit &cu) const {
+    reader in(line_, cu.stmt_list);
+    uint64_t length = in.u32();
+    const bool dwarf64 = length == 0xffffffff;
+    if (dwarf64) {
+        length = in.u64();
+    }
+    const uint64_t end = in.offset() + length;
+    const uint16_t version = in.u16();
+    if (version < 2 || version > 5) return;
+    uint8_t address_size = cu.address_size;
+    if (version >= 5) {
+        address_size = in.u8();
+        in.u8(); // segment_selector_size
+    }
+    const uint64_t header_length = in.section_offset(dwarf64);
+    const uint64_t program = in.offset() + header_length;
+    const uint8_t min_instruction_length = in.u8();
+    if (version >= 4) {
+        in.u8(); // maximum_operations_per_instruction, VLIW isn't supported
+    }
+    in.u8(); // default_is_stmt
+    const int8_t line_base = (int8_t) in.u8();
+    const uint8_t line_range = in.u8();
+    const uint8_t opcode_base = in.u8();
+    if (!line_range || !opcode_base) return;
+    std::vector<uint8_t> opcode_lengths(opcode_base, 0);
+    for (uint8_t i = 1; i < opcode_base; ++i) {
+        opcode_lengths[i] = in.u8();
+    }
+
+    // Directories and file names. In DWARF 5 both tables are 0-based and described by formats.
+    std::vector<std::string> directories;
+    if (version < 5) {
+        directories.push_back(cu.comp_dir);
+        for (const char *dir = in.cstr(); *dir; dir = in.cstr()) {
+            directories.push_back(dir);
+        }
+        cu.files.emplace_back();
+        for (const char *name = in.cstr(); *name; name = in.cstr()) {
+            const uint64_t dir = in.uleb();
+            in.uleb(); // modification time
+            in.uleb(); // file length
+            std::string path = name;
+            if (name[0] != '/' && dir < directories.size() && !directories[dir].empty()) {
+                path = directories[dir] + "/" + name;
+            }
+            cu.files.push_back(std::move(path));
+        }
+    } else {
+        // A line table uses its own address size and offset size for forms.
+        unit format;
+        format.version = version;
+        format.address_size = address_size;
+        format.dwarf64 = dwarf64;
+        format.str_offsets_base = cu.str_offsets_base;
+        for (int table = 0; table < 2; ++table) {
+            std::vector<std::pair<uint64_t, uint64_t>> formats(in.u8());
+            for (auto &item : formats) {
+                item.first = in.uleb();
+                item.second = in.uleb();
+            }
+            const uint64_t count = in.uleb();
+            for (uint64_t i = 0; i < count && !in.at_end(); ++i) {
+                const char *path = "";
+                uint64_t dir = 0;
+                for (const auto &item : formats) {
+                    attribute value;
+                    if (!read_attribute(in, format, item.second, 0, value)) return;
+                    if (item.first == DW_LNCT_path) {
+                        const char * const str = attribute_string(format, value);
+                        if (str) path = str;
+                    } else if (item.first == DW_LNCT_directory_index) {
+                        dir = value.value;
+                    }
+                }
+                if (!table) {
+                    directories.push_back(path);
+                } else if (path[0] != '/' && dir < directories.size() && !directories[dir].empty()) {
+                    cu.files.push_back(directories[dir] + "/" + path);
+                } else {
+                    cu.files.push_back(path);
+                }
+            }
+        }
+    }
+
+    // Running line number program.
+    in.seek(program);
+    uint64_t address = 0;
+    uint32_t file = 1;
+    int64_t line = 1;
+    size_t sequence_begin = cu.rows.size();
+    auto emit = [&] {
+        cu.rows.push_back({address, file, (uint32_t) line});
+    };
+    while (in.offset() < end && !in.at_end()) {
+        const uint8_t opcode = in.u8();
+        if (opcode >= opcode_base) {
+            const uint8_t adjusted = (uint8_t) (opcode - opcode_base);
+            address += (adjusted / line_range) * min_instruction_length;
+            line += line_base + adjusted % line_range;
+            emit();
+            continue;
+        }
+        switch (opcode) {
+            case 0: {
+                const uint64_t size = in.uleb();
+                const uint64_t next = in.offset() + size;
+                const uint8_t extended = size ? in.u8() : 0;
+                if (extended == DW_LNE_end_sequence) {
+                    // Sequences at address 0 belong to functions removed by a linker.
+                    if (cu.rows.size() > sequence_begin && cu.rows[sequence_begin].address) {
+                        cu.sequences.push_back({cu.rows[sequence_begin].address, address, sequence_begin, cu.rows.size()});
+                    } else {
+                        cu.rows.resize(sequence_begin);
+                    }
+                    sequence_begin = cu.rows.size();
+                    address = 0;
+                    file = 1;
+                    line = 1;
+                } else if (extended == DW_LNE_set_address) {
+                    address = in.sized((unsigned) std::min<uint64_t>(size - 1, 8));
+                }
+                in.seek(next);
+                break;
+            }
+            case DW_LNS_copy:
+                emit();
+                break;
+            case DW_LNS_advance_pc:
+                address += in.uleb() * min_instruction_length;
+                break;
+            case DW_LNS_advance_line:
+                line += in.sleb();
+                break;
+            case DW_LNS_set_file:
+                file = (uint32_t) in.uleb();
+                break;
+            case DW_LNS_const_add_pc:
+                address += ((255 - opcode_base) / line_range) * min_instruction_length;
+                break;
+            case DW_LNS_fixed_advance_pc:
+                address += in.u16();
+                break;
+            default:
+                // Other standard opcodes don't affect rows, skipping their arguments.
+                for (uint8_t i = 0; i < opcode_lengths[opcode]; ++i) {
+                    in.uleb();
+                }
+                break;
+        }
+    }
+    cu.rows.resize(sequence_begin);
+    std::sort(cu.sequences.begin(), cu.sequences.end(), [](const unit::line_sequence &a, const unit::line_sequence &b) {
+        return a.low < b.low;
+    });
+}
+
+std::string dwarf_info::die_name(const unit &cu, uint64_t offset, int depth) const {
+    reader in(info_, offset);
+    const auto abbrev_it = cu.abbrevs->find(in.uleb());
+    if (abbrev_it == cu.abbrevs->end()) return std::string();
+    const char *name = nullptr;
+    const char *linkage_name = nullptr;
+    uint64_t reference = 0;
+    for (const abbrev::spec &spec : abbrev_it->second.specs) {
+        attribute value;
+        if (!read_attribute(in, cu, spec.form, spec.implicit_const, value)) break;
+        switch (spec.name) {
+            case DW_AT_name:
+                name = attribute_string(cu, value);
+                break;
+            case DW_AT_linkage_name:
+            case DW_AT_MIPS_linkage_name:
+                linkage_name = attribute_string(cu, value);
+                break;
+            case DW_AT_abstract_origin:
+            case DW_AT_specification:
+                if (value.kind == attribute::reference) reference = value.value;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // A linkage name gives a fully qualified name with arguments.
+    if (linkage_name) return demangle(linkage_name);
+    if (reference && depth < MAX_REFERENCE_DEPTH) {
+        const unit * const target = find_unit_by_offset(reference);
+        if (target) {
+            std::string result = die_name(*target, reference, depth + 1);
+            if (!result.empty()) return result;
+        }
+    }
+    return name ? name : std::string();
+}
+
+const dwarf_info::unit *dwarf_info::find_unit_by_offset(uint64_t offset) const {
+    const auto it = std::upper_bound(units_.begin(), units_.end(), offset, [](uint64_t value, const std::unique_ptr<unit> &cu) {
+        return value < cu->offset;
+    });
+    if (it == units_.begin()) return nullptr;
+    const unit * const result = (it - 1)->get();
+    return offset < result->end ? result : nullptr;
+}
+
+void dwarf_info::parse_unit(unit &cu) const {
+    if (cu.has_lines && line_.data) {
+        parse_lines(cu);
+    }
+
+    // Walking DIE tree. A stack keeps the nearest enclosing function for every open DIE with children.
+    reader in(info_, cu.dies);
+    std::vector<long> parents;
+    while (in.offset() < cu.end && !in.at_end()) {
+        const uint64_t offset = in.offset();
+        const uint64_t code = in.uleb();
+        if (!code) {
+            if (parents.empty()) break;
+            parents.pop_back();
+            continue;
+        }
+        const auto abbrev_it = cu.abbrevs->find(code);
+        if (abbrev_it == cu.abbrevs->end()) break;
+        const abbrev &die = abbrev_it->second;
+        const bool is_function = die.tag == DW_TAG_subprogram || die.tag == DW_TAG_inlined_subroutine;
+        attribute low_pc, high_pc, ranges;
+        uint64_t call_file = 0, call_line = 0;
+        bool valid = true;
+        for (const abbrev::spec &spec : die.specs) {
+            attribute value;
+            if (!read_attribute(in, cu, spec.form, spec.implicit_const, value)) {
+                valid = false;
+                break;
+            }
+            if (!is_function) continue;
+            switch (spec.name) {
+                case DW_AT_low_pc:
+                    low_pc = value;
+                    break;
+                case DW_AT_high_pc:
+                    high_pc = value;
+                    break;
+                case DW_AT_ranges:
+                    ranges = value;
+                    break;
+                case DW_AT_call_file:
+                    call_file = value.value;
+                    break;
+                case DW_AT_call_line:
+                    call_line = value.value;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (!valid) break;
+
+        const long parent = parents.empty() ? -1 : parents.back();
+        long current = parent;
+        if (is_function) {
+            std::vector<std::pair<uint64_t, uint64_t>> function_ranges;
+            if (ranges.kind != attribute::none) {
+                read_ranges(cu, ranges, function_ranges);
+            } else if (low_pc.kind != attribute::none && high_pc.kind != attribute::none) {
+                const uint64_t low = attribute_address(cu, low_pc);
+                const uint64_t high = high_pc.kind == attribute::constant ?
+                        low + high_pc.value : attribute_address(cu, high_pc);
+                function_ranges.emplace_back(low, high);
+            }
+            function_ranges.erase(std::remove_if(function_ranges.begin(), function_ranges.end(),
+                    [](const std::pair<uint64_t, uint64_t> &range) {
+                        return !range.first || range.first >= range.second;
+                    }), function_ranges.end());
+            if (!function_ranges.empty()) {
+                current = (long) cu.functions.size();
+                cu.functions.emplace_back();
+                unit::function &function = cu.functions.back();
+                function.name = die_name(cu, offset, 0);
+                function.ranges = std::move(function_ranges);
+                function.call_file = call_file;
+                function.call_line = (unsigned) call_line;
+                // Nested subprograms like methods of local classes are separate functions, only
+                // inlined subroutines are attached to the enclosing function.
+                if (parent >= 0 && die.tag == DW_TAG_inlined_subroutine) {
+                    cu.functions[parent].children.push_back((size_t) current);
+                } else {
+                    for (const auto &range : cu.functions[current].ranges) {
+                        cu.function_ranges.push_back({range.first, range.second, (size_t) current});
+                    }
+                }
+            }
+        }
+        if (die.has_children) {
+            parents.push_back(current);
+        }
+    }
+    std::sort(cu.function_ranges.begin(), cu.function_ranges.end(),
+              [](const unit::function_range &a, const unit::function_range &b) {
+                  return a.low < b.low;
+              });
+}
+
+bool dwarf_info::lookup(uint64_t address, std::vector<source_frame> &frames) const {
+    // Looking for a compile unit. Ranges may overlap, checking several previous ones.
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), address, [](uint64_t value, const unit_range &range) {
+        return value < range.low;
+    });
+    unit *cu = nullptr;
+    for (size_t checked = 0; it != ranges_.begin() && checked < 16; ++checked) {
+        --it;
+        if (address < it->high) {
+            cu = it->owner;
+            break;
+        }
+    }
+    if (!cu) return false;
+    std::call_once(cu->parsed, [this, cu] { parse_unit(*cu); });
+
+    // Position from line table.
+    const unit::line_row *row = nullptr;
+    const auto sequence = std::upper_bound(cu->sequences.begin(), cu->sequences.end(), address,
+            [](uint64_t value, const unit::line_sequence &item) {
+                return value < item.low;
+            });
+    if (sequence != cu->sequences.begin() && address < (sequence - 1)->high) {
+        const auto rows_begin = cu->rows.begin() + (sequence - 1)->begin;
+        const auto rows_end = cu->rows.begin() + (sequence - 1)->end;
+        const auto row_it = std::upper_bound(rows_begin, rows_end, address, [](uint64_t value, const unit::line_row &item) {
+            return value < item.address;
+        });
+        if (row_it != rows_begin) {
+            row = &*(row_it - 1);
+        }
+    }
+    auto file_name = [cu](uint64_t index) {
+        return index < cu->files.size() ? cu->files[index] : std::string();
+    };
+
+    // Chain of functions from a top-level one to the innermost inlined subroutine.
+    std::vector<const unit::function *> chain;
+    auto contains = [address](const unit::function &function) {
+        for (const auto &range : function.ranges) {
+            if (range.first <= address && address < range.second) return true;
+        }
+        return false;
+    };
+    auto function_it = std::upper_bound(cu->function_ranges.begin(), cu->function_ranges.end(), address,
+            [](uint64_t value, const unit::function_range &range) {
+                return value < range.low;
+            });
+    for (size_t checked = 0; function_it != cu->function_ranges.begin() && checked < 16; ++checked) {
+        --function_it;
+        if (address < function_it->high) {
+            chain.push_back(&cu->functions[function_it->index]);
+            break;
+        }
+    }
+    while (!chain.empty()) {
+        const unit::function *next = nullptr;
+        for (size_t child : chain.back()->children) {
+            if (contains(cu->functions[child])) {
+                next = &cu->functions[child];
+                break;
+            }
+        }
+        if (!next) break;
+        chain.push_back(next);
+    }
+
+    if (chain.empty()) {
+        if (!row) return false;
+        source_frame frame;
+        frame.file = file_name(row->file);
+        frame.line = row->line;
+        frames.push_back(std::move(frame));
+        return true;
+    }
+
+    // The innermost function position is taken from a line table, others from call sites.
+    std::string file = row ? file_name(row->file) : std::string();
+    unsigned line = row ? row->line : 0;
+    for (size_t i = chain.size(); i > 0; --i) {
+        const unit::function &function = *chain[i - 1];
+        source_frame frame;
+        frame.function = function.name;
+        frame.file = file;
+        frame.line = line;
+        frames.push_back(std::move(frame));
+        file = file_name(function.call_file);
+        line = function.call_line;
+    }
+    return true;
+}
+
+} // namespace ndcrash
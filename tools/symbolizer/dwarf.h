@@ -0,0 +1,122 @@
+#ifndef NDCRASH_SYMBOLIZER_DWARF_H
+#define NDCRASH_SYMBOLIZER_DWARF_H
+#include "elf_file.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ndcrash {
+
+/**
+ * A frame of symbolized address: a function and a source position within it.
+ */
+struct source_frame {
+
+    /// Function name, demangled. Empty if unknown.
+    std::string function;
+
+    /// Source file path. Empty if unknown.
+    std::string file;
+
+    /// Line number, 0 if unknown.
+    unsigned line = 0;
+};
+
+/**
+ * Compact reader of DWARF debug information (versions 2-5). Supports only what's needed for
+ * symbolization: compile units address ranges, line number programs and a tree of functions with
+ * inlined subroutines. Compile units are parsed lazily on the first lookup within them, lookups
+ * from different threads are safe.
+ */
+class dwarf_info {
+public:
+
+    /**
+     * Reads compile units list of a file. A file should outlive this instance.
+     * @param elf ELF file with debug sections.
+     */
+    explicit dwarf_info(const elf_file &elf);
+    ~dwarf_info();
+
+    /// Flag whether a file has no debug information.
+    bool empty() const { return ranges_.empty(); }
+
+    /**
+     * Looks for a source position of an address.
+     * @param address ELF virtual address. For return addresses it should point to a call instruction.
+     * @param frames Vector where to append frames, the innermost inlined function first and a real
+     * function last.
+     * @return Flag whether an address is covered by debug information.
+     */
+    bool lookup(uint64_t address, std::vector<source_frame> &frames) const;
+
+private:
+    struct abbrev;
+    struct unit;
+    struct attribute;
+    class reader;
+
+    /// Address range of a compile unit.
+    struct unit_range {
+        uint64_t low;
+        uint64_t high;
+        unit *owner;
+    };
+
+    /// Section data, empty if a section is absent.
+    struct section_data {
+        const uint8_t *data = nullptr;
+        size_t size = 0;
+    };
+
+    /// Reads all compile unit headers and their ranges.
+    void read_units();
+
+    /// Reads an abbreviations table, tables are cached by offset.
+    const std::unordered_map<uint64_t, abbrev> *read_abbrevs(uint64_t offset);
+
+    /// Reads attribute value of a specified form.
+    bool read_attribute(reader &in, const unit &cu, uint64_t form, int64_t implicit_const, attribute &value) const;
+
+    /// Resolves string value, including indexed forms.
+    const char *attribute_string(const unit &cu, const attribute &value) const;
+
+    /// Resolves address value, including indexed forms.
+    uint64_t attribute_address(const unit &cu, const attribute &value) const;
+
+    /// Reads address ranges of DW_AT_ranges attribute.
+    void read_ranges(const unit &cu, const attribute &value, std::vector<std::pair<uint64_t, uint64_t>> &result) const;
+
+    /// Parses line table and functions of a compile unit.
+    void parse_unit(unit &cu) const;
+
+    /// Parses line number program of a compile unit.
+    void parse_lines(unit &cu) const;
+
+    /// Looks for a function name by DIE offset following abstract_origin and specification.
+    std::string die_name(const unit &cu, uint64_t offset, int depth) const;
+
+    /// Looks for a compile unit containing a DIE at specified section offset.
+    const unit *find_unit_by_offset(uint64_t offset) const;
+
+    section_data info_, abbrev_, line_, str_, line_str_, ranges_section_, rnglists_, addr_, str_offsets_;
+
+    /// Size of an address in bytes.
+    unsigned address_size_;
+
+    /// Compile units in order of appearance.
+    std::vector<std::unique_ptr<unit>> units_;
+
+    /// Address ranges of all compile units, sorted by low address.
+    std::vector<unit_range> ranges_;
+
+    /// Cached abbreviation tables by offset.
+    std::unordered_map<uint64_t, std::unique_ptr<std::unordered_map<uint64_t, abbrev>>> abbrevs_;
+};
+
+} // namespace ndcrash
+
+#endif //NDCRASH_SYMBOLIZER_DWARF_H
@@ -0,0 +1,195 @@
+#include "elf_file.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cxxabi.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace ndcrash {
+
+std::unique_ptr<elf_file> elf_file::open(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode) || (size_t) st.st_size < sizeof(Elf32_Ehdr)) {
+        close(fd);
+        return nullptr;
+    }
+    void * const data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return nullptr;
+
+    std::unique_ptr<elf_file> file(new elf_file());
+    file->path_ = path;
+    file->data_ = (const uint8_t *) data;
+    file->size_ = (size_t) st.st_size;
+    const uint8_t * const ident = file->data_;
+    if (memcmp(ident, ELFMAG, SELFMAG) || ident[EI_DATA] != ELFDATA2LSB) return nullptr;
+    bool parsed = false;
+    if (ident[EI_CLASS] == ELFCLASS64 && file->size_ >= sizeof(Elf64_Ehdr)) {
+        file->is_64_ = true;
+        parsed = file->parse<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr>();
+    } else if (ident[EI_CLASS] == ELFCLASS32) {
+        parsed = file->parse<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr>();
+    }
+    if (!parsed) return nullptr;
+    return file;
+}
+
+elf_file::~elf_file() {
+    if (data_) {
+        munmap((void *) data_, size_);
+    }
+}
+
+template <typename Ehdr, typename Shdr, typename Phdr>
+bool elf_file::parse() {
+    const Ehdr * const ehdr = (const Ehdr *) data_;
+    machine_ = ehdr->e_machine;
+
+    // Program headers, only notes are used.
+    if (ehdr->e_phentsize == sizeof(Phdr) && ehdr->e_phoff + (uint64_t) ehdr->e_phnum * sizeof(Phdr) <= size_) {
+        const Phdr * const phdrs = (const Phdr *) (data_ + ehdr->e_phoff);
+        for (size_t i = 0; i < ehdr->e_phnum; ++i) {
+            if (phdrs[i].p_type == PT_NOTE && phdrs[i].p_offset + phdrs[i].p_filesz <= size_) {
+                notes_.emplace_back(data_ + phdrs[i].p_offset, (size_t) phdrs[i].p_filesz);
+            }
+        }
+    }
+
+    // Sections with names.
+    if (ehdr->e_shentsize != sizeof(Shdr) || ehdr->e_shoff + (uint64_t) ehdr->e_shnum * sizeof(Shdr) > size_) {
+        return !notes_.empty();
+    }
+    const Shdr * const shdrs = (const Shdr *) (data_ + ehdr->e_shoff);
+    const Shdr * const names = ehdr->e_shstrndx < ehdr->e_shnum ? &shdrs[ehdr->e_shstrndx] : nullptr;
+    if (names && names->sh_offset + names->sh_size > size_) return false;
+    sections_.resize(ehdr->e_shnum);
+    for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+        const Shdr &shdr = shdrs[i];
+        section &item = sections_[i];
+        if (names && shdr.sh_name < names->sh_size) {
+            const char * const name = (const char *) (data_ + names->sh_offset + shdr.sh_name);
+            item.name.assign(name, strnlen(name, names->sh_size - shdr.sh_name));
+        }
+        item.type = shdr.sh_type;
+        item.flags = shdr.sh_flags;
+        item.link = shdr.sh_link;
+        if (shdr.sh_type != SHT_NOBITS && shdr.sh_offset + shdr.sh_size <= size_) {
+            item.data = data_ + shdr.sh_offset;
+            item.size = (size_t) shdr.sh_size;
+        }
+    }
+    return true;
+}
+
+const elf_file::section *elf_file::find_section(const char *name) const {
+    for (const section &item : sections_) {
+        // Compressed debug sections aren't supported, they are treated as absent.
+        if (item.name == name && item.data && !(item.flags & SHF_COMPRESSED)) return &item;
+    }
+    return nullptr;
+}
+
+std::string elf_file::parse_build_id(const uint8_t *notes, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    size_t offset = 0;
+    while (offset + sizeof(Elf32_Nhdr) <= size) {
+        // Note header layout is the same for both classes.
+        Elf32_Nhdr nhdr;
+        memcpy(&nhdr, notes + offset, sizeof(nhdr));
+        offset += sizeof(nhdr);
+        const size_t name_size = (nhdr.n_namesz + 3) & ~(size_t) 3;
+        const size_t desc_size = (nhdr.n_descsz + 3) & ~(size_t) 3;
+        if (name_size > size - offset || desc_size > size - offset - name_size) break;
+        if (nhdr.n_type == NT_GNU_BUILD_ID && nhdr.n_namesz == 4 && !memcmp(notes + offset, "GNU", 4)) {
+            std::string result;
+            const uint8_t * const desc = notes + offset + name_size;
+            for (size_t i = 0; i < nhdr.n_descsz; ++i) {
+                result += digits[desc[i] >> 4];
+                result += digits[desc[i] & 0xf];
+            }
+            return result;
+        }
+        offset += name_size + desc_size;
+    }
+    return std::string();
+}
+
+std::string elf_file::build_id() const {
+    for (const section &item : sections_) {
+        if (item.type != SHT_NOTE || !item.data) continue;
+        std::string result = parse_build_id(item.data, item.size);
+        if (!result.empty()) return result;
+    }
+    for (const auto &note : notes_) {
+        std::string result = parse_build_id(note.first, note.second);
+        if (!result.empty()) return result;
+    }
+    return std::string();
+}
+
+/**
+ * Appends function symbols of a symbol table section.
+ */
+template <typename Sym>
+static void read_symbols_table(
+        const elf_file::section &symtab,
+        const elf_file::section &strtab,
+        bool thumb,
+        std::vector<elf_file::symbol> &result) {
+    const Sym * const syms = (const Sym *) symtab.data;
+    const size_t count = symtab.size / sizeof(Sym);
+    for (size_t i = 0; i < count; ++i) {
+        const Sym &sym = syms[i];
+        const unsigned type = sym.st_info & 0xf;
+        if ((type != STT_FUNC && type != STT_GNU_IFUNC) || sym.st_shndx == SHN_UNDEF || !sym.st_value) continue;
+        if (sym.st_name >= strtab.size) continue;
+        uint64_t address = sym.st_value;
+        if (thumb) {
+            // The lowest bit is set for Thumb functions.
+            address &= ~(uint64_t) 1;
+        }
+        result.push_back({address, sym.st_size, (const char *) strtab.data + sym.st_name});
+    }
+}
+
+std::vector<elf_file::symbol> elf_file::read_symbols() const {
+    std::vector<symbol> result;
+    const section *symtab = find_section(".symtab");
+    if (!symtab || symtab->link >= sections_.size()) {
+        symtab = find_section(".dynsym");
+    }
+    if (!symtab || symtab->link >= sections_.size() || !sections_[symtab->link].data) return result;
+    const section &strtab = sections_[symtab->link];
+    if (is_64_) {
+        read_symbols_table<Elf64_Sym>(*symtab, strtab, false, result);
+    } else {
+        read_symbols_table<Elf32_Sym>(*symtab, strtab, machine_ == EM_ARM, result);
+    }
+
+    // Sorting by address, the largest symbol is kept for aliases.
+    std::sort(result.begin(), result.end(), [](const symbol &a, const symbol &b) {
+        return a.address != b.address ? a.address < b.address : a.size > b.size;
+    });
+    result.erase(std::unique(result.begin(), result.end(), [](const symbol &a, const symbol &b) {
+        return a.address == b.address;
+    }), result.end());
+    return result;
+}
+
+std::string demangle(const char *name) {
+    if (name[0] != '_' || name[1] != 'Z') return name;
+    int status = 0;
+    char * const demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (!demangled) return name;
+    std::string result(demangled);
+    free(demangled);
+    return result;
+}
+
+} // namespace ndcrash
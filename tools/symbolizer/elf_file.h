@@ -0,0 +1,133 @@
+#ifndef NDCRASH_SYMBOLIZER_ELF_FILE_H
+#define NDCRASH_SYMBOLIZER_ELF_FILE_H
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ndcrash {
+
+/**
+ * Read-only ELF file mapped to memory. Both 32 and 64-bit little-endian files are supported, so
+ * libraries of all Android ABIs may be processed on a 64-bit host.
+ */
+class elf_file {
+public:
+
+    /// Contents of a section.
+    struct section {
+
+        /// Section name.
+        std::string name;
+
+        /// Pointer to section data within a mapped file, nullptr for SHT_NOBITS sections.
+        const uint8_t *data = nullptr;
+
+        /// Size of section data in bytes.
+        size_t size = 0;
+
+        /// Section type, SHT_* value.
+        uint32_t type = 0;
+
+        /// Section flags, SHF_* bit mask.
+        uint64_t flags = 0;
+
+        /// Index of a linked section, for symbol tables it's a strings table.
+        uint32_t link = 0;
+    };
+
+    /// Function symbol.
+    struct symbol {
+
+        /// ELF virtual address of a function.
+        uint64_t address;
+
+        /// Size of a function in bytes, may be 0.
+        uint64_t size;
+
+        /// Null-terminated name, points to a mapped file.
+        const char *name;
+    };
+
+    /**
+     * Maps a file and parses its headers.
+     * @param path Path to a file.
+     * @return File instance or nullptr if a file couldn't be read or isn't ELF.
+     */
+    static std::unique_ptr<elf_file> open(const std::string &path);
+
+    ~elf_file();
+    elf_file(const elf_file &) = delete;
+    elf_file &operator=(const elf_file &) = delete;
+
+    /// Path of a file.
+    const std::string &path() const { return path_; }
+
+    /// Size of an address in bytes: 4 for 32-bit files, 8 for 64-bit.
+    unsigned address_size() const { return is_64_ ? 8 : 4; }
+
+    /// Machine type, EM_* value.
+    uint16_t machine() const { return machine_; }
+
+    /**
+     * Looks for a section by name.
+     * @param name Section name.
+     * @return Pointer to section description or nullptr if not found or compressed.
+     */
+    const section *find_section(const char *name) const;
+
+    /**
+     * GNU build-id from notes of this file.
+     * @return Build-id as lowercase hexadecimal string, empty if not found.
+     */
+    std::string build_id() const;
+
+    /**
+     * Reads function symbols from .symtab or .dynsym section if the first one is absent.
+     * @return Symbols sorted by address without duplicates.
+     */
+    std::vector<symbol> read_symbols() const;
+
+private:
+    elf_file() = default;
+
+    /// Parses ELF headers of a specified class.
+    template <typename Ehdr, typename Shdr, typename Phdr>
+    bool parse();
+
+    /// Looks for GNU build-id note in a notes block.
+    static std::string parse_build_id(const uint8_t *notes, size_t size);
+
+    /// Path of a file.
+    std::string path_;
+
+    /// Mapped file contents.
+    const uint8_t *data_ = nullptr;
+
+    /// Size of a file.
+    size_t size_ = 0;
+
+    /// Flag whether a file is 64-bit.
+    bool is_64_ = false;
+
+    /// Machine type.
+    uint16_t machine_ = 0;
+
+    /// All sections of a file.
+    std::vector<section> sections_;
+
+    /// Contents of PT_NOTE segments, used for build-id if there are no note sections.
+    std::vector<std::pair<const uint8_t *, size_t>> notes_;
+};
+
+/**
+ * Demangles a C++ symbol name.
+ * @param name Symbol name.
+ * @return Demangled name or passed name if it's not mangled.
+ */
+std::string demangle(const char *name);
+
+} // namespace ndcrash
+
+#endif //NDCRASH_SYMBOLIZER_ELF_FILE_H
@@ -0,0 +1,124 @@
+#include "module_cache.h"
+#include "report.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace ndcrash;
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s -s <symbols dir> [-s <symbols dir>...] [-j <threads>] [-o <output dir>|-] [-r] <report>...\n"
+            "Symbolizes ndcrash text reports using ELF files with debug information.\n"
+            "  -s  Directory with unstripped libraries, scanned recursively. Files are matched by build-id.\n"
+            "  -j  Count of worker threads, by default a count of CPU cores.\n"
+            "  -o  Output directory, '-' for stdout. By default <report>.symbolized is written.\n"
+            "  -r  Don't rewind return addresses, for reports of stackscan unwinder.\n",
+            program);
+}
+
+/// Returns a file name of a path.
+static std::string base_name(const std::string &path) {
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> directories;
+    std::string output;
+    bool rewind = true;
+    unsigned threads_count = std::thread::hardware_concurrency();
+    int opt;
+    while ((opt = getopt(argc, argv, "s:j:o:rh")) != -1) {
+        switch (opt) {
+            case 's':
+                directories.push_back(optarg);
+                break;
+            case 'j':
+                threads_count = (unsigned) atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'r':
+                rewind = false;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (directories.empty() || optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    const std::vector<std::string> reports(argv + optind, argv + argc);
+    if (!threads_count) {
+        threads_count = 1;
+    }
+    if (threads_count > reports.size()) {
+        threads_count = (unsigned) reports.size();
+    }
+
+    module_cache cache(directories);
+    fprintf(stderr, "Indexed %zu ELF files\n", cache.size());
+
+    // Workers take reports one by one. Modules are shared, so a library used by many reports is
+    // loaded and parsed once.
+    std::atomic<size_t> next(0);
+    std::atomic<int> errors(0);
+    std::mutex mutex;
+    symbolizer_stats total;
+    auto worker = [&] {
+        symbolizer_stats stats;
+        for (size_t index = next++; index < reports.size(); index = next++) {
+            const std::string &path = reports[index];
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                std::lock_guard<std::mutex> lock(mutex);
+                fprintf(stderr, "Couldn't read %s\n", path.c_str());
+                ++errors;
+                continue;
+            }
+            std::ostringstream text;
+            text << in.rdbuf();
+            const std::string result = symbolize_report(text.str(), cache, rewind, stats);
+            if (output == "-") {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::cout << result;
+                continue;
+            }
+            const std::string out_path = output.empty() ? path + ".symbolized" : output + "/" + base_name(path);
+            std::ofstream out(out_path, std::ios::binary);
+            if (!(out << result)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                fprintf(stderr, "Couldn't write %s\n", out_path.c_str());
+                ++errors;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        total.frames += stats.frames;
+        total.symbolized += stats.symbolized;
+        total.missing_modules += stats.missing_modules;
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threads_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    std::cout.flush();
+
+    fprintf(stderr, "Reports: %zu, frames: %zu, symbolized: %zu, without module: %zu\n",
+            reports.size(), total.frames, total.symbolized, total.missing_modules);
+    return errors ? 2 : 0;
+}
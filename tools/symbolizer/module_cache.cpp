@@ -0,0 +1,136 @@
+#include "module_cache.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+
+namespace ndcrash {
+
+/// Returns a file name of a path.
+static std::string base_name(const std::string &path) {
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+module::module(std::unique_ptr<elf_file> elf)
+        : elf_(std::move(elf)),
+          dwarf_(*elf_),
+          symbols_(elf_->read_symbols()) {}
+
+const elf_file::symbol *module::find_symbol(uint64_t address) const {
+    const auto it = std::upper_bound(symbols_.begin(), symbols_.end(), address,
+            [](uint64_t value, const elf_file::symbol &symbol) {
+                return value < symbol.address;
+            });
+    if (it == symbols_.begin()) return nullptr;
+    const elf_file::symbol &symbol = *(it - 1);
+
+    // Symbols with unknown size are matched up to the next symbol.
+    if (symbol.size && address >= symbol.address + symbol.size) return nullptr;
+    return &symbol;
+}
+
+bool module::symbolize(uint64_t address, symbolized_address &result) const {
+    const bool found = dwarf_.lookup(address, result.frames);
+    const elf_file::symbol * const symbol = find_symbol(address);
+    if (symbol) {
+        result.has_offset = true;
+        result.offset = address - symbol->address;
+        if (!found) {
+            result.frames.emplace_back();
+        }
+        // A symbol gives a qualified name with arguments, debug information may have only a short
+        // name for methods of local classes and lambdas.
+        result.frames.back().function = demangle(symbol->name);
+    }
+    return found || symbol;
+}
+
+module_cache::module_cache(const std::vector<std::string> &directories) {
+    for (const std::string &directory : directories) {
+        index_directory(directory);
+    }
+}
+
+void module_cache::index_directory(const std::string &path) {
+    DIR * const dir = opendir(path.c_str());
+    if (!dir) {
+        // May be a file passed directly.
+        index_file(path);
+        return;
+    }
+    std::vector<std::string> children;
+    while (const struct dirent * const item = readdir(dir)) {
+        if (!strcmp(item->d_name, ".") || !strcmp(item->d_name, "..")) continue;
+        children.push_back(path + "/" + item->d_name);
+    }
+    closedir(dir);
+
+    // Sorting for deterministic choice between equal files.
+    std::sort(children.begin(), children.end());
+    for (const std::string &child : children) {
+        struct stat st;
+        if (lstat(child.c_str(), &st)) continue;
+        if (S_ISDIR(st.st_mode)) {
+            index_directory(child);
+        } else if (S_ISREG(st.st_mode) || S_ISLNK(st.st_mode)) {
+            index_file(child);
+        }
+    }
+}
+
+void module_cache::index_file(const std::string &path) {
+    const std::unique_ptr<elf_file> elf = elf_file::open(path);
+    if (!elf) return;
+    std::unique_ptr<entry> item(new entry());
+    item->path = path;
+    item->build_id = elf->build_id();
+    item->rank = elf->find_section(".debug_info") ? 2 : elf->find_section(".symtab") ? 1 : 0;
+
+    if (!item->build_id.empty()) {
+        entry *&existing = by_build_id_[item->build_id];
+        if (existing) {
+            // The same build-id is already indexed, replacing it only with a better file.
+            if (existing->rank >= item->rank) return;
+            existing->path = item->path;
+            existing->rank = item->rank;
+            return;
+        }
+        existing = item.get();
+    }
+
+    // Different files with the same name make it ambiguous.
+    const std::string name = base_name(path);
+    const auto it = by_name_.find(name);
+    if (it == by_name_.end()) {
+        by_name_.emplace(name, item.get());
+    } else if (it->second && (it->second->build_id.empty() || it->second->build_id != item->build_id)) {
+        it->second = nullptr;
+    }
+    entries_.push_back(std::move(item));
+}
+
+std::shared_ptr<const module> module_cache::load(entry &item) {
+    std::call_once(item.loaded, [&item] {
+        std::unique_ptr<elf_file> elf = elf_file::open(item.path);
+        if (elf) {
+            item.instance = std::make_shared<const module>(std::move(elf));
+        }
+    });
+    return item.instance;
+}
+
+std::shared_ptr<const module> module_cache::find(const std::string &build_id, const std::string &path) {
+    if (!build_id.empty()) {
+        const auto it = by_build_id_.find(build_id);
+        if (it != by_build_id_.end()) return load(*it->second);
+    }
+
+    // Looking up by name, files with a known different build-id don't match.
+    const auto it = by_name_.find(base_name(path));
+    if (it == by_name_.end() || !it->second) return nullptr;
+    if (!build_id.empty() && !it->second->build_id.empty()) return nullptr;
+    return load(*it->second);
+}
+
+} // namespace ndcrash
@@ -0,0 +1,114 @@
+#ifndef NDCRASH_SYMBOLIZER_MODULE_CACHE_H
+#define NDCRASH_SYMBOLIZER_MODULE_CACHE_H
+#include "dwarf.h"
+#include "elf_file.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ndcrash {
+
+/**
+ * Result of address symbolization.
+ */
+struct symbolized_address {
+
+    /// Frames of an address, the innermost inlined function first and a real function last.
+    std::vector<source_frame> frames;
+
+    /// Flag whether a real function start is known from a symbols table.
+    bool has_offset = false;
+
+    /// Offset of an address from a real function start.
+    uint64_t offset = 0;
+};
+
+/**
+ * Symbolization data of a single ELF file: debug information and function symbols.
+ * Immutable after loading except lazily parsed compile units, safe for concurrent use.
+ */
+class module {
+public:
+    explicit module(std::unique_ptr<elf_file> elf);
+
+    /**
+     * Symbolizes an address. Debug information is preferred, a symbols table is used for a
+     * function name if there's no debug information for an address.
+     * @param address ELF virtual address.
+     * @param result Where to store a result.
+     * @return Flag whether anything is known about an address.
+     */
+    bool symbolize(uint64_t address, symbolized_address &result) const;
+
+private:
+
+    /// Looks for a function symbol containing an address, nullptr if not found.
+    const elf_file::symbol *find_symbol(uint64_t address) const;
+
+    std::unique_ptr<elf_file> elf_;
+    dwarf_info dwarf_;
+    std::vector<elf_file::symbol> symbols_;
+};
+
+/**
+ * Index of ELF files in symbol directories. Files are found by GNU build-id or by a file name if
+ * a report has no build-id and the name is unambiguous. Files are indexed once on construction and
+ * loaded on demand, each file is loaded once and shared between threads.
+ */
+class module_cache {
+public:
+
+    /**
+     * Indexes ELF files in directories recursively. When several files have the same build-id
+     * a file with debug information is preferred, then a file with a symbols table.
+     * @param directories Directories to scan.
+     */
+    explicit module_cache(const std::vector<std::string> &directories);
+
+    /// Count of indexed files.
+    size_t size() const { return entries_.size(); }
+
+    /**
+     * Looks for a module.
+     * @param build_id Build-id of a module from a report, may be empty.
+     * @param path Path of a module on a device.
+     * @return Loaded module or nullptr if not found or couldn't be loaded.
+     */
+    std::shared_ptr<const module> find(const std::string &build_id, const std::string &path);
+
+private:
+
+    /// Indexed file.
+    struct entry {
+        std::string path;
+        std::string build_id;
+
+        /// The larger the better: 2 for debug information, 1 for symbols table, 0 otherwise.
+        int rank;
+
+        std::once_flag loaded;
+        std::shared_ptr<const module> instance;
+    };
+
+    /// Recursively indexes a directory.
+    void index_directory(const std::string &path);
+
+    /// Indexes a single file if it's ELF.
+    void index_file(const std::string &path);
+
+    /// Loads a module of an entry once.
+    std::shared_ptr<const module> load(entry &item);
+
+    std::vector<std::unique_ptr<entry>> entries_;
+    std::unordered_map<std::string, entry *> by_build_id_;
+
+    /// Entries by file name, nullptr for ambiguous names.
+    std::unordered_map<std::string, entry *> by_name_;
+};
+
+} // namespace ndcrash
+
+#endif //NDCRASH_SYMBOLIZER_MODULE_CACHE_H
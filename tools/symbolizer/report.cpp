@@ -0,0 +1,90 @@
+#include "report.h"
+#include <sstream>
+#include <unordered_map>
+
+namespace ndcrash {
+
+/// Appends " at file:line" if a position is known.
+static void append_position(std::string &out, const source_frame &frame) {
+    if (frame.file.empty()) return;
+    out += " at ";
+    out += frame.file;
+    if (frame.line) {
+        out += ':';
+        out += std::to_string(frame.line);
+    }
+}
+
+std::string symbolize_report(const std::string &text, module_cache &cache, bool rewind, symbolizer_stats &stats) {
+    // Modules section is written after backtraces, reading it first.
+    std::unordered_map<std::string, std::string> build_ids;
+    {
+        std::istringstream in(text);
+        std::string line, path, build_id;
+        bool modules = false;
+        while (std::getline(in, line)) {
+            if (line == "modules:") {
+                modules = true;
+            } else if (modules && parse_module_line(line, path, build_id)) {
+                build_ids[path] = build_id;
+            } else {
+                modules = false;
+            }
+        }
+    }
+
+    std::string out;
+    out.reserve(text.size() * 2);
+    std::istringstream in(text);
+    std::string line;
+    report_frame frame;
+    while (std::getline(in, line)) {
+        if (!parse_frame_line(line, frame) || frame.map.empty() || frame.map[0] != '/') {
+            out += line;
+            out += '\n';
+            continue;
+        }
+        ++stats.frames;
+        const auto build_id = build_ids.find(frame.map);
+        const std::shared_ptr<const module> found = cache.find(
+                build_id != build_ids.end() ? build_id->second : std::string(), frame.map);
+        symbolized_address result;
+
+        // Return addresses point after a call instruction, the previous byte belongs to a call.
+        const uint64_t address = rewind && frame.number && frame.pc ? frame.pc - 1 : frame.pc;
+        if (!found) {
+            ++stats.missing_modules;
+        }
+        if (!found || !found->symbolize(address, result)) {
+            out += line;
+            out += '\n';
+            continue;
+        }
+        ++stats.symbolized;
+
+        // The first line is the innermost function, following lines are its callers if inlined.
+        out += line.substr(0, line.find(frame.map) + frame.map.size());
+        for (size_t i = 0; i < result.frames.size(); ++i) {
+            const source_frame &item = result.frames[i];
+            if (i) {
+                out += "\n        (inlined by)";
+            }
+            if (!item.function.empty()) {
+                out += i ? " " : " (";
+                out += item.function;
+                if (result.has_offset && i + 1 == result.frames.size()) {
+                    out += '+';
+                    out += std::to_string(frame.pc - (address - result.offset));
+                }
+                if (!i) out += ')';
+            } else if (i) {
+                out += " ??";
+            }
+            append_position(out, item);
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+} // namespace ndcrash
@@ -0,0 +1,32 @@
+#ifndef NDCRASH_SYMBOLIZER_REPORT_H
+#define NDCRASH_SYMBOLIZER_REPORT_H
+#include "module_cache.h"
+#include "report_format.h"
+#include <string>
+
+namespace ndcrash {
+
+/**
+ * Counters of symbolization, summed over all reports.
+ */
+struct symbolizer_stats {
+    size_t frames = 0;
+    size_t symbolized = 0;
+    size_t missing_modules = 0;
+};
+
+/**
+ * Symbolizes a text report: source positions and inlined functions are added to backtrace lines.
+ * Lines that couldn't be symbolized are kept as is.
+ * @param text Report contents.
+ * @param cache Modules cache.
+ * @param rewind Flag whether return addresses should be moved to a call instruction. Should be
+ * false for reports of stackscan unwinder, it rewinds them itself.
+ * @param stats Counters to increment.
+ * @return Symbolized report.
+ */
+std::string symbolize_report(const std::string &text, module_cache &cache, bool rewind, symbolizer_stats &stats);
+
+} // namespace ndcrash
+
+#endif //NDCRASH_SYMBOLIZER_REPORT_H
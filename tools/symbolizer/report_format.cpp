@@ -0,0 +1,64 @@
+#include "report_format.h"
+#include <cstdlib>
+
+namespace ndcrash {
+
+/// Parses a hexadecimal number at a position, returns a position after it or npos.
+static size_t parse_hex(const std::string &line, size_t pos, uint64_t &value) {
+    const char * const begin = line.c_str() + pos;
+    char *end = nullptr;
+    value = strtoull(begin, &end, 16);
+    return end == begin ? std::string::npos : pos + (size_t) (end - begin);
+}
+
+bool parse_frame_line(const std::string &line, report_frame &frame) {
+    static const char prefix[] = "    #";
+    if (line.compare(0, sizeof(prefix) - 1, prefix)) return false;
+    size_t pos = sizeof(prefix) - 1;
+    char *end = nullptr;
+    frame.number = (unsigned) strtoul(line.c_str() + pos, &end, 10);
+    pos = (size_t) (end - line.c_str());
+    if (line.compare(pos, 4, " pc ")) return false;
+    pos = parse_hex(line, pos + 4, frame.pc);
+    if (pos == std::string::npos || line.compare(pos, 2, "  ")) return false;
+    pos += 2;
+
+    // A function is in parentheses after a map name: " (name+offset)".
+    frame.function.clear();
+    frame.function_offset = 0;
+    const size_t open = line.find(" (", pos);
+    if (open != std::string::npos && line.back() == ')') {
+        const size_t plus = line.rfind('+');
+        if (plus != std::string::npos && plus > open) {
+            frame.map = line.substr(pos, open - pos);
+            frame.function = line.substr(open + 2, plus - open - 2);
+            frame.function_offset = strtoll(line.c_str() + plus + 1, nullptr, 10);
+            return true;
+        }
+    }
+    frame.map = line.substr(pos);
+    return true;
+}
+
+bool parse_module_line(const std::string &line, std::string &path, std::string &build_id) {
+    static const char build_id_prefix[] = " (BuildId: ";
+    uint64_t value;
+    if (line.compare(0, 4, "    ")) return false;
+    size_t pos = parse_hex(line, 4, value);
+    if (pos == std::string::npos || line.compare(pos, 1, " ")) return false;
+    pos = parse_hex(line, pos + 1, value);
+    if (pos == std::string::npos || line.compare(pos, 2, "  ")) return false;
+    pos += 2;
+    const size_t build_id_pos = line.rfind(build_id_prefix);
+    if (build_id_pos != std::string::npos && build_id_pos >= pos && line.back() == ')') {
+        path = line.substr(pos, build_id_pos - pos);
+        const size_t begin = build_id_pos + sizeof(build_id_prefix) - 1;
+        build_id = line.substr(begin, line.size() - 1 - begin);
+    } else {
+        path = line.substr(pos);
+        build_id.clear();
+    }
+    return true;
+}
+
+} // namespace ndcrash
@@ -0,0 +1,47 @@
+#ifndef NDCRASH_SYMBOLIZER_REPORT_FORMAT_H
+#define NDCRASH_SYMBOLIZER_REPORT_FORMAT_H
+#include <cstdint>
+#include <string>
+
+namespace ndcrash {
+
+/**
+ * Backtrace line of a report, see ndcrash_dump_backtrace_line. Example:
+ * "    #01 pc 00000000000035d9  /data/app/lib/arm64/libfoo.so (foo+9)"
+ */
+struct report_frame {
+
+    /// Frame number.
+    unsigned number = 0;
+
+    /// Program counter relative to a module start.
+    uint64_t pc = 0;
+
+    /// Module path, "<unknown>" or "<anonymous>" if a module isn't known.
+    std::string map;
+
+    /// Function name reported by a device, empty if absent.
+    std::string function;
+
+    /// Offset within a function reported by a device.
+    int64_t function_offset = 0;
+};
+
+/**
+ * Parses a backtrace line.
+ * @return Flag whether a line is a backtrace line.
+ */
+bool parse_frame_line(const std::string &line, report_frame &frame);
+
+/**
+ * Parses a line of "modules:" section, see ndcrash_dump_module_line. Example:
+ * "    00005643d42d2000 0000000000000000  /system/lib64/libc.so (BuildId: 3e73c6e9...)"
+ * @param path Where to store a module path.
+ * @param build_id Where to store a build-id, empty if absent.
+ * @return Flag whether a line is a module line.
+ */
+bool parse_module_line(const std::string &line, std::string &path, std::string &build_id);
+
+} // namespace ndcrash
+
+#endif //NDCRASH_SYMBOLIZER_REPORT_FORMAT_H
@@ -0,0 +1,6 @@
+// Library symbolized by symbolizer_test. It's built with debug information and a GNU build-id, the
+// test finds expected source lines by markers in comments, so lines may be moved freely.
+
+extern "C" int ndcrash_fixture_function(int value) { // fixture: function line
+    return value * 3 + 1;
+}
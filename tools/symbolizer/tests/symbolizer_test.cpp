@@ -0,0 +1,125 @@
+#include "module_cache.h"
+#include "report.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace ndcrash;
+
+/// Count of failed checks, returned from main as an exit code.
+static int failures = 0;
+
+/// Checks a condition, reports a location of a failed check and continues.
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while (0)
+
+/// Device path of a fixture library written to reports.
+static const char fixture_device_path[] = "/data/app/com.example-1/lib/arm64/libndcrash-symbolizer-fixture.so";
+
+/// Returns a 1-based number of a source line containing a marker, 0 if not found.
+static unsigned find_marker_line(const std::string &source_path, const std::string &marker) {
+    std::ifstream in(source_path);
+    std::string line;
+    for (unsigned number = 1; std::getline(in, line); ++number) {
+        if (line.find(marker) != std::string::npos) return number;
+    }
+    return 0;
+}
+
+/// Returns a hexadecimal value padded by zeroes to 16 digits as in reports.
+static std::string hex(uint64_t value) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long) value);
+    return buffer;
+}
+
+/// Creates a report with a single frame of a fixture library.
+static std::string make_report(uint64_t pc, const std::string &build_id) {
+    return "backtrace:\n"
+           "    #00 pc " + hex(pc) + "  " + fixture_device_path + "\n"
+           "\n"
+           "modules:\n"
+           "    0000007f00000000 0000000000000000  " + fixture_device_path + " (BuildId: " + build_id + ")\n";
+}
+
+/// Looks for a fixture function address in a symbols table.
+static uint64_t find_function(const elf_file &elf) {
+    for (const elf_file::symbol &symbol : elf.read_symbols()) {
+        if (!strcmp(symbol.name, "ndcrash_fixture_function")) return symbol.address;
+    }
+    return 0;
+}
+
+static void test_symbolize(const std::string &library, const std::string &source) {
+    const std::unique_ptr<elf_file> elf = elf_file::open(library);
+    CHECK(elf);
+    if (!elf) return;
+    const std::string build_id = elf->build_id();
+    const uint64_t address = find_function(*elf);
+    const unsigned line = find_marker_line(source, "// fixture: function line");
+    CHECK(!build_id.empty());
+    CHECK(address);
+    CHECK(line);
+
+    module_cache cache({ library });
+    CHECK(cache.size() == 1);
+    symbolizer_stats stats;
+    const std::string result = symbolize_report(make_report(address, build_id), cache, true, stats);
+    CHECK(stats.frames == 1);
+    CHECK(stats.symbolized == 1);
+    CHECK(stats.missing_modules == 0);
+
+    const std::string expected = std::string(fixture_device_path) + " (ndcrash_fixture_function+0) at ";
+    const size_t position = result.find(expected);
+    CHECK(position != std::string::npos);
+    if (position == std::string::npos) {
+        fprintf(stderr, "Unexpected result:\n%s", result.c_str());
+        return;
+    }
+
+    // File is written as a compiler has got it, only a file name and a line are checked.
+    const std::string location = "fixture.cpp:" + std::to_string(line) + "\n";
+    const size_t location_position = result.find(location, position + expected.size());
+    CHECK(location_position != std::string::npos);
+    CHECK(result.find('\n', position) == location_position + location.size() - 1);
+}
+
+static void test_build_id_mismatch(const std::string &library) {
+    const std::unique_ptr<elf_file> elf = elf_file::open(library);
+    CHECK(elf);
+    if (!elf) return;
+    std::string build_id = elf->build_id();
+    CHECK(!build_id.empty());
+    if (build_id.empty()) return;
+    build_id[0] = build_id[0] == '0' ? '1' : '0';
+
+    // The same file name with another build-id must not be used, a frame is kept as is.
+    module_cache cache({ library });
+    CHECK(!cache.find(build_id, fixture_device_path));
+    symbolizer_stats stats;
+    const std::string report = make_report(find_function(*elf), build_id);
+    const std::string result = symbolize_report(report, cache, true, stats);
+    CHECK(result == report);
+    CHECK(stats.frames == 1);
+    CHECK(stats.symbolized == 0);
+    CHECK(stats.missing_modules == 1);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <fixture library> <fixture source>\n", argv[0]);
+        return 1;
+    }
+    test_symbolize(argv[1], argv[2]);
+    test_build_id_mismatch(argv[1]);
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+    }
+    return failures ? 1 : 0;
+}